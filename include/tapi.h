@@ -27,6 +27,7 @@
 
 #include <errno.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <sys/types.h>
 
 /****************************************************************************
@@ -48,6 +49,12 @@
 
 #define DEFAULT_SLOT_ID 0
 
+/* Up to 20 digits packed two per byte */
+#define MAX_NUMBER_KEY_BCD_SIZE 10
+
+#define NUMBER_KEY_INTERNATIONAL 0x01 /* digits start with the country code */
+#define NUMBER_KEY_SHORT 0x02 /* service or short code, kept as dialed */
+
 #define KEY_CARRIER_CONFIG_SPN_STRING "Spn"
 
 /****************************************************************************
@@ -154,6 +161,7 @@ typedef enum {
     NETWORK_TYPE_HSPA = 12,
     NETWORK_TYPE_LTE = 13,
     NETWORK_TYPE_LTE_CA = 19,
+    NETWORK_TYPE_NR = 20,
 } tapi_network_type;
 
 typedef enum {
@@ -174,6 +182,16 @@ typedef struct {
     int type;
 } tapi_phone_number;
 
+/* Canonical form of a phone number, equal numbers have byte-equal keys.
+ * Digits are packed BCD, low nibble first, '*' is 0xA, '#' is 0xB and
+ * unused nibbles are 0xF.
+ */
+typedef struct {
+    uint8_t flags;
+    uint8_t length;
+    uint8_t bcd[MAX_NUMBER_KEY_BCD_SIZE];
+} tapi_number_key;
+
 typedef enum {
     RESPONSE = 0,
     INDICATION = 1,
@@ -281,6 +299,12 @@ typedef enum {
 
     MSG_MODEM_ECC_LIST_CHANGE_IND = 61,
 
+    // Network Indication Message
+    MSG_CELLINFO_DIFF_IND,
+
+    // Data Indication Message
+    MSG_DATA_STALL_IND,
+
     // tapi indication msg value max.
     MSG_IND_MASK,
 
@@ -338,4 +362,36 @@ const char* tapi_sim_state_to_string(tapi_sim_state sim_state);
 const char* tapi_utils_clir_status_to_string(tapi_clir_status status);
 tapi_clir_status tapi_utils_clir_status_from_string(const char* status);
 
+/**
+ * Convert a number to its canonical key.
+ * National numbers are expanded to E.164 with the country of the MCC,
+ * visual separators are dropped and post-dial digits are ignored.
+ * @param[in] number         Phone number as dialed or received.
+ * @param[in] mcc            Current MCC, NULL or empty if unknown.
+ * @param[out] out           Number key.
+ * @return Zero on success; a negated errno value on failure.
+ */
+int tapi_utils_number_key_from_string(const char* number, const char* mcc,
+    tapi_number_key* out);
+
+/**
+ * Convert a number to its canonical key with the MCC of the slot.
+ * Recent results are cached in the context.
+ * @param[in] context        Telephony api context.
+ * @param[in] slot_id        Slot id of current sim.
+ * @param[in] number         Phone number as dialed or received.
+ * @param[out] out           Number key.
+ * @return Zero on success; a negated errno value on failure.
+ */
+int tapi_utils_normalize_number(tapi_context context, int slot_id, const char* number,
+    tapi_number_key* out);
+
+bool tapi_utils_number_key_equal(const tapi_number_key* a, const tapi_number_key* b);
+
+/**
+ * Format a number key, international keys are prefixed with '+'.
+ * @return Length of the string; a negated errno value on failure.
+ */
+int tapi_utils_number_key_to_string(const tapi_number_key* key, char* out, int size);
+
 #endif /* __TELEPHONY_APIS_H */
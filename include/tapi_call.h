@@ -25,6 +25,7 @@
  * Included Files
  ****************************************************************************/
 
+#include <stdint.h>
 #include <tapi.h>
 #include <time.h>
 
@@ -44,6 +45,24 @@
 #define MAX_CALL_INFO_LENGTH 100
 #define MAX_CALL_LIST_COUNT 10
 #define MAX_IMS_CONFERENCE_CALLS 5
+#define MAX_CONFERENCE_BATCH_OPS 8
+#define MAX_CALL_EVENT_COALESCE_WINDOW 100 /* ms */
+
+#define MAX_DTMF_SEQUENCE_LENGTH 64
+
+#define CALL_RECORD_MULTIPARTY 0x01
+#define CALL_RECORD_REMOTE_HELD 0x02
+#define CALL_RECORD_REMOTE_MULTIPARTY 0x04
+#define CALL_RECORD_EMERGENCY 0x08
+
+#define CALL_KPI_BUCKET_COUNT 8
+#define CALL_KPI_DISCONNECT_REASON_COUNT (CALL_DISCONNECT_REASON_ERROR + 1)
+
+#define MAX_CALL_HISTORY_NUMBER_LENGTH 39
+
+#define CALL_HISTORY_INCOMING 0x01
+#define CALL_HISTORY_ANSWERED 0x02 /* reached the active state */
+#define CALL_HISTORY_EMERGENCY 0x04
 
 /****************************************************************************
  * Public Types
@@ -113,6 +132,125 @@ typedef struct {
     unsigned int condition;
 } ecc_info;
 
+typedef enum {
+    CONFERENCE_OP_DIAL, /* DialConference with participants */
+    CONFERENCE_OP_INVITE, /* InviteParticipants with participants */
+    CONFERENCE_OP_MERGE, /* CreateMultiparty */
+    CONFERENCE_OP_SEPARATE, /* PrivateChat with call_id */
+    CONFERENCE_OP_HANGUP, /* Hangup call_id */
+    CONFERENCE_OP_HANGUP_MULTIPARTY, /* HangupMultiparty */
+} tapi_conference_op_type;
+
+typedef struct {
+    tapi_conference_op_type type;
+    int count;
+    char* participants[MAX_IMS_CONFERENCE_CALLS];
+    char* call_id;
+} tapi_conference_op;
+
+typedef struct {
+    tapi_conference_op_type type;
+    int status; /* OK, ERROR or -ECANCELED if not executed */
+    int calls; /* calls in the multiparty after MERGE and SEPARATE */
+} tapi_conference_op_result;
+
+typedef struct {
+    int count;
+    int failed;
+    tapi_conference_op_result results[MAX_CONFERENCE_BATCH_OPS];
+} tapi_conference_batch_result;
+
+typedef struct {
+    u_int32_t on_duration; /* ms a digit is played */
+    u_int32_t off_duration; /* ms of silence after a digit */
+    u_int32_t pause_duration; /* ms of a ',' pause */
+    u_int32_t wait_duration; /* ms of a ';' pause */
+} tapi_dtmf_sequence_config;
+
+typedef struct {
+    char digit;
+    int status; /* OK, ERROR or a negated errno value */
+    int jitter; /* us between scheduled and actual start of the tone */
+} tapi_dtmf_digit_result;
+
+typedef struct {
+    int count;
+    bool cancelled;
+    int max_jitter; /* us */
+    int mean_jitter; /* us */
+    tapi_dtmf_digit_result digits[MAX_DTMF_SEQUENCE_LENGTH];
+} tapi_dtmf_sequence_result;
+
+/* Bucket 0 counts samples below unit ms, bucket i samples below unit << i ms,
+ * the last bucket takes everything above.
+ */
+typedef struct {
+    u_int32_t unit;
+    u_int32_t count;
+    u_int32_t min; /* ms */
+    u_int32_t max; /* ms */
+    u_int64_t sum; /* ms */
+    u_int32_t buckets[CALL_KPI_BUCKET_COUNT];
+} tapi_call_kpi_histogram;
+
+typedef struct {
+    tapi_call_kpi_histogram dial_reply; /* dial request to Dial reply */
+    tapi_call_kpi_histogram dial_alerting; /* dial request to alerting */
+    tapi_call_kpi_histogram dial_active; /* dial request to active */
+    tapi_call_kpi_histogram incoming_answer; /* incoming to active */
+    tapi_call_kpi_histogram duration; /* active to disconnected */
+    u_int32_t dial_rejected; /* Dial replied with an error */
+    u_int32_t setup_failed; /* outgoing call ended before active */
+    u_int32_t missed; /* incoming call ended before active */
+    u_int32_t disconnect_reasons[CALL_KPI_DISCONNECT_REASON_COUNT];
+} tapi_call_kpi_stats;
+
+/* Compact form of tapi_call_info, 18 bytes per call. Strings are offsets
+ * into the arena of the owning tapi_call_record_list and equal strings are
+ * stored once. call_id is split at its last '/' so that the modem path prefix
+ * is shared by all calls of the list.
+ */
+typedef struct {
+    uint16_t call_path;
+    uint16_t call_id;
+    uint16_t line_identification;
+    uint16_t incoming_line;
+    uint16_t name;
+    uint16_t start_time;
+    uint16_t info;
+    int8_t state;
+    uint8_t disconnect_reason;
+    uint8_t icon;
+    uint8_t flags;
+} tapi_call_record;
+
+/* Single allocation, release with free() */
+typedef struct {
+    int count;
+    tapi_call_record records[MAX_CALL_LIST_COUNT];
+    uint16_t arena_size;
+    char* arena;
+} tapi_call_record_list;
+
+/* One finished call, 64 bytes as stored in the call history file */
+typedef struct {
+    u_int32_t start; /* seconds since the epoch when the call was seen first */
+    u_int32_t duration; /* seconds in the active state */
+    uint8_t slot_id;
+    uint8_t flags; /* CALL_HISTORY_* */
+    uint8_t reason; /* tapi_call_disconnect_reason */
+    uint8_t reserved;
+    tapi_number_key key; /* empty for withheld numbers */
+    char number[MAX_CALL_HISTORY_NUMBER_LENGTH + 1];
+} tapi_call_history_record;
+
+typedef struct {
+    u_int32_t from; /* start time range, 0 for unbounded */
+    u_int32_t to;
+    const tapi_number_key* key; /* NULL for any number */
+    uint8_t flags; /* records must have all of these flags */
+} tapi_call_history_filter;
+
 /****************************************************************************
  * Public Function Prototypes
  ****************************************************************************/
@@ -230,6 +368,9 @@ int tapi_call_send_tones(void* context, int slot_id, char* tones);
 
 /**
  * Get all calls.
+ * Once the call list of the slot is synced the callback is posted from the
+ * loop with a copy of the library's mirror, otherwise GetCalls is sent;
+ * result->data is only valid inside the callback.
  * @param[in] context        Telephony api context.
  * @param[in] slot_id        Slot id of current sim.
  * @param[in] event_id       Async event identifier.
@@ -243,14 +384,80 @@ int tapi_call_get_all_calls(tapi_context context, int slot_id, int event_id,
  * @param[in] context        Telephony api context.
  * @param[in] slot_id        Slot id of current sim.
  * @param[in] state          Call state.
- * @param[in] call_list      All calls of current sim.
- * @param[in] size           Count of call list.
- * @param[out] out_list      Call list of matched call state.
+ * @param[in] call_list      All calls of current sim, NULL to use the library call list.
+ * @param[in] size           Count of call list, ignored when call_list is NULL.
+ * @param[out] out_list      Call list of matched call state,
+ *                           MAX_CALL_LIST_COUNT entries when call_list is NULL.
  * @return Positive value as matched size on success; a negated errno value on failure.
  */
 int tapi_call_get_call_by_state(tapi_context context, int slot_id,
     int state, tapi_call_info* call_list, int size, tapi_call_info* out_list);
 
+/**
+ * Get all calls as compact records.
+ * The callback receives a tapi_call_record_list in data and the call count
+ * in arg2. The list is released once the callback returns.
+ * @param[in] context        Telephony api context.
+ * @param[in] slot_id        Slot id of current sim.
+ * @param[in] event_id       Async event identifier.
+ * @param[in] p_handle       Event callback.
+ * @return Zero on success; a negated errno value on failure.
+ */
+int tapi_call_get_all_call_records(tapi_context context, int slot_id, int event_id,
+    tapi_async_function p_handle);
+
+/**
+ * Get a string of a call record.
+ * @param[in] list           Call record list owning the record.
+ * @param[in] offset         String field of the record, e.g. record->name.
+ * @return Pointer to the string inside the list arena.
+ */
+const char* tapi_call_record_get_string(const tapi_call_record_list* list, uint16_t offset);
+
+/**
+ * Get the full call id of a call record.
+ * @param[in] list           Call record list owning the record.
+ * @param[in] record         Call record.
+ * @param[out] out           Call id container.
+ * @param[in] size           Size of call id container.
+ * @return Zero on success; a negated errno value on failure.
+ */
+int tapi_call_record_get_id(const tapi_call_record_list* list,
+    const tapi_call_record* record, char* out, int size);
+
+/**
+ * Convert a call record to the legacy call info.
+ * @param[in] list           Call record list owning the record.
+ * @param[in] record         Call record.
+ * @param[out] out           Call info.
+ * @return Zero on success; a negated errno value on failure.
+ */
+int tapi_call_record_to_info(const tapi_call_record_list* list,
+    const tapi_call_record* record, tapi_call_info* out);
+
+/**
+ * Build a compact call record list from legacy call infos.
+ * @param[in] call_list      Call infos.
+ * @param[in] count          Count of call infos, at most MAX_CALL_LIST_COUNT.
+ * @return Pointer to a list to be released with free() or NULL on failure.
+ */
+tapi_call_record_list* tapi_call_record_list_from_info(const tapi_call_info* call_list, int count);
+
+/**
+ * Get a snapshot of current calls without D-Bus round trip.
+ * The call list is kept up to date from CallAdded, CallRemoved and call
+ * PropertyChanged signals, and only refreshed by GetCalls after modem restart.
+ * The call list is created on first use, so the first call may return -EAGAIN.
+ * @param[in] context        Telephony api context.
+ * @param[in] slot_id        Slot id of current sim.
+ * @param[out] out           Call list container.
+ * @param[in] size           Max count of call list container.
+ * @return Count of calls on success; -EAGAIN if the call list is not synced yet;
+ * a negated errno value on failure.
+ */
+int tapi_call_get_call_list_snapshot(tapi_context context, int slot_id,
+    tapi_call_info* out, int size);
+
 /**
  * Get all ecc list
  * @param[in] context        Telephony api context.
@@ -268,6 +475,29 @@ int tapi_call_get_ecc_list(tapi_context context, int slot_id, ecc_info* out);
  */
 int tapi_call_is_emergency_number(tapi_context context, char* number);
 
+/**
+ * Look up a number in the emergency number index of one slot.
+ * The index is rebuilt only when the ecc list of the slot changes.
+ * @param[in] context        Telephony api context.
+ * @param[in] slot_id        Slot id of current sim.
+ * @param[in] number         Phone number.
+ * @param[out] out           Matched ecc info, may be NULL. ecc_num stays valid
+ *                           until the ecc list changes.
+ * @return 1 if number is emergency number, 0 if not; a negated errno value on failure.
+ */
+int tapi_call_match_emergency_number(tapi_context context, int slot_id,
+    const char* number, ecc_info* out);
+
+/**
+ * Count emergency numbers starting with the given prefix, e.g. while dialing.
+ * @param[in] context        Telephony api context.
+ * @param[in] slot_id        Slot id of current sim.
+ * @param[in] prefix         Dialed digits so far.
+ * @return Count of emergency numbers matching the prefix on success;
+ * a negated errno value on failure.
+ */
+int tapi_call_match_emergency_prefix(tapi_context context, int slot_id, const char* prefix);
+
 /**
  * Register ecc list change callback.
  * @param[in] context        Telephony api context.
@@ -322,6 +552,7 @@ int tapi_call_invite_participants(tapi_context context, int slot_id, char* parti
 
 /**
  * Register call event callback.
+ * With event coalescing enabled, arg2 holds the count of merged changes.
  * @param[in] context        Telephony api context.
  * @param[in] slot_id        Slot id of current sim.
  * @param[in] user_obj       User data.
@@ -382,6 +613,135 @@ int tapi_call_start_dtmf(tapi_context context, int slot_id, unsigned char digit,
 int tapi_call_stop_dtmf(tapi_context context, int slot_id, int event_id,
     tapi_async_function p_handle);
 
+/**
+ * Play a DTMF sequence with client-side pacing.
+ * ',' and ';' insert a pause of pause_duration and wait_duration. Tones are
+ * paced by one timer against an absolute schedule and start/stop requests are
+ * not serialized on their replies. The callback is invoked once with a
+ * tapi_dtmf_sequence_result in data and the count of played digits in arg2.
+ * @param[in] context        Telephony api context.
+ * @param[in] slot_id        Slot id of current sim.
+ * @param[in] sequence       DTMF digits and pause characters.
+ * @param[in] config         Tone durations, NULL for default.
+ * @param[in] event_id       Async event identifier.
+ * @param[in] p_handle       Event callback.
+ * @return Zero on success; -EBUSY if a sequence is playing on the slot;
+ * a negated errno value on failure.
+ */
+int tapi_call_play_dtmf_sequence(tapi_context context, int slot_id, const char* sequence,
+    const tapi_dtmf_sequence_config* config, int event_id, tapi_async_function p_handle);
+
+/**
+ * Cancel the DTMF sequence playing on the slot.
+ * The sequence callback is invoked with cancelled set once pending requests finished.
+ * @param[in] context        Telephony api context.
+ * @param[in] slot_id        Slot id of current sim.
+ * @return Zero on success; a negated errno value on failure.
+ */
+int tapi_call_cancel_dtmf_sequence(tapi_context context, int slot_id);
+
+/**
+ * Run a set of conference operations as one request.
+ * Operations are executed in order, each one is sent as soon as the reply
+ * to the previous one is received, and the callback is invoked once with a
+ * tapi_conference_batch_result in data and the count of successful
+ * operations in arg2. Strings of ops are copied.
+ * @param[in] context        Telephony api context.
+ * @param[in] slot_id        Slot id of current sim.
+ * @param[in] ops            Operations to run.
+ * @param[in] count          Count of operations.
+ * @param[in] stop_on_error  Cancel the remaining operations after a failure.
+ * @param[in] event_id       Async event identifier.
+ * @param[in] p_handle       Event callback.
+ * @return Zero on success; a negated errno value on failure.
+ */
+int tapi_call_conference_batch(tapi_context context, int slot_id, const tapi_conference_op* ops,
+    int count, bool stop_on_error, int event_id, tapi_async_function p_handle);
+
+/**
+ * Get call setup and duration KPIs of the slot.
+ * Collection starts with the first get or reset on the context; every call
+ * seen since then is accounted, whether or not the client listens to call
+ * state changes.
+ * @param[in] context        Telephony api context.
+ * @param[in] slot_id        Slot id of current sim.
+ * @param[out] out           KPI histograms and counters.
+ * @return Zero on success; a negated errno value on failure.
+ */
+int tapi_call_get_kpi_stats(tapi_context context, int slot_id, tapi_call_kpi_stats* out);
+
+/**
+ * Clear the call KPIs of the slot, calls in progress are still tracked.
+ * @param[in] context        Telephony api context.
+ * @param[in] slot_id        Slot id of current sim.
+ * @return Zero on success; a negated errno value on failure.
+ */
+int tapi_call_reset_kpi_stats(tapi_context context, int slot_id);
+
+/**
+ * Coalesce call state and ring back tone indications of the slot.
+ * Changes of one call received within the window are merged, and the call
+ * state callback is invoked once with the latest tapi_call_info. Incoming,
+ * waiting and disconnected calls are delivered at once, after the pending
+ * changes of all calls. Only the last ring back tone of the window is
+ * delivered. Coalescing is off by default.
+ * @param[in] context        Telephony api context.
+ * @param[in] slot_id        Slot id of current sim.
+ * @param[in] window_ms      Coalescing window, 0 delivers every change at once.
+ * @return Zero on success; a negated errno value on failure.
+ */
+int tapi_call_set_event_coalescing(tapi_context context, int slot_id, u_int32_t window_ms);
+
+/**
+ * Record finished calls of all slots into a call history file.
+ * The file holds fixed size records and is only appended to. It is mapped
+ * in memory, with the time range and a number filter kept per block of
+ * records, so queries skip blocks that cannot match. Finished calls are
+ * buffered and written in batches of CONFIG_TELEPHONY_CALL_HISTORY_BATCH
+ * or after CONFIG_TELEPHONY_CALL_HISTORY_FLUSH_DELAY. When the file is
+ * full, its oldest half is dropped. An existing file at path that is not
+ * a call history is renamed to path with a ".bad" suffix, not overwritten.
+ * @param[in] context        Telephony api context.
+ * @param[in] path           Path of the call history file.
+ * @param[in] capacity       Records of a new file, 0 for the default. An
+ *                           existing file keeps its capacity.
+ * @return Zero on success; a negated errno value on failure.
+ */
+int tapi_call_history_enable(tapi_context context, const char* path, u_int32_t capacity);
+
+/**
+ * Write buffered calls and close the call history file.
+ * @param[in] context        Telephony api context.
+ * @return Zero on success; a negated errno value on failure.
+ */
+int tapi_call_history_disable(tapi_context context);
+
+/**
+ * Append a call record, e.g. a call made over another service.
+ * @param[in] context        Telephony api context.
+ * @param[in] record         Record to append.
+ * @return Zero on success; a negated errno value on failure.
+ */
+int tapi_call_history_add(tapi_context context, const tapi_call_history_record* record);
+
+/**
+ * Write buffered calls to the call history file now.
+ * @param[in] context        Telephony api context.
+ * @return Zero on success; a negated errno value on failure.
+ */
+int tapi_call_history_flush(tapi_context context);
+
+/**
+ * Query the call history, newest records first. Buffered calls are included.
+ * @param[in] context        Telephony api context.
+ * @param[in] filter         Records to return, NULL for all.
+ * @param[out] out           Matching records.
+ * @param[in] max            Size of out.
+ * @return Count of records in out; a negated errno value on failure.
+ */
+int tapi_call_history_query(tapi_context context, const tapi_call_history_filter* filter,
+    tapi_call_history_record* out, int max);
+
 /**
  * Set default voicecall slot id.
  * @param[in] context       Telephony api context.
@@ -40,6 +40,19 @@
 #define MAX_IP_STRING_LENGTH 128
 #define MAX_DATA_DNS_COUNT 10
 #define MAX_DATA_CALL_LIST_SIZE 10
+#define MAX_APN_BATCH_OPS 16
+#define MAX_APN_ID_LENGTH 64
+
+/* Fields of a data connection that changed since its last
+ * MSG_DATA_CONNECTION_STATE_CHANGE_IND, reported in arg2 */
+#define DATA_CONNECTION_CHANGED_INTERFACE 0x01
+#define DATA_CONNECTION_CHANGED_ADDRESS 0x02
+#define DATA_CONNECTION_CHANGED_GATEWAY 0x04
+#define DATA_CONNECTION_CHANGED_DNS 0x08
+#define DATA_CONNECTION_CHANGED_MTU 0x10
+#define DATA_CONNECTION_CHANGED_PCSCF 0x20
+#define DATA_CONNECTION_CHANGED_ACTIVE 0x40
+#define DATA_CONNECTION_CHANGED_ALL 0x7f
 
 /****************************************************************************
  * Public Types
@@ -115,6 +128,51 @@ typedef struct {
     tapi_ip_settings* ip_settings;
 } tapi_data_context;
 
+typedef struct {
+    int from_slot; /* -1 if no slot was set */
+    int to_slot;
+    bool parallel; /* the target came up before DataSlot moved and the old slot was released */
+    u_int32_t gap; /* ms without an internet context on either slot */
+    u_int32_t duration; /* ms from the request to the completion */
+} tapi_data_slot_switch_result;
+
+typedef enum {
+    APN_OP_ADD, /* AddContext */
+    APN_OP_EDIT, /* EditContext of apn->id */
+    APN_OP_REMOVE, /* RemoveContext of apn->id */
+} tapi_apn_op_type;
+
+typedef struct {
+    tapi_apn_op_type type;
+    tapi_data_context* apn;
+} tapi_apn_op;
+
+typedef struct {
+    tapi_apn_op_type type;
+    int status; /* OK, ERROR or -ECANCELED if not executed */
+    bool rolled_back;
+    char id[MAX_APN_ID_LENGTH + 1]; /* new id of a removed context restored by the rollback */
+} tapi_apn_op_result;
+
+typedef struct {
+    int count;
+    int failed;
+    tapi_apn_op_result results[MAX_APN_BATCH_OPS];
+} tapi_apn_batch_result;
+
+typedef struct {
+    tapi_data_context_type type;
+    char interface[MAX_IP_INTERFACE_NAME_LENGTH + 1]; /* last one if not active */
+    bool active;
+    bool stalled;
+    u_int64_t rx_bytes; /* since the monitor was enabled, over all activations */
+    u_int64_t tx_bytes;
+    u_int64_t rx_packets;
+    u_int64_t tx_packets;
+    u_int32_t rx_rate; /* bytes per second over the last interval */
+    u_int32_t tx_rate;
+} tapi_data_traffic_stats;
+
 /****************************************************************************
  * Public Function Prototypes
  ****************************************************************************/
@@ -125,6 +183,9 @@ extern "C" {
 
 /**
  * Load Apn List from Apn Storage.
+ * The list is served from the per-slot apn table once it is loaded, in that case
+ * p_handle is invoked before this function returns. The table follows context
+ * changes and is only loaded from modem again after a modem restart.
  * @param[in] context        Telephony api context.
  * @param[in] slot_id        Slot id of current sim.
  * @param[in] event_id       Async event identifier.
@@ -134,6 +195,17 @@ extern "C" {
 int tapi_data_load_apn_contexts(tapi_context context,
     int slot_id, int event_id, tapi_async_function p_handle);
 
+/**
+ * Reload Apn List from modem, replacing the per-slot apn table.
+ * @param[in] context        Telephony api context.
+ * @param[in] slot_id        Slot id of current sim.
+ * @param[in] event_id       Async event identifier.
+ * @param[in] p_handle       Event callback.
+ * @return Zero on success; a negated errno value on failure.
+ */
+int tapi_data_refresh_apn_contexts(tapi_context context,
+    int slot_id, int event_id, tapi_async_function p_handle);
+
 /**
  * Add Apn to Apn Storage.
  * @param[in] context        Telephony api context.
@@ -181,6 +253,29 @@ int tapi_data_edit_apn_context(tapi_context context,
 int tapi_data_reset_apn_contexts(tapi_context context,
     int slot_id, int event_id, tapi_async_function p_handle);
 
+/**
+ * Add, edit and remove Apns as one request.
+ * All operations are sent at once and executed in order, the callback is
+ * invoked once with a tapi_apn_batch_result in data and the count of
+ * successful operations in arg2. With rollback, the succeeded operations
+ * are reverted one after the other in reverse order when one of them
+ * fails, the values to revert edits and removals to are loaded before the
+ * batch is sent. A removed context is restored by adding it again, so it
+ * comes back under a new id that is reported in the id of its result and
+ * of the results of earlier edits of it, which need no revert of their
+ * own. Apns of ops are copied.
+ * @param[in] context        Telephony api context.
+ * @param[in] slot_id        Slot id of current sim.
+ * @param[in] ops            Operations to run.
+ * @param[in] count          Count of operations.
+ * @param[in] rollback       Revert the batch when an operation fails.
+ * @param[in] event_id       Async event identifier.
+ * @param[in] p_handle       Event callback.
+ * @return Zero on success; a negated errno value on failure.
+ */
+int tapi_data_apn_batch(tapi_context context, int slot_id, const tapi_apn_op* ops,
+    int count, bool rollback, int event_id, tapi_async_function p_handle);
+
 /**
  * Check if Packet switched domain is registered or not.
  * @param[in] context        Telephony api context.
@@ -219,6 +314,9 @@ int tapi_data_is_data_roaming(tapi_context context, int slot_id, bool* out);
 
 /**
  * Request network per APN type.
+ * Requests of one type are counted per slot, only the first one is sent
+ * to the modem. Each request must be paired with tapi_data_release_network,
+ * also when the modem rejects it; that release sends nothing.
  * @param[in] context        Telephony api context.
  * @param[in] slot_id        Slot id of current sim.
  * @param[in] type          Apn type.
@@ -226,8 +324,26 @@ int tapi_data_is_data_roaming(tapi_context context, int slot_id, bool* out);
  */
 int tapi_data_request_network(tapi_context context, int slot_id, const char* type);
 
+/**
+ * Request network per APN type and report when it is granted.
+ * The callback is invoked once the modem answers the request, at once
+ * if the network is already requested by another holder. A failed
+ * request holds no reference and must not be released.
+ * @param[in] context        Telephony api context.
+ * @param[in] slot_id        Slot id of current sim.
+ * @param[in] type          Apn type.
+ * @param[in] event_id       Async event identifier.
+ * @param[in] p_handle       Event callback, arg2 is the apn type.
+ * @return Zero on success; a negated errno value on failure.
+ */
+int tapi_data_acquire_network(tapi_context context, int slot_id, const char* type,
+    int event_id, tapi_async_function p_handle);
+
 /**
  * Release network per APN type.
+ * The network is released to the modem after the last holder released it
+ * and CONFIG_TELEPHONY_DATA_NETWORK_LINGER passed without a new request.
+ * A network no holder in this process requested is released at once.
  * @param[in] context        Telephony api context.
  * @param[in] slot_id        Slot id of current sim.
  * @param[in] type          Apn type.
@@ -235,6 +351,17 @@ int tapi_data_request_network(tapi_context context, int slot_id, const char* typ
  */
 int tapi_data_release_network(tapi_context context, int slot_id, const char* type);
 
+/**
+ * Get the count of holders of a network requested per APN type.
+ * @param[in] context        Telephony api context.
+ * @param[in] slot_id        Slot id of current sim.
+ * @param[in] type          Apn type.
+ * @param[out] out           Count of requests not released yet.
+ * @return Zero on success; a negated errno value on failure.
+ */
+int tapi_data_get_network_request_count(tapi_context context, int slot_id, const char* type,
+    int* out);
+
 /**
  * Get active data connection list.
  * @param[in] context        Telephony api context.
@@ -245,6 +372,19 @@ int tapi_data_release_network(tapi_context context, int slot_id, const char* typ
 int tapi_data_get_data_connection_list(tapi_context context, int slot_id, int event_id,
     tapi_async_function p_handle);
 
+/**
+ * Get active data connection list of one apn type.
+ * Only active contexts of the requested type are decoded.
+ * @param[in] context        Telephony api context.
+ * @param[in] slot_id        Slot id of current sim.
+ * @param[in] type           Apn type, DATA_CONTEXT_TYPE_ANY for all types.
+ * @param[in] event_id       Async event identifier.
+ * @param[in] p_handle       Event callback.
+ * @return Zero on success; a negated errno value on failure.
+ */
+int tapi_data_get_data_connection_list_by_type(tapi_context context, int slot_id,
+    tapi_data_context_type type, int event_id, tapi_async_function p_handle);
+
 /**
  * Set preferred apn for internet.
  * @param[in] context        Telephony api context.
@@ -311,6 +451,27 @@ int tapi_data_set_default_slot(tapi_context context, int slot_id);
  */
 int tapi_data_get_default_slot(tapi_context context, int* out);
 
+/**
+ * Switch the default data slot and keep the data gap short.
+ * The target slot is allowed data next to the old one; once its internet
+ * context is active the default slot is moved and, after the move is
+ * acknowledged, the old slot is released. If the modem refuses two data
+ * slots or the target does not come up in
+ * CONFIG_TELEPHONY_DATA_SLOT_SWITCH_TIMEOUT, the switch falls back to
+ * releasing the old slot and moving the default slot first. The switch
+ * completes when the move is acknowledged and the internet context of the
+ * target is active. If the move fails, the old slot is allowed data again
+ * and the target is not. The callback is invoked once with a
+ * tapi_data_slot_switch_result in data and the gap in ms in arg2.
+ * @param[in] context        Telephony api context.
+ * @param[in] slot_id        Target slot id.
+ * @param[in] event_id       Async event identifier.
+ * @param[in] p_handle       Event callback.
+ * @return Zero on success; a negated errno value on failure.
+ */
+int tapi_data_switch_default_slot(tapi_context context, int slot_id, int event_id,
+    tapi_async_function p_handle);
+
 /**
  * Set data allow in given slot id.
  * @param[in] context        Telephony api context.
@@ -335,6 +496,88 @@ int tapi_data_set_data_allow(tapi_context context, int slot_id,
 int tapi_data_register(tapi_context context,
     int slot_id, tapi_indication_msg msg, void* user_obj, tapi_async_function p_handle);
 
+/**
+ * Sample the traffic of the active data contexts of a slot.
+ * The rx/tx counters of each context interface are read from the procfs
+ * node /proc/net/<interface> every interval, byte counters and rates need a
+ * device that keeps them. A context that keeps sending packets without
+ * receiving any for stall_timeout_ms, with packets sent within the last
+ * stall_timeout_ms, is reported as stalled with MSG_DATA_STALL_IND, arg2 is 1
+ * when it stalls and 0 when it receives again, data is the
+ * tapi_data_traffic_stats of the context.
+ * @param[in] context          Telephony api context.
+ * @param[in] slot_id          Slot id of current sim.
+ * @param[in] interval_ms      Sampling interval, 0 for the default.
+ * @param[in] stall_timeout_ms Stall detection time, 0 for the default.
+ * @param[in] user_obj         User data.
+ * @param[in] p_handle         Stall callback.
+ * @return Zero on success; a negated errno value on failure.
+ */
+int tapi_data_enable_traffic_monitor(tapi_context context, int slot_id, u_int32_t interval_ms,
+    u_int32_t stall_timeout_ms, void* user_obj, tapi_async_function p_handle);
+
+/**
+ * Stop sampling the traffic of a slot.
+ * @param[in] context        Telephony api context.
+ * @param[in] slot_id        Slot id of current sim.
+ * @return Zero on success; a negated errno value on failure.
+ */
+int tapi_data_disable_traffic_monitor(tapi_context context, int slot_id);
+
+/**
+ * Get the traffic counters of the data contexts of a slot.
+ * Counters of a context are kept when it is deactivated or the modem
+ * restarts, and grow again when the same context is active again.
+ * Traffic of an interface shared by several contexts is counted on the
+ * first context using it only.
+ * @param[in] context        Telephony api context.
+ * @param[in] slot_id        Slot id of current sim.
+ * @param[out] out           Counters, one entry per context seen active.
+ * @param[in] size           Entries of out.
+ * @return Number of entries filled; a negated errno value on failure.
+ */
+int tapi_data_get_traffic_stats(tapi_context context, int slot_id,
+    tapi_data_traffic_stats* out, int size);
+
+/**
+ * Enable pre-warming of the internet bearer of the default data slot.
+ * The bearer is requested ahead of demand when the screen turns on, the
+ * packet domain registers again or its technology changes, and released
+ * once no such event happened for the idle timeout. The screen state is
+ * taken from tapi_set_screen_state; nothing is pre-warmed while it is off.
+ * The pre-warm hold counts as one request of tapi_data_request_network.
+ * @param[in] context          Telephony api context.
+ * @param[in] idle_timeout_ms  Time the bearer is held, 0 for the default.
+ * @return Zero on success; a negated errno value on failure.
+ */
+int tapi_data_enable_prewarm(tapi_context context, u_int32_t idle_timeout_ms);
+
+/**
+ * Disable pre-warming and release a pre-warmed bearer.
+ * @param[in] context        Telephony api context.
+ * @return Zero on success; a negated errno value on failure.
+ */
+int tapi_data_disable_prewarm(tapi_context context);
+
+/**
+ * Keep the data of a MSG_DATA_CONNECTION_STATE_CHANGE_IND indication.
+ * The indication data is only valid during the callback, a retained
+ * context stays valid until it is released.
+ * Only the context of that indication (result->data) can be retained;
+ * contexts of tapi_data_get_data_connection_list, the APN context
+ * callbacks or the caller's own storage are rejected.
+ * @param[in] dc             Data context of the indication.
+ * @return The same data context, NULL if dc is NULL or not retainable.
+ */
+tapi_data_context* tapi_data_context_retain(tapi_data_context* dc);
+
+/**
+ * Release a data context retained by tapi_data_context_retain.
+ * @param[in] dc             Retained data context.
+ * @return Zero on success; -EINVAL if dc was not retained.
+ */
+int tapi_data_context_release(tapi_data_context* dc);
+
 /**
  * Unregister data event callback.
  * @param[in] context        Telephony api context.
@@ -38,6 +38,33 @@ typedef struct {
     int rx_time;
 } modem_activity_info;
 
+typedef struct {
+    int slot_id;
+    int status;
+    int arg2;
+    void* data;
+} tapi_fan_out_slot_result;
+
+typedef int (*tapi_slot_request_function)(tapi_context context,
+    int slot_id, int event_id, tapi_async_function p_handle);
+
+typedef void* (*tapi_fan_out_dup_function)(tapi_async_result* result);
+
+typedef enum {
+    DISPATCH_LANE_HIGH = 0, /* incoming and waiting calls, emergency CBS, ECC list */
+    DISPATCH_LANE_LOW, /* cell info, signal strength, data logging */
+    DISPATCH_LANE_COUNT,
+} tapi_dispatch_lane;
+
+typedef struct {
+    u_int32_t count; /* indications delivered */
+    u_int32_t pending; /* indications waiting in the lane */
+    u_int32_t max_pending;
+    u_int32_t dropped; /* indications superseded by a newer one or dropped from a full lane */
+    u_int32_t max_latency; /* us from signal arrival to callback return, queueing included */
+    u_int64_t total_latency; /* us */
+} tapi_dispatch_lane_stats;
+
 /****************************************************************************
  * Public Function Prototypes
  ****************************************************************************/
@@ -255,10 +282,12 @@ int tapi_get_modem_status_sync(tapi_context context, int slot_id, tapi_modem_sta
 
 /**
  * Set fast dormancy to modem.
+ * The state is the screen state reported to the modem, it is applied to
+ * the telephony policies as well, see tapi_set_screen_state.
  * @param[in] context        Telephony api context.
  * @param[in] slot_id        Slot id of current sim.
  * @param[in] event_id       Async event identifier.
- * @param[in] state          fast dormancy state to modem.
+ * @param[in] state          fast dormancy state to modem, true with the screen on.
  * @param[in] p_handle       Event callback.
  * @return Zero on success; a negated errno value on failure.
  */
@@ -327,6 +356,59 @@ int tapi_get_carrier_config_int(tapi_context context, int slot_id, char* key, in
  */
 int tapi_get_carrier_config_string(tapi_context context, int slot_id, char* key, char** out);
 
+/**
+ * Issue the same async request on all active slots concurrently.
+ * The callback is invoked once, when every slot has answered or the deadline
+ * expired, with data pointing to an array of arg2 tapi_fan_out_slot_result
+ * indexed by slot id. Slots without reply are reported with -ETIMEDOUT.
+ * Per-slot result data is released once the callback returns, so dup is used
+ * to keep a malloc'd copy of it; it is only called for successful replies.
+ * @param[in] context        Telephony api context.
+ * @param[in] event_id       Async event identifier.
+ * @param[in] request_fn     Per-slot async request, e.g. tapi_network_get_registration_info.
+ * @param[in] dup            Result data copy function, NULL to keep status only.
+ * @param[in] timeout_ms     Deadline in milliseconds, zero to wait for all slots.
+ * @param[in] p_handle       Event callback.
+ * @return Zero on success; a negated errno value on failure.
+ */
+int tapi_fan_out(tapi_context context, int event_id, tapi_slot_request_function request_fn,
+    tapi_fan_out_dup_function dup, u_int32_t timeout_ms, tapi_async_function p_handle);
+
+/**
+ * Notify the telephony policies of the screen state.
+ * The cellinfo update rate controller backs off and the data pre-warm
+ * policy stops pre-warming while the screen is off. The screen is
+ * assumed on after tapi_open. tapi_set_fast_dormancy reports the state
+ * here itself, callers that send the screen state to the modem need not
+ * call this as well.
+ * @param[in] context        Telephony api context.
+ * @param[in] screen_on      Whether the screen is on.
+ * @return Zero on success; a negated errno value on failure.
+ */
+int tapi_set_screen_state(tapi_context context, bool screen_on);
+
+/**
+ * Get delivery statistics of an indication lane.
+ * Low priority indications are queued and delivered from the event loop in
+ * small batches, so high priority ones are never stuck behind a storm of
+ * them. A queued indication is replaced by a newer one of the same watch
+ * and property, and the oldest one is dropped when the lane is full.
+ * Statistics are shared by all contexts of the process.
+ * @param[in] context        Telephony api context.
+ * @param[in] lane           Indication lane.
+ * @param[out] out           Lane statistics.
+ * @return Zero on success; a negated errno value on failure.
+ */
+int tapi_get_dispatch_stats(tapi_context context, tapi_dispatch_lane lane,
+    tapi_dispatch_lane_stats* out);
+
+/**
+ * Clear delivery statistics of all indication lanes.
+ * @param[in] context        Telephony api context.
+ * @return Zero on success; a negated errno value on failure.
+ */
+int tapi_reset_dispatch_stats(tapi_context context);
+
 #ifdef __cplusplus
 }
 #endif
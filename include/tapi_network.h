@@ -25,6 +25,7 @@
  * Included Files
  ****************************************************************************/
 
+#include <stdint.h>
 #include <tapi.h>
 
 /****************************************************************************
@@ -47,6 +48,14 @@ typedef enum {
     TYPE_NR,
 } tapi_cell_type;
 
+typedef enum {
+    SIGNAL_METRIC_RSSI = 0,
+    SIGNAL_METRIC_RSRP,
+    SIGNAL_METRIC_RSRQ,
+    SIGNAL_METRIC_RSSNR,
+    SIGNAL_METRIC_COUNT,
+} tapi_signal_metric;
+
 typedef struct {
     int sec;
     int min;
@@ -119,6 +128,59 @@ typedef struct {
     tapi_signal_strength signal_strength;
 } tapi_cell_identity;
 
+typedef struct {
+    bool snapshot; /* added holds the full list, nothing removed or changed */
+    int added_count;
+    int removed_count;
+    int changed_count;
+    tapi_cell_identity* added[MAX_CELL_INFO_LIST_SIZE];
+    tapi_cell_identity* removed[MAX_CELL_INFO_LIST_SIZE];
+    tapi_cell_identity* changed[MAX_CELL_INFO_LIST_SIZE];
+} tapi_cell_list_diff;
+
+typedef struct {
+    int64_t timestamp; /* Milliseconds since epoch */
+    tapi_cell_type type;
+    bool registered;
+    int ci;
+    int pci;
+    int earfcn;
+    int tac;
+    int rsrp;
+    int rsrq;
+    int rssnr;
+} tapi_cell_measurement;
+
+typedef struct {
+    int count; /* Samples in the window */
+    int last;
+    int ewma;
+    int min;
+    int max;
+    int mean;
+    int variance;
+    int p10;
+    int p50;
+    int p90;
+} tapi_signal_metric_stats;
+
+typedef struct {
+    u_int32_t min_period; /* Fastest report period in millis */
+    u_int32_t max_period; /* Slowest report period in millis */
+    int rsrp_threshold; /* Serving rsrp deviation in dB considered as mobility */
+} tapi_cell_rate_config;
+
+typedef struct {
+    u_int32_t current_period;
+    int rsrp_deviation;
+    int updates;
+    int raise_count;
+    int hold_count;
+    int backoff_count;
+    int serving_changes;
+    int rate_requests;
+} tapi_cell_rate_stats;
+
 /****************************************************************************
  * Public Function Prototypes
  ****************************************************************************/
@@ -280,6 +342,14 @@ int tapi_network_register(tapi_context context,
  */
 int tapi_network_unregister(tapi_context context, int watch_id);
 
+/**
+ * Request a full snapshot on the next MSG_CELLINFO_DIFF_IND of a registration.
+ * @param[in] context        Telephony api context.
+ * @param[in] watch_id       Watch id returned from MSG_CELLINFO_DIFF_IND registration.
+ * @return Zero on success; a negated errno value on failure.
+ */
+int tapi_network_request_cell_snapshot(tapi_context context, int watch_id);
+
 /**
  * Get the display name of current registered operator.
  * @param[in] context        Telephony api context.
@@ -298,6 +368,98 @@ int tapi_network_get_mcc(tapi_context context, int slot_id, char** mcc);
  */
 int tapi_network_get_mnc(tapi_context context, int slot_id, char** mnc);
 
+/**
+ * Enable or disable the cell measurement history of one slot.
+ * Every CellList change is recorded into a delta encoded ring buffer,
+ * disabling drops the recorded history.
+ * @param[in] context        Telephony api context.
+ * @param[in] slot_id        Slot id of current sim.
+ * @param[in] enable         Enable or disable the history.
+ * @return Zero on success; a negated errno value on failure.
+ */
+int tapi_network_cell_history_enable(tapi_context context, int slot_id, bool enable);
+
+/**
+ * Query recorded cell measurements within a time window, oldest first.
+ * @param[in] context        Telephony api context.
+ * @param[in] slot_id        Slot id of current sim.
+ * @param[in] from           Window start in milliseconds since epoch.
+ * @param[in] to             Window end in milliseconds since epoch.
+ * @param[out] out           Measurements returned from history.
+ * @param[in] max_count      Capacity of out.
+ * @return Number of measurements on success; a negated errno value on failure.
+ */
+int tapi_network_cell_history_query_by_time(tapi_context context, int slot_id,
+    int64_t from, int64_t to, tapi_cell_measurement* out, int max_count);
+
+/**
+ * Query recorded cell measurements of one cell, oldest first.
+ * @param[in] context        Telephony api context.
+ * @param[in] slot_id        Slot id of current sim.
+ * @param[in] ci             Cell id.
+ * @param[out] out           Measurements returned from history.
+ * @param[in] max_count      Capacity of out.
+ * @return Number of measurements on success; a negated errno value on failure.
+ */
+int tapi_network_cell_history_query_by_cell(tapi_context context, int slot_id,
+    int ci, tapi_cell_measurement* out, int max_count);
+
+/**
+ * Export the encoded cell measurement history to a binary file.
+ * @param[in] context        Telephony api context.
+ * @param[in] slot_id        Slot id of current sim.
+ * @param[in] file_path      Path of the exported file.
+ * @return Zero on success; a negated errno value on failure.
+ */
+int tapi_network_cell_history_export(tapi_context context, int slot_id, const char* file_path);
+
+/**
+ * Enable or disable the adaptive cellinfo update rate controller.
+ * The rate is raised on serving cell changes or high signal deviation,
+ * and backed off exponentially when stationary or the screen is off.
+ * The screen state is taken from tapi_set_screen_state.
+ * @param[in] context        Telephony api context.
+ * @param[in] slot_id        Slot id of current sim.
+ * @param[in] enable         Enable or disable the controller.
+ * @param[in] config         Rate bounds, NULL for default.
+ * @return Zero on success; a negated errno value on failure.
+ */
+int tapi_network_set_cell_rate_control(tapi_context context, int slot_id,
+    bool enable, const tapi_cell_rate_config* config);
+
+/**
+ * Get the current rate and decision statistics of the controller.
+ * @param[in] context        Telephony api context.
+ * @param[in] slot_id        Slot id of current sim.
+ * @param[out] out           Controller statistics.
+ * @return Zero on success; a negated errno value on failure.
+ */
+int tapi_network_get_cell_rate_stats(tapi_context context, int slot_id, tapi_cell_rate_stats* out);
+
+/**
+ * Enable or disable the rolling signal quality statistics of one slot.
+ * Samples come from SignalStrength and serving cell updates, and are kept
+ * per RAT and metric over the last window samples.
+ * @param[in] context        Telephony api context.
+ * @param[in] slot_id        Slot id of current sim.
+ * @param[in] enable         Enable or disable the statistics.
+ * @param[in] window         Samples per window, up to CONFIG_TELEPHONY_SIGNAL_STATS_WINDOW.
+ * @return Zero on success; a negated errno value on failure.
+ */
+int tapi_network_signal_stats_enable(tapi_context context, int slot_id, bool enable, int window);
+
+/**
+ * Get the rolling statistics of one signal metric.
+ * @param[in] context        Telephony api context.
+ * @param[in] slot_id        Slot id of current sim.
+ * @param[in] rat            Radio access technology of the samples.
+ * @param[in] metric         Signal metric.
+ * @param[out] out           Statistics of the current window.
+ * @return Zero on success; a negated errno value on failure.
+ */
+int tapi_network_get_signal_stats(tapi_context context, int slot_id,
+    tapi_cell_type rat, tapi_signal_metric metric, tapi_signal_metric_stats* out);
+
 #ifdef __cplusplus
 }
 #endif
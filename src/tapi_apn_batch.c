@@ -0,0 +1,466 @@
+/*
+ * Copyright (C) 2023 Xiaomi Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+
+#include "tapi.h"
+#include "tapi_internal.h"
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+
+/* Context object paths look like "/ril_0/context1" */
+#define APN_BATCH_ID_LENGTH MAX_APN_ID_LENGTH
+
+/****************************************************************************
+ * Private Type Declarations
+ ****************************************************************************/
+
+typedef enum {
+    APN_BATCH_SNAPSHOT, /* GetContexts for the values to roll back to */
+    APN_BATCH_APPLY,
+    APN_BATCH_ROLLBACK,
+} apn_batch_phase;
+
+typedef struct apn_batch apn_batch;
+
+typedef struct {
+    apn_batch* batch;
+    int index;
+    tapi_apn_op_type type;
+    tapi_data_context apn; /* apn.id points at id */
+    char id[APN_BATCH_ID_LENGTH + 1];
+    bool saved; /* previous holds the values before an edit or remove */
+    tapi_data_context previous; /* previous.id points at id */
+} apn_batch_op;
+
+struct apn_batch {
+    GDBusProxy* proxy;
+    int slot_id;
+    int event_id;
+    tapi_async_function cb;
+    bool rollback;
+    apn_batch_phase phase;
+    int undo; /* op rolled back last, rollback walks down from count */
+    int refs; /* method calls in flight, the last one frees the batch */
+    int count;
+    apn_batch_op ops[MAX_APN_BATCH_OPS];
+    tapi_apn_batch_result result;
+};
+
+/****************************************************************************
+ * Private Function Prototypes
+ ****************************************************************************/
+
+static void apn_batch_apply(apn_batch* batch);
+static void apn_batch_reply(DBusMessage* message, void* user_data);
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+
+static void apn_batch_append(DBusMessageIter* iter, void* user_data)
+{
+    apn_batch_op* op = user_data;
+    tapi_async_handler handler;
+    tapi_async_result ar;
+    tapi_apn_op_type type = op->type;
+
+    memset(&ar, 0, sizeof(tapi_async_result));
+    ar.data = &op->apn;
+
+    /* a rollback sends the inverse of the operation with the saved values */
+    if (op->batch->phase == APN_BATCH_ROLLBACK) {
+        if (type == APN_OP_ADD) {
+            type = APN_OP_REMOVE;
+        } else {
+            type = type == APN_OP_REMOVE ? APN_OP_ADD : APN_OP_EDIT;
+            ar.data = &op->previous;
+        }
+    }
+
+    handler.result = &ar;
+    handler.cb_function = NULL;
+
+    switch (type) {
+    case APN_OP_ADD:
+        apn_context_append(iter, &handler);
+        break;
+    case APN_OP_EDIT:
+        apn_context_edit(iter, &handler);
+        break;
+    case APN_OP_REMOVE:
+        apn_context_remove(iter, &handler);
+        break;
+    }
+}
+
+static const char* apn_batch_member(apn_batch_op* op)
+{
+    tapi_apn_op_type type = op->type;
+
+    if (op->batch->phase == APN_BATCH_ROLLBACK && type != APN_OP_EDIT)
+        type = type == APN_OP_ADD ? APN_OP_REMOVE : APN_OP_ADD;
+
+    switch (type) {
+    case APN_OP_ADD:
+        return "AddContext";
+    case APN_OP_EDIT:
+        return "EditContext";
+    case APN_OP_REMOVE:
+        return "RemoveContext";
+    default:
+        return NULL;
+    }
+}
+
+static void apn_batch_complete(apn_batch* batch)
+{
+    tapi_async_result ar;
+
+    memset(&ar, 0, sizeof(tapi_async_result));
+    ar.msg_id = batch->event_id;
+    ar.msg_type = RESPONSE;
+    ar.arg1 = batch->slot_id;
+    ar.arg2 = batch->count - batch->result.failed;
+    ar.status = batch->result.failed == 0 ? OK : ERROR;
+    ar.data = &batch->result;
+
+    if (batch->cb != NULL)
+        batch->cb(&ar);
+}
+
+static void apn_batch_release(void* user_data)
+{
+    apn_batch_op* op = user_data;
+    apn_batch* batch = op->batch;
+
+    if (--batch->refs == 0)
+        free(batch);
+}
+
+static bool apn_batch_failed(DBusMessage* message)
+{
+    DBusError err;
+
+    dbus_error_init(&err);
+    if (dbus_set_error_from_message(&err, message) == true) {
+        tapi_log_error("error from message in %s, %s: %s", __func__, err.name, err.message);
+        dbus_error_free(&err);
+        return true;
+    }
+
+    return false;
+}
+
+/* Returns the later op that removed the context of index, -1 if none */
+static int apn_batch_removed_later(apn_batch* batch, int index)
+{
+    for (int i = index + 1; i < batch->count; i++) {
+        if (batch->ops[i].type == APN_OP_REMOVE && batch->result.results[i].status == OK
+            && strcmp(batch->ops[i].id, batch->ops[index].id) == 0)
+            return i;
+    }
+
+    return -1;
+}
+
+/* Rolls back the next succeeded operation, newest first, one at a time */
+static bool apn_batch_undo_next(apn_batch* batch)
+{
+    while (--batch->undo >= 0) {
+        apn_batch_op* op = &batch->ops[batch->undo];
+        tapi_apn_op_result* result = &batch->result.results[batch->undo];
+        int removed;
+
+        if (result->status != OK)
+            continue;
+
+        /* the path of an added context is only known from the reply */
+        if ((op->type == APN_OP_ADD && op->id[0] == '\0')
+            || (op->type != APN_OP_ADD && !op->saved))
+            continue;
+
+        /* re-adding the removed context already restored the saved values */
+        removed = op->type != APN_OP_ADD ? apn_batch_removed_later(batch, batch->undo) : -1;
+        if (removed >= 0) {
+            result->rolled_back = batch->result.results[removed].rolled_back;
+            strcpy(result->id, batch->result.results[removed].id);
+            continue;
+        }
+
+        if (g_dbus_proxy_method_call(batch->proxy, apn_batch_member(op), apn_batch_append,
+                apn_batch_reply, op, apn_batch_release)) {
+            batch->refs++;
+            return true;
+        }
+
+        tapi_log_error("dbus method call fail in %s", __func__);
+    }
+
+    return false;
+}
+
+static void apn_batch_undone(apn_batch_op* op, DBusMessage* message)
+{
+    tapi_apn_op_result* result = &op->batch->result.results[op->index];
+    DBusMessageIter iter;
+    const char* path;
+
+    result->rolled_back = !apn_batch_failed(message);
+
+    /* a removal is rolled back by AddContext, the context has a new path */
+    if (result->rolled_back && op->type == APN_OP_REMOVE
+        && dbus_message_iter_init(message, &iter)
+        && dbus_message_iter_get_arg_type(&iter) == DBUS_TYPE_OBJECT_PATH) {
+        dbus_message_iter_get_basic(&iter, &path);
+        if (strlen(path) <= APN_BATCH_ID_LENGTH)
+            strcpy(result->id, path);
+    }
+}
+
+static void apn_batch_reply(DBusMessage* message, void* user_data)
+{
+    apn_batch_op* op = user_data;
+    apn_batch* batch = op->batch;
+    tapi_apn_op_result* result = &batch->result.results[op->index];
+    DBusMessageIter iter;
+    const char* path;
+
+    if (batch->phase == APN_BATCH_ROLLBACK) {
+        apn_batch_undone(op, message);
+        if (!apn_batch_undo_next(batch))
+            apn_batch_complete(batch);
+        return;
+    }
+
+    if (apn_batch_failed(message)) {
+        result->status = ERROR;
+        batch->result.failed++;
+    } else {
+        result->status = OK;
+
+        if (op->type == APN_OP_ADD && dbus_message_iter_init(message, &iter)
+            && dbus_message_iter_get_arg_type(&iter) == DBUS_TYPE_OBJECT_PATH) {
+            dbus_message_iter_get_basic(&iter, &path);
+            if (strlen(path) <= APN_BATCH_ID_LENGTH)
+                strcpy(op->id, path);
+        }
+    }
+
+    /* the release of this call comes after the reply, it is still counted */
+    if (batch->refs > 1)
+        return;
+
+    /* the inverse operations depend on each other, they are sent in turn */
+    if (batch->rollback && batch->result.failed > 0) {
+        batch->phase = APN_BATCH_ROLLBACK;
+        batch->undo = batch->count;
+        if (apn_batch_undo_next(batch))
+            return;
+    }
+
+    apn_batch_complete(batch);
+}
+
+static void apn_batch_snapshot_done(DBusMessage* message, void* user_data)
+{
+    apn_batch_op* op = user_data;
+    apn_batch* batch = op->batch;
+    DBusMessageIter args, list;
+
+    if (apn_batch_failed(message) || !dbus_message_has_signature(message, "a(oa{sv})")
+        || !dbus_message_iter_init(message, &args)) {
+        /* without previous values nothing can be rolled back, fail them all */
+        for (int i = 0; i < batch->count; i++) {
+            batch->result.results[i].status = -ECANCELED;
+            batch->result.failed++;
+        }
+
+        apn_batch_complete(batch);
+        return;
+    }
+
+    dbus_message_iter_recurse(&args, &list);
+
+    while (dbus_message_iter_get_arg_type(&list) == DBUS_TYPE_STRUCT) {
+        DBusMessageIter entry, dict;
+        const char* path;
+
+        dbus_message_iter_recurse(&list, &entry);
+        dbus_message_iter_get_basic(&entry, &path);
+        dbus_message_iter_next(&entry);
+
+        for (int i = 0; i < batch->count; i++) {
+            apn_batch_op* item = &batch->ops[i];
+
+            if (item->type == APN_OP_ADD || strcmp(item->id, path) != 0)
+                continue;
+
+            dbus_message_iter_recurse(&entry, &dict);
+            update_data_contexts(&dict, &item->previous);
+            item->saved = true;
+        }
+
+        dbus_message_iter_next(&list);
+    }
+
+    apn_batch_apply(batch);
+
+    /* only this call is in flight, nothing could be sent */
+    if (batch->refs == 1)
+        apn_batch_complete(batch);
+}
+
+static void apn_batch_apply(apn_batch* batch)
+{
+    batch->phase = APN_BATCH_APPLY;
+
+    /* replies come back in order, all operations are sent at once */
+    for (int i = 0; i < batch->count; i++) {
+        apn_batch_op* op = &batch->ops[i];
+
+        if (g_dbus_proxy_method_call(batch->proxy, apn_batch_member(op), apn_batch_append,
+                apn_batch_reply, op, apn_batch_release)) {
+            batch->refs++;
+        } else {
+            tapi_log_error("dbus method call fail in %s", __func__);
+            batch->result.results[i].status = ERROR;
+            batch->result.failed++;
+        }
+    }
+}
+
+static bool apn_batch_copy(apn_batch_op* dst, const tapi_apn_op* src)
+{
+    memset(dst, 0, sizeof(apn_batch_op));
+
+    if (src->apn == NULL)
+        return false;
+
+    if (src->type == APN_OP_EDIT || src->type == APN_OP_REMOVE) {
+        if (src->apn->id == NULL || strlen(src->apn->id) > APN_BATCH_ID_LENGTH)
+            return false;
+
+        strcpy(dst->id, src->apn->id);
+    } else if (src->type != APN_OP_ADD) {
+        return false;
+    }
+
+    if (src->type != APN_OP_REMOVE && tapi_utils_apn_type_to_string(src->apn->type) == NULL)
+        return false;
+
+    dst->type = src->type;
+    memcpy(&dst->apn, src->apn, sizeof(tapi_data_context));
+    dst->apn.id = dst->id;
+    dst->apn.ip_settings = NULL;
+    dst->previous.id = dst->id;
+    return true;
+}
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+int tapi_data_apn_batch(tapi_context context, int slot_id, const tapi_apn_op* ops,
+    int count, bool rollback, int event_id, tapi_async_function p_handle)
+{
+    dbus_context* ctx = context;
+    GDBusProxy* proxy;
+    apn_batch* batch;
+    bool snapshot = false;
+
+    if (ctx == NULL) {
+        tapi_log_error("context is null in %s", __func__);
+        return -EINVAL;
+    }
+
+    if (!tapi_is_valid_slotid(slot_id)) {
+        tapi_log_error("invalid slot id %d in %s", slot_id, __func__);
+        return -EINVAL;
+    }
+
+    if (ops == NULL || count <= 0 || count > MAX_APN_BATCH_OPS) {
+        tapi_log_error("invalid ops in %s", __func__);
+        return -EINVAL;
+    }
+
+    proxy = ctx->dbus_proxy[slot_id][DBUS_PROXY_DATA];
+    if (proxy == NULL) {
+        tapi_log_error("no available proxy in %s", __func__);
+        return -EIO;
+    }
+
+    batch = malloc(sizeof(apn_batch));
+    if (batch == NULL) {
+        tapi_log_error("batch in %s is null", __func__);
+        return -ENOMEM;
+    }
+
+    memset(batch, 0, sizeof(apn_batch));
+
+    for (int i = 0; i < count; i++) {
+        if (!apn_batch_copy(&batch->ops[i], &ops[i])) {
+            tapi_log_error("invalid op %d in %s", i, __func__);
+            free(batch);
+            return -EINVAL;
+        }
+
+        batch->ops[i].batch = batch;
+        batch->ops[i].index = i;
+        batch->result.results[i].type = ops[i].type;
+        batch->result.results[i].status = -ECANCELED;
+
+        if (ops[i].type != APN_OP_ADD)
+            snapshot = rollback;
+    }
+
+    batch->proxy = proxy;
+    batch->slot_id = slot_id;
+    batch->event_id = event_id;
+    batch->cb = p_handle;
+    batch->rollback = rollback;
+    batch->count = count;
+    batch->result.count = count;
+
+    if (snapshot) {
+        batch->phase = APN_BATCH_SNAPSHOT;
+        if (!g_dbus_proxy_method_call(proxy, "GetContexts", NULL,
+                apn_batch_snapshot_done, &batch->ops[0], apn_batch_release)) {
+            tapi_log_error("dbus method call fail in %s", __func__);
+            free(batch);
+            return -EINVAL;
+        }
+
+        batch->refs = 1;
+        return OK;
+    }
+
+    apn_batch_apply(batch);
+    if (batch->refs == 0) {
+        tapi_log_error("dbus method call fail in %s", __func__);
+        free(batch);
+        return -EINVAL;
+    }
+
+    return OK;
+}
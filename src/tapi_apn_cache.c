@@ -0,0 +1,648 @@
+/*
+ * Copyright (C) 2023 Xiaomi Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+
+#include "tapi.h"
+#include "tapi_internal.h"
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+
+/* Context object paths look like "/ril_0/context1" */
+#define APN_CACHE_PATH_LENGTH 64
+
+/* Path and the six string properties of a context */
+#define APN_CACHE_STRING_COUNT 7
+
+#define APN_CACHE_GROW_STEP 4
+
+/****************************************************************************
+ * Private Type Declarations
+ ****************************************************************************/
+
+/* A cached context, its strings are packed back to back behind it */
+typedef struct {
+    tapi_data_context_type type;
+    tapi_data_proto protocol;
+    tapi_data_auth_method auth_method;
+    bool active;
+    bool preferred;
+    char arena[]; /* path first, then the strings of apn_cache_strings */
+} apn_cache_entry;
+
+typedef struct {
+    dbus_context* ctx;
+    int slot_id;
+    bool warm;
+    unsigned int generation;
+    int added_watch;
+    int removed_watch;
+    int count;
+    int capacity;
+    apn_cache_entry** entries;
+} apn_cache_slot;
+
+typedef struct {
+    dbus_context* ctx;
+    int slot_id;
+    unsigned int generation;
+    int event_id;
+    tapi_async_function cb;
+} apn_cache_load_param;
+
+struct apn_cache {
+    int property_watch;
+    apn_cache_slot slots[CONFIG_MODEM_ACTIVE_COUNT];
+};
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+
+/* The string fields of dc in arena order, after the path */
+static void apn_cache_strings(tapi_data_context* dc, char** strings)
+{
+    strings[0] = dc->name;
+    strings[1] = dc->username;
+    strings[2] = dc->password;
+    strings[3] = dc->accesspointname;
+    strings[4] = dc->messageproxy;
+    strings[5] = dc->messagecenter;
+}
+
+static const char* apn_cache_entry_path(const apn_cache_entry* entry)
+{
+    return entry->arena;
+}
+
+static apn_cache_entry* apn_cache_entry_pack(const char* path, tapi_data_context* dc)
+{
+    char* strings[APN_CACHE_STRING_COUNT - 1];
+    apn_cache_entry* entry;
+    size_t size;
+    char* pos;
+
+    if (strlen(path) > APN_CACHE_PATH_LENGTH) {
+        tapi_log_error("context path %s is too long in %s", path, __func__);
+        return NULL;
+    }
+
+    apn_cache_strings(dc, strings);
+
+    size = strlen(path) + 1;
+    for (int i = 0; i < APN_CACHE_STRING_COUNT - 1; i++)
+        size += strlen(strings[i]) + 1;
+
+    entry = malloc(sizeof(apn_cache_entry) + size);
+    if (entry == NULL) {
+        tapi_log_error("entry in %s is null", __func__);
+        return NULL;
+    }
+
+    entry->type = dc->type;
+    entry->protocol = dc->protocol;
+    entry->auth_method = dc->auth_method;
+    entry->active = dc->active;
+    entry->preferred = dc->preferred;
+
+    strcpy(entry->arena, path);
+    pos = entry->arena + strlen(path) + 1;
+    for (int i = 0; i < APN_CACHE_STRING_COUNT - 1; i++) {
+        strcpy(pos, strings[i]);
+        pos += strlen(pos) + 1;
+    }
+
+    return entry;
+}
+
+/* Expands entry into dc, dc->id points into the entry */
+static void apn_cache_entry_unpack(apn_cache_entry* entry, tapi_data_context* dc)
+{
+    char* strings[APN_CACHE_STRING_COUNT - 1];
+    char* pos = entry->arena;
+
+    memset(dc, 0, sizeof(tapi_data_context));
+    dc->id = pos;
+    dc->type = entry->type;
+    dc->protocol = entry->protocol;
+    dc->auth_method = entry->auth_method;
+    dc->active = entry->active;
+    dc->preferred = entry->preferred;
+
+    apn_cache_strings(dc, strings);
+
+    pos += strlen(pos) + 1;
+    for (int i = 0; i < APN_CACHE_STRING_COUNT - 1; i++) {
+        strcpy(strings[i], pos);
+        pos += strlen(pos) + 1;
+    }
+}
+
+/*
+ * Applies a property, or a property dict if key is NULL, to entry and
+ * packs it again. A NULL entry starts from an empty context. Returns the
+ * new entry, entry is freed; NULL on failure with entry left as it was.
+ */
+static apn_cache_entry* apn_cache_entry_update(apn_cache_entry* entry, const char* path,
+    const char* key, DBusMessageIter* iter)
+{
+    apn_cache_entry* packed;
+    tapi_data_context dc;
+
+    if (entry != NULL)
+        apn_cache_entry_unpack(entry, &dc);
+    else
+        memset(&dc, 0, sizeof(tapi_data_context));
+
+    if (key != NULL)
+        update_data_context(key, iter, &dc);
+    else
+        update_data_contexts(iter, &dc);
+
+    packed = apn_cache_entry_pack(path, &dc);
+    if (packed != NULL)
+        free(entry);
+
+    return packed;
+}
+
+static void apn_cache_free_entries(apn_cache_entry** entries, int count)
+{
+    while (count > 0)
+        free(entries[--count]);
+
+    free(entries);
+}
+
+/* Makes room for one more entry in entries of *capacity */
+static bool apn_cache_reserve(apn_cache_entry*** entries, int* capacity, int count)
+{
+    apn_cache_entry** grown;
+
+    if (count < *capacity)
+        return true;
+
+    grown = realloc(*entries, (*capacity + APN_CACHE_GROW_STEP) * sizeof(apn_cache_entry*));
+    if (grown == NULL) {
+        tapi_log_error("entries in %s is null", __func__);
+        return false;
+    }
+
+    *entries = grown;
+    *capacity += APN_CACHE_GROW_STEP;
+    return true;
+}
+
+static void apn_cache_clear(apn_cache_slot* slot)
+{
+    apn_cache_free_entries(slot->entries, slot->count);
+    slot->entries = NULL;
+    slot->count = 0;
+    slot->capacity = 0;
+}
+
+static void apn_cache_invalidate_slot(apn_cache_slot* slot)
+{
+    apn_cache_clear(slot);
+    slot->warm = false;
+    slot->generation++;
+}
+
+static int apn_cache_find(apn_cache_slot* slot, const char* path)
+{
+    for (int i = 0; i < slot->count; i++) {
+        if (strcmp(apn_cache_entry_path(slot->entries[i]), path) == 0)
+            return i;
+    }
+
+    return -1;
+}
+
+/* Decodes a GetContexts reply into a new entries array, returns the entry count or -1 */
+static int apn_cache_decode(DBusMessage* message, apn_cache_entry*** out)
+{
+    DBusMessageIter args, list;
+    apn_cache_entry** entries = NULL;
+    int capacity = 0;
+    int count = 0;
+
+    if (dbus_message_has_signature(message, "a(oa{sv})") == false) {
+        tapi_log_error("message signature in %s is error", __func__);
+        return -1;
+    }
+
+    if (dbus_message_iter_init(message, &args) == false) {
+        tapi_log_error("message iter init fail in %s", __func__);
+        return -1;
+    }
+
+    dbus_message_iter_recurse(&args, &list);
+
+    while (dbus_message_iter_get_arg_type(&list) == DBUS_TYPE_STRUCT) {
+        DBusMessageIter entry, dict;
+        apn_cache_entry* item;
+        const char* path;
+
+        if (!apn_cache_reserve(&entries, &capacity, count))
+            goto error;
+
+        dbus_message_iter_recurse(&list, &entry);
+        dbus_message_iter_get_basic(&entry, &path);
+        dbus_message_iter_next(&entry);
+        dbus_message_iter_recurse(&entry, &dict);
+
+        item = apn_cache_entry_update(NULL, path, NULL, &dict);
+        if (item == NULL)
+            goto error;
+
+        entries[count++] = item;
+        dbus_message_iter_next(&list);
+    }
+
+    *out = entries;
+    return count;
+
+error:
+    apn_cache_free_entries(entries, count);
+    return -1;
+}
+
+/* Expands the entries for the callback, the contexts only live during it */
+static void apn_cache_deliver(int slot_id, int event_id, tapi_async_function cb,
+    int status, apn_cache_entry** entries, int count)
+{
+    tapi_data_context** result = NULL;
+    tapi_data_context* contexts;
+    tapi_async_result ar;
+
+    if (cb == NULL)
+        return;
+
+    memset(&ar, 0, sizeof(tapi_async_result));
+    ar.msg_id = event_id;
+    ar.msg_type = RESPONSE;
+    ar.arg1 = slot_id;
+    ar.status = status;
+
+    if (status == OK && count > 0) {
+        result = malloc(count * (sizeof(tapi_data_context*) + sizeof(tapi_data_context)));
+        if (result == NULL) {
+            tapi_log_error("result in %s is null", __func__);
+            ar.status = ERROR;
+            cb(&ar);
+            return;
+        }
+
+        contexts = (tapi_data_context*)(result + count);
+        for (int i = 0; i < count; i++) {
+            apn_cache_entry_unpack(entries[i], &contexts[i]);
+            result[i] = &contexts[i];
+        }
+    }
+
+    if (ar.status == OK) {
+        ar.arg2 = count; // apn count;
+        ar.data = result;
+    }
+
+    cb(&ar);
+    free(result);
+}
+
+static void apn_cache_loaded(DBusMessage* message, void* user_data)
+{
+    apn_cache_load_param* param = user_data;
+    apn_cache_entry** entries = NULL;
+    apn_cache_slot* slot = NULL;
+    DBusError err;
+    int count;
+
+    if (param == NULL) {
+        tapi_log_error("param in %s is null", __func__);
+        return;
+    }
+
+    dbus_error_init(&err);
+    if (dbus_set_error_from_message(&err, message) == true) {
+        tapi_log_error("error from message in %s, %s: %s", __func__, err.name, err.message);
+        dbus_error_free(&err);
+        apn_cache_deliver(param->slot_id, param->event_id, param->cb, ERROR, NULL, 0);
+        return;
+    }
+
+    count = apn_cache_decode(message, &entries);
+    if (count < 0) {
+        apn_cache_deliver(param->slot_id, param->event_id, param->cb, ERROR, NULL, 0);
+        return;
+    }
+
+    if (param->ctx->apn_cache != NULL)
+        slot = &param->ctx->apn_cache->slots[param->slot_id];
+
+    /* a restart or refresh since the request makes this reply stale for the table */
+    if (slot != NULL && slot->generation == param->generation) {
+        apn_cache_clear(slot);
+        slot->entries = entries;
+        slot->count = count;
+        slot->capacity = count;
+        slot->warm = true;
+        apn_cache_deliver(slot->slot_id, param->event_id, param->cb, OK,
+            slot->entries, slot->count);
+        return;
+    }
+
+    apn_cache_deliver(param->slot_id, param->event_id, param->cb, OK, entries, count);
+    apn_cache_free_entries(entries, count);
+}
+
+static int apn_cache_context_added(DBusConnection* connection, DBusMessage* message,
+    void* user_data)
+{
+    apn_cache_slot* slot = user_data;
+    apn_cache_entry* entry;
+    DBusMessageIter iter, dict;
+    const char* path;
+    int index;
+
+    if (slot == NULL) {
+        tapi_log_error("slot in %s is null", __func__);
+        return 0;
+    }
+
+    if (!slot->warm)
+        return 1;
+
+    if (!dbus_message_iter_init(message, &iter)
+        || dbus_message_iter_get_arg_type(&iter) != DBUS_TYPE_OBJECT_PATH) {
+        tapi_log_error("message invalid in %s", __func__);
+        return 0;
+    }
+
+    dbus_message_iter_get_basic(&iter, &path);
+    dbus_message_iter_next(&iter);
+    if (dbus_message_iter_get_arg_type(&iter) != DBUS_TYPE_ARRAY) {
+        tapi_log_error("message invalid in %s", __func__);
+        return 0;
+    }
+
+    dbus_message_iter_recurse(&iter, &dict);
+
+    index = apn_cache_find(slot, path);
+    if (index < 0) {
+        index = slot->count;
+        entry = NULL;
+        if (apn_cache_reserve(&slot->entries, &slot->capacity, slot->count))
+            entry = apn_cache_entry_update(NULL, path, NULL, &dict);
+    } else {
+        entry = apn_cache_entry_update(slot->entries[index], path, NULL, &dict);
+    }
+
+    /* the table can not follow, fall back to GetContexts on next load */
+    if (entry == NULL) {
+        apn_cache_invalidate_slot(slot);
+        return 1;
+    }
+
+    slot->entries[index] = entry;
+    if (index == slot->count)
+        slot->count++;
+
+    return 1;
+}
+
+static int apn_cache_context_removed(DBusConnection* connection, DBusMessage* message,
+    void* user_data)
+{
+    apn_cache_slot* slot = user_data;
+    DBusMessageIter iter;
+    const char* path;
+    int index;
+
+    if (slot == NULL) {
+        tapi_log_error("slot in %s is null", __func__);
+        return 0;
+    }
+
+    if (!dbus_message_iter_init(message, &iter)
+        || dbus_message_iter_get_arg_type(&iter) != DBUS_TYPE_OBJECT_PATH) {
+        tapi_log_error("message invalid in %s", __func__);
+        return 0;
+    }
+
+    dbus_message_iter_get_basic(&iter, &path);
+
+    index = apn_cache_find(slot, path);
+    if (index < 0)
+        return 1;
+
+    free(slot->entries[index]);
+    slot->count--;
+    if (index < slot->count) {
+        memmove(&slot->entries[index], &slot->entries[index + 1],
+            (slot->count - index) * sizeof(apn_cache_entry*));
+    }
+
+    return 1;
+}
+
+static int apn_cache_property_changed(DBusConnection* connection, DBusMessage* message,
+    void* user_data)
+{
+    apn_cache* cache = user_data;
+    DBusMessageIter iter, value;
+    apn_cache_entry* entry;
+    const char* path;
+    const char* key;
+    int index;
+
+    if (cache == NULL) {
+        tapi_log_error("cache in %s is null", __func__);
+        return 0;
+    }
+
+    path = dbus_message_get_path(message);
+    if (path == NULL)
+        return 1;
+
+    if (!dbus_message_iter_init(message, &iter)
+        || dbus_message_iter_get_arg_type(&iter) != DBUS_TYPE_STRING) {
+        tapi_log_error("message invalid in %s", __func__);
+        return 0;
+    }
+
+    dbus_message_iter_get_basic(&iter, &key);
+    dbus_message_iter_next(&iter);
+    dbus_message_iter_recurse(&iter, &value);
+
+    for (int i = 0; i < CONFIG_MODEM_ACTIVE_COUNT; i++) {
+        apn_cache_slot* slot = &cache->slots[i];
+
+        index = apn_cache_find(slot, path);
+        if (index < 0)
+            continue;
+
+        entry = apn_cache_entry_update(slot->entries[index], path, key, &value);
+        if (entry != NULL)
+            slot->entries[index] = entry;
+        else
+            apn_cache_invalidate_slot(slot);
+
+        break;
+    }
+
+    return 1;
+}
+
+static int apn_cache_add_slot_watch(dbus_context* ctx, const char* modem_path,
+    const char* member, GDBusSignalFunction function, apn_cache_slot* slot)
+{
+    return g_dbus_add_signal_watch(ctx->connection, OFONO_SERVICE, modem_path,
+        OFONO_CONNECTION_MANAGER_INTERFACE, member, function, slot, NULL);
+}
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+int apn_cache_init(dbus_context* ctx)
+{
+    apn_cache* cache;
+    const char* modem_path;
+
+    cache = malloc(sizeof(apn_cache));
+    if (cache == NULL) {
+        tapi_log_error("cache in %s is null", __func__);
+        return -ENOMEM;
+    }
+
+    memset(cache, 0, sizeof(apn_cache));
+    ctx->apn_cache = cache;
+
+    /* context objects live below the modem path, one watch serves all slots */
+    cache->property_watch = g_dbus_add_signal_watch(ctx->connection, OFONO_SERVICE,
+        NULL, OFONO_CONNECTION_CONTEXT_INTERFACE, "PropertyChanged",
+        apn_cache_property_changed, cache, NULL);
+
+    for (int i = 0; i < CONFIG_MODEM_ACTIVE_COUNT; i++) {
+        apn_cache_slot* slot = &cache->slots[i];
+
+        slot->ctx = ctx;
+        slot->slot_id = i;
+
+        modem_path = tapi_utils_get_modem_path(i);
+        if (modem_path == NULL)
+            continue;
+
+        slot->added_watch = apn_cache_add_slot_watch(ctx, modem_path,
+            "ContextAdded", apn_cache_context_added, slot);
+        slot->removed_watch = apn_cache_add_slot_watch(ctx, modem_path,
+            "ContextRemoved", apn_cache_context_removed, slot);
+    }
+
+    if (cache->property_watch == 0) {
+        tapi_log_error("add signal watch failed in %s", __func__);
+        apn_cache_release(ctx);
+        return -EINVAL;
+    }
+
+    return OK;
+}
+
+void apn_cache_invalidate(dbus_context* ctx, int slot_id)
+{
+    if (ctx->apn_cache == NULL || !tapi_is_valid_slotid(slot_id))
+        return;
+
+    apn_cache_invalidate_slot(&ctx->apn_cache->slots[slot_id]);
+}
+
+int apn_cache_load(dbus_context* ctx, int slot_id, int event_id,
+    tapi_async_function p_handle, bool refresh)
+{
+    apn_cache_load_param* param;
+    apn_cache_slot* slot = NULL;
+    GDBusProxy* proxy;
+
+    proxy = ctx->dbus_proxy[slot_id][DBUS_PROXY_DATA];
+    if (proxy == NULL) {
+        tapi_log_error("no available proxy in %s", __func__);
+        return -EIO;
+    }
+
+    if (ctx->apn_cache != NULL)
+        slot = &ctx->apn_cache->slots[slot_id];
+
+    if (slot != NULL && refresh)
+        apn_cache_invalidate_slot(slot);
+
+    if (slot != NULL && slot->warm) {
+        apn_cache_deliver(slot_id, event_id, p_handle, OK, slot->entries, slot->count);
+        return OK;
+    }
+
+    param = malloc(sizeof(apn_cache_load_param));
+    if (param == NULL) {
+        tapi_log_error("param in %s is null", __func__);
+        return -ENOMEM;
+    }
+
+    param->ctx = ctx;
+    param->slot_id = slot_id;
+    param->generation = slot != NULL ? slot->generation : 0;
+    param->event_id = event_id;
+    param->cb = p_handle;
+
+    if (!g_dbus_proxy_method_call(proxy, "GetContexts", NULL,
+            apn_cache_loaded, param, free)) {
+        tapi_log_error("method call fail in %s", __func__);
+        free(param);
+        return -EINVAL;
+    }
+
+    return OK;
+}
+
+void apn_cache_release(dbus_context* ctx)
+{
+    apn_cache* cache = ctx->apn_cache;
+
+    if (cache == NULL)
+        return;
+
+    if (cache->property_watch != 0)
+        g_dbus_remove_watch(ctx->connection, cache->property_watch);
+
+    for (int i = 0; i < CONFIG_MODEM_ACTIVE_COUNT; i++) {
+        apn_cache_slot* slot = &cache->slots[i];
+
+        if (slot->added_watch != 0)
+            g_dbus_remove_watch(ctx->connection, slot->added_watch);
+        if (slot->removed_watch != 0)
+            g_dbus_remove_watch(ctx->connection, slot->removed_watch);
+
+        apn_cache_clear(slot);
+    }
+
+    free(cache);
+    ctx->apn_cache = NULL;
+}
@@ -32,14 +32,12 @@
 #define NEW_VOICE_CALL_DBUS_PROXY 1
 #define RELEASE_VOICE_CALL_DBUS_PROXY 2
 
-#define START_PLAY_DTMF 1
-#define STOP_PLAY_DTMF 2
-
 /****************************************************************************
  * Private Type Declarations
  ****************************************************************************/
 
 typedef struct {
+    dbus_context* ctx;
     char number[MAX_PHONE_NUMBER_LENGTH + 1];
     int hide_callerid;
 } call_param;
@@ -63,11 +61,8 @@ typedef struct {
  * Private Function Prototypes
  ****************************************************************************/
 
-static int decode_voice_call_info(DBusMessageIter* iter, tapi_call_info* call_info);
 static int call_manager_property_changed(DBusConnection* connection, DBusMessage* message,
     void* user_data);
-static int call_state_changed(DBusConnection* connection, DBusMessage* message,
-    void* user_data);
 static int tapi_call_property_change(DBusMessage* message, tapi_async_handler* handler);
 
 /****************************************************************************
@@ -95,7 +90,7 @@ static int call_strcpy(char* dst, const char* src, int dst_size)
     return 0;
 }
 
-static bool is_valid_dtmf_char(char c)
+bool is_valid_dtmf_digit(char c)
 {
     if ((c >= '0' && c <= '9') || c == '*' || c == '#') {
         return true;
@@ -291,38 +286,6 @@ static int tapi_call_default_voicecall_slot_change(DBusMessage* message, tapi_as
     return true;
 }
 
-static int ring_back_tone_change(DBusMessage* message, tapi_async_handler* handler)
-{
-    tapi_async_result* ar;
-    tapi_async_function cb;
-    DBusMessageIter iter;
-
-    if (handler == NULL) {
-        tapi_log_error("handler in %s is null", __func__);
-        return false;
-    }
-
-    ar = handler->result;
-    if (ar == NULL) {
-        tapi_log_error("async result in %s is null", __func__);
-        return false;
-    }
-
-    cb = handler->cb_function;
-    if (cb == NULL) {
-        tapi_log_error("callback in %s is null", __func__);
-        return false;
-    }
-
-    if (is_call_signal_message(message, &iter, DBUS_TYPE_INT32)) {
-        dbus_message_iter_get_basic(&iter, &ar->arg2);
-        ar->status = OK;
-        cb(ar);
-    }
-
-    return true;
-}
-
 static int
 call_manager_property_changed(DBusConnection* connection, DBusMessage* message,
     void* user_data)
@@ -346,10 +309,6 @@ call_manager_property_changed(DBusConnection* connection, DBusMessage* message,
     if (dbus_message_is_signal(message, OFONO_VOICECALL_MANAGER_INTERFACE,
             "PropertyChanged")) {
         return tapi_call_property_change(message, handler);
-    } else if (dbus_message_is_signal(message, OFONO_VOICECALL_MANAGER_INTERFACE,
-                   "RingBackTone")
-        && msg_id == MSG_CALL_RING_BACK_TONE_IND) {
-        return ring_back_tone_change(message, handler);
     } else if (dbus_message_is_signal(message, OFONO_MANAGER_INTERFACE, "PropertyChanged")
         && msg_id == MSG_DEFAULT_VOICECALL_SLOT_CHANGE_IND) {
         return tapi_call_default_voicecall_slot_change(message, handler);
@@ -358,52 +317,13 @@ call_manager_property_changed(DBusConnection* connection, DBusMessage* message,
     return true;
 }
 
-static int call_state_changed(DBusConnection* connection, DBusMessage* message, void* user_data)
-{
-    tapi_async_handler* handler = user_data;
-    tapi_async_result* ar;
-    tapi_async_function cb;
-    DBusMessageIter iter;
-    tapi_call_info voicecall;
-
-    if (handler == NULL) {
-        tapi_log_error("handler in %s is null", __func__);
-        return 0;
-    }
-
-    ar = handler->result;
-    if (ar == NULL) {
-        tapi_log_error("async result in %s is null", __func__);
-        return 0;
-    }
-
-    cb = handler->cb_function;
-    if (cb == NULL) {
-        tapi_log_error("callback in %s is null", __func__);
-        return 0;
-    }
-
-    if (!dbus_message_iter_init(message, &iter)) {
-        tapi_log_error("dbus message iter init failed in %s", __func__);
-        return 0;
-    }
-
-    if (decode_voice_call_info(&iter, &voicecall)) {
-        ar->data = &voicecall;
-        ar->status = OK;
-        cb(ar);
-        return 1;
-    }
-
-    return 0;
-}
-
 static void dial_call_callback(DBusMessage* message, void* user_data)
 {
     tapi_async_handler* handler = user_data;
     tapi_async_function cb;
     tapi_async_result* ar;
     DBusMessageIter iter;
+    call_param* param;
     DBusError err;
     char* call_id;
 
@@ -418,11 +338,9 @@ static void dial_call_callback(DBusMessage* message, void* user_data)
         return;
     }
 
-    cb = handler->cb_function;
-    if (cb == NULL) {
-        tapi_log_error("callback in %s is null", __func__);
-        return;
-    }
+    // the KPI reply and the param are handled with or without a callback.
+    param = ar->data;
+    ar->data = NULL;
 
     dbus_error_init(&err);
     if (dbus_set_error_from_message(&err, message) == true) {
@@ -445,7 +363,14 @@ static void dial_call_callback(DBusMessage* message, void* user_data)
     }
 
 done:
-    cb(ar);
+    if (param != NULL) {
+        call_kpi_dial_replied(param->ctx, ar->arg1, ar->status == OK ? ar->data : NULL);
+        free(param);
+    }
+
+    cb = handler->cb_function;
+    if (cb != NULL)
+        cb(ar);
 }
 
 static void play_dtmf_callback(DBusMessage* message, void* user_data)
@@ -549,7 +474,7 @@ done:
 
 static void call_list_query_complete(DBusMessage* message, void* user_data)
 {
-    tapi_call_info call_list[MAX_CALL_LIST_COUNT];
+    tapi_call_info* call_list = NULL;
     tapi_async_handler* handler = user_data;
     DBusMessageIter args, list;
     tapi_async_function cb;
@@ -593,9 +518,17 @@ static void call_list_query_complete(DBusMessage* message, void* user_data)
         goto done;
     }
 
+    // keep the call list off the stack, it is several KB.
+    call_list = malloc(sizeof(tapi_call_info) * MAX_CALL_LIST_COUNT);
+    if (call_list == NULL) {
+        tapi_log_error("call list in %s is null", __func__);
+        goto done;
+    }
+
     dbus_message_iter_recurse(&args, &list);
 
-    while (dbus_message_iter_get_arg_type(&list) == DBUS_TYPE_STRUCT) {
+    while (dbus_message_iter_get_arg_type(&list) == DBUS_TYPE_STRUCT
+        && call_count < MAX_CALL_LIST_COUNT) {
         DBusMessageIter entry;
 
         dbus_message_iter_recurse(&list, &entry);
@@ -614,6 +547,9 @@ static void call_list_query_complete(DBusMessage* message, void* user_data)
 
 done:
     cb(ar);
+
+    if (call_list != NULL)
+        free(call_list);
 }
 
 static int tapi_call_property_change(DBusMessage* message, tapi_async_handler* handler)
@@ -622,6 +558,7 @@ static int tapi_call_property_change(DBusMessage* message, tapi_async_handler* h
     tapi_async_result* ar;
     tapi_async_function cb;
     ecc_info ecc_list[MAX_ECC_LIST_SIZE] = { 0 };
+    uint64_t begin = dispatch_lane_begin();
     char* key;
     int index = 0;
 
@@ -685,12 +622,59 @@ static int tapi_call_property_change(DBusMessage* message, tapi_async_handler* h
         ar->data = ecc_list;
         ar->arg2 = index;
         cb(ar);
+        dispatch_lane_end(DISPATCH_LANE_HIGH, begin);
     }
 
     return true;
 }
 
-static int decode_voice_call_info(DBusMessageIter* iter, tapi_call_info* call_info)
+void apply_voice_call_property(tapi_call_info* call_info, const char* key,
+    DBusMessageIter* value)
+{
+    unsigned char val;
+    char* result;
+    int ret;
+
+    if (strcmp(key, "State") == 0) {
+        dbus_message_iter_get_basic(value, &result);
+        call_info->state = tapi_utils_call_status_from_string(result);
+    } else if (strcmp(key, "LineIdentification") == 0) {
+        dbus_message_iter_get_basic(value, &result);
+        call_strcpy(call_info->lineIdentification, result, MAX_CALL_LINE_ID_LENGTH);
+    } else if (strcmp(key, "IncomingLine") == 0) {
+        dbus_message_iter_get_basic(value, &result);
+        call_strcpy(call_info->incoming_line, result, MAX_CALL_INCOMING_LINE_LENGTH);
+    } else if (strcmp(key, "Name") == 0) {
+        dbus_message_iter_get_basic(value, &result);
+        call_strcpy(call_info->name, result, MAX_CALL_NAME_LENGTH);
+    } else if (strcmp(key, "StartTime") == 0) {
+        dbus_message_iter_get_basic(value, &result);
+        call_strcpy(call_info->start_time, result, MAX_CALL_START_TIME_LENGTH);
+    } else if (strcmp(key, "Multiparty") == 0) {
+        dbus_message_iter_get_basic(value, &ret);
+        call_info->multiparty = ret;
+    } else if (strcmp(key, "RemoteHeld") == 0) {
+        dbus_message_iter_get_basic(value, &ret);
+        call_info->remote_held = ret;
+    } else if (strcmp(key, "RemoteMultiparty") == 0) {
+        dbus_message_iter_get_basic(value, &ret);
+        call_info->remote_multiparty = ret;
+    } else if (strcmp(key, "Information") == 0) {
+        dbus_message_iter_get_basic(value, &result);
+        call_strcpy(call_info->info, result, MAX_CALL_INFO_LENGTH);
+    } else if (strcmp(key, "Icon") == 0) {
+        dbus_message_iter_get_basic(value, &val);
+        call_info->icon = val;
+    } else if (strcmp(key, "Emergency") == 0) {
+        dbus_message_iter_get_basic(value, &ret);
+        call_info->is_emergency_number = ret;
+    } else if (strcmp(key, "DisconnectReason") == 0) {
+        dbus_message_iter_get_basic(value, &ret);
+        call_info->disconnect_reason = ret;
+    }
+}
+
+int decode_voice_call_info(DBusMessageIter* iter, tapi_call_info* call_info)
 {
     DBusMessageIter subArrayIter;
     char* property;
@@ -708,10 +692,7 @@ static int decode_voice_call_info(DBusMessageIter* iter, tapi_call_info* call_in
 
     while (dbus_message_iter_get_arg_type(&subArrayIter) == DBUS_TYPE_DICT_ENTRY) {
         DBusMessageIter entry, value;
-        unsigned char val;
         const char* key;
-        char* result;
-        int ret;
 
         dbus_message_iter_recurse(&subArrayIter, &entry);
         dbus_message_iter_get_basic(&entry, &key);
@@ -719,43 +700,7 @@ static int decode_voice_call_info(DBusMessageIter* iter, tapi_call_info* call_in
         dbus_message_iter_next(&entry);
         dbus_message_iter_recurse(&entry, &value);
 
-        if (strcmp(key, "State") == 0) {
-            dbus_message_iter_get_basic(&value, &result);
-            call_info->state = tapi_utils_call_status_from_string(result);
-        } else if (strcmp(key, "LineIdentification") == 0) {
-            dbus_message_iter_get_basic(&value, &result);
-            call_strcpy(call_info->lineIdentification, result, MAX_CALL_LINE_ID_LENGTH);
-        } else if (strcmp(key, "IncomingLine") == 0) {
-            dbus_message_iter_get_basic(&value, &result);
-            call_strcpy(call_info->incoming_line, result, MAX_CALL_INCOMING_LINE_LENGTH);
-        } else if (strcmp(key, "Name") == 0) {
-            dbus_message_iter_get_basic(&value, &result);
-            call_strcpy(call_info->name, result, MAX_CALL_NAME_LENGTH);
-        } else if (strcmp(key, "StartTime") == 0) {
-            dbus_message_iter_get_basic(&value, &result);
-            call_strcpy(call_info->start_time, result, MAX_CALL_START_TIME_LENGTH);
-        } else if (strcmp(key, "Multiparty") == 0) {
-            dbus_message_iter_get_basic(&value, &ret);
-            call_info->multiparty = ret;
-        } else if (strcmp(key, "RemoteHeld") == 0) {
-            dbus_message_iter_get_basic(&value, &ret);
-            call_info->remote_held = ret;
-        } else if (strcmp(key, "RemoteMultiparty") == 0) {
-            dbus_message_iter_get_basic(&value, &ret);
-            call_info->remote_multiparty = ret;
-        } else if (strcmp(key, "Information") == 0) {
-            dbus_message_iter_get_basic(&value, &result);
-            call_strcpy(call_info->info, result, MAX_CALL_INFO_LENGTH);
-        } else if (strcmp(key, "Icon") == 0) {
-            dbus_message_iter_get_basic(&value, &val);
-            call_info->icon = val;
-        } else if (strcmp(key, "Emergency") == 0) {
-            dbus_message_iter_get_basic(&value, &ret);
-            call_info->is_emergency_number = ret;
-        } else if (strcmp(key, "DisconnectReason") == 0) {
-            dbus_message_iter_get_basic(&value, &ret);
-            call_info->disconnect_reason = ret;
-        }
+        apply_voice_call_property(call_info, key, &value);
 
         dbus_message_iter_next(&subArrayIter);
     }
@@ -975,7 +920,7 @@ static int call_play_dtmf(tapi_context context, int slot_id, unsigned char digit
         return -EINVAL;
     }
 
-    if (flag == START_PLAY_DTMF && !is_valid_dtmf_char(digit)) {
+    if (flag == START_PLAY_DTMF && !is_valid_dtmf_digit(digit)) {
         tapi_log_error("invalid digit %d in %s", digit, __func__);
         return -EINVAL;
     }
@@ -1064,6 +1009,7 @@ int tapi_call_dial(tapi_context context, int slot_id, char* number, int hide_cal
         return -ENOMEM;
     }
 
+    param->ctx = ctx;
     snprintf(param->number, sizeof(param->number), "%s", number);
     param->hide_callerid = hide_callerid;
 
@@ -1098,6 +1044,7 @@ int tapi_call_dial(tapi_context context, int slot_id, char* number, int hide_cal
         return -EINVAL;
     }
 
+    call_kpi_dial_sent(ctx, slot_id);
     return OK;
 }
 
@@ -1146,6 +1093,7 @@ int tapi_call_get_call_by_state(tapi_context context, int slot_id,
     int state, tapi_call_info* call_list, int size, tapi_call_info* info)
 {
     dbus_context* ctx = context;
+    const tapi_call_info* calls = call_list;
     int index = 0;
 
     if (ctx == NULL) {
@@ -1158,19 +1106,24 @@ int tapi_call_get_call_by_state(tapi_context context, int slot_id,
         return -EINVAL;
     }
 
-    if (call_list == NULL) {
-        tapi_log_error("call list is null in %s", __func__);
-        return -EINVAL;
-    }
-
     if (info == NULL) {
         tapi_log_error("info is null in %s", __func__);
         return -EINVAL;
     }
 
+    if (calls == NULL) {
+        // no list given, match against the library's own call list.
+        call_list_mirror_attach(ctx);
+        calls = call_list_mirror_get(ctx, slot_id, &size);
+        if (calls == NULL) {
+            tapi_log_error("call list of slot %d is not synced in %s", slot_id, __func__);
+            return -EAGAIN;
+        }
+    }
+
     for (int i = 0; i < size; i++) {
-        if (call_list[i].state == state) {
-            memcpy(info + index, call_list + i, sizeof(tapi_call_info));
+        if (calls[i].state == state) {
+            memcpy(info + index, calls + i, sizeof(tapi_call_info));
             index++;
         }
     }
@@ -1196,6 +1149,11 @@ int tapi_call_get_all_calls(tapi_context context, int slot_id, int event_id,
         return -EINVAL;
     }
 
+    // the synced mirror answers without a GetCalls round trip.
+    call_list_mirror_attach(ctx);
+    if (call_list_mirror_post(ctx, slot_id, event_id, p_handle) == OK)
+        return OK;
+
     proxy = ctx->dbus_proxy[slot_id][DBUS_PROXY_CALL];
     if (proxy == NULL) {
         tapi_log_error("no available proxy in %s", __func__);
@@ -1456,19 +1414,19 @@ int tapi_call_get_ecc_list(tapi_context context, int slot_id, ecc_info* out)
 
 int tapi_call_is_emergency_number(tapi_context context, char* number)
 {
+    ecc_info ecc;
+    int ret;
+
     for (int i = 0; i < CONFIG_MODEM_ACTIVE_COUNT; i++) {
-        ecc_info ecc_list[MAX_ECC_LIST_SIZE] = { 0 };
-        int size = tapi_call_get_ecc_list(context, i, ecc_list);
-        if (size <= 0) {
+        ret = tapi_call_match_emergency_number(context, i, number, &ecc);
+        if (ret < 0) {
             tapi_log_error("tapi_is_emergency_number: get ecc list error\n");
             return -1;
         }
 
-        for (int j = 0; j < size; j++) {
-            if (strcmp(number, ecc_list[j].ecc_num) == 0) {
-                tapi_log_debug("tapi_is_emergency_number:%s is emergency number\n", number);
-                return ecc_list[j].condition;
-            }
+        if (ret > 0) {
+            tapi_log_debug("tapi_is_emergency_number:%s is emergency number\n", number);
+            return ecc.condition;
         }
     }
 
@@ -1506,9 +1464,8 @@ int tapi_call_register_ringback_tone_change(tapi_context context, int slot_id, v
         return -EINVAL;
     }
 
-    return tapi_register_manager_call_signal(context, slot_id,
-        OFONO_VOICECALL_MANAGER_INTERFACE, MSG_CALL_RING_BACK_TONE_IND, user_obj,
-        p_handle, call_manager_property_changed);
+    return call_coalesce_register(context, slot_id, MSG_CALL_RING_BACK_TONE_IND,
+        user_obj, p_handle);
 }
 
 int tapi_call_register_default_voicecall_slot_change(tapi_context context, void* user_obj,
@@ -1578,13 +1535,7 @@ int tapi_call_invite_participants(tapi_context context, int slot_id,
 int tapi_call_register_call_state_change(tapi_context context, int slot_id,
     void* user_obj, tapi_async_function p_handle)
 {
-    dbus_context* ctx = context;
-    const char* modem_path;
-    int watch_id;
-    tapi_async_handler* handler;
-    tapi_async_result* ar;
-
-    if (ctx == NULL) {
+    if (context == NULL) {
         tapi_log_error("context is null in %s", __func__);
         return -EINVAL;
     }
@@ -1594,41 +1545,8 @@ int tapi_call_register_call_state_change(tapi_context context, int slot_id,
         return -EINVAL;
     }
 
-    modem_path = tapi_utils_get_modem_path(slot_id);
-    if (modem_path == NULL) {
-        tapi_log_error("no available modem in %s", __func__);
-        return -EIO;
-    }
-
-    handler = malloc(sizeof(tapi_async_handler));
-    if (handler == NULL) {
-        tapi_log_error("malloc failed in %s", __func__);
-        return -ENOMEM;
-    }
-
-    handler->cb_function = p_handle;
-    ar = malloc(sizeof(tapi_async_result));
-    if (ar == NULL) {
-        tapi_log_error("async result in %s is null", __func__);
-        free(handler);
-        return -ENOMEM;
-    }
-    handler->result = ar;
-    ar->arg1 = slot_id;
-    ar->user_obj = user_obj;
-    ar->msg_type = INDICATION;
-
-    watch_id = g_dbus_add_signal_watch(ctx->connection,
-        OFONO_SERVICE, modem_path, OFONO_VOICECALL_MANAGER_INTERFACE,
-        "CallChanged", call_state_changed, handler, handler_free);
-
-    if (watch_id == 0) {
-        tapi_log_error("add signal watch failed in %s", __func__);
-        handler_free(handler);
-        return -EINVAL;
-    }
-
-    return watch_id;
+    return call_coalesce_register(context, slot_id, MSG_CALL_STATE_CHANGE_IND,
+        user_obj, p_handle);
 }
 
 int tapi_call_answer_by_id(tapi_context context, int slot_id, char* call_id)
@@ -0,0 +1,449 @@
+/*
+ * Copyright (C) 2023 Xiaomi Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <string.h>
+#include <uv.h>
+
+#include "tapi.h"
+#include "tapi_internal.h"
+
+/****************************************************************************
+ * Private Type Declarations
+ ****************************************************************************/
+
+typedef struct {
+    bool used;
+    int merged; /* CallChanged signals folded into info */
+    tapi_call_info info;
+} coalesce_call;
+
+typedef struct {
+    struct list_node node;
+    dbus_context* ctx; /* NULL once the context is closed */
+    int slot_id;
+    tapi_async_handler* handler;
+    int watch_id;
+    uv_timer_t timer;
+    bool timer_ready;
+    bool flushing;
+    bool released; /* watch removed from a callback, free after the flush */
+    coalesce_call calls[MAX_CALL_LIST_COUNT];
+    bool ring_back_pending;
+    int ring_back_tone;
+} call_coalescer;
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+
+static void coalescer_close_done(uv_handle_t* handle)
+{
+    call_coalescer* coalescer = handle->data;
+
+    handler_free(coalescer->handler);
+    free(coalescer);
+}
+
+static void coalescer_destroy(call_coalescer* coalescer)
+{
+    if (coalescer->node.next != NULL)
+        list_delete(&coalescer->node);
+
+    if (!coalescer->timer_ready) {
+        handler_free(coalescer->handler);
+        free(coalescer);
+        return;
+    }
+
+    uv_timer_stop(&coalescer->timer);
+    uv_close((uv_handle_t*)&coalescer->timer, coalescer_close_done);
+}
+
+static void call_coalescer_free(void* obj)
+{
+    call_coalescer* coalescer = obj;
+
+    if (coalescer == NULL)
+        return;
+
+    if (coalescer->flushing) {
+        coalescer->released = true;
+        return;
+    }
+
+    coalescer_destroy(coalescer);
+}
+
+static u_int32_t coalescer_window(call_coalescer* coalescer)
+{
+    if (coalescer->ctx == NULL)
+        return 0;
+
+    return coalescer->ctx->call_coalesce_window[coalescer->slot_id];
+}
+
+static bool coalescer_pending(call_coalescer* coalescer)
+{
+    if (coalescer->ring_back_pending)
+        return true;
+
+    for (int i = 0; i < MAX_CALL_LIST_COUNT; i++) {
+        if (coalescer->calls[i].used)
+            return true;
+    }
+
+    return false;
+}
+
+static void coalescer_deliver_call(call_coalescer* coalescer, tapi_call_info* info, int merged,
+    uint64_t begin)
+{
+    tapi_async_result* ar = coalescer->handler->result;
+
+    ar->arg2 = merged;
+    ar->data = info;
+    ar->status = OK;
+    coalescer->handler->cb_function(ar);
+
+    if (info->state == CALL_STATUS_INCOMING || info->state == CALL_STATUS_WAITING)
+        dispatch_lane_end(DISPATCH_LANE_HIGH, begin);
+}
+
+static void coalescer_deliver_ring_back(call_coalescer* coalescer, int tone)
+{
+    tapi_async_result* ar = coalescer->handler->result;
+
+    ar->arg2 = tone;
+    ar->status = OK;
+    coalescer->handler->cb_function(ar);
+}
+
+/* Delivers all pending changes, earlier changes of other calls go first as well */
+static void coalescer_flush_pending(call_coalescer* coalescer)
+{
+    tapi_call_info info;
+    int merged;
+
+    for (int i = 0; i < MAX_CALL_LIST_COUNT && !coalescer->released; i++) {
+        coalesce_call* call = &coalescer->calls[i];
+
+        if (!call->used)
+            continue;
+
+        memcpy(&info, &call->info, sizeof(tapi_call_info));
+        merged = call->merged;
+        call->used = false;
+        coalescer_deliver_call(coalescer, &info, merged, dispatch_lane_begin());
+    }
+
+    if (coalescer->ring_back_pending && !coalescer->released) {
+        coalescer->ring_back_pending = false;
+        coalescer_deliver_ring_back(coalescer, coalescer->ring_back_tone);
+    }
+}
+
+static void coalescer_begin(call_coalescer* coalescer)
+{
+    coalescer->flushing = true;
+}
+
+/* A callback may have removed the watch, the coalescer is gone then */
+static void coalescer_end(call_coalescer* coalescer)
+{
+    coalescer->flushing = false;
+
+    if (coalescer->released) {
+        coalescer_destroy(coalescer);
+        return;
+    }
+
+    if (coalescer->timer_ready && !coalescer_pending(coalescer))
+        uv_timer_stop(&coalescer->timer);
+}
+
+static void coalescer_expired(uv_timer_t* handle)
+{
+    call_coalescer* coalescer = handle->data;
+
+    coalescer_begin(coalescer);
+    coalescer_flush_pending(coalescer);
+    coalescer_end(coalescer);
+}
+
+static void coalescer_arm(call_coalescer* coalescer, u_int32_t window)
+{
+    if (!coalescer->timer_ready) {
+        uv_timer_init(uv_default_loop(), &coalescer->timer);
+        coalescer->timer.data = coalescer;
+        coalescer->timer_ready = true;
+    }
+
+    /* the window starts with the first change, later ones do not extend it */
+    if (!uv_is_active((uv_handle_t*)&coalescer->timer))
+        uv_timer_start(&coalescer->timer, coalescer_expired, window, 0);
+}
+
+static bool coalescer_critical(const tapi_call_info* info)
+{
+    return info->state == CALL_STATUS_DISCONNECTED
+        || info->state == CALL_STATUS_INCOMING
+        || info->state == CALL_STATUS_WAITING;
+}
+
+static coalesce_call* coalescer_slot(call_coalescer* coalescer, const char* call_id)
+{
+    coalesce_call* free_call = NULL;
+
+    for (int i = 0; i < MAX_CALL_LIST_COUNT; i++) {
+        coalesce_call* call = &coalescer->calls[i];
+
+        if (call->used && strcmp(call->info.call_id, call_id) == 0)
+            return call;
+
+        if (!call->used && free_call == NULL)
+            free_call = call;
+    }
+
+    return free_call;
+}
+
+static int call_state_changed(DBusConnection* connection, DBusMessage* message, void* user_data)
+{
+    call_coalescer* coalescer = user_data;
+    uint64_t begin = dispatch_lane_begin();
+    tapi_call_info voicecall;
+    DBusMessageIter iter;
+    coalesce_call* call;
+    u_int32_t window;
+
+    if (coalescer == NULL) {
+        tapi_log_error("coalescer in %s is null", __func__);
+        return 0;
+    }
+
+    if (coalescer->handler->cb_function == NULL) {
+        tapi_log_error("callback in %s is null", __func__);
+        return 0;
+    }
+
+    if (!dbus_message_iter_init(message, &iter)) {
+        tapi_log_error("dbus message iter init failed in %s", __func__);
+        return 0;
+    }
+
+    if (decode_voice_call_info(&iter, &voicecall) < 0)
+        return 0;
+
+    window = coalescer_window(coalescer);
+    call = coalescer_slot(coalescer, voicecall.call_id);
+
+    if (window > 0 && !coalescer_critical(&voicecall) && call != NULL) {
+        /* CallChanged carries every property, the latest one is the merge */
+        call->merged = call->used ? call->merged + 1 : 1;
+        call->used = true;
+        memcpy(&call->info, &voicecall, sizeof(tapi_call_info));
+        coalescer_arm(coalescer, window);
+        return 1;
+    }
+
+    /* keep the order of changes across calls, or make room for new ones */
+    coalescer_begin(coalescer);
+    coalescer_flush_pending(coalescer);
+    if (!coalescer->released)
+        coalescer_deliver_call(coalescer, &voicecall, 1, begin);
+    coalescer_end(coalescer);
+
+    return 1;
+}
+
+static int ring_back_tone_changed(DBusConnection* connection, DBusMessage* message,
+    void* user_data)
+{
+    call_coalescer* coalescer = user_data;
+    DBusMessageIter iter;
+    u_int32_t window;
+    int tone;
+
+    if (coalescer == NULL) {
+        tapi_log_error("coalescer in %s is null", __func__);
+        return 0;
+    }
+
+    if (coalescer->handler->cb_function == NULL) {
+        tapi_log_error("callback in %s is null", __func__);
+        return 0;
+    }
+
+    if (!is_call_signal_message(message, &iter, DBUS_TYPE_INT32))
+        return 1;
+
+    dbus_message_iter_get_basic(&iter, &tone);
+
+    window = coalescer_window(coalescer);
+    if (window > 0) {
+        coalescer->ring_back_pending = true;
+        coalescer->ring_back_tone = tone;
+        coalescer_arm(coalescer, window);
+        return 1;
+    }
+
+    coalescer_begin(coalescer);
+    coalescer_deliver_ring_back(coalescer, tone);
+    coalescer_end(coalescer);
+
+    return 1;
+}
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+int call_coalesce_register(dbus_context* ctx, int slot_id, tapi_indication_msg msg,
+    void* user_obj, tapi_async_function p_handle)
+{
+    GDBusSignalFunction function;
+    call_coalescer* coalescer;
+    tapi_async_handler* handler;
+    tapi_async_result* ar;
+    const char* modem_path;
+    const char* member;
+    int watch_id;
+
+    switch (msg) {
+    case MSG_CALL_STATE_CHANGE_IND:
+        member = "CallChanged";
+        function = call_state_changed;
+        break;
+    case MSG_CALL_RING_BACK_TONE_IND:
+        member = "RingBackTone";
+        function = ring_back_tone_changed;
+        break;
+    default:
+        tapi_log_error("invalid msg %d in %s", (int)msg, __func__);
+        return -EINVAL;
+    }
+
+    modem_path = tapi_utils_get_modem_path(slot_id);
+    if (modem_path == NULL) {
+        tapi_log_error("no available modem in %s", __func__);
+        return -EIO;
+    }
+
+    coalescer = malloc(sizeof(call_coalescer));
+    if (coalescer == NULL) {
+        tapi_log_error("coalescer in %s is null", __func__);
+        return -ENOMEM;
+    }
+
+    handler = malloc(sizeof(tapi_async_handler));
+    if (handler == NULL) {
+        tapi_log_error("handler in %s is null", __func__);
+        free(coalescer);
+        return -ENOMEM;
+    }
+
+    ar = malloc(sizeof(tapi_async_result));
+    if (ar == NULL) {
+        tapi_log_error("async result in %s is null", __func__);
+        free(handler);
+        free(coalescer);
+        return -ENOMEM;
+    }
+
+    memset(ar, 0, sizeof(tapi_async_result));
+    ar->msg_id = msg;
+    ar->msg_type = INDICATION;
+    ar->arg1 = slot_id;
+    ar->user_obj = user_obj;
+    handler->result = ar;
+    handler->cb_function = p_handle;
+
+    memset(coalescer, 0, sizeof(call_coalescer));
+    coalescer->ctx = ctx;
+    coalescer->slot_id = slot_id;
+    coalescer->handler = handler;
+
+    watch_id = g_dbus_add_signal_watch(ctx->connection,
+        OFONO_SERVICE, modem_path, OFONO_VOICECALL_MANAGER_INTERFACE,
+        member, function, coalescer, call_coalescer_free);
+    if (watch_id == 0) {
+        tapi_log_error("add signal watch failed in %s", __func__);
+        call_coalescer_free(coalescer);
+        return -EINVAL;
+    }
+
+    coalescer->watch_id = watch_id;
+    list_add_tail(&ctx->call_coalesce_list, &coalescer->node);
+    return watch_id;
+}
+
+void call_coalesce_detach_all(dbus_context* ctx)
+{
+    call_coalescer* coalescer;
+    call_coalescer* tmp;
+
+    /* pending changes are dropped, the timer is closed and freed with the watch */
+    list_for_every_entry_safe(&ctx->call_coalesce_list, coalescer, tmp, call_coalescer, node)
+    {
+        list_delete(&coalescer->node);
+        coalescer->ctx = NULL;
+        coalescer->ring_back_pending = false;
+        for (int i = 0; i < MAX_CALL_LIST_COUNT; i++)
+            coalescer->calls[i].used = false;
+
+        g_dbus_remove_watch(ctx->connection, coalescer->watch_id);
+    }
+}
+
+int tapi_call_set_event_coalescing(tapi_context context, int slot_id, u_int32_t window_ms)
+{
+    dbus_context* ctx = context;
+    call_coalescer* coalescer;
+
+    if (ctx == NULL) {
+        tapi_log_error("context is null in %s", __func__);
+        return -EINVAL;
+    }
+
+    if (!tapi_is_valid_slotid(slot_id)) {
+        tapi_log_error("invalid slot id %d in %s", slot_id, __func__);
+        return -EINVAL;
+    }
+
+    if (window_ms > MAX_CALL_EVENT_COALESCE_WINDOW) {
+        tapi_log_error("invalid window %u in %s", (unsigned)window_ms, __func__);
+        return -EINVAL;
+    }
+
+    ctx->call_coalesce_window[slot_id] = window_ms;
+    if (window_ms > 0)
+        return OK;
+
+    /* nothing may stay queued once coalescing is off */
+    list_for_every_entry(&ctx->call_coalesce_list, coalescer, call_coalescer, node)
+    {
+        if (coalescer->slot_id == slot_id && coalescer_pending(coalescer)) {
+            uv_timer_stop(&coalescer->timer);
+            uv_timer_start(&coalescer->timer, coalescer_expired, 0, 0);
+        }
+    }
+
+    return OK;
+}
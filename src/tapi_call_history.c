@@ -0,0 +1,699 @@
+/*
+ * Copyright (C) 2023 Xiaomi Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include <uv.h>
+
+#include "tapi.h"
+#include "tapi_internal.h"
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+
+#define CALL_HISTORY_MAGIC 0x31484354 /* "TCH1" */
+#define CALL_HISTORY_VERSION 1
+
+/* Appended to the path of an existing file that is not a call history */
+#define CALL_HISTORY_ASIDE_SUFFIX ".bad"
+
+/* Records summarized by one index entry */
+#define CALL_HISTORY_BLOCK_RECORDS 64
+
+/* Number filter of a block, two bits per record keep false hits under 5% */
+#define CALL_HISTORY_FILTER_WORDS 8
+
+#define CALL_HISTORY_BLOCKS(capacity) \
+    (((capacity) + CALL_HISTORY_BLOCK_RECORDS - 1) / CALL_HISTORY_BLOCK_RECORDS)
+
+/****************************************************************************
+ * Private Type Declarations
+ ****************************************************************************/
+
+/* File layout: header, one index entry per block, then the records */
+typedef struct {
+    u_int32_t magic;
+    uint16_t version;
+    uint16_t record_size;
+    u_int32_t capacity; /* multiple of CALL_HISTORY_BLOCK_RECORDS */
+    u_int32_t count; /* records written, updated after them */
+    u_int32_t reserved[4];
+} call_history_header;
+
+typedef struct {
+    u_int32_t min_start;
+    u_int32_t max_start;
+    uint64_t numbers[CALL_HISTORY_FILTER_WORDS]; /* bloom filter of the number keys */
+} call_history_index;
+
+typedef struct {
+    int word[2];
+    uint64_t bit[2];
+} call_history_key_bits;
+
+typedef struct {
+    bool used;
+    bool incoming;
+    bool answered;
+    bool emergency;
+    char call_id[MAX_CALL_ID_LENGTH + 1];
+    char number[MAX_CALL_HISTORY_NUMBER_LENGTH + 1];
+    tapi_call_disconnect_reason reason;
+    u_int32_t created; /* s, wall clock */
+    uint64_t active; /* ns, uv_hrtime */
+} call_history_call;
+
+struct call_history {
+    int fd;
+    size_t size;
+    uint8_t* map;
+    call_history_header* header;
+    call_history_index* index;
+    tapi_call_history_record* records;
+    tapi_call_history_record pending[CONFIG_TELEPHONY_CALL_HISTORY_BATCH];
+    int pending_count;
+    uv_timer_t timer;
+    call_history_call calls[CONFIG_MODEM_ACTIVE_COUNT][MAX_CALL_LIST_COUNT];
+};
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+
+static size_t call_history_file_size(u_int32_t capacity)
+{
+    return sizeof(call_history_header)
+        + CALL_HISTORY_BLOCKS(capacity) * sizeof(call_history_index)
+        + (size_t)capacity * sizeof(tapi_call_history_record);
+}
+
+static void call_history_hash_key(const tapi_number_key* key, call_history_key_bits* bits)
+{
+    u_int32_t hash = 2166136261u;
+    int bytes = (key->length + 1) / 2;
+
+    hash = (hash ^ key->flags) * 16777619u;
+    hash = (hash ^ key->length) * 16777619u;
+    for (int i = 0; i < bytes && i < MAX_NUMBER_KEY_BCD_SIZE; i++)
+        hash = (hash ^ key->bcd[i]) * 16777619u;
+
+    for (int i = 0; i < 2; i++, hash >>= 9) {
+        bits->word[i] = (hash >> 6) % CALL_HISTORY_FILTER_WORDS;
+        bits->bit[i] = 1ULL << (hash & 63);
+    }
+}
+
+static bool call_history_match(const tapi_call_history_record* record,
+    const tapi_call_history_filter* filter)
+{
+    if (filter == NULL)
+        return true;
+
+    if ((filter->from != 0 && record->start < filter->from)
+        || (filter->to != 0 && record->start > filter->to))
+        return false;
+
+    if ((record->flags & filter->flags) != filter->flags)
+        return false;
+
+    return filter->key == NULL || tapi_utils_number_key_equal(&record->key, filter->key);
+}
+
+static bool call_history_block_match(const call_history_index* index,
+    const tapi_call_history_filter* filter, const call_history_key_bits* bits)
+{
+    if (filter == NULL)
+        return true;
+
+    if ((filter->from != 0 && index->max_start < filter->from)
+        || (filter->to != 0 && index->min_start > filter->to))
+        return false;
+
+    if (filter->key == NULL)
+        return true;
+
+    for (int i = 0; i < 2; i++) {
+        if ((index->numbers[bits->word[i]] & bits->bit[i]) == 0)
+            return false;
+    }
+
+    return true;
+}
+
+static void call_history_index_add(call_history_index* index,
+    const tapi_call_history_record* record, bool first)
+{
+    call_history_key_bits bits;
+
+    if (first) {
+        memset(index, 0, sizeof(call_history_index));
+        index->min_start = record->start;
+        index->max_start = record->start;
+    } else {
+        if (record->start < index->min_start)
+            index->min_start = record->start;
+        if (record->start > index->max_start)
+            index->max_start = record->start;
+    }
+
+    call_history_hash_key(&record->key, &bits);
+    for (int i = 0; i < 2; i++)
+        index->numbers[bits.word[i]] |= bits.bit[i];
+}
+
+/* Writes back the pages of [from, to) of the mapping */
+static int call_history_sync(call_history* history, const void* from, const void* to)
+{
+    uintptr_t page = sysconf(_SC_PAGESIZE);
+    uintptr_t start = ((uintptr_t)from - (uintptr_t)history->map) / page * page;
+    uintptr_t end = (uintptr_t)to - (uintptr_t)history->map;
+    int ret;
+
+    if (msync(history->map + start, end - start, MS_SYNC) < 0) {
+        ret = -errno;
+        tapi_log_error("msync failed in %s, ret %d", __func__, ret);
+        return ret;
+    }
+
+    return OK;
+}
+
+/*
+ * Drops the oldest half, whole blocks move so the index stays valid.
+ * The cleared count reaches the flash before records move, a crash during
+ * the move leaves an empty history instead of a count over moved records.
+ * The caller publishes the kept count after writing the kept records.
+ */
+static int call_history_compact(call_history* history, u_int32_t* kept)
+{
+    u_int32_t count = history->header->count;
+    u_int32_t blocks = CALL_HISTORY_BLOCKS(count);
+    u_int32_t drop = blocks > 1 ? blocks / 2 : blocks;
+    u_int32_t dropped = drop * CALL_HISTORY_BLOCK_RECORDS;
+    int ret;
+
+    history->header->count = 0;
+    ret = call_history_sync(history, history->header, history->header + 1);
+    if (ret != OK) {
+        history->header->count = count;
+        return ret;
+    }
+
+    if (dropped >= count) {
+        *kept = 0;
+        return OK;
+    }
+
+    memmove(history->index, history->index + drop, (blocks - drop) * sizeof(call_history_index));
+    memmove(history->records, history->records + dropped,
+        (count - dropped) * sizeof(tapi_call_history_record));
+    *kept = count - dropped;
+    return OK;
+}
+
+static void call_history_expired(uv_timer_t* handle);
+
+/* Pending records stay buffered until a write succeeds, the timer retries */
+static int call_history_write(call_history* history)
+{
+    call_history_header* header = history->header;
+    u_int32_t first;
+    u_int32_t count;
+    int ret;
+
+    if (history->pending_count == 0)
+        return OK;
+
+    uv_timer_stop(&history->timer);
+
+    /* a compaction rewrites everything that is kept */
+    first = header->count;
+    count = header->count;
+    if (count + history->pending_count > header->capacity) {
+        ret = call_history_compact(history, &count);
+        if (ret != OK)
+            goto retry;
+
+        first = 0;
+    }
+
+    for (int i = 0; i < history->pending_count; i++, count++) {
+        memcpy(&history->records[count], &history->pending[i], sizeof(tapi_call_history_record));
+        call_history_index_add(&history->index[count / CALL_HISTORY_BLOCK_RECORDS],
+            &history->pending[i], count % CALL_HISTORY_BLOCK_RECORDS == 0);
+    }
+
+    /* the records reach the flash before the count that makes them visible */
+    ret = call_history_sync(history, &history->index[first / CALL_HISTORY_BLOCK_RECORDS],
+        &history->index[CALL_HISTORY_BLOCKS(count)]);
+    if (ret == OK)
+        ret = call_history_sync(history, &history->records[first], &history->records[count]);
+    if (ret != OK)
+        goto retry;
+
+    header->count = count;
+    ret = call_history_sync(history, header, header + 1);
+    if (ret != OK) {
+        header->count = first;
+        goto retry;
+    }
+
+    history->pending_count = 0;
+    return OK;
+
+retry:
+    uv_timer_start(&history->timer, call_history_expired,
+        CONFIG_TELEPHONY_CALL_HISTORY_FLUSH_DELAY, 0);
+    return ret;
+}
+
+static void call_history_expired(uv_timer_t* handle)
+{
+    call_history_write(handle->data);
+}
+
+static int call_history_append(call_history* history, const tapi_call_history_record* record)
+{
+    /* the buffer is still full of records a failed write kept */
+    if (history->pending_count >= CONFIG_TELEPHONY_CALL_HISTORY_BATCH
+        && call_history_write(history) != OK) {
+        tapi_log_error("history write failed, record dropped in %s", __func__);
+        return -EIO;
+    }
+
+    memcpy(&history->pending[history->pending_count++], record, sizeof(tapi_call_history_record));
+
+    if (history->pending_count >= CONFIG_TELEPHONY_CALL_HISTORY_BATCH)
+        return call_history_write(history);
+
+    if (!uv_is_active((uv_handle_t*)&history->timer))
+        uv_timer_start(&history->timer, call_history_expired,
+            CONFIG_TELEPHONY_CALL_HISTORY_FLUSH_DELAY, 0);
+
+    return OK;
+}
+
+/* A file that is not a call history is kept next to it instead of being overwritten */
+static int call_history_set_aside(call_history* history, const char* path)
+{
+    char* aside;
+    int ret;
+
+    close(history->fd);
+
+    aside = malloc(strlen(path) + sizeof(CALL_HISTORY_ASIDE_SUFFIX));
+    if (aside == NULL) {
+        tapi_log_error("aside in %s is null", __func__);
+        return -ENOMEM;
+    }
+
+    sprintf(aside, "%s" CALL_HISTORY_ASIDE_SUFFIX, path);
+    if (rename(path, aside) < 0) {
+        ret = -errno;
+        tapi_log_error("rename %s failed in %s, ret %d", path, __func__, ret);
+        free(aside);
+        return ret;
+    }
+
+    tapi_log_error("%s is no call history, moved to %s", path, aside);
+    free(aside);
+
+    history->fd = open(path, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (history->fd < 0) {
+        ret = -errno;
+        tapi_log_error("open %s failed in %s, ret %d", path, __func__, ret);
+        return ret;
+    }
+
+    return OK;
+}
+
+static int call_history_map(call_history* history, const char* path, u_int32_t capacity)
+{
+    call_history_header header;
+    struct stat st;
+    bool valid = false;
+    int ret;
+
+    history->fd = open(path, O_RDWR | O_CREAT, 0600);
+    if (history->fd < 0) {
+        tapi_log_error("open %s failed in %s, errno %d", path, __func__, errno);
+        return -errno;
+    }
+
+    if (fstat(history->fd, &st) < 0) {
+        ret = -errno;
+        tapi_log_error("stat %s failed in %s, ret %d", path, __func__, ret);
+        close(history->fd);
+        return ret;
+    }
+
+    if (st.st_size >= (off_t)sizeof(call_history_header)
+        && read(history->fd, &header, sizeof(header)) == sizeof(header)) {
+        valid = header.magic == CALL_HISTORY_MAGIC
+            && header.version == CALL_HISTORY_VERSION
+            && header.record_size == sizeof(tapi_call_history_record)
+            && header.capacity % CALL_HISTORY_BLOCK_RECORDS == 0
+            && header.count <= header.capacity
+            && st.st_size == (off_t)call_history_file_size(header.capacity);
+    }
+
+    if (!valid && st.st_size > 0) {
+        ret = call_history_set_aside(history, path);
+        if (ret != OK)
+            return ret;
+    }
+
+    if (valid) {
+        capacity = header.capacity;
+    } else {
+        capacity = CALL_HISTORY_BLOCKS(capacity) * CALL_HISTORY_BLOCK_RECORDS;
+        if (ftruncate(history->fd, call_history_file_size(capacity)) < 0) {
+            tapi_log_error("resize %s failed in %s, errno %d", path, __func__, errno);
+            close(history->fd);
+            return -errno;
+        }
+    }
+
+    history->size = call_history_file_size(capacity);
+    history->map = mmap(NULL, history->size, PROT_READ | PROT_WRITE, MAP_SHARED,
+        history->fd, 0);
+    if (history->map == MAP_FAILED) {
+        tapi_log_error("mmap %s failed in %s, errno %d", path, __func__, errno);
+        close(history->fd);
+        return -errno;
+    }
+
+    history->header = (call_history_header*)history->map;
+    history->index = (call_history_index*)(history->map + sizeof(call_history_header));
+    history->records = (tapi_call_history_record*)(history->index
+        + CALL_HISTORY_BLOCKS(capacity));
+
+    if (!valid) {
+        memset(history->header, 0, sizeof(call_history_header));
+        history->header->magic = CALL_HISTORY_MAGIC;
+        history->header->version = CALL_HISTORY_VERSION;
+        history->header->record_size = sizeof(tapi_call_history_record);
+        history->header->capacity = capacity;
+        msync(history->map, sizeof(call_history_header), MS_SYNC);
+    }
+
+    return OK;
+}
+
+static void call_history_close_done(uv_handle_t* handle)
+{
+    free(handle->data);
+}
+
+static call_history_call* call_history_find(call_history* history, int slot_id,
+    const char* call_id, bool create)
+{
+    call_history_call* free_call = NULL;
+
+    for (int i = 0; i < MAX_CALL_LIST_COUNT; i++) {
+        call_history_call* call = &history->calls[slot_id][i];
+
+        if (call->used && strcmp(call->call_id, call_id) == 0)
+            return call;
+
+        if (!call->used && free_call == NULL)
+            free_call = call;
+    }
+
+    if (!create || free_call == NULL)
+        return NULL;
+
+    memset(free_call, 0, sizeof(call_history_call));
+    free_call->used = true;
+    snprintf(free_call->call_id, sizeof(free_call->call_id), "%s", call_id);
+    return free_call;
+}
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+void call_history_update(dbus_context* ctx, int slot_id, const tapi_call_info* call_info)
+{
+    call_history* history = ctx->call_history;
+    call_history_call* call;
+    bool create;
+
+    if (history == NULL || !tapi_is_valid_slotid(slot_id))
+        return;
+
+    create = call_info->state == CALL_STATUS_DIALING || call_info->state == CALL_STATUS_ALERTING
+        || call_info->state == CALL_STATUS_INCOMING || call_info->state == CALL_STATUS_WAITING;
+
+    call = call_history_find(history, slot_id, call_info->call_id, create);
+    if (call == NULL)
+        return;
+
+    if (call->created == 0) {
+        call->created = time(NULL);
+        call->incoming = call_info->state == CALL_STATUS_INCOMING
+            || call_info->state == CALL_STATUS_WAITING;
+    }
+
+    /* the line identification of an incoming call may come later */
+    if (call->number[0] == '\0')
+        snprintf(call->number, sizeof(call->number), "%.*s", (int)sizeof(call->number) - 1,
+            call_info->lineIdentification);
+
+    if (call_info->state == CALL_STATUS_ACTIVE && !call->answered) {
+        call->answered = true;
+        call->active = uv_hrtime();
+    }
+
+    call->emergency |= call_info->is_emergency_number;
+    call->reason = call_info->disconnect_reason;
+}
+
+void call_history_remove(dbus_context* ctx, int slot_id, const char* call_id)
+{
+    call_history* history = ctx->call_history;
+    tapi_call_history_record record;
+    call_history_call* call;
+
+    if (history == NULL || !tapi_is_valid_slotid(slot_id))
+        return;
+
+    call = call_history_find(history, slot_id, call_id, false);
+    if (call == NULL)
+        return;
+
+    memset(&record, 0, sizeof(tapi_call_history_record));
+    record.start = call->created;
+    record.slot_id = slot_id;
+    record.reason = call->reason;
+    snprintf(record.number, sizeof(record.number), "%s", call->number);
+
+    if (call->incoming)
+        record.flags |= CALL_HISTORY_INCOMING;
+    if (call->emergency)
+        record.flags |= CALL_HISTORY_EMERGENCY;
+    if (call->answered) {
+        record.flags |= CALL_HISTORY_ANSWERED;
+        record.duration = (uv_hrtime() - call->active) / 1000000000ULL;
+    }
+
+    /* withheld numbers keep an empty key */
+    if (record.number[0] != '\0')
+        tapi_utils_normalize_number(ctx, slot_id, record.number, &record.key);
+
+    call->used = false;
+    call_history_append(history, &record);
+}
+
+void call_history_drop_calls(dbus_context* ctx, int slot_id)
+{
+    if (ctx->call_history == NULL || !tapi_is_valid_slotid(slot_id))
+        return;
+
+    /* the end of these calls was not observed, they are not recorded */
+    for (int i = 0; i < MAX_CALL_LIST_COUNT; i++)
+        ctx->call_history->calls[slot_id][i].used = false;
+}
+
+void call_history_release(dbus_context* ctx)
+{
+    call_history* history = ctx->call_history;
+
+    if (history == NULL)
+        return;
+
+    call_history_write(history);
+    munmap(history->map, history->size);
+    close(history->fd);
+
+    ctx->call_history = NULL;
+    uv_close((uv_handle_t*)&history->timer, call_history_close_done);
+}
+
+int tapi_call_history_enable(tapi_context context, const char* path, u_int32_t capacity)
+{
+    dbus_context* ctx = context;
+    call_history* history;
+    int ret;
+
+    if (ctx == NULL || path == NULL) {
+        tapi_log_error("invalid argument in %s", __func__);
+        return -EINVAL;
+    }
+
+    if (ctx->call_history != NULL) {
+        tapi_log_error("call history already enabled in %s", __func__);
+        return -EALREADY;
+    }
+
+    history = malloc(sizeof(call_history));
+    if (history == NULL) {
+        tapi_log_error("history in %s is null", __func__);
+        return -ENOMEM;
+    }
+
+    memset(history, 0, sizeof(call_history));
+
+    ret = call_history_map(history, path,
+        capacity > 0 ? capacity : CONFIG_TELEPHONY_CALL_HISTORY_CAPACITY);
+    if (ret != OK) {
+        free(history);
+        return ret;
+    }
+
+    uv_timer_init(uv_default_loop(), &history->timer);
+    history->timer.data = history;
+
+    ctx->call_history = history;
+
+    /* calls are recorded from the mirror's signals */
+    if (call_list_mirror_attach(ctx) != OK)
+        tapi_log_error("call list mirror attach failed in %s", __func__);
+
+    return OK;
+}
+
+int tapi_call_history_disable(tapi_context context)
+{
+    dbus_context* ctx = context;
+
+    if (ctx == NULL) {
+        tapi_log_error("context is null in %s", __func__);
+        return -EINVAL;
+    }
+
+    if (ctx->call_history == NULL) {
+        tapi_log_error("call history in %s is null", __func__);
+        return -EIO;
+    }
+
+    call_history_release(ctx);
+    return OK;
+}
+
+int tapi_call_history_add(tapi_context context, const tapi_call_history_record* record)
+{
+    dbus_context* ctx = context;
+
+    if (ctx == NULL || record == NULL) {
+        tapi_log_error("invalid argument in %s", __func__);
+        return -EINVAL;
+    }
+
+    if (ctx->call_history == NULL) {
+        tapi_log_error("call history in %s is null", __func__);
+        return -EIO;
+    }
+
+    return call_history_append(ctx->call_history, record);
+}
+
+int tapi_call_history_flush(tapi_context context)
+{
+    dbus_context* ctx = context;
+
+    if (ctx == NULL) {
+        tapi_log_error("context is null in %s", __func__);
+        return -EINVAL;
+    }
+
+    if (ctx->call_history == NULL) {
+        tapi_log_error("call history in %s is null", __func__);
+        return -EIO;
+    }
+
+    return call_history_write(ctx->call_history);
+}
+
+int tapi_call_history_query(tapi_context context, const tapi_call_history_filter* filter,
+    tapi_call_history_record* out, int max)
+{
+    dbus_context* ctx = context;
+    call_history_key_bits bits;
+    call_history* history;
+    int found = 0;
+    int block;
+
+    if (ctx == NULL || out == NULL || max <= 0) {
+        tapi_log_error("invalid argument in %s", __func__);
+        return -EINVAL;
+    }
+
+    history = ctx->call_history;
+    if (history == NULL) {
+        tapi_log_error("call history in %s is null", __func__);
+        return -EIO;
+    }
+
+    if (filter != NULL && filter->key != NULL)
+        call_history_hash_key(filter->key, &bits);
+
+    for (int i = history->pending_count - 1; i >= 0 && found < max; i--) {
+        if (call_history_match(&history->pending[i], filter))
+            memcpy(&out[found++], &history->pending[i], sizeof(tapi_call_history_record));
+    }
+
+    /* only the index and the blocks that may match are touched */
+    block = CALL_HISTORY_BLOCKS(history->header->count) - 1;
+    for (; block >= 0 && found < max; block--) {
+        int first = block * CALL_HISTORY_BLOCK_RECORDS;
+        int last = first + CALL_HISTORY_BLOCK_RECORDS - 1;
+
+        if (!call_history_block_match(&history->index[block], filter, &bits))
+            continue;
+
+        if (last >= (int)history->header->count)
+            last = history->header->count - 1;
+
+        for (int i = last; i >= first && found < max; i--) {
+            if (call_history_match(&history->records[i], filter))
+                memcpy(&out[found++], &history->records[i], sizeof(tapi_call_history_record));
+        }
+    }
+
+    return found;
+}
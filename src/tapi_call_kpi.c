@@ -0,0 +1,370 @@
+/*
+ * Copyright (C) 2023 Xiaomi Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <uv.h>
+
+#include "tapi.h"
+#include "tapi_internal.h"
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+
+/* Upper bound of the first bucket, 250ms ... 16s for setup latencies */
+#define CALL_KPI_LATENCY_UNIT 250
+
+/* 15s ... 16min for call durations */
+#define CALL_KPI_DURATION_UNIT 15000
+
+#define NSEC_PER_MSEC 1000000ULL
+
+/****************************************************************************
+ * Private Type Declarations
+ ****************************************************************************/
+
+typedef struct {
+    bool used;
+    bool incoming;
+    char call_id[MAX_CALL_ID_LENGTH + 1];
+    tapi_call_status state;
+    tapi_call_disconnect_reason reason;
+    uint64_t created; /* ns, uv_hrtime */
+    uint64_t dial_sent;
+    uint64_t alerting;
+    uint64_t active;
+    uint64_t ended;
+} call_kpi_call;
+
+typedef struct {
+    uint64_t dial_sent; /* Dial requested, not yet bound to a call */
+    call_kpi_call calls[MAX_CALL_LIST_COUNT];
+    tapi_call_kpi_stats stats;
+} call_kpi_slot;
+
+struct call_kpi_tracker {
+    call_kpi_slot slots[CONFIG_MODEM_ACTIVE_COUNT];
+};
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+
+static void kpi_stats_clear(tapi_call_kpi_stats* stats)
+{
+    memset(stats, 0, sizeof(tapi_call_kpi_stats));
+    stats->dial_reply.unit = CALL_KPI_LATENCY_UNIT;
+    stats->dial_alerting.unit = CALL_KPI_LATENCY_UNIT;
+    stats->dial_active.unit = CALL_KPI_LATENCY_UNIT;
+    stats->incoming_answer.unit = CALL_KPI_LATENCY_UNIT;
+    stats->duration.unit = CALL_KPI_DURATION_UNIT;
+}
+
+static void kpi_histogram_add(tapi_call_kpi_histogram* histogram, uint64_t from, uint64_t to)
+{
+    u_int32_t value;
+    int bucket = 0;
+
+    if (from == 0 || to < from)
+        return;
+
+    value = (to - from) / NSEC_PER_MSEC;
+
+    while (bucket < CALL_KPI_BUCKET_COUNT - 1 && value >= (histogram->unit << bucket))
+        bucket++;
+
+    histogram->buckets[bucket]++;
+    histogram->sum += value;
+
+    if (histogram->count == 0 || value < histogram->min)
+        histogram->min = value;
+    if (value > histogram->max)
+        histogram->max = value;
+
+    histogram->count++;
+}
+
+static call_kpi_slot* kpi_get_slot(dbus_context* ctx, int slot_id)
+{
+    if (ctx->call_kpi == NULL || !tapi_is_valid_slotid(slot_id))
+        return NULL;
+
+    return &ctx->call_kpi->slots[slot_id];
+}
+
+static call_kpi_call* kpi_find_call(call_kpi_slot* slot, const char* call_id)
+{
+    for (int i = 0; i < MAX_CALL_LIST_COUNT; i++) {
+        if (slot->calls[i].used && strcmp(slot->calls[i].call_id, call_id) == 0)
+            return &slot->calls[i];
+    }
+
+    return NULL;
+}
+
+static call_kpi_call* kpi_new_call(call_kpi_slot* slot, const char* call_id, bool incoming,
+    uint64_t now)
+{
+    call_kpi_call* call = NULL;
+
+    for (int i = 0; i < MAX_CALL_LIST_COUNT; i++) {
+        if (!slot->calls[i].used) {
+            call = &slot->calls[i];
+            break;
+        }
+    }
+
+    if (call == NULL) {
+        tapi_log_error("no free call kpi entry in %s", __func__);
+        return NULL;
+    }
+
+    memset(call, 0, sizeof(call_kpi_call));
+    call->used = true;
+    call->incoming = incoming;
+    call->state = CALL_STATUS_UNKNOW;
+    call->created = now;
+    snprintf(call->call_id, sizeof(call->call_id), "%s", call_id);
+
+    /* the first outgoing call after a Dial request owns its timestamp */
+    if (!incoming) {
+        call->dial_sent = slot->dial_sent != 0 ? slot->dial_sent : now;
+        slot->dial_sent = 0;
+    }
+
+    return call;
+}
+
+static void kpi_finish_call(call_kpi_slot* slot, call_kpi_call* call, uint64_t now)
+{
+    tapi_call_kpi_stats* stats = &slot->stats;
+
+    if (call->ended == 0)
+        call->ended = now;
+
+    if (call->active != 0)
+        kpi_histogram_add(&stats->duration, call->active, call->ended);
+    else if (call->incoming)
+        stats->missed++;
+    else
+        stats->setup_failed++;
+
+    if (call->reason < CALL_KPI_DISCONNECT_REASON_COUNT)
+        stats->disconnect_reasons[call->reason]++;
+
+    call->used = false;
+}
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+int call_kpi_init(dbus_context* ctx)
+{
+    call_kpi_tracker* kpi;
+
+    if (ctx->call_kpi != NULL)
+        return OK;
+
+    kpi = malloc(sizeof(call_kpi_tracker));
+    if (kpi == NULL) {
+        tapi_log_error("kpi in %s is null", __func__);
+        return -ENOMEM;
+    }
+
+    memset(kpi, 0, sizeof(call_kpi_tracker));
+    for (int i = 0; i < CONFIG_MODEM_ACTIVE_COUNT; i++)
+        kpi_stats_clear(&kpi->slots[i].stats);
+
+    ctx->call_kpi = kpi;
+    return OK;
+}
+
+void call_kpi_release(dbus_context* ctx)
+{
+    free(ctx->call_kpi);
+    ctx->call_kpi = NULL;
+}
+
+void call_kpi_dial_sent(dbus_context* ctx, int slot_id)
+{
+    call_kpi_slot* slot = kpi_get_slot(ctx, slot_id);
+
+    if (slot != NULL)
+        slot->dial_sent = uv_hrtime();
+}
+
+void call_kpi_dial_replied(dbus_context* ctx, int slot_id, const char* call_id)
+{
+    call_kpi_slot* slot = kpi_get_slot(ctx, slot_id);
+    uint64_t now = uv_hrtime();
+    call_kpi_call* call;
+
+    if (slot == NULL)
+        return;
+
+    if (call_id == NULL) {
+        slot->stats.dial_rejected++;
+        slot->dial_sent = 0;
+        return;
+    }
+
+    /* CallAdded may have been seen before the Dial reply */
+    call = kpi_find_call(slot, call_id);
+    if (call == NULL)
+        call = kpi_new_call(slot, call_id, false, now);
+
+    if (call != NULL)
+        kpi_histogram_add(&slot->stats.dial_reply, call->dial_sent, now);
+}
+
+void call_kpi_update(dbus_context* ctx, int slot_id, const tapi_call_info* call_info)
+{
+    call_kpi_slot* slot = kpi_get_slot(ctx, slot_id);
+    uint64_t now = uv_hrtime();
+    call_kpi_call* call;
+
+    if (slot == NULL)
+        return;
+
+    call = kpi_find_call(slot, call_info->call_id);
+    if (call == NULL) {
+        /* calls first seen past setup have no usable start time */
+        switch (call_info->state) {
+        case CALL_STATUS_DIALING:
+        case CALL_STATUS_ALERTING:
+            call = kpi_new_call(slot, call_info->call_id, false, now);
+            break;
+        case CALL_STATUS_INCOMING:
+        case CALL_STATUS_WAITING:
+            call = kpi_new_call(slot, call_info->call_id, true, now);
+            break;
+        default:
+            break;
+        }
+
+        if (call == NULL)
+            return;
+    }
+
+    call->reason = call_info->disconnect_reason;
+    if (call->state == call_info->state)
+        return;
+
+    call->state = call_info->state;
+
+    switch (call->state) {
+    case CALL_STATUS_ALERTING:
+        if (call->alerting == 0 && !call->incoming) {
+            call->alerting = now;
+            kpi_histogram_add(&slot->stats.dial_alerting, call->dial_sent, now);
+        }
+        break;
+    case CALL_STATUS_ACTIVE:
+        if (call->active == 0) {
+            call->active = now;
+            if (call->incoming)
+                kpi_histogram_add(&slot->stats.incoming_answer, call->created, now);
+            else
+                kpi_histogram_add(&slot->stats.dial_active, call->dial_sent, now);
+        }
+        break;
+    case CALL_STATUS_DISCONNECTED:
+        /* DisconnectReason may still follow, account the call on CallRemoved */
+        call->ended = now;
+        break;
+    default:
+        break;
+    }
+}
+
+void call_kpi_remove(dbus_context* ctx, int slot_id, const char* call_id)
+{
+    call_kpi_slot* slot = kpi_get_slot(ctx, slot_id);
+    call_kpi_call* call;
+
+    if (slot == NULL)
+        return;
+
+    call = kpi_find_call(slot, call_id);
+    if (call != NULL)
+        kpi_finish_call(slot, call, uv_hrtime());
+}
+
+void call_kpi_drop_calls(dbus_context* ctx, int slot_id)
+{
+    call_kpi_slot* slot = kpi_get_slot(ctx, slot_id);
+
+    if (slot == NULL)
+        return;
+
+    /* the end of these calls was not observed, keep them out of the stats */
+    slot->dial_sent = 0;
+    for (int i = 0; i < MAX_CALL_LIST_COUNT; i++)
+        slot->calls[i].used = false;
+}
+
+int tapi_call_get_kpi_stats(tapi_context context, int slot_id, tapi_call_kpi_stats* out)
+{
+    dbus_context* ctx = context;
+
+    if (ctx == NULL || out == NULL) {
+        tapi_log_error("invalid argument in %s", __func__);
+        return -EINVAL;
+    }
+
+    if (!tapi_is_valid_slotid(slot_id)) {
+        tapi_log_error("invalid slot id %d in %s", slot_id, __func__);
+        return -EINVAL;
+    }
+
+    // collection starts with the first query, calls come from the mirror.
+    if (call_kpi_init(ctx) != OK || call_list_mirror_attach(ctx) != OK) {
+        tapi_log_error("call kpi attach failed in %s", __func__);
+        return -EIO;
+    }
+
+    memcpy(out, &ctx->call_kpi->slots[slot_id].stats, sizeof(tapi_call_kpi_stats));
+    return OK;
+}
+
+int tapi_call_reset_kpi_stats(tapi_context context, int slot_id)
+{
+    dbus_context* ctx = context;
+
+    if (ctx == NULL) {
+        tapi_log_error("context is null in %s", __func__);
+        return -EINVAL;
+    }
+
+    if (!tapi_is_valid_slotid(slot_id)) {
+        tapi_log_error("invalid slot id %d in %s", slot_id, __func__);
+        return -EINVAL;
+    }
+
+    if (call_kpi_init(ctx) != OK || call_list_mirror_attach(ctx) != OK) {
+        tapi_log_error("call kpi attach failed in %s", __func__);
+        return -EIO;
+    }
+
+    kpi_stats_clear(&ctx->call_kpi->slots[slot_id].stats);
+    return OK;
+}
@@ -0,0 +1,584 @@
+/*
+ * Copyright (C) 2023 Xiaomi Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <uv.h>
+
+#include "tapi.h"
+#include "tapi_internal.h"
+
+/****************************************************************************
+ * Private Type Declarations
+ ****************************************************************************/
+
+typedef struct {
+    dbus_context* ctx;
+    int slot_id;
+    bool synced;
+    bool syncing; /* GetCalls in flight */
+    unsigned int generation;
+    int added_watch;
+    int removed_watch;
+    int changed_watch;
+    int count;
+    tapi_call_info calls[MAX_CALL_LIST_COUNT];
+} call_list_slot;
+
+typedef struct {
+    call_list_slot* slot;
+    unsigned int generation;
+} call_list_sync_param;
+
+/* A call list answered from the mirror, delivered from the loop */
+typedef struct {
+    struct list_node node;
+    uv_timer_t timer;
+    tapi_async_function cb;
+    tapi_async_result result;
+    tapi_call_info* calls;
+} call_list_reply;
+
+struct call_list_mirror {
+    int property_watch;
+    struct list_node replies;
+    call_list_slot slots[CONFIG_MODEM_ACTIVE_COUNT];
+};
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+
+static void call_list_sync_done(DBusMessage* message, void* user_data);
+
+static void call_list_request(call_list_slot* slot)
+{
+    call_list_sync_param* param;
+    GDBusProxy* proxy;
+
+    proxy = slot->ctx->dbus_proxy[slot->slot_id][DBUS_PROXY_CALL];
+    if (proxy == NULL) {
+        tapi_log_error("no available proxy in %s", __func__);
+        return;
+    }
+
+    param = malloc(sizeof(call_list_sync_param));
+    if (param == NULL) {
+        tapi_log_error("param in %s is null", __func__);
+        return;
+    }
+
+    param->slot = slot;
+    param->generation = slot->generation;
+
+    if (!g_dbus_proxy_method_call(proxy, "GetCalls", NULL,
+            call_list_sync_done, param, free)) {
+        tapi_log_error("dbus method call fail in %s", __func__);
+        free(param);
+        return;
+    }
+
+    slot->syncing = true;
+}
+
+/* A failed GetCalls is asked again on the next call signal */
+static void call_list_retry(call_list_slot* slot)
+{
+    if (!slot->synced && !slot->syncing)
+        call_list_request(slot);
+}
+
+static int call_list_find(call_list_slot* slot, const char* call_id)
+{
+    for (int i = 0; i < slot->count; i++) {
+        if (strcmp(slot->calls[i].call_id, call_id) == 0)
+            return i;
+    }
+
+    return -1;
+}
+
+static void call_list_update(call_list_slot* slot, const tapi_call_info* call_info)
+{
+    int index = call_list_find(slot, call_info->call_id);
+
+    if (index < 0) {
+        if (slot->count >= MAX_CALL_LIST_COUNT) {
+            tapi_log_error("call list of slot %d is full in %s", slot->slot_id, __func__);
+            return;
+        }
+
+        index = slot->count++;
+    }
+
+    memcpy(&slot->calls[index], call_info, sizeof(tapi_call_info));
+}
+
+static void call_list_remove(call_list_slot* slot, const char* call_id)
+{
+    int index = call_list_find(slot, call_id);
+
+    if (index < 0)
+        return;
+
+    slot->count--;
+    if (index < slot->count) {
+        memmove(&slot->calls[index], &slot->calls[index + 1],
+            (slot->count - index) * sizeof(tapi_call_info));
+    }
+}
+
+static int call_list_added(DBusConnection* connection, DBusMessage* message, void* user_data)
+{
+    call_list_slot* slot = user_data;
+    tapi_call_info call_info;
+    DBusMessageIter iter;
+
+    if (slot == NULL) {
+        tapi_log_error("slot in %s is null", __func__);
+        return 0;
+    }
+
+    if (!dbus_message_iter_init(message, &iter)
+        || dbus_message_iter_get_arg_type(&iter) != DBUS_TYPE_OBJECT_PATH) {
+        tapi_log_error("message invalid in %s", __func__);
+        return 0;
+    }
+
+    if (decode_voice_call_info(&iter, &call_info) < 0)
+        return 0;
+
+    call_list_update(slot, &call_info);
+    call_kpi_update(slot->ctx, slot->slot_id, &call_info);
+    call_history_update(slot->ctx, slot->slot_id, &call_info);
+    call_list_retry(slot);
+    return 1;
+}
+
+static int call_list_changed(DBusConnection* connection, DBusMessage* message, void* user_data)
+{
+    call_list_slot* slot = user_data;
+    tapi_call_info call_info;
+    DBusMessageIter iter;
+
+    if (slot == NULL) {
+        tapi_log_error("slot in %s is null", __func__);
+        return 0;
+    }
+
+    if (!dbus_message_iter_init(message, &iter)
+        || dbus_message_iter_get_arg_type(&iter) != DBUS_TYPE_OBJECT_PATH) {
+        tapi_log_error("message invalid in %s", __func__);
+        return 0;
+    }
+
+    if (decode_voice_call_info(&iter, &call_info) < 0)
+        return 0;
+
+    /* a late disconnect report must not resurrect a removed call */
+    if (call_info.state == CALL_STATUS_DISCONNECTED
+        && call_list_find(slot, call_info.call_id) < 0)
+        return 1;
+
+    call_list_update(slot, &call_info);
+    call_kpi_update(slot->ctx, slot->slot_id, &call_info);
+    call_history_update(slot->ctx, slot->slot_id, &call_info);
+    call_list_retry(slot);
+    return 1;
+}
+
+static int call_list_removed(DBusConnection* connection, DBusMessage* message, void* user_data)
+{
+    call_list_slot* slot = user_data;
+    DBusMessageIter iter;
+    const char* path;
+
+    if (slot == NULL) {
+        tapi_log_error("slot in %s is null", __func__);
+        return 0;
+    }
+
+    if (!dbus_message_iter_init(message, &iter)
+        || dbus_message_iter_get_arg_type(&iter) != DBUS_TYPE_OBJECT_PATH) {
+        tapi_log_error("message invalid in %s", __func__);
+        return 0;
+    }
+
+    dbus_message_iter_get_basic(&iter, &path);
+    call_list_remove(slot, path);
+    call_kpi_remove(slot->ctx, slot->slot_id, path);
+    call_history_remove(slot->ctx, slot->slot_id, path);
+    call_list_retry(slot);
+    return 1;
+}
+
+static int call_list_property_changed(DBusConnection* connection, DBusMessage* message,
+    void* user_data)
+{
+    call_list_mirror* mirror = user_data;
+    DBusMessageIter iter, value;
+    const char* modem_path;
+    const char* path;
+    const char* key;
+    int index;
+
+    if (mirror == NULL) {
+        tapi_log_error("mirror in %s is null", __func__);
+        return 0;
+    }
+
+    path = dbus_message_get_path(message);
+    if (path == NULL)
+        return 1;
+
+    if (!dbus_message_iter_init(message, &iter)
+        || dbus_message_iter_get_arg_type(&iter) != DBUS_TYPE_STRING) {
+        tapi_log_error("message invalid in %s", __func__);
+        return 0;
+    }
+
+    dbus_message_iter_get_basic(&iter, &key);
+    dbus_message_iter_next(&iter);
+    dbus_message_iter_recurse(&iter, &value);
+
+    for (int i = 0; i < CONFIG_MODEM_ACTIVE_COUNT; i++) {
+        call_list_slot* slot = &mirror->slots[i];
+
+        index = call_list_find(slot, path);
+        if (index >= 0) {
+            apply_voice_call_property(&slot->calls[index], key, &value);
+            call_kpi_update(slot->ctx, slot->slot_id, &slot->calls[index]);
+            call_history_update(slot->ctx, slot->slot_id, &slot->calls[index]);
+            break;
+        }
+
+        /* a call of a slot whose GetCalls failed, ask again */
+        modem_path = tapi_utils_get_modem_path(i);
+        if (!slot->synced && modem_path != NULL
+            && strncmp(path, modem_path, strlen(modem_path)) == 0) {
+            call_list_retry(slot);
+            break;
+        }
+    }
+
+    return 1;
+}
+
+static void call_list_sync_done(DBusMessage* message, void* user_data)
+{
+    call_list_sync_param* param = user_data;
+    DBusMessageIter args, list;
+    call_list_slot* slot;
+    DBusError err;
+
+    if (param == NULL) {
+        tapi_log_error("param in %s is null", __func__);
+        return;
+    }
+
+    slot = param->slot;
+    if (param->generation != slot->generation) {
+        /* superseded by a later resync */
+        return;
+    }
+
+    slot->syncing = false;
+
+    dbus_error_init(&err);
+    if (dbus_set_error_from_message(&err, message) == true) {
+        tapi_log_error("error from message in %s, %s: %s", __func__, err.name, err.message);
+        dbus_error_free(&err);
+        return;
+    }
+
+    if (dbus_message_has_signature(message, "a(oa{sv})") == false) {
+        tapi_log_error("dbus message has wrong signature in %s", __func__);
+        return;
+    }
+
+    if (dbus_message_iter_init(message, &args) == false) {
+        tapi_log_error("dbus message iter init failed in %s", __func__);
+        return;
+    }
+
+    slot->count = 0;
+    dbus_message_iter_recurse(&args, &list);
+
+    while (dbus_message_iter_get_arg_type(&list) == DBUS_TYPE_STRUCT
+        && slot->count < MAX_CALL_LIST_COUNT) {
+        DBusMessageIter entry;
+
+        dbus_message_iter_recurse(&list, &entry);
+        if (dbus_message_iter_get_arg_type(&entry) == DBUS_TYPE_OBJECT_PATH
+            && decode_voice_call_info(&entry, &slot->calls[slot->count]) > 0) {
+            slot->count++;
+        }
+
+        dbus_message_iter_next(&list);
+    }
+
+    slot->synced = true;
+    tapi_log_info("call list of slot %d synced, count: %d", slot->slot_id, slot->count);
+}
+
+static void call_list_reply_close_done(uv_handle_t* handle)
+{
+    call_list_reply* reply = handle->data;
+
+    free(reply->calls);
+    free(reply);
+}
+
+static void call_list_reply_fire(uv_timer_t* handle)
+{
+    call_list_reply* reply = handle->data;
+
+    list_delete(&reply->node);
+    reply->cb(&reply->result);
+    uv_close((uv_handle_t*)&reply->timer, call_list_reply_close_done);
+}
+
+static int call_list_add_slot_watch(dbus_context* ctx, const char* modem_path,
+    const char* member, GDBusSignalFunction function, call_list_slot* slot)
+{
+    return g_dbus_add_signal_watch(ctx->connection, OFONO_SERVICE, modem_path,
+        OFONO_VOICECALL_MANAGER_INTERFACE, member, function, slot, NULL);
+}
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+int call_list_mirror_attach(dbus_context* ctx)
+{
+    call_list_mirror* mirror;
+    const char* modem_path;
+
+    if (ctx->call_mirror != NULL)
+        return OK;
+
+    mirror = malloc(sizeof(call_list_mirror));
+    if (mirror == NULL) {
+        tapi_log_error("mirror in %s is null", __func__);
+        return -ENOMEM;
+    }
+
+    memset(mirror, 0, sizeof(call_list_mirror));
+    list_initialize(&mirror->replies);
+    ctx->call_mirror = mirror;
+
+    /* call objects live below the modem path, one watch serves all slots */
+    mirror->property_watch = g_dbus_add_signal_watch(ctx->connection, OFONO_SERVICE,
+        NULL, OFONO_VOICECALL_INTERFACE, "PropertyChanged",
+        call_list_property_changed, mirror, NULL);
+
+    for (int i = 0; i < CONFIG_MODEM_ACTIVE_COUNT; i++) {
+        call_list_slot* slot = &mirror->slots[i];
+
+        slot->ctx = ctx;
+        slot->slot_id = i;
+
+        modem_path = tapi_utils_get_modem_path(i);
+        if (modem_path == NULL)
+            continue;
+
+        slot->added_watch = call_list_add_slot_watch(ctx, modem_path,
+            "CallAdded", call_list_added, slot);
+        slot->removed_watch = call_list_add_slot_watch(ctx, modem_path,
+            "CallRemoved", call_list_removed, slot);
+        slot->changed_watch = call_list_add_slot_watch(ctx, modem_path,
+            "CallChanged", call_list_changed, slot);
+    }
+
+    if (mirror->property_watch == 0) {
+        tapi_log_error("add signal watch failed in %s", __func__);
+        call_list_mirror_release(ctx);
+        return -EINVAL;
+    }
+
+    /* attached after the client got ready, the ready callback synced nothing */
+    if (ctx->client_ready) {
+        for (int i = 0; i < CONFIG_MODEM_ACTIVE_COUNT; i++)
+            call_list_mirror_sync(ctx, i);
+    }
+
+    return OK;
+}
+
+void call_list_mirror_sync(dbus_context* ctx, int slot_id)
+{
+    call_list_slot* slot;
+
+    if (ctx->call_mirror == NULL || !tapi_is_valid_slotid(slot_id))
+        return;
+
+    /* calls do not survive a modem restart, drop them until GetCalls answers */
+    slot = &ctx->call_mirror->slots[slot_id];
+    slot->synced = false;
+    slot->syncing = false;
+    slot->count = 0;
+    slot->generation++;
+    call_kpi_drop_calls(ctx, slot_id);
+    call_history_drop_calls(ctx, slot_id);
+
+    call_list_request(slot);
+}
+
+void call_list_mirror_retry(dbus_context* ctx, int slot_id)
+{
+    if (ctx->call_mirror == NULL || !tapi_is_valid_slotid(slot_id))
+        return;
+
+    call_list_retry(&ctx->call_mirror->slots[slot_id]);
+}
+
+void call_list_mirror_release(dbus_context* ctx)
+{
+    call_list_mirror* mirror = ctx->call_mirror;
+    call_list_reply* reply;
+    call_list_reply* tmp;
+
+    if (mirror == NULL)
+        return;
+
+    /* replies not delivered yet go with the context */
+    list_for_every_entry_safe(&mirror->replies, reply, tmp, call_list_reply, node)
+    {
+        list_delete(&reply->node);
+        uv_timer_stop(&reply->timer);
+        uv_close((uv_handle_t*)&reply->timer, call_list_reply_close_done);
+    }
+
+    if (mirror->property_watch != 0)
+        g_dbus_remove_watch(ctx->connection, mirror->property_watch);
+
+    for (int i = 0; i < CONFIG_MODEM_ACTIVE_COUNT; i++) {
+        call_list_slot* slot = &mirror->slots[i];
+
+        if (slot->added_watch != 0)
+            g_dbus_remove_watch(ctx->connection, slot->added_watch);
+        if (slot->removed_watch != 0)
+            g_dbus_remove_watch(ctx->connection, slot->removed_watch);
+        if (slot->changed_watch != 0)
+            g_dbus_remove_watch(ctx->connection, slot->changed_watch);
+    }
+
+    free(mirror);
+    ctx->call_mirror = NULL;
+}
+
+const tapi_call_info* call_list_mirror_get(dbus_context* ctx, int slot_id, int* count)
+{
+    call_list_slot* slot;
+
+    if (ctx->call_mirror == NULL || !tapi_is_valid_slotid(slot_id))
+        return NULL;
+
+    slot = &ctx->call_mirror->slots[slot_id];
+    if (!slot->synced)
+        return NULL;
+
+    *count = slot->count;
+    return slot->calls;
+}
+
+int call_list_mirror_post(dbus_context* ctx, int slot_id, int event_id,
+    tapi_async_function p_handle)
+{
+    const tapi_call_info* calls;
+    call_list_reply* reply;
+    int count;
+
+    calls = call_list_mirror_get(ctx, slot_id, &count);
+    if (calls == NULL)
+        return -EAGAIN;
+
+    if (p_handle == NULL)
+        return OK;
+
+    reply = malloc(sizeof(call_list_reply));
+    if (reply == NULL) {
+        tapi_log_error("reply in %s is null", __func__);
+        return -ENOMEM;
+    }
+
+    memset(reply, 0, sizeof(call_list_reply));
+    if (count > 0) {
+        /* the list as of the request, later signals must not change it */
+        reply->calls = malloc(count * sizeof(tapi_call_info));
+        if (reply->calls == NULL) {
+            tapi_log_error("calls in %s is null", __func__);
+            free(reply);
+            return -ENOMEM;
+        }
+
+        memcpy(reply->calls, calls, count * sizeof(tapi_call_info));
+    }
+
+    reply->cb = p_handle;
+    reply->result.msg_id = event_id;
+    reply->result.msg_type = RESPONSE;
+    reply->result.arg1 = slot_id;
+    reply->result.arg2 = count;
+    reply->result.status = OK;
+    reply->result.data = reply->calls;
+
+    uv_timer_init(uv_default_loop(), &reply->timer);
+    reply->timer.data = reply;
+    list_add_tail(&ctx->call_mirror->replies, &reply->node);
+    uv_timer_start(&reply->timer, call_list_reply_fire, 0, 0);
+    return OK;
+}
+
+int tapi_call_get_call_list_snapshot(tapi_context context, int slot_id,
+    tapi_call_info* out, int size)
+{
+    dbus_context* ctx = context;
+    const tapi_call_info* calls;
+    int count;
+
+    if (ctx == NULL) {
+        tapi_log_error("context is null in %s", __func__);
+        return -EINVAL;
+    }
+
+    if (!tapi_is_valid_slotid(slot_id)) {
+        tapi_log_error("invalid slot id %d in %s", slot_id, __func__);
+        return -EINVAL;
+    }
+
+    if (out == NULL || size < 0) {
+        tapi_log_error("out is invalid in %s", __func__);
+        return -EINVAL;
+    }
+
+    call_list_mirror_attach(ctx);
+    calls = call_list_mirror_get(ctx, slot_id, &count);
+    if (calls == NULL) {
+        tapi_log_error("call list of slot %d is not synced in %s", slot_id, __func__);
+        return -EAGAIN;
+    }
+
+    if (count > size)
+        count = size;
+
+    memcpy(out, calls, count * sizeof(tapi_call_info));
+    return count;
+}
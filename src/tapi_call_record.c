@@ -0,0 +1,499 @@
+/*
+ * Copyright (C) 2023 Xiaomi Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+
+#include "tapi.h"
+#include "tapi_internal.h"
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+
+/* call path prefix, call id and five string properties */
+#define CALL_RECORD_STRINGS_PER_CALL 7
+#define CALL_RECORD_MAX_STRINGS (MAX_CALL_LIST_COUNT * CALL_RECORD_STRINGS_PER_CALL)
+#define CALL_RECORD_MAX_ARENA_SIZE UINT16_MAX
+
+/****************************************************************************
+ * Private Type Declarations
+ ****************************************************************************/
+
+typedef struct {
+    tapi_call_record_list* list;
+    uint16_t used;
+    int interned_count;
+    uint16_t interned[CALL_RECORD_MAX_STRINGS];
+} call_record_builder;
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+
+static bool is_call_record_string(const char* key)
+{
+    return strcmp(key, "LineIdentification") == 0
+        || strcmp(key, "IncomingLine") == 0
+        || strcmp(key, "Name") == 0
+        || strcmp(key, "StartTime") == 0
+        || strcmp(key, "Information") == 0;
+}
+
+static tapi_call_record_list* call_record_list_new(call_record_builder* builder,
+    size_t arena_size)
+{
+    tapi_call_record_list* list;
+
+    /* offset 0 is the shared empty string */
+    arena_size++;
+    if (arena_size > CALL_RECORD_MAX_ARENA_SIZE) {
+        tapi_log_error("arena size %zu is too large in %s", arena_size, __func__);
+        return NULL;
+    }
+
+    list = malloc(sizeof(tapi_call_record_list) + arena_size);
+    if (list == NULL)
+        return NULL;
+
+    memset(list, 0, sizeof(tapi_call_record_list));
+    list->arena = (char*)(list + 1);
+    list->arena[0] = '\0';
+    list->arena_size = arena_size;
+
+    builder->list = list;
+    builder->used = 1;
+    builder->interned_count = 0;
+
+    return list;
+}
+
+static uint16_t call_record_intern(call_record_builder* builder, const char* str, size_t len)
+{
+    tapi_call_record_list* list = builder->list;
+    uint16_t offset;
+
+    if (len == 0)
+        return 0;
+
+    for (int i = 0; i < builder->interned_count; i++) {
+        offset = builder->interned[i];
+        if (strncmp(list->arena + offset, str, len) == 0 && list->arena[offset + len] == '\0')
+            return offset;
+    }
+
+    if (builder->used + len + 1 > list->arena_size) {
+        tapi_log_error("arena is full in %s", __func__);
+        return 0;
+    }
+
+    offset = builder->used;
+    memcpy(list->arena + offset, str, len);
+    list->arena[offset + len] = '\0';
+    builder->used += len + 1;
+
+    if (builder->interned_count < CALL_RECORD_MAX_STRINGS)
+        builder->interned[builder->interned_count++] = offset;
+
+    return offset;
+}
+
+static void call_record_set_id(call_record_builder* builder, tapi_call_record* record,
+    const char* call_id)
+{
+    const char* slash = strrchr(call_id, '/');
+
+    /* "/ril_0/voicecall01" is kept as "/ril_0" shared by all calls + "voicecall01" */
+    if (slash != NULL && slash != call_id) {
+        record->call_path = call_record_intern(builder, call_id, slash - call_id);
+        record->call_id = call_record_intern(builder, slash + 1, strlen(slash + 1));
+    } else {
+        record->call_path = 0;
+        record->call_id = call_record_intern(builder, call_id, strlen(call_id));
+    }
+}
+
+static size_t call_record_measure(DBusMessageIter* list)
+{
+    DBusMessageIter iter = *list;
+    size_t size = 0;
+
+    while (dbus_message_iter_get_arg_type(&iter) == DBUS_TYPE_STRUCT) {
+        DBusMessageIter entry, properties;
+        const char* str;
+
+        dbus_message_iter_recurse(&iter, &entry);
+        if (dbus_message_iter_get_arg_type(&entry) == DBUS_TYPE_OBJECT_PATH) {
+            dbus_message_iter_get_basic(&entry, &str);
+            size += strlen(str) + 1;
+
+            dbus_message_iter_next(&entry);
+            dbus_message_iter_recurse(&entry, &properties);
+
+            while (dbus_message_iter_get_arg_type(&properties) == DBUS_TYPE_DICT_ENTRY) {
+                DBusMessageIter dict, value;
+
+                dbus_message_iter_recurse(&properties, &dict);
+                dbus_message_iter_next(&dict);
+                dbus_message_iter_recurse(&dict, &value);
+
+                if (dbus_message_iter_get_arg_type(&value) == DBUS_TYPE_STRING) {
+                    dbus_message_iter_get_basic(&value, &str);
+                    size += strlen(str) + 1;
+                }
+
+                dbus_message_iter_next(&properties);
+            }
+        }
+
+        dbus_message_iter_next(&iter);
+    }
+
+    return size;
+}
+
+static void call_record_decode(call_record_builder* builder, DBusMessageIter* iter,
+    tapi_call_record* record)
+{
+    DBusMessageIter properties;
+    const char* call_id;
+
+    memset(record, 0, sizeof(tapi_call_record));
+
+    dbus_message_iter_get_basic(iter, &call_id);
+    call_record_set_id(builder, record, call_id);
+
+    dbus_message_iter_next(iter);
+    dbus_message_iter_recurse(iter, &properties);
+
+    while (dbus_message_iter_get_arg_type(&properties) == DBUS_TYPE_DICT_ENTRY) {
+        DBusMessageIter entry, value;
+        unsigned char val;
+        const char* key;
+        uint16_t offset;
+        char* result;
+        int ret;
+
+        dbus_message_iter_recurse(&properties, &entry);
+        dbus_message_iter_get_basic(&entry, &key);
+
+        dbus_message_iter_next(&entry);
+        dbus_message_iter_recurse(&entry, &value);
+
+        if (strcmp(key, "State") == 0) {
+            dbus_message_iter_get_basic(&value, &result);
+            record->state = tapi_utils_call_status_from_string(result);
+        } else if (is_call_record_string(key)) {
+            dbus_message_iter_get_basic(&value, &result);
+            offset = call_record_intern(builder, result, strlen(result));
+
+            if (strcmp(key, "LineIdentification") == 0)
+                record->line_identification = offset;
+            else if (strcmp(key, "IncomingLine") == 0)
+                record->incoming_line = offset;
+            else if (strcmp(key, "Name") == 0)
+                record->name = offset;
+            else if (strcmp(key, "StartTime") == 0)
+                record->start_time = offset;
+            else
+                record->info = offset;
+        } else if (strcmp(key, "Multiparty") == 0) {
+            dbus_message_iter_get_basic(&value, &ret);
+            if (ret)
+                record->flags |= CALL_RECORD_MULTIPARTY;
+        } else if (strcmp(key, "RemoteHeld") == 0) {
+            dbus_message_iter_get_basic(&value, &ret);
+            if (ret)
+                record->flags |= CALL_RECORD_REMOTE_HELD;
+        } else if (strcmp(key, "RemoteMultiparty") == 0) {
+            dbus_message_iter_get_basic(&value, &ret);
+            if (ret)
+                record->flags |= CALL_RECORD_REMOTE_MULTIPARTY;
+        } else if (strcmp(key, "Icon") == 0) {
+            dbus_message_iter_get_basic(&value, &val);
+            record->icon = val;
+        } else if (strcmp(key, "Emergency") == 0) {
+            dbus_message_iter_get_basic(&value, &ret);
+            if (ret)
+                record->flags |= CALL_RECORD_EMERGENCY;
+        } else if (strcmp(key, "DisconnectReason") == 0) {
+            dbus_message_iter_get_basic(&value, &ret);
+            record->disconnect_reason = ret;
+        }
+
+        dbus_message_iter_next(&properties);
+    }
+}
+
+static void call_record_query_complete(DBusMessage* message, void* user_data)
+{
+    tapi_call_record_list* list = NULL;
+    tapi_async_handler* handler = user_data;
+    call_record_builder builder;
+    DBusMessageIter args, calls;
+    tapi_async_function cb;
+    tapi_async_result* ar;
+    DBusError err;
+
+    if (handler == NULL) {
+        tapi_log_error("handler in %s is null", __func__);
+        return;
+    }
+
+    ar = handler->result;
+    if (ar == NULL) {
+        tapi_log_error("async result in %s is null", __func__);
+        return;
+    }
+
+    ar->status = ERROR;
+    ar->data = NULL;
+    ar->arg2 = 0;
+    cb = handler->cb_function;
+    if (cb == NULL) {
+        tapi_log_error("callback in %s is null", __func__);
+        return;
+    }
+
+    dbus_error_init(&err);
+    if (dbus_set_error_from_message(&err, message) == true) {
+        tapi_log_error("error from message in %s, %s: %s", __func__, err.name, err.message);
+        dbus_error_free(&err);
+        goto done;
+    }
+
+    if (dbus_message_has_signature(message, "a(oa{sv})") == false) {
+        tapi_log_error("dbus message has wrong signature in %s", __func__);
+        goto done;
+    }
+
+    if (dbus_message_iter_init(message, &args) == false) {
+        tapi_log_error("dbus message iter init failed in %s", __func__);
+        goto done;
+    }
+
+    dbus_message_iter_recurse(&args, &calls);
+
+    list = call_record_list_new(&builder, call_record_measure(&calls));
+    if (list == NULL) {
+        tapi_log_error("list in %s is null", __func__);
+        goto done;
+    }
+
+    while (dbus_message_iter_get_arg_type(&calls) == DBUS_TYPE_STRUCT
+        && list->count < MAX_CALL_LIST_COUNT) {
+        DBusMessageIter entry;
+
+        dbus_message_iter_recurse(&calls, &entry);
+        if (dbus_message_iter_get_arg_type(&entry) == DBUS_TYPE_OBJECT_PATH)
+            call_record_decode(&builder, &entry, &list->records[list->count++]);
+
+        dbus_message_iter_next(&calls);
+    }
+
+    ar->arg2 = list->count;
+    ar->status = OK;
+    ar->data = list;
+
+done:
+    cb(ar);
+
+    if (list != NULL)
+        free(list);
+}
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+int tapi_call_get_all_call_records(tapi_context context, int slot_id, int event_id,
+    tapi_async_function p_handle)
+{
+    dbus_context* ctx = context;
+    tapi_async_handler* handler;
+    tapi_async_result* ar;
+    GDBusProxy* proxy;
+
+    if (ctx == NULL) {
+        tapi_log_error("context is null in %s", __func__);
+        return -EINVAL;
+    }
+
+    if (!tapi_is_valid_slotid(slot_id)) {
+        tapi_log_error("invalid slot id %d in %s", slot_id, __func__);
+        return -EINVAL;
+    }
+
+    proxy = ctx->dbus_proxy[slot_id][DBUS_PROXY_CALL];
+    if (proxy == NULL) {
+        tapi_log_error("no available proxy in %s", __func__);
+        return -EIO;
+    }
+
+    ar = malloc(sizeof(tapi_async_result));
+    if (ar == NULL) {
+        tapi_log_error("async result in %s is null", __func__);
+        return -ENOMEM;
+    }
+    ar->msg_id = event_id;
+    ar->arg1 = slot_id;
+
+    handler = malloc(sizeof(tapi_async_handler));
+    if (handler == NULL) {
+        tapi_log_error("handler in %s is null", __func__);
+        free(ar);
+        return -ENOMEM;
+    }
+
+    handler->cb_function = p_handle;
+    handler->result = ar;
+
+    if (!g_dbus_proxy_method_call(proxy, "GetCalls", NULL,
+            call_record_query_complete, handler, handler_free)) {
+        tapi_log_error("dbus method call fail in %s", __func__);
+        handler_free(handler);
+        return -EINVAL;
+    }
+
+    return OK;
+}
+
+const char* tapi_call_record_get_string(const tapi_call_record_list* list, uint16_t offset)
+{
+    if (list == NULL || offset >= list->arena_size)
+        return "";
+
+    return list->arena + offset;
+}
+
+int tapi_call_record_get_id(const tapi_call_record_list* list,
+    const tapi_call_record* record, char* out, int size)
+{
+    int len;
+
+    if (list == NULL || record == NULL || out == NULL || size <= 0) {
+        tapi_log_error("invalid argument in %s", __func__);
+        return -EINVAL;
+    }
+
+    if (record->call_path != 0) {
+        len = snprintf(out, size, "%s/%s",
+            tapi_call_record_get_string(list, record->call_path),
+            tapi_call_record_get_string(list, record->call_id));
+    } else {
+        len = snprintf(out, size, "%s", tapi_call_record_get_string(list, record->call_id));
+    }
+
+    return len < size ? OK : -ENAMETOOLONG;
+}
+
+int tapi_call_record_to_info(const tapi_call_record_list* list,
+    const tapi_call_record* record, tapi_call_info* out)
+{
+    int ret;
+
+    if (list == NULL || record == NULL || out == NULL) {
+        tapi_log_error("invalid argument in %s", __func__);
+        return -EINVAL;
+    }
+
+    memset(out, 0, sizeof(tapi_call_info));
+
+    ret = tapi_call_record_get_id(list, record, out->call_id, sizeof(out->call_id));
+    if (ret != OK)
+        return ret;
+
+    out->state = record->state;
+    snprintf(out->lineIdentification, sizeof(out->lineIdentification), "%s",
+        tapi_call_record_get_string(list, record->line_identification));
+    snprintf(out->incoming_line, sizeof(out->incoming_line), "%s",
+        tapi_call_record_get_string(list, record->incoming_line));
+    snprintf(out->name, sizeof(out->name), "%s",
+        tapi_call_record_get_string(list, record->name));
+    snprintf(out->start_time, sizeof(out->start_time), "%s",
+        tapi_call_record_get_string(list, record->start_time));
+    snprintf(out->info, sizeof(out->info), "%s",
+        tapi_call_record_get_string(list, record->info));
+    out->multiparty = record->flags & CALL_RECORD_MULTIPARTY;
+    out->remote_held = record->flags & CALL_RECORD_REMOTE_HELD;
+    out->remote_multiparty = record->flags & CALL_RECORD_REMOTE_MULTIPARTY;
+    out->is_emergency_number = record->flags & CALL_RECORD_EMERGENCY;
+    out->icon = record->icon;
+    out->disconnect_reason = record->disconnect_reason;
+
+    return OK;
+}
+
+tapi_call_record_list* tapi_call_record_list_from_info(const tapi_call_info* call_list, int count)
+{
+    tapi_call_record_list* list;
+    call_record_builder builder;
+    tapi_call_record* record;
+    const tapi_call_info* info;
+    size_t size = 0;
+
+    if (call_list == NULL || count < 0 || count > MAX_CALL_LIST_COUNT) {
+        tapi_log_error("invalid argument in %s", __func__);
+        return NULL;
+    }
+
+    for (int i = 0; i < count; i++) {
+        info = &call_list[i];
+        size += strlen(info->call_id) + strlen(info->lineIdentification)
+            + strlen(info->incoming_line) + strlen(info->name)
+            + strlen(info->start_time) + strlen(info->info) + 6;
+    }
+
+    list = call_record_list_new(&builder, size);
+    if (list == NULL) {
+        tapi_log_error("list in %s is null", __func__);
+        return NULL;
+    }
+
+    for (int i = 0; i < count; i++) {
+        info = &call_list[i];
+        record = &list->records[list->count++];
+
+        memset(record, 0, sizeof(tapi_call_record));
+        call_record_set_id(&builder, record, info->call_id);
+        record->state = info->state;
+        record->line_identification = call_record_intern(&builder,
+            info->lineIdentification, strlen(info->lineIdentification));
+        record->incoming_line = call_record_intern(&builder,
+            info->incoming_line, strlen(info->incoming_line));
+        record->name = call_record_intern(&builder, info->name, strlen(info->name));
+        record->start_time = call_record_intern(&builder,
+            info->start_time, strlen(info->start_time));
+        record->info = call_record_intern(&builder, info->info, strlen(info->info));
+        record->icon = info->icon;
+        record->disconnect_reason = info->disconnect_reason;
+
+        if (info->multiparty)
+            record->flags |= CALL_RECORD_MULTIPARTY;
+        if (info->remote_held)
+            record->flags |= CALL_RECORD_REMOTE_HELD;
+        if (info->remote_multiparty)
+            record->flags |= CALL_RECORD_REMOTE_MULTIPARTY;
+        if (info->is_emergency_number)
+            record->flags |= CALL_RECORD_EMERGENCY;
+    }
+
+    return list;
+}
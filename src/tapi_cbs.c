@@ -60,6 +60,7 @@ static int unsol_cbs_message(DBusConnection* connection,
     char *name, *value;
     dbus_bool_t value_t = false;
     tapi_cbs_message* cbs_message;
+    uint64_t begin = dispatch_lane_begin();
 
     if (NULL == handler) {
         tapi_log_error("handler in %s is null", __func__);
@@ -144,6 +145,7 @@ static int unsol_cbs_message(DBusConnection* connection,
         ar->data = cbs_emergency_message;
         ar->status = OK;
         cb(ar);
+        dispatch_lane_end(DISPATCH_LANE_HIGH, begin);
         free(cbs_emergency_message);
     }
 
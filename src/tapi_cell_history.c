@@ -0,0 +1,613 @@
+/*
+ * Copyright (C) 2023 Xiaomi Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "tapi.h"
+#include "tapi_internal.h"
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+
+#define CELL_HISTORY_MAGIC 0x53484354 /* "TCHS" */
+#define CELL_HISTORY_VERSION 1
+
+/* Cells seen in one block, a record is encoded as delta of its cell */
+#define CELL_HISTORY_REF_COUNT 32
+
+/* Mask + meta + type + 64 bit timestamp + 7 int32 fields */
+#define CELL_HISTORY_MAX_RECORD_SIZE (3 + 10 + 7 * 5)
+
+/* Mask byte: fields present in the record */
+#define CELL_FIELD_TIMESTAMP (1 << 0)
+#define CELL_FIELD_CI (1 << 1)
+#define CELL_FIELD_PCI (1 << 2)
+#define CELL_FIELD_EARFCN (1 << 3)
+#define CELL_FIELD_TAC (1 << 4)
+#define CELL_FIELD_RSRP (1 << 5)
+#define CELL_FIELD_RSRQ (1 << 6)
+#define CELL_FIELD_RSSNR (1 << 7)
+
+/* Meta byte: reference slot and flags */
+#define CELL_META_REF_MASK 0x1F
+#define CELL_META_REGISTERED (1 << 5)
+#define CELL_META_NEW_REF (1 << 6)
+
+/****************************************************************************
+ * Private Type Declarations
+ ****************************************************************************/
+
+typedef struct {
+    int64_t first_ts;
+    int64_t last_ts;
+    uint16_t used;
+    uint16_t records;
+    uint8_t data[CONFIG_TELEPHONY_CELL_HISTORY_BLOCK_SIZE];
+} cell_history_block;
+
+typedef struct {
+    int64_t last_ts;
+    int next_ref;
+    int ref_count;
+    tapi_cell_measurement refs[CELL_HISTORY_REF_COUNT];
+} cell_history_codec;
+
+typedef struct {
+    int64_t from;
+    int64_t to;
+    bool by_cell;
+    int ci;
+} cell_history_filter;
+
+struct cell_history {
+    int slot_id;
+    int watch_id;
+    int head;
+    int count;
+    cell_history_codec encoder;
+    cell_history_block blocks[CONFIG_TELEPHONY_CELL_HISTORY_BLOCK_COUNT];
+};
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+
+static int64_t cell_history_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static int put_varint(uint8_t* buf, int64_t value)
+{
+    uint64_t zigzag = ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+    int len = 0;
+
+    while (zigzag >= 0x80) {
+        buf[len++] = (uint8_t)(zigzag | 0x80);
+        zigzag >>= 7;
+    }
+
+    buf[len++] = (uint8_t)zigzag;
+    return len;
+}
+
+static bool get_varint(const uint8_t* buf, int size, int* pos, int64_t* value)
+{
+    uint64_t zigzag = 0;
+    int shift = 0;
+
+    while (*pos < size && shift < 64) {
+        uint8_t byte = buf[(*pos)++];
+
+        zigzag |= (uint64_t)(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) {
+            *value = (int64_t)(zigzag >> 1) ^ -(int64_t)(zigzag & 1);
+            return true;
+        }
+
+        shift += 7;
+    }
+
+    return false;
+}
+
+static int find_ref(cell_history_codec* codec, const tapi_cell_measurement* m)
+{
+    for (int i = 0; i < codec->ref_count; i++) {
+        tapi_cell_measurement* ref = &codec->refs[i];
+
+        if (ref->type == m->type && ref->ci == m->ci
+            && ref->pci == m->pci && ref->earfcn == m->earfcn)
+            return i;
+    }
+
+    return -1;
+}
+
+static int encode_measurement(cell_history_codec* codec,
+    const tapi_cell_measurement* m, uint8_t* buf)
+{
+    tapi_cell_measurement base;
+    uint8_t mask = 0;
+    uint8_t meta = 0;
+    int64_t delta;
+    int len = 2;
+    int ref;
+
+    ref = find_ref(codec, m);
+    if (ref < 0) {
+        ref = codec->next_ref;
+        codec->next_ref = (codec->next_ref + 1) % CELL_HISTORY_REF_COUNT;
+        if (codec->ref_count < CELL_HISTORY_REF_COUNT)
+            codec->ref_count++;
+
+        memset(&base, 0, sizeof(base));
+        meta |= CELL_META_NEW_REF;
+        buf[len++] = (uint8_t)(m->type + 1);
+    } else {
+        base = codec->refs[ref];
+    }
+
+    meta |= ref & CELL_META_REF_MASK;
+    if (m->registered)
+        meta |= CELL_META_REGISTERED;
+
+    delta = m->timestamp - codec->last_ts;
+    if (delta != 0) {
+        mask |= CELL_FIELD_TIMESTAMP;
+        len += put_varint(buf + len, delta);
+    }
+
+#define ENCODE_FIELD(field, bit)                                \
+    if (m->field != base.field) {                               \
+        mask |= bit;                                            \
+        len += put_varint(buf + len, (int64_t)m->field - base.field); \
+    }
+
+    ENCODE_FIELD(ci, CELL_FIELD_CI);
+    ENCODE_FIELD(pci, CELL_FIELD_PCI);
+    ENCODE_FIELD(earfcn, CELL_FIELD_EARFCN);
+    ENCODE_FIELD(tac, CELL_FIELD_TAC);
+    ENCODE_FIELD(rsrp, CELL_FIELD_RSRP);
+    ENCODE_FIELD(rsrq, CELL_FIELD_RSRQ);
+    ENCODE_FIELD(rssnr, CELL_FIELD_RSSNR);
+
+#undef ENCODE_FIELD
+
+    buf[0] = mask;
+    buf[1] = meta;
+
+    codec->refs[ref] = *m;
+    codec->last_ts = m->timestamp;
+
+    return len;
+}
+
+static bool decode_measurement(cell_history_codec* codec,
+    const uint8_t* buf, int size, int* pos, tapi_cell_measurement* m)
+{
+    uint8_t mask, meta;
+    int64_t delta;
+    int ref;
+
+    if (*pos + 2 > size)
+        return false;
+
+    mask = buf[(*pos)++];
+    meta = buf[(*pos)++];
+    ref = meta & CELL_META_REF_MASK;
+
+    if (meta & CELL_META_NEW_REF) {
+        if (*pos >= size)
+            return false;
+
+        memset(m, 0, sizeof(tapi_cell_measurement));
+        m->type = (tapi_cell_type)(buf[(*pos)++] - 1);
+    } else {
+        *m = codec->refs[ref];
+    }
+
+    m->registered = (meta & CELL_META_REGISTERED) != 0;
+
+    if (mask & CELL_FIELD_TIMESTAMP) {
+        if (!get_varint(buf, size, pos, &delta))
+            return false;
+
+        codec->last_ts += delta;
+    }
+    m->timestamp = codec->last_ts;
+
+#define DECODE_FIELD(field, bit)                       \
+    if (mask & bit) {                                  \
+        if (!get_varint(buf, size, pos, &delta))       \
+            return false;                              \
+        m->field += (int)delta;                        \
+    }
+
+    DECODE_FIELD(ci, CELL_FIELD_CI);
+    DECODE_FIELD(pci, CELL_FIELD_PCI);
+    DECODE_FIELD(earfcn, CELL_FIELD_EARFCN);
+    DECODE_FIELD(tac, CELL_FIELD_TAC);
+    DECODE_FIELD(rsrp, CELL_FIELD_RSRP);
+    DECODE_FIELD(rsrq, CELL_FIELD_RSRQ);
+    DECODE_FIELD(rssnr, CELL_FIELD_RSSNR);
+
+#undef DECODE_FIELD
+
+    codec->refs[ref] = *m;
+    return true;
+}
+
+static cell_history_block* cell_history_new_block(cell_history* history)
+{
+    cell_history_block* block;
+
+    if (history->count == CONFIG_TELEPHONY_CELL_HISTORY_BLOCK_COUNT) {
+        history->head = (history->head + 1) % CONFIG_TELEPHONY_CELL_HISTORY_BLOCK_COUNT;
+        history->count--;
+    }
+
+    block = &history->blocks[(history->head + history->count)
+        % CONFIG_TELEPHONY_CELL_HISTORY_BLOCK_COUNT];
+    history->count++;
+
+    block->first_ts = 0;
+    block->last_ts = 0;
+    block->used = 0;
+    block->records = 0;
+    memset(&history->encoder, 0, sizeof(cell_history_codec));
+
+    return block;
+}
+
+static void cell_history_append(cell_history* history, int64_t timestamp,
+    const tapi_cell_identity* cell)
+{
+    uint8_t buf[CELL_HISTORY_MAX_RECORD_SIZE];
+    cell_history_block* block = NULL;
+    tapi_cell_measurement m;
+    int len;
+
+    m.timestamp = timestamp;
+    m.type = cell->type;
+    m.registered = cell->registered;
+    m.ci = cell->ci;
+    m.pci = cell->pci;
+    m.earfcn = cell->earfcn;
+    m.tac = cell->tac;
+    m.rsrp = cell->signal_strength.rsrp;
+    m.rsrq = cell->signal_strength.rsrq;
+    m.rssnr = cell->signal_strength.rssnr;
+
+    if (history->count > 0) {
+        block = &history->blocks[(history->head + history->count - 1)
+            % CONFIG_TELEPHONY_CELL_HISTORY_BLOCK_COUNT];
+        if (block->used + CELL_HISTORY_MAX_RECORD_SIZE > CONFIG_TELEPHONY_CELL_HISTORY_BLOCK_SIZE)
+            block = NULL;
+    }
+
+    if (block == NULL)
+        block = cell_history_new_block(history);
+
+    len = encode_measurement(&history->encoder, &m, buf);
+    memcpy(block->data + block->used, buf, len);
+
+    if (block->records == 0)
+        block->first_ts = timestamp;
+
+    block->last_ts = timestamp;
+    block->used += len;
+    block->records++;
+}
+
+static int cell_history_collect(cell_history* history, const cell_history_filter* filter,
+    tapi_cell_measurement* out, int max_count)
+{
+    cell_history_codec* codec;
+    tapi_cell_measurement m;
+    int found = 0;
+
+    codec = malloc(sizeof(cell_history_codec));
+    if (codec == NULL) {
+        tapi_log_error("codec in %s is null", __func__);
+        return -ENOMEM;
+    }
+
+    for (int i = 0; i < history->count && found < max_count; i++) {
+        cell_history_block* block = &history->blocks[(history->head + i)
+            % CONFIG_TELEPHONY_CELL_HISTORY_BLOCK_COUNT];
+        int pos = 0;
+
+        if (block->last_ts < filter->from || block->first_ts > filter->to)
+            continue;
+
+        memset(codec, 0, sizeof(cell_history_codec));
+        while (pos < block->used && found < max_count) {
+            if (!decode_measurement(codec, block->data, block->used, &pos, &m)) {
+                tapi_log_error("corrupted block in %s, slot %d", __func__, history->slot_id);
+                break;
+            }
+
+            if (m.timestamp < filter->from || m.timestamp > filter->to)
+                continue;
+
+            if (filter->by_cell && m.ci != filter->ci)
+                continue;
+
+            out[found++] = m;
+        }
+    }
+
+    free(codec);
+    return found;
+}
+
+static int cell_history_list_changed(DBusConnection* connection,
+    DBusMessage* message, void* user_data)
+{
+    cell_history* history = user_data;
+    tapi_cell_identity cell;
+    DBusMessageIter iter, list;
+    const char* property;
+    int64_t timestamp;
+
+    if (history == NULL) {
+        tapi_log_error("history in %s is null", __func__);
+        return 0;
+    }
+
+    if (dbus_message_iter_init(message, &iter) == false) {
+        tapi_log_error("message iter init failed in %s", __func__);
+        return 0;
+    }
+
+    dbus_message_iter_get_basic(&iter, &property);
+    if (strcmp(property, "CellList") != 0)
+        return 1;
+
+    dbus_message_iter_next(&iter);
+    if (dbus_message_iter_get_arg_type(&iter) != DBUS_TYPE_ARRAY) {
+        tapi_log_error("message iter get arg type failed in %s", __func__);
+        return 0;
+    }
+
+    dbus_message_iter_recurse(&iter, &list);
+    timestamp = cell_history_now();
+
+    while (dbus_message_iter_get_arg_type(&list) == DBUS_TYPE_STRUCT) {
+        DBusMessageIter entry, dict;
+
+        memset(&cell, 0, sizeof(tapi_cell_identity));
+        cell.type = TYPE_NONE;
+
+        dbus_message_iter_recurse(&list, &entry);
+        dbus_message_iter_recurse(&entry, &dict);
+
+        fill_cell_identity_list(&dict, &cell);
+        cell_history_append(history, timestamp, &cell);
+
+        dbus_message_iter_next(&list);
+    }
+
+    return 1;
+}
+
+static cell_history* get_cell_history(dbus_context* ctx, int slot_id, const char* caller)
+{
+    if (ctx == NULL) {
+        tapi_log_error("context in %s is null", caller);
+        return NULL;
+    }
+
+    if (!tapi_is_valid_slotid(slot_id)) {
+        tapi_log_error("slot_id in %s is invalid", caller);
+        return NULL;
+    }
+
+    if (ctx->cell_histories[slot_id] == NULL) {
+        tapi_log_error("cell history in %s is not enabled", caller);
+        return NULL;
+    }
+
+    return ctx->cell_histories[slot_id];
+}
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+void cell_history_release_all(dbus_context* ctx)
+{
+    for (int i = 0; i < CONFIG_MODEM_ACTIVE_COUNT; i++) {
+        cell_history* history = ctx->cell_histories[i];
+
+        if (history == NULL)
+            continue;
+
+        g_dbus_remove_watch(ctx->connection, history->watch_id);
+        free(history);
+        ctx->cell_histories[i] = NULL;
+    }
+}
+
+int tapi_network_cell_history_enable(tapi_context context, int slot_id, bool enable)
+{
+    dbus_context* ctx = context;
+    cell_history* history;
+    const char* modem_path;
+
+    if (ctx == NULL) {
+        tapi_log_error("context in %s is null", __func__);
+        return -EINVAL;
+    }
+
+    if (!tapi_is_valid_slotid(slot_id)) {
+        tapi_log_error("slot_id in %s is invalid", __func__);
+        return -EINVAL;
+    }
+
+    history = ctx->cell_histories[slot_id];
+    if (!enable) {
+        if (history != NULL) {
+            g_dbus_remove_watch(ctx->connection, history->watch_id);
+            free(history);
+            ctx->cell_histories[slot_id] = NULL;
+        }
+
+        return OK;
+    }
+
+    if (history != NULL)
+        return OK;
+
+    modem_path = tapi_utils_get_modem_path(slot_id);
+    if (modem_path == NULL) {
+        tapi_log_error("no available modem in %s", __func__);
+        return -EIO;
+    }
+
+    history = malloc(sizeof(cell_history));
+    if (history == NULL) {
+        tapi_log_error("history in %s is null", __func__);
+        return -ENOMEM;
+    }
+
+    history->slot_id = slot_id;
+    history->head = 0;
+    history->count = 0;
+    history->watch_id = g_dbus_add_signal_watch(ctx->connection,
+        OFONO_SERVICE, modem_path, OFONO_NETMON_INTERFACE,
+        "PropertyChanged", cell_history_list_changed, history, NULL);
+    if (history->watch_id == 0) {
+        tapi_log_error("add signal watch failed in %s", __func__);
+        free(history);
+        return -EINVAL;
+    }
+
+    ctx->cell_histories[slot_id] = history;
+    return OK;
+}
+
+int tapi_network_cell_history_query_by_time(tapi_context context, int slot_id,
+    int64_t from, int64_t to, tapi_cell_measurement* out, int max_count)
+{
+    cell_history_filter filter;
+    cell_history* history;
+
+    if (out == NULL || max_count <= 0 || from > to) {
+        tapi_log_error("invalid argument in %s", __func__);
+        return -EINVAL;
+    }
+
+    history = get_cell_history(context, slot_id, __func__);
+    if (history == NULL)
+        return -EINVAL;
+
+    filter.from = from;
+    filter.to = to;
+    filter.by_cell = false;
+    filter.ci = 0;
+
+    return cell_history_collect(history, &filter, out, max_count);
+}
+
+int tapi_network_cell_history_query_by_cell(tapi_context context, int slot_id,
+    int ci, tapi_cell_measurement* out, int max_count)
+{
+    cell_history_filter filter;
+    cell_history* history;
+
+    if (out == NULL || max_count <= 0) {
+        tapi_log_error("invalid argument in %s", __func__);
+        return -EINVAL;
+    }
+
+    history = get_cell_history(context, slot_id, __func__);
+    if (history == NULL)
+        return -EINVAL;
+
+    filter.from = INT64_MIN;
+    filter.to = INT64_MAX;
+    filter.by_cell = true;
+    filter.ci = ci;
+
+    return cell_history_collect(history, &filter, out, max_count);
+}
+
+int tapi_network_cell_history_export(tapi_context context, int slot_id, const char* file_path)
+{
+    cell_history* history;
+    uint32_t header[4];
+    FILE* fp;
+    int ret = OK;
+
+    if (file_path == NULL) {
+        tapi_log_error("file_path in %s is null", __func__);
+        return -EINVAL;
+    }
+
+    history = get_cell_history(context, slot_id, __func__);
+    if (history == NULL)
+        return -EINVAL;
+
+    fp = fopen(file_path, "wb");
+    if (fp == NULL) {
+        tapi_log_error("open %s failed in %s, errno: %d", file_path, __func__, errno);
+        return -errno;
+    }
+
+    /* Header: magic, version << 16 | slot, block size, block count */
+    header[0] = CELL_HISTORY_MAGIC;
+    header[1] = (CELL_HISTORY_VERSION << 16) | (uint32_t)slot_id;
+    header[2] = CONFIG_TELEPHONY_CELL_HISTORY_BLOCK_SIZE;
+    header[3] = history->count;
+
+    if (fwrite(header, sizeof(header), 1, fp) != 1) {
+        ret = -EIO;
+        goto done;
+    }
+
+    for (int i = 0; i < history->count; i++) {
+        cell_history_block* block = &history->blocks[(history->head + i)
+            % CONFIG_TELEPHONY_CELL_HISTORY_BLOCK_COUNT];
+
+        if (fwrite(&block->first_ts, sizeof(block->first_ts), 1, fp) != 1
+            || fwrite(&block->last_ts, sizeof(block->last_ts), 1, fp) != 1
+            || fwrite(&block->used, sizeof(block->used), 1, fp) != 1
+            || fwrite(&block->records, sizeof(block->records), 1, fp) != 1
+            || (block->used > 0 && fwrite(block->data, block->used, 1, fp) != 1)) {
+            ret = -EIO;
+            goto done;
+        }
+    }
+
+done:
+    if (ret != OK)
+        tapi_log_error("write %s failed in %s", file_path, __func__);
+
+    fclose(fp);
+    return ret;
+}
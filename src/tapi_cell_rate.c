@@ -0,0 +1,383 @@
+/*
+ * Copyright (C) 2023 Xiaomi Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+
+#include "tapi.h"
+#include "tapi_internal.h"
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+
+#define CELL_RATE_DEFAULT_MIN_PERIOD 1000
+#define CELL_RATE_DEFAULT_MAX_PERIOD 60000
+#define CELL_RATE_DEFAULT_RSRP_THRESHOLD 6
+
+/* Deviation is an EWMA of |delta rsrp| kept in 1/16 dB, weight 1/4 */
+#define CELL_RATE_DEVIATION_SHIFT 4
+#define CELL_RATE_DEVIATION_WEIGHT 2
+
+/****************************************************************************
+ * Private Type Declarations
+ ****************************************************************************/
+
+typedef enum {
+    CELL_RATE_HOLD = 0,
+    CELL_RATE_RAISE,
+    CELL_RATE_BACKOFF,
+} cell_rate_decision;
+
+struct cell_rate_controller {
+    dbus_context* ctx;
+    int slot_id;
+    int watch_id;
+    tapi_cell_rate_config config;
+    tapi_cell_rate_stats stats;
+    bool has_serving;
+    int serving_ci;
+    int serving_pci;
+    int serving_earfcn;
+    int serving_rsrp;
+    unsigned int neighbour_signature;
+    int deviation; /* 1/16 dB */
+};
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+
+static void cell_rate_param_append(DBusMessageIter* iter, void* user_data)
+{
+    cell_rate_controller* controller = user_data;
+    uint32_t period;
+
+    if (controller == NULL) {
+        tapi_log_error("controller in %s is null", __func__);
+        return;
+    }
+
+    period = controller->stats.current_period;
+    dbus_message_iter_append_basic(iter, DBUS_TYPE_UINT32, &period);
+}
+
+static void cell_rate_apply(cell_rate_controller* controller, u_int32_t period)
+{
+    u_int32_t previous;
+    GDBusProxy* proxy;
+
+    if (period < controller->config.min_period)
+        period = controller->config.min_period;
+    else if (period > controller->config.max_period)
+        period = controller->config.max_period;
+
+    if (period == controller->stats.current_period)
+        return;
+
+    proxy = controller->ctx->dbus_proxy[controller->slot_id][DBUS_PROXY_NETMON];
+    if (proxy == NULL) {
+        tapi_log_error("no available proxy in %s", __func__);
+        return;
+    }
+
+    /* the setup function is invoked synchronously, no handler to free */
+    previous = controller->stats.current_period;
+    controller->stats.current_period = period;
+    if (!g_dbus_proxy_method_call(proxy, "CellInfoUpdateRate",
+            cell_rate_param_append, NULL, controller, NULL)) {
+        tapi_log_error("method call failed in %s", __func__);
+
+        /* keep the old period so the next decision asks again */
+        controller->stats.current_period = previous;
+        return;
+    }
+
+    controller->stats.rate_requests++;
+}
+
+static void cell_rate_decide(cell_rate_controller* controller, cell_rate_decision decision)
+{
+    u_int32_t period = controller->stats.current_period;
+
+    switch (decision) {
+    case CELL_RATE_RAISE:
+        controller->stats.raise_count++;
+        period = controller->config.min_period;
+        break;
+    case CELL_RATE_BACKOFF:
+        controller->stats.backoff_count++;
+        period = period > controller->config.max_period / 2
+            ? controller->config.max_period
+            : period * 2;
+        break;
+    case CELL_RATE_HOLD:
+    default:
+        controller->stats.hold_count++;
+        break;
+    }
+
+    cell_rate_apply(controller, period);
+}
+
+static void cell_rate_update(cell_rate_controller* controller,
+    const tapi_cell_identity* serving, unsigned int neighbour_signature)
+{
+    bool serving_changed = false;
+    bool neighbour_changed;
+    int delta;
+
+    controller->stats.updates++;
+
+    neighbour_changed = neighbour_signature != controller->neighbour_signature;
+    controller->neighbour_signature = neighbour_signature;
+
+    if (serving != NULL) {
+        if (controller->has_serving) {
+            serving_changed = serving->ci != controller->serving_ci
+                || serving->pci != controller->serving_pci
+                || serving->earfcn != controller->serving_earfcn;
+
+            delta = serving->signal_strength.rsrp - controller->serving_rsrp;
+            if (delta < 0)
+                delta = -delta;
+
+            controller->deviation += ((delta << CELL_RATE_DEVIATION_SHIFT)
+                                         - controller->deviation)
+                >> CELL_RATE_DEVIATION_WEIGHT;
+        }
+
+        controller->has_serving = true;
+        controller->serving_ci = serving->ci;
+        controller->serving_pci = serving->pci;
+        controller->serving_earfcn = serving->earfcn;
+        controller->serving_rsrp = serving->signal_strength.rsrp;
+    } else if (controller->has_serving) {
+        serving_changed = true;
+        controller->has_serving = false;
+    }
+
+    if (serving_changed)
+        controller->stats.serving_changes++;
+
+    controller->stats.rsrp_deviation = controller->deviation >> CELL_RATE_DEVIATION_SHIFT;
+
+    if (!controller->ctx->screen_on)
+        cell_rate_decide(controller, CELL_RATE_BACKOFF);
+    else if (serving_changed || controller->stats.rsrp_deviation >= controller->config.rsrp_threshold)
+        cell_rate_decide(controller, CELL_RATE_RAISE);
+    else if (neighbour_changed)
+        cell_rate_decide(controller, CELL_RATE_HOLD);
+    else
+        cell_rate_decide(controller, CELL_RATE_BACKOFF);
+}
+
+static int cell_rate_list_changed(DBusConnection* connection,
+    DBusMessage* message, void* user_data)
+{
+    cell_rate_controller* controller = user_data;
+    unsigned int neighbour_signature = 0;
+    tapi_cell_identity serving;
+    tapi_cell_identity cell;
+    bool has_serving = false;
+    DBusMessageIter iter, list;
+    const char* property;
+
+    if (controller == NULL) {
+        tapi_log_error("controller in %s is null", __func__);
+        return 0;
+    }
+
+    if (dbus_message_iter_init(message, &iter) == false) {
+        tapi_log_error("message iter init failed in %s", __func__);
+        return 0;
+    }
+
+    dbus_message_iter_get_basic(&iter, &property);
+    if (strcmp(property, "CellList") != 0)
+        return 1;
+
+    dbus_message_iter_next(&iter);
+    if (dbus_message_iter_get_arg_type(&iter) != DBUS_TYPE_ARRAY) {
+        tapi_log_error("message iter get arg type failed in %s", __func__);
+        return 0;
+    }
+
+    dbus_message_iter_recurse(&iter, &list);
+
+    while (dbus_message_iter_get_arg_type(&list) == DBUS_TYPE_STRUCT) {
+        DBusMessageIter entry, dict;
+
+        memset(&cell, 0, sizeof(tapi_cell_identity));
+        cell.type = TYPE_NONE;
+
+        dbus_message_iter_recurse(&list, &entry);
+        dbus_message_iter_recurse(&entry, &dict);
+
+        fill_cell_identity_list(&dict, &cell);
+
+        if (cell.registered && !has_serving) {
+            serving = cell;
+            has_serving = true;
+        } else {
+            /* order independent signature of the neighbour set */
+            neighbour_signature += (unsigned int)cell.pci * 2654435761u
+                ^ (unsigned int)cell.earfcn;
+        }
+
+        dbus_message_iter_next(&list);
+    }
+
+    cell_rate_update(controller, has_serving ? &serving : NULL, neighbour_signature);
+    return 1;
+}
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+void cell_rate_release_all(dbus_context* ctx)
+{
+    for (int i = 0; i < CONFIG_MODEM_ACTIVE_COUNT; i++) {
+        cell_rate_controller* controller = ctx->cell_rate_controllers[i];
+
+        if (controller == NULL)
+            continue;
+
+        g_dbus_remove_watch(ctx->connection, controller->watch_id);
+        free(controller);
+        ctx->cell_rate_controllers[i] = NULL;
+    }
+}
+
+void cell_rate_screen_changed(dbus_context* ctx)
+{
+    for (int i = 0; i < CONFIG_MODEM_ACTIVE_COUNT; i++) {
+        cell_rate_controller* controller = ctx->cell_rate_controllers[i];
+
+        if (controller == NULL)
+            continue;
+
+        cell_rate_apply(controller, ctx->screen_on
+                ? controller->config.min_period
+                : controller->config.max_period);
+    }
+}
+
+int tapi_network_set_cell_rate_control(tapi_context context, int slot_id,
+    bool enable, const tapi_cell_rate_config* config)
+{
+    dbus_context* ctx = context;
+    cell_rate_controller* controller;
+    const char* modem_path;
+
+    if (ctx == NULL) {
+        tapi_log_error("context in %s is null", __func__);
+        return -EINVAL;
+    }
+
+    if (!tapi_is_valid_slotid(slot_id)) {
+        tapi_log_error("slot_id in %s is invalid", __func__);
+        return -EINVAL;
+    }
+
+    controller = ctx->cell_rate_controllers[slot_id];
+    if (!enable) {
+        if (controller != NULL) {
+            g_dbus_remove_watch(ctx->connection, controller->watch_id);
+            free(controller);
+            ctx->cell_rate_controllers[slot_id] = NULL;
+        }
+
+        return OK;
+    }
+
+    if (config != NULL && (config->min_period == 0
+                              || config->min_period > config->max_period)) {
+        tapi_log_error("config in %s is invalid", __func__);
+        return -EINVAL;
+    }
+
+    if (controller == NULL) {
+        modem_path = tapi_utils_get_modem_path(slot_id);
+        if (modem_path == NULL) {
+            tapi_log_error("no available modem in %s", __func__);
+            return -EIO;
+        }
+
+        controller = malloc(sizeof(cell_rate_controller));
+        if (controller == NULL) {
+            tapi_log_error("controller in %s is null", __func__);
+            return -ENOMEM;
+        }
+
+        memset(controller, 0, sizeof(cell_rate_controller));
+        controller->ctx = ctx;
+        controller->slot_id = slot_id;
+        controller->watch_id = g_dbus_add_signal_watch(ctx->connection,
+            OFONO_SERVICE, modem_path, OFONO_NETMON_INTERFACE,
+            "PropertyChanged", cell_rate_list_changed, controller, NULL);
+        if (controller->watch_id == 0) {
+            tapi_log_error("add signal watch failed in %s", __func__);
+            free(controller);
+            return -EINVAL;
+        }
+
+        ctx->cell_rate_controllers[slot_id] = controller;
+    }
+
+    if (config != NULL) {
+        controller->config = *config;
+    } else {
+        controller->config.min_period = CELL_RATE_DEFAULT_MIN_PERIOD;
+        controller->config.max_period = CELL_RATE_DEFAULT_MAX_PERIOD;
+        controller->config.rsrp_threshold = CELL_RATE_DEFAULT_RSRP_THRESHOLD;
+    }
+
+    /* start fast, the controller backs off once the device is stationary */
+    cell_rate_apply(controller, ctx->screen_on
+            ? controller->config.min_period
+            : controller->config.max_period);
+
+    return OK;
+}
+
+int tapi_network_get_cell_rate_stats(tapi_context context, int slot_id, tapi_cell_rate_stats* out)
+{
+    dbus_context* ctx = context;
+
+    if (ctx == NULL || out == NULL) {
+        tapi_log_error("invalid argument in %s", __func__);
+        return -EINVAL;
+    }
+
+    if (!tapi_is_valid_slotid(slot_id)) {
+        tapi_log_error("slot_id in %s is invalid", __func__);
+        return -EINVAL;
+    }
+
+    if (ctx->cell_rate_controllers[slot_id] == NULL) {
+        tapi_log_error("cell rate control in %s is not enabled", __func__);
+        return -EINVAL;
+    }
+
+    *out = ctx->cell_rate_controllers[slot_id]->stats;
+    return OK;
+}
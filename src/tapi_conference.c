@@ -0,0 +1,344 @@
+/*
+ * Copyright (C) 2023 Xiaomi Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+
+#include "tapi.h"
+#include "tapi_internal.h"
+
+/****************************************************************************
+ * Private Type Declarations
+ ****************************************************************************/
+
+typedef struct {
+    tapi_conference_op_type type;
+    int count;
+    char participants[MAX_IMS_CONFERENCE_CALLS][MAX_PHONE_NUMBER_LENGTH + 1];
+    char call_id[MAX_CALL_ID_LENGTH + 1];
+} conference_op;
+
+typedef struct {
+    GDBusProxy* proxy;
+    int slot_id;
+    int event_id;
+    tapi_async_function cb;
+    bool stop_on_error;
+    bool chained; /* the reply sent the next operation */
+    int current;
+    int count;
+    conference_op ops[MAX_CONFERENCE_BATCH_OPS];
+    tapi_conference_batch_result result;
+} conference_batch;
+
+/****************************************************************************
+ * Private Function Prototypes
+ ****************************************************************************/
+
+static void conference_batch_reply(DBusMessage* message, void* user_data);
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+
+static const char* conference_op_member(tapi_conference_op_type type)
+{
+    switch (type) {
+    case CONFERENCE_OP_DIAL:
+        return "DialConference";
+    case CONFERENCE_OP_INVITE:
+        return "InviteParticipants";
+    case CONFERENCE_OP_MERGE:
+        return "CreateMultiparty";
+    case CONFERENCE_OP_SEPARATE:
+        return "PrivateChat";
+    case CONFERENCE_OP_HANGUP:
+        return "Hangup";
+    case CONFERENCE_OP_HANGUP_MULTIPARTY:
+        return "HangupMultiparty";
+    default:
+        return NULL;
+    }
+}
+
+static bool conference_op_copy(conference_op* dst, const tapi_conference_op* src)
+{
+    memset(dst, 0, sizeof(conference_op));
+    dst->type = src->type;
+
+    switch (src->type) {
+    case CONFERENCE_OP_DIAL:
+    case CONFERENCE_OP_INVITE:
+        if (src->count <= 0 || src->count > MAX_IMS_CONFERENCE_CALLS)
+            return false;
+
+        for (int i = 0; i < src->count; i++) {
+            if (src->participants[i] == NULL)
+                return false;
+
+            snprintf(dst->participants[i], sizeof(dst->participants[i]), "%s",
+                src->participants[i]);
+        }
+
+        dst->count = src->count;
+        return true;
+    case CONFERENCE_OP_SEPARATE:
+    case CONFERENCE_OP_HANGUP:
+        if (src->call_id == NULL)
+            return false;
+
+        snprintf(dst->call_id, sizeof(dst->call_id), "%s", src->call_id);
+        return true;
+    case CONFERENCE_OP_MERGE:
+    case CONFERENCE_OP_HANGUP_MULTIPARTY:
+        return true;
+    default:
+        return false;
+    }
+}
+
+static void conference_batch_append(DBusMessageIter* iter, void* user_data)
+{
+    conference_batch* batch = user_data;
+    conference_op* op;
+    DBusMessageIter array;
+    char* value;
+
+    if (batch == NULL) {
+        tapi_log_error("batch in %s is null", __func__);
+        return;
+    }
+
+    op = &batch->ops[batch->current];
+
+    switch (op->type) {
+    case CONFERENCE_OP_DIAL:
+    case CONFERENCE_OP_INVITE:
+        dbus_message_iter_open_container(iter, DBUS_TYPE_ARRAY,
+            DBUS_TYPE_STRING_AS_STRING, &array);
+        for (int i = 0; i < op->count; i++) {
+            value = op->participants[i];
+            dbus_message_iter_append_basic(&array, DBUS_TYPE_STRING, &value);
+        }
+        dbus_message_iter_close_container(iter, &array);
+        break;
+    case CONFERENCE_OP_SEPARATE:
+    case CONFERENCE_OP_HANGUP:
+        value = op->call_id;
+        dbus_message_iter_append_basic(iter, DBUS_TYPE_OBJECT_PATH, &value);
+        break;
+    default:
+        break;
+    }
+}
+
+static void conference_batch_destroy(void* user_data)
+{
+    conference_batch* batch = user_data;
+
+    /* the batch moved on to the next operation, it is released later */
+    if (batch->chained) {
+        batch->chained = false;
+        return;
+    }
+
+    free(batch);
+}
+
+static bool conference_batch_send(conference_batch* batch)
+{
+    conference_op* op = &batch->ops[batch->current];
+    bool has_args = op->type != CONFERENCE_OP_MERGE
+        && op->type != CONFERENCE_OP_HANGUP_MULTIPARTY;
+
+    return g_dbus_proxy_method_call(batch->proxy, conference_op_member(op->type),
+        has_args ? conference_batch_append : NULL, conference_batch_reply,
+        batch, conference_batch_destroy);
+}
+
+static void conference_batch_record(conference_batch* batch, int status)
+{
+    tapi_conference_op_result* result = &batch->result.results[batch->current];
+
+    result->status = status;
+    if (status != OK)
+        batch->result.failed++;
+}
+
+/* Sends the next operation, returns false once nothing is left in flight */
+static bool conference_batch_next(conference_batch* batch)
+{
+    while (++batch->current < batch->count) {
+        if (batch->stop_on_error && batch->result.failed > 0) {
+            batch->result.results[batch->current].status = -ECANCELED;
+            continue;
+        }
+
+        if (conference_batch_send(batch))
+            return true;
+
+        tapi_log_error("dbus method call fail in %s", __func__);
+        conference_batch_record(batch, ERROR);
+    }
+
+    return false;
+}
+
+static void conference_batch_complete(conference_batch* batch)
+{
+    tapi_async_result ar;
+
+    memset(&ar, 0, sizeof(tapi_async_result));
+    ar.msg_id = batch->event_id;
+    ar.msg_type = RESPONSE;
+    ar.arg1 = batch->slot_id;
+    ar.arg2 = batch->count;
+    ar.status = OK;
+
+    for (int i = 0; i < batch->count; i++) {
+        if (batch->result.results[i].status != OK) {
+            ar.arg2--;
+            ar.status = ERROR;
+        }
+    }
+
+    ar.data = &batch->result;
+
+    if (batch->cb != NULL)
+        batch->cb(&ar);
+}
+
+static int conference_multiparty_count(DBusMessage* message)
+{
+    DBusMessageIter iter, list;
+    int count = 0;
+
+    if (!dbus_message_has_signature(message, "ao")
+        || !dbus_message_iter_init(message, &iter))
+        return 0;
+
+    dbus_message_iter_recurse(&iter, &list);
+    while (dbus_message_iter_get_arg_type(&list) == DBUS_TYPE_OBJECT_PATH) {
+        count++;
+        dbus_message_iter_next(&list);
+    }
+
+    return count;
+}
+
+static void conference_batch_reply(DBusMessage* message, void* user_data)
+{
+    conference_batch* batch = user_data;
+    tapi_conference_op_result* result;
+    DBusError err;
+
+    if (batch == NULL) {
+        tapi_log_error("batch in %s is null", __func__);
+        return;
+    }
+
+    result = &batch->result.results[batch->current];
+
+    dbus_error_init(&err);
+    if (dbus_set_error_from_message(&err, message) == true) {
+        tapi_log_error("error from message in %s, %s: %s", __func__, err.name, err.message);
+        dbus_error_free(&err);
+        conference_batch_record(batch, ERROR);
+    } else {
+        if (result->type == CONFERENCE_OP_MERGE || result->type == CONFERENCE_OP_SEPARATE)
+            result->calls = conference_multiparty_count(message);
+
+        conference_batch_record(batch, OK);
+    }
+
+    if (conference_batch_next(batch)) {
+        batch->chained = true;
+        return;
+    }
+
+    conference_batch_complete(batch);
+}
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+int tapi_call_conference_batch(tapi_context context, int slot_id, const tapi_conference_op* ops,
+    int count, bool stop_on_error, int event_id, tapi_async_function p_handle)
+{
+    dbus_context* ctx = context;
+    conference_batch* batch;
+    GDBusProxy* proxy;
+
+    if (ctx == NULL) {
+        tapi_log_error("context is null in %s", __func__);
+        return -EINVAL;
+    }
+
+    if (!tapi_is_valid_slotid(slot_id)) {
+        tapi_log_error("invalid slot id %d in %s", slot_id, __func__);
+        return -EINVAL;
+    }
+
+    if (ops == NULL || count <= 0 || count > MAX_CONFERENCE_BATCH_OPS) {
+        tapi_log_error("invalid ops in %s", __func__);
+        return -EINVAL;
+    }
+
+    proxy = ctx->dbus_proxy[slot_id][DBUS_PROXY_CALL];
+    if (proxy == NULL) {
+        tapi_log_error("no available proxy in %s", __func__);
+        return -EIO;
+    }
+
+    batch = malloc(sizeof(conference_batch));
+    if (batch == NULL) {
+        tapi_log_error("batch in %s is null", __func__);
+        return -ENOMEM;
+    }
+
+    memset(batch, 0, sizeof(conference_batch));
+
+    for (int i = 0; i < count; i++) {
+        if (!conference_op_copy(&batch->ops[i], &ops[i])) {
+            tapi_log_error("invalid op %d in %s", i, __func__);
+            free(batch);
+            return -EINVAL;
+        }
+
+        batch->result.results[i].type = ops[i].type;
+    }
+
+    batch->proxy = proxy;
+    batch->slot_id = slot_id;
+    batch->event_id = event_id;
+    batch->cb = p_handle;
+    batch->stop_on_error = stop_on_error;
+    batch->count = count;
+    batch->result.count = count;
+
+    if (!conference_batch_send(batch)) {
+        tapi_log_error("dbus method call fail in %s", __func__);
+        free(batch);
+        return -EINVAL;
+    }
+
+    return OK;
+}
@@ -24,6 +24,57 @@
 #include "tapi.h"
 #include "tapi_internal.h"
 
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+
+/* A field of an absent address family reads as empty */
+#define DATA_CONNECTION_IPV4(dc, field) \
+    ((dc)->ip_settings->ipv4 != NULL ? (dc)->ip_settings->ipv4->field : "")
+#define DATA_CONNECTION_IPV6(dc, field) \
+    ((dc)->ip_settings->ipv6 != NULL ? (dc)->ip_settings->ipv6->field : "")
+#define DATA_CONNECTION_DIFFERS(a, b, field) \
+    (strcmp(DATA_CONNECTION_IPV4(a, field), DATA_CONNECTION_IPV4(b, field)) != 0 \
+        || strcmp(DATA_CONNECTION_IPV6(a, field), DATA_CONNECTION_IPV6(b, field)) != 0)
+
+/****************************************************************************
+ * Private Type Declarations
+ ****************************************************************************/
+
+/* One decoded data connection with its settings, allocated together */
+typedef struct {
+    tapi_data_context dc;
+    tapi_ip_settings ip_settings;
+    tapi_ipv4_settings ipv4;
+    tapi_ipv6_settings ipv6;
+} data_connection_item;
+
+/* Connection state indication, the arena keeps id and dns strings */
+typedef struct {
+    struct list_node node; /* in g_data_snapshots while referenced */
+    int refcount;
+    size_t capacity;
+    size_t used;
+    data_connection_item item;
+    char arena[];
+} data_connection_snapshot;
+
+typedef struct {
+    tapi_async_result result;
+    tapi_async_function cb;
+    data_connection_snapshot* snapshot; /* reused while nobody retains it */
+    int reported_count;
+    /* last reported snapshot of each context, least recently reported first */
+    data_connection_snapshot* reported[MAX_DATA_CALL_LIST_SIZE];
+} data_connection_watch;
+
+/****************************************************************************
+ * Private Data
+ ****************************************************************************/
+
+/* Live snapshots, retain and release only accept contexts found here */
+static struct list_node g_data_snapshots = LIST_INITIAL_VALUE(g_data_snapshots);
+
 /****************************************************************************
  * Private Functions
  ****************************************************************************/
@@ -35,9 +86,12 @@ static void parse_ipv4_properties(DBusMessageIter* iter, tapi_data_context* dc)
     char* value_str;
     int dns_index;
 
-    dc->ip_settings->ipv4 = malloc(sizeof(tapi_ipv4_settings));
-    if (dc->ip_settings->ipv4 == NULL)
-        return;
+    /* the caller may provide the storage */
+    if (dc->ip_settings->ipv4 == NULL) {
+        dc->ip_settings->ipv4 = malloc(sizeof(tapi_ipv4_settings));
+        if (dc->ip_settings->ipv4 == NULL)
+            return;
+    }
 
     dc->ip_settings->ipv4->interface[0] = '\0';
     dc->ip_settings->ipv4->ip[0] = '\0';
@@ -117,9 +171,12 @@ static void parse_ipv6_properties(DBusMessageIter* iter, tapi_data_context* dc)
     char* value_str;
     int dns_index;
 
-    dc->ip_settings->ipv6 = malloc(sizeof(tapi_ipv6_settings));
-    if (dc->ip_settings->ipv6 == NULL)
-        return;
+    /* the caller may provide the storage */
+    if (dc->ip_settings->ipv6 == NULL) {
+        dc->ip_settings->ipv6 = malloc(sizeof(tapi_ipv6_settings));
+        if (dc->ip_settings->ipv6 == NULL)
+            return;
+    }
 
     dc->ip_settings->ipv6->interface[0] = '\0';
     dc->ip_settings->ipv6->ip[0] = '\0';
@@ -266,121 +323,11 @@ done:
     return true;
 }
 
-static int data_connection_changed(DBusConnection* connection,
-    DBusMessage* message, void* user_data)
-{
-    tapi_async_handler* handler = user_data;
-    tapi_async_result* ar;
-    tapi_async_function cb;
-    DBusMessageIter args, list;
-    tapi_data_context* dc;
-
-    if (handler == NULL) {
-        tapi_log_error("handler in %s is null", __func__);
-        return false;
-    }
-
-    ar = handler->result;
-    if (ar == NULL) {
-        tapi_log_error("async result in %s is null", __func__);
-        return false;
-    }
-
-    cb = handler->cb_function;
-    if (cb == NULL) {
-        tapi_log_error("callback in %s is null", __func__);
-        return false;
-    }
-
-    dc = malloc(sizeof(tapi_data_context));
-    if (dc == NULL) {
-        tapi_log_error("dc in %s is null", __func__);
-        return false;
-    }
-
-    dc->ip_settings = malloc(sizeof(tapi_ip_settings));
-    if (dc->ip_settings == NULL) {
-        tapi_log_error("ip settings in %s is null", __func__);
-        free(dc);
-        return false;
-    }
-
-    if (dbus_message_iter_init(message, &args) == false) {
-        tapi_log_error("dbus message iter init fail in %s", __func__);
-        ar->status = ERROR;
-        goto done;
-    }
-
-    dbus_message_iter_get_basic(&args, &dc->id);
-
-    dbus_message_iter_next(&args);
-    dbus_message_iter_recurse(&args, &list);
-
-    dc->accesspointname[0] = '\0';
-    dc->name[0] = '\0';
-    dc->username[0] = '\0';
-    dc->password[0] = '\0';
-    dc->messageproxy[0] = '\0';
-    dc->messagecenter[0] = '\0';
-    dc->ip_settings->ipv4 = NULL;
-    dc->ip_settings->ipv6 = NULL;
-
-    while (dbus_message_iter_get_arg_type(&list) == DBUS_TYPE_DICT_ENTRY) {
-        DBusMessageIter entry, value;
-        const char* key;
-        const char* value_str;
-        int value_int;
-
-        dbus_message_iter_recurse(&list, &entry);
-        dbus_message_iter_get_basic(&entry, &key);
-
-        dbus_message_iter_next(&entry);
-        dbus_message_iter_recurse(&entry, &value);
-
-        if (strcmp(key, "Type") == 0) {
-            dbus_message_iter_get_basic(&value, &value_str);
-            dc->type = tapi_utils_apn_type_from_string(value_str);
-        } else if (strcmp(key, "Active") == 0) {
-            dbus_message_iter_get_basic(&value, &value_int);
-            dc->active = value_int;
-        } else if (strcmp(key, "Mtu") == 0) {
-            dbus_message_iter_get_basic(&value, &value_int);
-            dc->ip_settings->mtu = value_int;
-        } else if (strcmp(key, "Settings") == 0) {
-            // parse ipv4 information.
-            parse_ipv4_properties(&value, dc);
-        } else if (strcmp(key, "IPv6.Settings") == 0) {
-            // parse ipv6 information.
-            parse_ipv6_properties(&value, dc);
-        }
-
-        dbus_message_iter_next(&list);
-    }
-
-    ar->status = OK;
-    ar->data = dc;
-
-done:
-    cb(ar);
-
-    if (dc != NULL) {
-        if (dc->ip_settings != NULL) {
-            if (dc->ip_settings->ipv4 != NULL)
-                free(dc->ip_settings->ipv4);
-            if (dc->ip_settings->ipv6 != NULL)
-                free(dc->ip_settings->ipv6);
-
-            free(dc->ip_settings);
-        }
-        free(dc);
-    }
-    return true;
-}
-
-static void update_data_context(const char* prop, DBusMessageIter* iter, tapi_data_context* dc)
+void update_data_context(const char* prop, DBusMessageIter* iter, tapi_data_context* dc)
 {
     const char* value;
     dbus_bool_t value_t;
+    int value_int = 0;
 
     if (strcmp(prop, "Name") == 0) {
         dbus_message_iter_get_basic(iter, &value);
@@ -423,6 +370,9 @@ static void update_data_context(const char* prop, DBusMessageIter* iter, tapi_da
         dbus_message_iter_get_basic(iter, &value);
         if (strlen(value) <= MAX_APN_DOMAIN_LENGTH)
             strcpy(dc->messagecenter, value);
+    } else if (strcmp(prop, "Mtu") == 0 && dc->ip_settings != NULL) {
+        dbus_message_iter_get_basic(iter, &value_int);
+        dc->ip_settings->mtu = value_int;
     } else if (strcmp(prop, "Settings") == 0 && dc->ip_settings != NULL) {
         // parse ipv4 information.
         parse_ipv4_properties(iter, dc);
@@ -432,7 +382,7 @@ static void update_data_context(const char* prop, DBusMessageIter* iter, tapi_da
     }
 }
 
-static void update_data_contexts(DBusMessageIter* iter, tapi_data_context* dc)
+void update_data_contexts(DBusMessageIter* iter, tapi_data_context* dc)
 {
     while (dbus_message_iter_get_arg_type(iter) == DBUS_TYPE_DICT_ENTRY) {
         DBusMessageIter entry, value;
@@ -449,88 +399,6 @@ static void update_data_contexts(DBusMessageIter* iter, tapi_data_context* dc)
     }
 }
 
-static void apn_list_loaded(DBusMessage* message, void* user_data)
-{
-    tapi_async_handler* handler = user_data;
-    tapi_async_result* ar;
-    tapi_async_function cb;
-    DBusMessageIter args, list;
-    DBusError err;
-    tapi_data_context* result[MAX_APN_LIST_CAPACITY];
-    int index = 0;
-
-    if (handler == NULL) {
-        tapi_log_error("handler in %s is null", __func__);
-        return;
-    }
-
-    ar = handler->result;
-    if (ar == NULL) {
-        tapi_log_error("async result in %s is null", __func__);
-        return;
-    }
-
-    cb = handler->cb_function;
-    if (cb == NULL) {
-        tapi_log_error("callback in %s is null", __func__);
-        return;
-    }
-
-    dbus_error_init(&err);
-    if (dbus_set_error_from_message(&err, message) == true) {
-        tapi_log_error("error from message in %s, %s: %s", __func__, err.name, err.message);
-        dbus_error_free(&err);
-        ar->status = ERROR;
-        goto done;
-    }
-
-    if (dbus_message_has_signature(message, "a(oa{sv})") == false) {
-        tapi_log_error("message signature in %s is error", __func__);
-        ar->status = ERROR;
-        goto done;
-    }
-
-    if (dbus_message_iter_init(message, &args) == false) {
-        tapi_log_error("message iter init fail in %s", __func__);
-        ar->status = ERROR;
-        goto done;
-    }
-
-    dbus_message_iter_recurse(&args, &list);
-
-    while (dbus_message_iter_get_arg_type(&list) == DBUS_TYPE_STRUCT) {
-        DBusMessageIter entry, dict;
-        tapi_data_context* dc = malloc(sizeof(tapi_data_context));
-        if (dc == NULL) {
-            tapi_log_error("dc in %s is null", __func__);
-            break;
-        }
-        dc->ip_settings = NULL;
-
-        dbus_message_iter_recurse(&list, &entry);
-        dbus_message_iter_get_basic(&entry, &dc->id);
-
-        dbus_message_iter_next(&entry);
-        dbus_message_iter_recurse(&entry, &dict);
-        update_data_contexts(&dict, dc);
-        dbus_message_iter_next(&list);
-
-        result[index++] = dc;
-        if (index >= MAX_APN_LIST_CAPACITY)
-            break;
-    }
-
-    ar->status = OK;
-    ar->arg2 = index; // apn count;
-    ar->data = result;
-
-done:
-    cb(ar);
-    while (--index >= 0) {
-        free(result[index]);
-    }
-}
-
 static void apn_list_changed(DBusMessage* message, void* user_data)
 {
     tapi_async_handler* handler = user_data;
@@ -566,7 +434,7 @@ static void apn_list_changed(DBusMessage* message, void* user_data)
     cb(ar);
 }
 
-static void apn_context_append(DBusMessageIter* iter, void* user_data)
+void apn_context_append(DBusMessageIter* iter, void* user_data)
 {
     tapi_async_handler* handler = user_data;
     tapi_async_result* ar;
@@ -615,7 +483,7 @@ static void apn_context_append(DBusMessageIter* iter, void* user_data)
     free(password);
 }
 
-static void apn_context_remove(DBusMessageIter* iter, void* user_data)
+void apn_context_remove(DBusMessageIter* iter, void* user_data)
 {
     tapi_async_handler* handler = user_data;
     tapi_async_result* ar;
@@ -646,7 +514,7 @@ static void apn_context_remove(DBusMessageIter* iter, void* user_data)
     dbus_message_iter_append_basic(iter, DBUS_TYPE_OBJECT_PATH, &dc->id);
 }
 
-static void apn_context_edit(DBusMessageIter* iter, void* user_data)
+void apn_context_edit(DBusMessageIter* iter, void* user_data)
 {
     tapi_async_handler* handler = user_data;
     tapi_async_result* ar;
@@ -705,6 +573,416 @@ static void network_operation_append(DBusMessageIter* iter, void* user_data)
     dbus_message_iter_append_basic(iter, DBUS_TYPE_STRING, &type);
 }
 
+/* Returns true if an active context of the requested type is described by dict */
+static bool data_connection_matches(DBusMessageIter dict, tapi_data_context_type type)
+{
+    bool active = false;
+    bool type_matched = type == DATA_CONTEXT_TYPE_ANY;
+
+    while (dbus_message_iter_get_arg_type(&dict) == DBUS_TYPE_DICT_ENTRY) {
+        DBusMessageIter entry, value;
+        const char* key;
+        const char* value_str;
+        dbus_bool_t value_t;
+
+        dbus_message_iter_recurse(&dict, &entry);
+        dbus_message_iter_get_basic(&entry, &key);
+
+        dbus_message_iter_next(&entry);
+        dbus_message_iter_recurse(&entry, &value);
+
+        if (strcmp(key, "Active") == 0) {
+            dbus_message_iter_get_basic(&value, &value_t);
+            if (!value_t)
+                return false;
+
+            active = true;
+        } else if (!type_matched && strcmp(key, "Type") == 0) {
+            dbus_message_iter_get_basic(&value, &value_str);
+            if (tapi_utils_apn_type_from_string(value_str) != type)
+                return false;
+
+            type_matched = true;
+        }
+
+        if (active && type_matched)
+            return true;
+
+        dbus_message_iter_next(&dict);
+    }
+
+    return false;
+}
+
+static void data_connection_decode(DBusMessageIter* dict, data_connection_item* item)
+{
+    tapi_data_context* dc = &item->dc;
+
+    memset(item, 0, sizeof(data_connection_item));
+    dc->ip_settings = &item->ip_settings;
+
+    while (dbus_message_iter_get_arg_type(dict) == DBUS_TYPE_DICT_ENTRY) {
+        DBusMessageIter entry, value;
+        const char* key;
+
+        dbus_message_iter_recurse(dict, &entry);
+        dbus_message_iter_get_basic(&entry, &key);
+
+        dbus_message_iter_next(&entry);
+        dbus_message_iter_recurse(&entry, &value);
+
+        /* settings are parsed into the item, ipv4/ipv6 stay NULL when absent */
+        if (strcmp(key, "Settings") == 0)
+            dc->ip_settings->ipv4 = &item->ipv4;
+        else if (strcmp(key, "IPv6.Settings") == 0)
+            dc->ip_settings->ipv6 = &item->ipv6;
+
+        update_data_context(key, &value, dc);
+        dbus_message_iter_next(dict);
+    }
+}
+
+static size_t data_connection_dns_size(DBusMessageIter settings)
+{
+    DBusMessageIter list, entry, value, dns_iter;
+    const char* key;
+    const char* dns;
+    size_t size = 0;
+
+    if (dbus_message_iter_get_arg_type(&settings) != DBUS_TYPE_ARRAY)
+        return 0;
+
+    dbus_message_iter_recurse(&settings, &list);
+
+    while (dbus_message_iter_get_arg_type(&list) == DBUS_TYPE_DICT_ENTRY) {
+        dbus_message_iter_recurse(&list, &entry);
+        dbus_message_iter_get_basic(&entry, &key);
+
+        if (strcmp(key, "DomainNameServers") == 0) {
+            dbus_message_iter_next(&entry);
+            dbus_message_iter_recurse(&entry, &value);
+            dbus_message_iter_recurse(&value, &dns_iter);
+
+            while (dbus_message_iter_get_arg_type(&dns_iter) == DBUS_TYPE_STRING) {
+                dbus_message_iter_get_basic(&dns_iter, &dns);
+                size += strlen(dns) + 1;
+                dbus_message_iter_next(&dns_iter);
+            }
+        }
+
+        dbus_message_iter_next(&list);
+    }
+
+    return size;
+}
+
+/* Upper bound of the strings a connection state change points into */
+static size_t data_connection_strings_size(const char* path, DBusMessageIter dict)
+{
+    size_t size = strlen(path) + 1;
+
+    while (dbus_message_iter_get_arg_type(&dict) == DBUS_TYPE_DICT_ENTRY) {
+        DBusMessageIter entry, value;
+        const char* key;
+
+        dbus_message_iter_recurse(&dict, &entry);
+        dbus_message_iter_get_basic(&entry, &key);
+
+        if (strcmp(key, "Settings") == 0 || strcmp(key, "IPv6.Settings") == 0) {
+            dbus_message_iter_next(&entry);
+            dbus_message_iter_recurse(&entry, &value);
+            size += data_connection_dns_size(value);
+        }
+
+        dbus_message_iter_next(&dict);
+    }
+
+    return size;
+}
+
+/* Returns NULL for a context not delivered by the connection state indication */
+static data_connection_snapshot* data_connection_snapshot_of(const tapi_data_context* dc)
+{
+    data_connection_snapshot* snapshot;
+
+    list_for_every_entry(&g_data_snapshots, snapshot, data_connection_snapshot, node)
+    {
+        if (&snapshot->item.dc == dc)
+            return snapshot;
+    }
+
+    return NULL;
+}
+
+static void data_connection_snapshot_unref(data_connection_snapshot* snapshot)
+{
+    if (--snapshot->refcount == 0) {
+        list_delete(&snapshot->node);
+        free(snapshot);
+    }
+}
+
+static data_connection_snapshot* data_connection_snapshot_get(data_connection_watch* watch,
+    size_t size)
+{
+    data_connection_snapshot* snapshot = watch->snapshot;
+
+    /* a retained snapshot belongs to the consumer now */
+    if (snapshot != NULL && (snapshot->refcount > 1 || snapshot->capacity < size)) {
+        data_connection_snapshot_unref(snapshot);
+        snapshot = NULL;
+    }
+
+    if (snapshot == NULL) {
+        snapshot = malloc(sizeof(data_connection_snapshot) + size);
+        watch->snapshot = snapshot;
+        if (snapshot == NULL)
+            return NULL;
+
+        snapshot->refcount = 1;
+        snapshot->capacity = size;
+        list_add_tail(&g_data_snapshots, &snapshot->node);
+    }
+
+    snapshot->used = 0;
+    return snapshot;
+}
+
+static char* data_connection_snapshot_strdup(data_connection_snapshot* snapshot,
+    const char* str)
+{
+    size_t len = strlen(str) + 1;
+    char* dst = snapshot->arena + snapshot->used;
+
+    memcpy(dst, str, len);
+    snapshot->used += len;
+    return dst;
+}
+
+/* Moves the strings still pointing into the message to the snapshot arena */
+static void data_connection_snapshot_own(data_connection_snapshot* snapshot, const char* path)
+{
+    tapi_ip_settings* ip_settings = snapshot->item.dc.ip_settings;
+    char** dns;
+
+    snapshot->item.dc.id = data_connection_snapshot_strdup(snapshot, path);
+
+    for (int i = 0; i < MAX_DATA_DNS_COUNT; i++) {
+        if (ip_settings->ipv4 != NULL) {
+            dns = &ip_settings->ipv4->dns[i];
+            *dns = **dns == '\0' ? "" : data_connection_snapshot_strdup(snapshot, *dns);
+        }
+
+        if (ip_settings->ipv6 != NULL) {
+            dns = &ip_settings->ipv6->dns[i];
+            *dns = **dns == '\0' ? "" : data_connection_snapshot_strdup(snapshot, *dns);
+        }
+    }
+}
+
+/* Every server of a is in b, a NULL list has none */
+static bool data_connection_dns_within(char* const* a, char* const* b)
+{
+    bool found;
+
+    for (int i = 0; a != NULL && i < MAX_DATA_DNS_COUNT; i++) {
+        if (a[i][0] == '\0')
+            continue;
+
+        found = false;
+        for (int j = 0; b != NULL && j < MAX_DATA_DNS_COUNT && !found; j++)
+            found = strcmp(a[i], b[j]) == 0;
+
+        if (!found)
+            return false;
+    }
+
+    return true;
+}
+
+/* The dns set does not depend on the order of the servers */
+static bool data_connection_dns_differs(const tapi_data_context* a, const tapi_data_context* b)
+{
+    char* const* a4 = a->ip_settings->ipv4 != NULL ? a->ip_settings->ipv4->dns : NULL;
+    char* const* b4 = b->ip_settings->ipv4 != NULL ? b->ip_settings->ipv4->dns : NULL;
+    char* const* a6 = a->ip_settings->ipv6 != NULL ? a->ip_settings->ipv6->dns : NULL;
+    char* const* b6 = b->ip_settings->ipv6 != NULL ? b->ip_settings->ipv6->dns : NULL;
+
+    return !data_connection_dns_within(a4, b4) || !data_connection_dns_within(b4, a4)
+        || !data_connection_dns_within(a6, b6) || !data_connection_dns_within(b6, a6);
+}
+
+/*
+ * Returns the DATA_CONNECTION_CHANGED_* fields since the last report of the
+ * context and keeps the snapshot as its last report. The watch takes the
+ * replaced report back for the next indication if nobody else holds it.
+ */
+static int data_connection_diff(data_connection_watch* watch, data_connection_snapshot* snapshot)
+{
+    const tapi_data_context* dc = &snapshot->item.dc;
+    data_connection_snapshot* last = NULL;
+    const tapi_data_context* prev;
+    int changed = 0;
+    int index;
+
+    for (index = 0; index < watch->reported_count; index++) {
+        if (strcmp(watch->reported[index]->item.dc.id, dc->id) == 0) {
+            last = watch->reported[index];
+            break;
+        }
+    }
+
+    if (last == NULL && watch->reported_count == MAX_DATA_CALL_LIST_SIZE) {
+        /* forget an inactive context first, the least recently reported otherwise */
+        for (index = 0; index < watch->reported_count; index++) {
+            if (!watch->reported[index]->item.dc.active)
+                break;
+        }
+
+        if (index == watch->reported_count)
+            index = 0;
+
+        data_connection_snapshot_unref(watch->reported[index]);
+    }
+
+    /* the context moves to the end, the list stays in report order */
+    if (index < watch->reported_count) {
+        memmove(&watch->reported[index], &watch->reported[index + 1],
+            (watch->reported_count - index - 1) * sizeof(data_connection_snapshot*));
+        watch->reported_count--;
+    }
+
+    watch->reported[watch->reported_count++] = snapshot;
+    watch->snapshot = NULL;
+
+    if (last == NULL)
+        return DATA_CONNECTION_CHANGED_ALL;
+
+    prev = &last->item.dc;
+    if (DATA_CONNECTION_DIFFERS(prev, dc, interface))
+        changed |= DATA_CONNECTION_CHANGED_INTERFACE;
+    if (DATA_CONNECTION_DIFFERS(prev, dc, ip))
+        changed |= DATA_CONNECTION_CHANGED_ADDRESS;
+    if (DATA_CONNECTION_DIFFERS(prev, dc, gateway))
+        changed |= DATA_CONNECTION_CHANGED_GATEWAY;
+    if (data_connection_dns_differs(prev, dc))
+        changed |= DATA_CONNECTION_CHANGED_DNS;
+    if (prev->ip_settings->mtu != dc->ip_settings->mtu)
+        changed |= DATA_CONNECTION_CHANGED_MTU;
+    if (DATA_CONNECTION_DIFFERS(prev, dc, pcscf))
+        changed |= DATA_CONNECTION_CHANGED_PCSCF;
+    if (prev->active != dc->active)
+        changed |= DATA_CONNECTION_CHANGED_ACTIVE;
+
+    if (last->refcount == 1)
+        watch->snapshot = last;
+    else
+        data_connection_snapshot_unref(last);
+
+    return changed;
+}
+
+static int data_connection_changed(DBusConnection* connection,
+    DBusMessage* message, void* user_data)
+{
+    data_connection_watch* watch = user_data;
+    data_connection_snapshot* snapshot;
+    tapi_async_result* ar;
+    DBusMessageIter args, dict;
+    const char* path;
+
+    if (watch == NULL) {
+        tapi_log_error("watch in %s is null", __func__);
+        return false;
+    }
+
+    if (watch->cb == NULL) {
+        tapi_log_error("callback in %s is null", __func__);
+        return false;
+    }
+
+    ar = &watch->result;
+    ar->status = ERROR;
+    ar->arg2 = 0;
+    ar->data = NULL;
+
+    if (dbus_message_iter_init(message, &args) == false
+        || dbus_message_iter_get_arg_type(&args) != DBUS_TYPE_OBJECT_PATH) {
+        tapi_log_error("dbus message iter init fail in %s", __func__);
+        goto done;
+    }
+
+    dbus_message_iter_get_basic(&args, &path);
+    dbus_message_iter_next(&args);
+    if (dbus_message_iter_get_arg_type(&args) != DBUS_TYPE_ARRAY) {
+        tapi_log_error("dbus message is invalid in %s", __func__);
+        goto done;
+    }
+
+    dbus_message_iter_recurse(&args, &dict);
+
+    snapshot = data_connection_snapshot_get(watch, data_connection_strings_size(path, dict));
+    if (snapshot == NULL) {
+        tapi_log_error("snapshot in %s is null", __func__);
+        return false;
+    }
+
+    data_connection_decode(&dict, &snapshot->item);
+    data_connection_snapshot_own(snapshot, path);
+
+    ar->status = OK;
+    ar->arg2 = data_connection_diff(watch, snapshot);
+    ar->data = &snapshot->item.dc;
+
+done:
+    watch->cb(ar);
+    return true;
+}
+
+static void data_connection_watch_free(void* user_data)
+{
+    data_connection_watch* watch = user_data;
+
+    if (watch->snapshot != NULL)
+        data_connection_snapshot_unref(watch->snapshot);
+
+    for (int i = 0; i < watch->reported_count; i++)
+        data_connection_snapshot_unref(watch->reported[i]);
+
+    free(watch);
+}
+
+static int data_connection_register(dbus_context* ctx, int slot_id, const char* modem_path,
+    void* user_obj, tapi_async_function p_handle)
+{
+    data_connection_watch* watch;
+    int watch_id;
+
+    watch = malloc(sizeof(data_connection_watch));
+    if (watch == NULL) {
+        tapi_log_error("watch in %s is null", __func__);
+        return -ENOMEM;
+    }
+
+    memset(watch, 0, sizeof(data_connection_watch));
+    watch->result.msg_id = MSG_DATA_CONNECTION_STATE_CHANGE_IND;
+    watch->result.msg_type = INDICATION;
+    watch->result.arg1 = slot_id;
+    watch->result.user_obj = user_obj;
+    watch->cb = p_handle;
+
+    watch_id = g_dbus_add_signal_watch(ctx->connection,
+        OFONO_SERVICE, modem_path, OFONO_CONNECTION_MANAGER_INTERFACE,
+        "ContextChanged", data_connection_changed, watch, data_connection_watch_free);
+    if (watch_id == 0) {
+        tapi_log_error("add signal watch failed in %s", __func__);
+        free(watch);
+        return -EINVAL;
+    }
+
+    return watch_id;
+}
+
 static void data_connection_list_query_done(DBusMessage* message, void* user_data)
 {
     tapi_async_handler* handler = user_data;
@@ -712,8 +990,10 @@ static void data_connection_list_query_done(DBusMessage* message, void* user_dat
     tapi_async_function cb;
     DBusMessageIter args, list;
     DBusError err;
-    tapi_data_context* result[MAX_DATA_CALL_LIST_SIZE];
-    int index = 0;
+    tapi_data_context** result = NULL;
+    tapi_data_context_type type;
+    data_connection_item* items = NULL;
+    int count = 0;
 
     if (handler == NULL) {
         tapi_log_error("handler in %s is null", __func__);
@@ -732,6 +1012,9 @@ static void data_connection_list_query_done(DBusMessage* message, void* user_dat
         return;
     }
 
+    type = ar->arg2;
+    ar->arg2 = 0;
+
     dbus_error_init(&err);
     if (dbus_set_error_from_message(&err, message) == true) {
         tapi_log_error("error from message in %s, %s: %s", __func__, err.name, err.message);
@@ -752,65 +1035,63 @@ static void data_connection_list_query_done(DBusMessage* message, void* user_dat
         goto done;
     }
 
+    /* first pass only checks Active and Type, inactive contexts are not decoded */
     dbus_message_iter_recurse(&args, &list);
 
     while (dbus_message_iter_get_arg_type(&list) == DBUS_TYPE_STRUCT) {
         DBusMessageIter entry, dict;
-        tapi_data_context* dc = malloc(sizeof(tapi_data_context));
-        if (dc == NULL)
-            break;
 
-        dc->ip_settings = malloc(sizeof(tapi_ip_settings));
-        if (dc->ip_settings == NULL) {
-            tapi_log_error("ip_settings in %s is null", __func__);
-            free(dc);
-            break;
+        dbus_message_iter_recurse(&list, &entry);
+        dbus_message_iter_next(&entry);
+        dbus_message_iter_recurse(&entry, &dict);
+
+        if (data_connection_matches(dict, type))
+            count++;
+
+        dbus_message_iter_next(&list);
+    }
+
+    /* the list is sized by the matches, pointers first and items behind them */
+    if (count > 0) {
+        result = malloc(count * (sizeof(tapi_data_context*) + sizeof(data_connection_item)));
+        if (result == NULL) {
+            tapi_log_error("result in %s is null", __func__);
+            ar->status = ERROR;
+            goto done;
         }
 
-        dc->active = false;
-        dc->accesspointname[0] = '\0';
-        dc->name[0] = '\0';
-        dc->username[0] = '\0';
-        dc->password[0] = '\0';
-        dc->messageproxy[0] = '\0';
-        dc->messagecenter[0] = '\0';
-        dc->ip_settings->ipv4 = NULL;
-        dc->ip_settings->ipv6 = NULL;
-        dc->ip_settings->mtu = 0;
+        items = (data_connection_item*)(result + count);
+    }
 
-        dbus_message_iter_recurse(&list, &entry);
-        dbus_message_iter_get_basic(&entry, &dc->id);
+    count = 0;
+    dbus_message_iter_recurse(&args, &list);
+
+    while (dbus_message_iter_get_arg_type(&list) == DBUS_TYPE_STRUCT) {
+        DBusMessageIter entry, dict;
+        const char* path;
 
+        dbus_message_iter_recurse(&list, &entry);
+        dbus_message_iter_get_basic(&entry, &path);
         dbus_message_iter_next(&entry);
         dbus_message_iter_recurse(&entry, &dict);
-        update_data_contexts(&dict, dc);
-        dbus_message_iter_next(&list);
 
-        if (dc->active)
-            result[index++] = dc;
-        else {
-            free(dc->ip_settings->ipv4);
-            free(dc->ip_settings->ipv6);
-            free(dc->ip_settings);
-            free(dc);
+        if (data_connection_matches(dict, type)) {
+            data_connection_decode(&dict, &items[count]);
+            items[count].dc.id = (char*)path;
+            result[count] = &items[count].dc;
+            count++;
         }
 
-        if (index >= MAX_DATA_CALL_LIST_SIZE)
-            break;
+        dbus_message_iter_next(&list);
     }
 
     ar->status = OK;
-    ar->arg2 = index;
+    ar->arg2 = count;
     ar->data = result;
 
 done:
     cb(ar);
-    while (--index >= 0) {
-        free(result[index]->ip_settings->ipv4);
-        free(result[index]->ip_settings->ipv6);
-        free(result[index]->ip_settings);
-        free(result[index]);
-    }
+    free(result);
 }
 
 /****************************************************************************
@@ -821,9 +1102,6 @@ int tapi_data_load_apn_contexts(tapi_context context,
     int slot_id, int event_id, tapi_async_function p_handle)
 {
     dbus_context* ctx = context;
-    GDBusProxy* proxy;
-    tapi_async_handler* handler;
-    tapi_async_result* ar;
 
     if (ctx == NULL) {
         tapi_log_error("context in %s is null", __func__);
@@ -835,38 +1113,25 @@ int tapi_data_load_apn_contexts(tapi_context context,
         return -EINVAL;
     }
 
-    proxy = ctx->dbus_proxy[slot_id][DBUS_PROXY_DATA];
-    if (proxy == NULL) {
-        tapi_log_error("no available proxy in %s", __func__);
-        return -EIO;
-    }
+    return apn_cache_load(ctx, slot_id, event_id, p_handle, false);
+}
 
-    handler = malloc(sizeof(tapi_async_handler));
-    if (handler == NULL) {
-        tapi_log_error("handler in %s is null", __func__);
-        return -ENOMEM;
-    }
+int tapi_data_refresh_apn_contexts(tapi_context context,
+    int slot_id, int event_id, tapi_async_function p_handle)
+{
+    dbus_context* ctx = context;
 
-    ar = malloc(sizeof(tapi_async_result));
-    if (ar == NULL) {
-        tapi_log_error("async result in %s is null", __func__);
-        free(handler);
-        return -ENOMEM;
+    if (ctx == NULL) {
+        tapi_log_error("context in %s is null", __func__);
+        return -EINVAL;
     }
 
-    ar->msg_id = event_id;
-    ar->arg1 = slot_id;
-    handler->result = ar;
-    handler->cb_function = p_handle;
-
-    if (!g_dbus_proxy_method_call(proxy,
-            "GetContexts", NULL, apn_list_loaded, handler, handler_free)) {
-        tapi_log_error("method call fail in %s", __func__);
-        handler_free(handler);
+    if (!tapi_is_valid_slotid(slot_id)) {
+        tapi_log_error("invalid slot id in %s", __func__);
         return -EINVAL;
     }
 
-    return OK;
+    return apn_cache_load(ctx, slot_id, event_id, p_handle, true);
 }
 
 int tapi_data_add_apn_context(tapi_context context,
@@ -1102,6 +1367,8 @@ int tapi_data_reset_apn_contexts(tapi_context context,
         return -EINVAL;
     }
 
+    /* contexts are provisioned again, reload them on next use */
+    apn_cache_invalidate(ctx, slot_id);
     return OK;
 }
 
@@ -1266,9 +1533,28 @@ int tapi_data_is_data_roaming(tapi_context context, int slot_id, bool* out)
     return -EINVAL;
 }
 
+/* Types the library does not know are passed to ofono without arbitration */
+static int network_operation_call(GDBusProxy* proxy, const char* member, const char* type)
+{
+    if (!g_dbus_proxy_method_call(proxy,
+            member, network_operation_append, NULL, (void*)type, NULL)) {
+        tapi_log_error("method call failed in %s", __func__);
+        return -EINVAL;
+    }
+
+    return OK;
+}
+
 int tapi_data_request_network(tapi_context context, int slot_id, const char* type)
+{
+    return tapi_data_acquire_network(context, slot_id, type, 0, NULL);
+}
+
+int tapi_data_acquire_network(tapi_context context, int slot_id, const char* type,
+    int event_id, tapi_async_function p_handle)
 {
     dbus_context* ctx = context;
+    tapi_data_context_type apn_type;
     GDBusProxy* proxy;
 
     if (ctx == NULL) {
@@ -1292,18 +1578,17 @@ int tapi_data_request_network(tapi_context context, int slot_id, const char* typ
         return -EIO;
     }
 
-    if (!g_dbus_proxy_method_call(proxy,
-            "RequestNetwork", network_operation_append, NULL, (void*)type, NULL)) {
-        tapi_log_error("method call failed in %s", __func__);
-        return -EINVAL;
-    }
+    apn_type = tapi_utils_apn_type_from_string(type);
+    if (apn_type == DATA_CONTEXT_TYPE_ANY)
+        return network_operation_call(proxy, "RequestNetwork", type);
 
-    return OK;
+    return network_request_acquire(ctx, slot_id, apn_type, event_id, NULL, p_handle);
 }
 
 int tapi_data_release_network(tapi_context context, int slot_id, const char* type)
 {
     dbus_context* ctx = context;
+    tapi_data_context_type apn_type;
     GDBusProxy* proxy;
 
     if (ctx == NULL) {
@@ -1327,17 +1612,46 @@ int tapi_data_release_network(tapi_context context, int slot_id, const char* typ
         return -EIO;
     }
 
-    if (!g_dbus_proxy_method_call(proxy,
-            "ReleaseNetwork", network_operation_append, NULL, (void*)type, NULL)) {
-        tapi_log_error("method call failed in %s", __func__);
+    apn_type = tapi_utils_apn_type_from_string(type);
+    if (apn_type == DATA_CONTEXT_TYPE_ANY)
+        return network_operation_call(proxy, "ReleaseNetwork", type);
+
+    return network_request_drop(ctx, slot_id, apn_type);
+}
+
+int tapi_data_get_network_request_count(tapi_context context, int slot_id, const char* type,
+    int* out)
+{
+    dbus_context* ctx = context;
+
+    if (ctx == NULL) {
+        tapi_log_error("context in %s is null", __func__);
+        return -EINVAL;
+    }
+
+    if (!tapi_is_valid_slotid(slot_id)) {
+        tapi_log_error("invalid slot id in %s", __func__);
         return -EINVAL;
     }
 
+    if (type == NULL || out == NULL) {
+        tapi_log_error("type or out in %s is null", __func__);
+        return -EINVAL;
+    }
+
+    *out = network_request_count(ctx, slot_id, tapi_utils_apn_type_from_string(type));
     return OK;
 }
 
 int tapi_data_get_data_connection_list(tapi_context context, int slot_id, int event_id,
     tapi_async_function p_handle)
+{
+    return tapi_data_get_data_connection_list_by_type(context, slot_id,
+        DATA_CONTEXT_TYPE_ANY, event_id, p_handle);
+}
+
+int tapi_data_get_data_connection_list_by_type(tapi_context context, int slot_id,
+    tapi_data_context_type type, int event_id, tapi_async_function p_handle)
 {
     dbus_context* ctx = context;
     GDBusProxy* proxy;
@@ -1354,6 +1668,11 @@ int tapi_data_get_data_connection_list(tapi_context context, int slot_id, int ev
         return -EINVAL;
     }
 
+    if (type < DATA_CONTEXT_TYPE_ANY || type > DATA_CONTEXT_TYPE_EMERGENCY) {
+        tapi_log_error("invalid type %d in %s", type, __func__);
+        return -EINVAL;
+    }
+
     proxy = ctx->dbus_proxy[slot_id][DBUS_PROXY_DATA];
     if (proxy == NULL) {
         tapi_log_error("no available proxy in %s", __func__);
@@ -1375,6 +1694,7 @@ int tapi_data_get_data_connection_list(tapi_context context, int slot_id, int ev
 
     ar->msg_id = event_id;
     ar->arg1 = slot_id;
+    ar->arg2 = type; /* the filter, replaced by the count on reply */
     handler->result = ar;
     handler->cb_function = p_handle;
 
@@ -1751,6 +2071,10 @@ int tapi_data_register(tapi_context context,
         return -EIO;
     }
 
+    /* connection state changes are decoded into storage owned by the watch */
+    if (msg == MSG_DATA_CONNECTION_STATE_CHANGE_IND)
+        return data_connection_register(ctx, slot_id, modem_path, user_obj, p_handle);
+
     handler = malloc(sizeof(tapi_async_handler));
     if (handler == NULL) {
         tapi_log_error("handler in %s is null", __func__);
@@ -1783,11 +2107,6 @@ int tapi_data_register(tapi_context context,
             OFONO_SERVICE, OFONO_MANAGER_PATH, OFONO_MANAGER_INTERFACE,
             "PropertyChanged", data_property_changed, handler, handler_free);
         break;
-    case MSG_DATA_CONNECTION_STATE_CHANGE_IND:
-        watch_id = g_dbus_add_signal_watch(ctx->connection,
-            OFONO_SERVICE, modem_path, OFONO_CONNECTION_MANAGER_INTERFACE,
-            "ContextChanged", data_connection_changed, handler, handler_free);
-        break;
     default:
         break;
     }
@@ -1821,3 +2140,41 @@ int tapi_data_unregister(tapi_context context, int watch_id)
 
     return OK;
 }
+
+tapi_data_context* tapi_data_context_retain(tapi_data_context* dc)
+{
+    data_connection_snapshot* snapshot;
+
+    if (dc == NULL) {
+        tapi_log_error("dc in %s is null", __func__);
+        return NULL;
+    }
+
+    snapshot = data_connection_snapshot_of(dc);
+    if (snapshot == NULL) {
+        tapi_log_error("dc in %s is not retainable", __func__);
+        return NULL;
+    }
+
+    snapshot->refcount++;
+    return dc;
+}
+
+int tapi_data_context_release(tapi_data_context* dc)
+{
+    data_connection_snapshot* snapshot;
+
+    if (dc == NULL) {
+        tapi_log_error("dc in %s is null", __func__);
+        return -EINVAL;
+    }
+
+    snapshot = data_connection_snapshot_of(dc);
+    if (snapshot == NULL) {
+        tapi_log_error("dc in %s is not retained", __func__);
+        return -EINVAL;
+    }
+
+    data_connection_snapshot_unref(snapshot);
+    return OK;
+}
@@ -0,0 +1,725 @@
+/*
+ * Copyright (C) 2023 Xiaomi Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <uv.h>
+
+#include "tapi.h"
+#include "tapi_internal.h"
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+
+/* NuttX procfs lists the statistics of each device in its own node */
+#define DATA_MONITOR_NET_NODE "/proc/net/"
+#define DATA_MONITOR_LINE_LENGTH 256
+#define DATA_MONITOR_COLUMNS 8
+
+/* Context object paths look like "/ril_0/context1" */
+#define DATA_MONITOR_ID_LENGTH 64
+
+/****************************************************************************
+ * Private Type Declarations
+ ****************************************************************************/
+
+/* Counters of a context survive its deactivation and a modem restart */
+typedef struct {
+    char id[DATA_MONITOR_ID_LENGTH + 1];
+    bool sampled; /* the last counters are valid */
+    u_int64_t rx_bytes;
+    u_int64_t tx_bytes;
+    u_int64_t rx_packets;
+    u_int64_t tx_packets;
+    u_int64_t unanswered; /* ms, uv_now of the first tx without rx, 0 if none */
+    u_int64_t last_tx; /* ms, uv_now of the last sample with tx */
+    bool unreadable; /* the statistics node failed, logged once */
+    tapi_data_traffic_stats stats;
+} data_monitor_context;
+
+typedef struct {
+    u_int64_t rx_bytes;
+    u_int64_t tx_bytes;
+    u_int64_t rx_packets;
+    u_int64_t tx_packets;
+} data_monitor_counters;
+
+struct data_monitor {
+    dbus_context* ctx;
+    int slot_id;
+    unsigned int generation;
+    u_int32_t interval;
+    u_int32_t stall_timeout;
+    u_int64_t sampled; /* ms, uv_now of the last tick */
+    int context_watch;
+    uv_timer_t timer;
+    tapi_async_result result;
+    tapi_async_function cb;
+    int count;
+    data_monitor_context contexts[MAX_DATA_CALL_LIST_SIZE];
+};
+
+typedef struct {
+    dbus_context* ctx;
+    int slot_id;
+    unsigned int generation;
+} data_monitor_sync_param;
+
+/****************************************************************************
+ * Private Data
+ ****************************************************************************/
+
+/* A reply is only applied to the monitor that sent the request */
+static unsigned int g_monitor_generation;
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+
+static void data_monitor_close_done(uv_handle_t* handle)
+{
+    free(handle->data);
+}
+
+static int data_monitor_find(data_monitor* monitor, const char* id)
+{
+    for (int i = 0; i < monitor->count; i++) {
+        if (strcmp(monitor->contexts[i].id, id) == 0)
+            return i;
+    }
+
+    return -1;
+}
+
+static void data_monitor_deactivate(data_monitor_context* context)
+{
+    context->stats.active = false;
+    context->stats.stalled = false;
+    context->stats.rx_rate = 0;
+    context->stats.tx_rate = 0;
+    context->sampled = false;
+    context->unanswered = 0;
+}
+
+/* A new context takes a free entry, or the entry of a context that is not active */
+static int data_monitor_add(data_monitor* monitor, const char* path)
+{
+    int index = -1;
+
+    if (strlen(path) > DATA_MONITOR_ID_LENGTH)
+        return -1;
+
+    if (monitor->count < MAX_DATA_CALL_LIST_SIZE) {
+        index = monitor->count++;
+    } else {
+        for (int i = 0; i < monitor->count && index < 0; i++) {
+            if (!monitor->contexts[i].stats.active)
+                index = i;
+        }
+    }
+
+    if (index >= 0) {
+        memset(&monitor->contexts[index], 0, sizeof(data_monitor_context));
+        strcpy(monitor->contexts[index].id, path);
+    }
+
+    return index;
+}
+
+static bool data_monitor_has_active(data_monitor* monitor)
+{
+    for (int i = 0; i < monitor->count; i++) {
+        if (monitor->contexts[i].stats.active)
+            return true;
+    }
+
+    return false;
+}
+
+static void data_monitor_notify(data_monitor* monitor, data_monitor_context* context)
+{
+    tapi_log_info("data of slot %d on %s %s", monitor->slot_id, context->stats.interface,
+        context->stats.stalled ? "stalled" : "recovered");
+
+    if (monitor->cb == NULL)
+        return;
+
+    monitor->result.arg2 = context->stats.stalled;
+    monitor->result.data = &context->stats;
+    monitor->cb(&monitor->result);
+    monitor->result.data = NULL;
+}
+
+static void data_monitor_sample(data_monitor* monitor, data_monitor_context* context,
+    const data_monitor_counters* counters, u_int64_t now, u_int64_t elapsed)
+{
+    tapi_data_traffic_stats* stats = &context->stats;
+    u_int64_t rx_bytes = 0;
+    u_int64_t tx_bytes = 0;
+    u_int64_t rx_packets = 0;
+    u_int64_t tx_packets = 0;
+
+    /* counters going backwards mean the interface was created again */
+    if (context->sampled && counters->rx_bytes >= context->rx_bytes
+        && counters->tx_bytes >= context->tx_bytes
+        && counters->rx_packets >= context->rx_packets
+        && counters->tx_packets >= context->tx_packets) {
+        rx_bytes = counters->rx_bytes - context->rx_bytes;
+        tx_bytes = counters->tx_bytes - context->tx_bytes;
+        rx_packets = counters->rx_packets - context->rx_packets;
+        tx_packets = counters->tx_packets - context->tx_packets;
+    }
+
+    context->sampled = true;
+    context->rx_bytes = counters->rx_bytes;
+    context->tx_bytes = counters->tx_bytes;
+    context->rx_packets = counters->rx_packets;
+    context->tx_packets = counters->tx_packets;
+
+    stats->rx_bytes += rx_bytes;
+    stats->tx_bytes += tx_bytes;
+    stats->rx_packets += rx_packets;
+    stats->tx_packets += tx_packets;
+
+    if (elapsed > 0) {
+        stats->rx_rate = rx_bytes * 1000 / elapsed;
+        stats->tx_rate = tx_bytes * 1000 / elapsed;
+    }
+
+    if (rx_packets > 0) {
+        context->unanswered = 0;
+        if (stats->stalled) {
+            stats->stalled = false;
+            data_monitor_notify(monitor, context);
+        }
+        return;
+    }
+
+    if (tx_packets > 0) {
+        context->last_tx = now;
+        if (context->unanswered == 0)
+            context->unanswered = now;
+    }
+
+    /* a link that went idle is not stalled, the next tx starts over */
+    if (context->unanswered != 0 && now - context->last_tx >= monitor->stall_timeout) {
+        context->unanswered = 0;
+        return;
+    }
+
+    if (!stats->stalled && context->unanswered != 0
+        && now - context->unanswered >= monitor->stall_timeout) {
+        stats->stalled = true;
+        data_monitor_notify(monitor, context);
+    }
+}
+
+/* Picks the packets and, if listed, the Bytes column of one RX or TX block */
+static bool data_monitor_parse_block(char* header, char* values, const char* packets_column,
+    u_int64_t* packets, u_int64_t* bytes)
+{
+    char* names[DATA_MONITOR_COLUMNS];
+    bool found = false;
+    int count = 0;
+    char* token;
+    char* save;
+
+    for (token = strtok_r(header, " \t\n", &save); token != NULL && count < DATA_MONITOR_COLUMNS;
+         token = strtok_r(NULL, " \t\n", &save))
+        names[count++] = token;
+
+    token = strtok_r(values, " \t\n", &save);
+    for (int i = 0; i < count && token != NULL; i++, token = strtok_r(NULL, " \t\n", &save)) {
+        if (strcmp(names[i], packets_column) == 0) {
+            *packets = strtoull(token, NULL, 16);
+            found = true;
+        } else if (strcmp(names[i], "Bytes") == 0) {
+            *bytes = strtoull(token, NULL, 16);
+        }
+    }
+
+    return found;
+}
+
+/*
+ * Reads /proc/net/<interface>, where an "RX:" or "TX:" line names the
+ * columns of the hex counters on the line below it. Byte counters are
+ * only there when the device keeps them, rates stay 0 otherwise.
+ */
+static int data_monitor_read(const char* interface, data_monitor_counters* counters)
+{
+    char path[sizeof(DATA_MONITOR_NET_NODE) + MAX_IP_INTERFACE_NAME_LENGTH];
+    char header[DATA_MONITOR_LINE_LENGTH];
+    char values[DATA_MONITOR_LINE_LENGTH];
+    bool rx = false;
+    bool tx = false;
+    char* marker;
+    FILE* fp;
+
+    snprintf(path, sizeof(path), "%s%s", DATA_MONITOR_NET_NODE, interface);
+    fp = fopen(path, "r");
+    if (fp == NULL)
+        return -errno;
+
+    memset(counters, 0, sizeof(data_monitor_counters));
+
+    while (fgets(header, sizeof(header), fp) != NULL) {
+        marker = header + strspn(header, " \t");
+        if (strncmp(marker, "RX:", 3) != 0 && strncmp(marker, "TX:", 3) != 0)
+            continue;
+
+        if (fgets(values, sizeof(values), fp) == NULL)
+            break;
+
+        if (marker[0] == 'R')
+            rx = data_monitor_parse_block(marker + 3, values, "Received",
+                &counters->rx_packets, &counters->rx_bytes);
+        else
+            tx = data_monitor_parse_block(marker + 3, values, "Sent",
+                &counters->tx_packets, &counters->tx_bytes);
+    }
+
+    fclose(fp);
+    return rx && tx ? OK : -EINVAL;
+}
+
+static void data_monitor_expired(uv_timer_t* handle)
+{
+    data_monitor* monitor = handle->data;
+    data_monitor_counters counters;
+    u_int64_t now = uv_now(uv_default_loop());
+    u_int64_t elapsed = now - monitor->sampled;
+    bool shared;
+    int ret;
+
+    monitor->sampled = now;
+
+    for (int i = 0; i < monitor->count; i++) {
+        data_monitor_context* context = &monitor->contexts[i];
+
+        if (!context->stats.active)
+            continue;
+
+        /* contexts sharing one interface are counted once, on the first of them */
+        shared = false;
+        for (int j = 0; j < i && !shared; j++) {
+            shared = monitor->contexts[j].stats.active
+                && strcmp(monitor->contexts[j].stats.interface, context->stats.interface) == 0;
+        }
+
+        if (shared) {
+            context->sampled = false; /* starts over if it is the first one later */
+            continue;
+        }
+
+        ret = data_monitor_read(context->stats.interface, &counters);
+        if (ret != OK) {
+            if (!context->unreadable)
+                tapi_log_error("no statistics of %s in %s, ret %d",
+                    context->stats.interface, __func__, ret);
+            context->unreadable = true;
+            continue;
+        }
+
+        context->unreadable = false;
+        data_monitor_sample(monitor, context, &counters, now, elapsed);
+    }
+}
+
+/* Sampling only runs while the slot has active contexts */
+static void data_monitor_schedule(data_monitor* monitor)
+{
+    bool running = uv_is_active((uv_handle_t*)&monitor->timer);
+    bool active = data_monitor_has_active(monitor);
+
+    if (active && !running) {
+        monitor->sampled = uv_now(uv_default_loop());
+        uv_timer_start(&monitor->timer, data_monitor_expired,
+            monitor->interval, monitor->interval);
+    } else if (!active && running) {
+        uv_timer_stop(&monitor->timer);
+    }
+}
+
+static void data_monitor_read_interface(DBusMessageIter* settings, char* interface)
+{
+    DBusMessageIter list, entry, value;
+    const char* key;
+    const char* name;
+
+    if (dbus_message_iter_get_arg_type(settings) != DBUS_TYPE_ARRAY)
+        return;
+
+    dbus_message_iter_recurse(settings, &list);
+
+    while (dbus_message_iter_get_arg_type(&list) == DBUS_TYPE_DICT_ENTRY) {
+        dbus_message_iter_recurse(&list, &entry);
+        dbus_message_iter_get_basic(&entry, &key);
+
+        if (strcmp(key, "Interface") == 0) {
+            dbus_message_iter_next(&entry);
+            dbus_message_iter_recurse(&entry, &value);
+            dbus_message_iter_get_basic(&value, &name);
+
+            if (strlen(name) <= MAX_IP_INTERFACE_NAME_LENGTH)
+                strcpy(interface, name);
+            return;
+        }
+
+        dbus_message_iter_next(&list);
+    }
+}
+
+/* Follows one context from its path and a{sv} properties */
+static void data_monitor_update(data_monitor* monitor, const char* path, DBusMessageIter* dict)
+{
+    data_monitor_context* context;
+    tapi_data_context_type type = DATA_CONTEXT_TYPE_ANY;
+    char interface[MAX_IP_INTERFACE_NAME_LENGTH + 1] = "";
+    dbus_bool_t active = false;
+    int index;
+
+    while (dbus_message_iter_get_arg_type(dict) == DBUS_TYPE_DICT_ENTRY) {
+        DBusMessageIter entry, value;
+        const char* key;
+        const char* value_str;
+
+        dbus_message_iter_recurse(dict, &entry);
+        dbus_message_iter_get_basic(&entry, &key);
+
+        dbus_message_iter_next(&entry);
+        dbus_message_iter_recurse(&entry, &value);
+
+        if (strcmp(key, "Active") == 0) {
+            dbus_message_iter_get_basic(&value, &active);
+        } else if (strcmp(key, "Type") == 0) {
+            dbus_message_iter_get_basic(&value, &value_str);
+            type = tapi_utils_apn_type_from_string(value_str);
+        } else if (strcmp(key, "Settings") == 0) {
+            data_monitor_read_interface(&value, interface);
+        } else if (strcmp(key, "IPv6.Settings") == 0 && interface[0] == '\0') {
+            data_monitor_read_interface(&value, interface);
+        }
+
+        dbus_message_iter_next(dict);
+    }
+
+    index = data_monitor_find(monitor, path);
+
+    if (!active || interface[0] == '\0') {
+        if (index >= 0)
+            data_monitor_deactivate(&monitor->contexts[index]);
+        return;
+    }
+
+    if (index < 0) {
+        index = data_monitor_add(monitor, path);
+        if (index < 0) {
+            tapi_log_error("context %s can not be monitored in %s", path, __func__);
+            return;
+        }
+    }
+
+    context = &monitor->contexts[index];
+    context->stats.type = type;
+
+    /* a new interface starts from its current counters */
+    if (!context->stats.active || strcmp(context->stats.interface, interface) != 0) {
+        strcpy(context->stats.interface, interface);
+        context->stats.active = true;
+        context->sampled = false;
+        context->unanswered = 0;
+        context->unreadable = false;
+    }
+}
+
+static int data_monitor_context_changed(DBusConnection* connection, DBusMessage* message,
+    void* user_data)
+{
+    data_monitor* monitor = user_data;
+    DBusMessageIter iter, dict;
+    const char* path;
+
+    if (monitor == NULL) {
+        tapi_log_error("monitor in %s is null", __func__);
+        return 0;
+    }
+
+    if (!dbus_message_iter_init(message, &iter)
+        || dbus_message_iter_get_arg_type(&iter) != DBUS_TYPE_OBJECT_PATH) {
+        tapi_log_error("message invalid in %s", __func__);
+        return 0;
+    }
+
+    dbus_message_iter_get_basic(&iter, &path);
+    dbus_message_iter_next(&iter);
+    if (dbus_message_iter_get_arg_type(&iter) != DBUS_TYPE_ARRAY) {
+        tapi_log_error("message invalid in %s", __func__);
+        return 0;
+    }
+
+    dbus_message_iter_recurse(&iter, &dict);
+    data_monitor_update(monitor, path, &dict);
+    data_monitor_schedule(monitor);
+    return 1;
+}
+
+static void data_monitor_sync_done(DBusMessage* message, void* user_data)
+{
+    data_monitor_sync_param* param = user_data;
+    data_monitor* monitor;
+    DBusMessageIter args, list;
+    DBusError err;
+
+    if (param == NULL) {
+        tapi_log_error("param in %s is null", __func__);
+        return;
+    }
+
+    monitor = param->ctx->data_monitors[param->slot_id];
+    if (monitor == NULL || monitor->generation != param->generation) {
+        /* disabled or superseded by a later resync */
+        return;
+    }
+
+    dbus_error_init(&err);
+    if (dbus_set_error_from_message(&err, message) == true) {
+        tapi_log_error("error from message in %s, %s: %s", __func__, err.name, err.message);
+        dbus_error_free(&err);
+        return;
+    }
+
+    if (dbus_message_has_signature(message, "a(oa{sv})") == false
+        || dbus_message_iter_init(message, &args) == false) {
+        tapi_log_error("dbus message is invalid in %s", __func__);
+        return;
+    }
+
+    dbus_message_iter_recurse(&args, &list);
+
+    while (dbus_message_iter_get_arg_type(&list) == DBUS_TYPE_STRUCT) {
+        DBusMessageIter entry, dict;
+        const char* path;
+
+        dbus_message_iter_recurse(&list, &entry);
+        dbus_message_iter_get_basic(&entry, &path);
+
+        dbus_message_iter_next(&entry);
+        dbus_message_iter_recurse(&entry, &dict);
+        data_monitor_update(monitor, path, &dict);
+
+        dbus_message_iter_next(&list);
+    }
+
+    data_monitor_schedule(monitor);
+}
+
+static void data_monitor_release_slot(dbus_context* ctx, int slot_id)
+{
+    data_monitor* monitor = ctx->data_monitors[slot_id];
+
+    if (monitor == NULL)
+        return;
+
+    if (monitor->context_watch != 0)
+        g_dbus_remove_watch(ctx->connection, monitor->context_watch);
+
+    ctx->data_monitors[slot_id] = NULL;
+    uv_timer_stop(&monitor->timer);
+    uv_close((uv_handle_t*)&monitor->timer, data_monitor_close_done);
+}
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+void data_monitor_sync(dbus_context* ctx, int slot_id)
+{
+    data_monitor_sync_param* param;
+    data_monitor* monitor;
+    GDBusProxy* proxy;
+
+    if (!tapi_is_valid_slotid(slot_id))
+        return;
+
+    monitor = ctx->data_monitors[slot_id];
+    if (monitor == NULL)
+        return;
+
+    /* contexts are down after a modem restart until GetContexts answers, counters stay */
+    monitor->generation = ++g_monitor_generation;
+    for (int i = 0; i < monitor->count; i++)
+        data_monitor_deactivate(&monitor->contexts[i]);
+    data_monitor_schedule(monitor);
+
+    proxy = ctx->dbus_proxy[slot_id][DBUS_PROXY_DATA];
+    if (proxy == NULL) {
+        tapi_log_error("no available proxy in %s", __func__);
+        return;
+    }
+
+    param = malloc(sizeof(data_monitor_sync_param));
+    if (param == NULL) {
+        tapi_log_error("param in %s is null", __func__);
+        return;
+    }
+
+    param->ctx = ctx;
+    param->slot_id = slot_id;
+    param->generation = monitor->generation;
+
+    if (!g_dbus_proxy_method_call(proxy, "GetContexts", NULL,
+            data_monitor_sync_done, param, free)) {
+        tapi_log_error("dbus method call fail in %s", __func__);
+        free(param);
+    }
+}
+
+void data_monitor_release_all(dbus_context* ctx)
+{
+    for (int i = 0; i < CONFIG_MODEM_ACTIVE_COUNT; i++)
+        data_monitor_release_slot(ctx, i);
+}
+
+int tapi_data_enable_traffic_monitor(tapi_context context, int slot_id, u_int32_t interval_ms,
+    u_int32_t stall_timeout_ms, void* user_obj, tapi_async_function p_handle)
+{
+    dbus_context* ctx = context;
+    data_monitor* monitor;
+    const char* modem_path;
+
+    if (ctx == NULL) {
+        tapi_log_error("context is null in %s", __func__);
+        return -EINVAL;
+    }
+
+    if (!tapi_is_valid_slotid(slot_id)) {
+        tapi_log_error("invalid slot id %d in %s", slot_id, __func__);
+        return -EINVAL;
+    }
+
+    if (ctx->data_monitors[slot_id] != NULL) {
+        tapi_log_error("traffic monitor of slot %d already enabled in %s", slot_id, __func__);
+        return -EALREADY;
+    }
+
+    modem_path = tapi_utils_get_modem_path(slot_id);
+    if (modem_path == NULL) {
+        tapi_log_error("no available modem in %s", __func__);
+        return -EIO;
+    }
+
+    monitor = malloc(sizeof(data_monitor));
+    if (monitor == NULL) {
+        tapi_log_error("monitor in %s is null", __func__);
+        return -ENOMEM;
+    }
+
+    memset(monitor, 0, sizeof(data_monitor));
+    monitor->ctx = ctx;
+    monitor->slot_id = slot_id;
+    monitor->interval = interval_ms > 0 ? interval_ms
+                                        : CONFIG_TELEPHONY_DATA_MONITOR_INTERVAL;
+    monitor->stall_timeout = stall_timeout_ms > 0 ? stall_timeout_ms
+                                                  : CONFIG_TELEPHONY_DATA_STALL_TIMEOUT;
+    monitor->result.msg_id = MSG_DATA_STALL_IND;
+    monitor->result.msg_type = INDICATION;
+    monitor->result.arg1 = slot_id;
+    monitor->result.status = OK;
+    monitor->result.user_obj = user_obj;
+    monitor->cb = p_handle;
+
+    monitor->context_watch = g_dbus_add_signal_watch(ctx->connection, OFONO_SERVICE,
+        modem_path, OFONO_CONNECTION_MANAGER_INTERFACE, "ContextChanged",
+        data_monitor_context_changed, monitor, NULL);
+    if (monitor->context_watch == 0) {
+        tapi_log_error("add signal watch failed in %s", __func__);
+        free(monitor);
+        return -EINVAL;
+    }
+
+    uv_timer_init(uv_default_loop(), &monitor->timer);
+    monitor->timer.data = monitor;
+
+    ctx->data_monitors[slot_id] = monitor;
+    data_monitor_sync(ctx, slot_id);
+    return OK;
+}
+
+int tapi_data_disable_traffic_monitor(tapi_context context, int slot_id)
+{
+    dbus_context* ctx = context;
+
+    if (ctx == NULL) {
+        tapi_log_error("context is null in %s", __func__);
+        return -EINVAL;
+    }
+
+    if (!tapi_is_valid_slotid(slot_id)) {
+        tapi_log_error("invalid slot id %d in %s", slot_id, __func__);
+        return -EINVAL;
+    }
+
+    if (ctx->data_monitors[slot_id] == NULL) {
+        tapi_log_error("traffic monitor of slot %d is null in %s", slot_id, __func__);
+        return -EIO;
+    }
+
+    data_monitor_release_slot(ctx, slot_id);
+    return OK;
+}
+
+int tapi_data_get_traffic_stats(tapi_context context, int slot_id,
+    tapi_data_traffic_stats* out, int size)
+{
+    dbus_context* ctx = context;
+    data_monitor* monitor;
+    int count;
+
+    if (ctx == NULL) {
+        tapi_log_error("context is null in %s", __func__);
+        return -EINVAL;
+    }
+
+    if (!tapi_is_valid_slotid(slot_id)) {
+        tapi_log_error("invalid slot id %d in %s", slot_id, __func__);
+        return -EINVAL;
+    }
+
+    if (out == NULL || size < 0) {
+        tapi_log_error("out is invalid in %s", __func__);
+        return -EINVAL;
+    }
+
+    monitor = ctx->data_monitors[slot_id];
+    if (monitor == NULL) {
+        tapi_log_error("traffic monitor of slot %d is null in %s", slot_id, __func__);
+        return -EIO;
+    }
+
+    count = monitor->count < size ? monitor->count : size;
+    for (int i = 0; i < count; i++)
+        memcpy(&out[i], &monitor->contexts[i].stats, sizeof(tapi_data_traffic_stats));
+
+    return count;
+}
@@ -0,0 +1,358 @@
+/*
+ * Copyright (C) 2023 Xiaomi Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <uv.h>
+
+#include "tapi.h"
+#include "tapi_internal.h"
+
+/****************************************************************************
+ * Private Type Declarations
+ ****************************************************************************/
+
+/*
+ * Holds the internet bearer of the default data slot ahead of demand.
+ * The hold is one more reference of the network request arbiter, so it
+ * never tears down a bearer an app requested.
+ */
+struct data_prewarm {
+    dbus_context* ctx;
+    int slot_id; /* default data slot, -1 if unknown */
+    bool registered; /* packet domain of slot_id */
+    int technology;
+    bool pending; /* request in flight */
+    bool holding;
+    u_int32_t idle_timeout;
+    int data_watch;
+    int slot_watch;
+    uv_timer_t idle_timer;
+};
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+
+static void data_prewarm_close_done(uv_handle_t* handle)
+{
+    free(handle->data);
+}
+
+static bool data_prewarm_is_registered(int status)
+{
+    return status == NETWORK_REGISTRATION_STATUS_REGISTERED
+        || status == NETWORK_REGISTRATION_STATUS_ROAMING;
+}
+
+static void data_prewarm_drop(data_prewarm* prewarm)
+{
+    uv_timer_stop(&prewarm->idle_timer);
+
+    if (!prewarm->holding)
+        return;
+
+    tapi_log_info("%s: slot %d", __func__, prewarm->slot_id);
+    prewarm->holding = false;
+    network_request_drop(prewarm->ctx, prewarm->slot_id, DATA_CONTEXT_TYPE_INTERNET);
+}
+
+static void data_prewarm_idle(uv_timer_t* handle)
+{
+    data_prewarm_drop(handle->data);
+}
+
+static void data_prewarm_arm(data_prewarm* prewarm)
+{
+    uv_timer_start(&prewarm->idle_timer, data_prewarm_idle, prewarm->idle_timeout, 0);
+}
+
+static void data_prewarm_granted(tapi_async_result* result)
+{
+    dbus_context* ctx = result->user_obj;
+    data_prewarm* prewarm = ctx->data_prewarm;
+
+    /* disabled or moved to another slot while the request was in flight */
+    if (prewarm == NULL || !prewarm->pending || prewarm->slot_id != result->arg1) {
+        if (result->status == OK)
+            network_request_drop(ctx, result->arg1, DATA_CONTEXT_TYPE_INTERNET);
+        return;
+    }
+
+    prewarm->pending = false;
+    if (result->status != OK) {
+        tapi_log_error("pre-warm of slot %d failed in %s", prewarm->slot_id, __func__);
+        return;
+    }
+
+    prewarm->holding = true;
+    data_prewarm_arm(prewarm);
+}
+
+/* Data is likely needed soon, bring the bearer up or keep it up */
+static void data_prewarm_trigger(data_prewarm* prewarm, const char* reason)
+{
+    if (!prewarm->ctx->screen_on || !prewarm->registered || prewarm->pending)
+        return;
+
+    if (prewarm->holding) {
+        data_prewarm_arm(prewarm);
+        return;
+    }
+
+    tapi_log_info("%s: slot %d on %s", __func__, prewarm->slot_id, reason);
+
+    prewarm->pending = true;
+    if (network_request_acquire(prewarm->ctx, prewarm->slot_id, DATA_CONTEXT_TYPE_INTERNET,
+            0, prewarm->ctx, data_prewarm_granted)
+        != OK)
+        prewarm->pending = false;
+}
+
+static void data_prewarm_load_slot(data_prewarm* prewarm)
+{
+    GDBusProxy* proxy;
+    DBusMessageIter iter;
+    int value;
+
+    prewarm->registered = false;
+    prewarm->technology = 0;
+
+    if (!tapi_is_valid_slotid(prewarm->slot_id))
+        return;
+
+    proxy = prewarm->ctx->dbus_proxy[prewarm->slot_id][DBUS_PROXY_DATA];
+    if (proxy == NULL)
+        return;
+
+    if (g_dbus_proxy_get_property(proxy, "Status", &iter)) {
+        dbus_message_iter_get_basic(&iter, &value);
+        prewarm->registered = data_prewarm_is_registered(value);
+    }
+
+    if (g_dbus_proxy_get_property(proxy, "Technology", &iter))
+        dbus_message_iter_get_basic(&iter, &prewarm->technology);
+}
+
+static bool data_prewarm_property(DBusMessage* message, const char** key,
+    DBusMessageIter* value)
+{
+    DBusMessageIter iter;
+
+    if (!dbus_message_iter_init(message, &iter)
+        || dbus_message_iter_get_arg_type(&iter) != DBUS_TYPE_STRING)
+        return false;
+
+    dbus_message_iter_get_basic(&iter, key);
+    dbus_message_iter_next(&iter);
+    if (dbus_message_iter_get_arg_type(&iter) != DBUS_TYPE_VARIANT)
+        return false;
+
+    dbus_message_iter_recurse(&iter, value);
+    return true;
+}
+
+static int data_prewarm_data_changed(DBusConnection* connection, DBusMessage* message,
+    void* user_data)
+{
+    data_prewarm* prewarm = user_data;
+    DBusMessageIter value;
+    const char* modem_path;
+    const char* path;
+    const char* key;
+    bool registered;
+    int technology;
+    int status;
+
+    if (prewarm == NULL) {
+        tapi_log_error("prewarm in %s is null", __func__);
+        return 0;
+    }
+
+    modem_path = tapi_utils_get_modem_path(prewarm->slot_id);
+    path = dbus_message_get_path(message);
+    if (modem_path == NULL || path == NULL || strcmp(modem_path, path) != 0)
+        return 1;
+
+    if (!data_prewarm_property(message, &key, &value))
+        return 1;
+
+    if (strcmp(key, "Status") == 0) {
+        dbus_message_iter_get_basic(&value, &status);
+        registered = prewarm->registered;
+        prewarm->registered = data_prewarm_is_registered(status);
+
+        /* back in coverage */
+        if (!registered && prewarm->registered)
+            data_prewarm_trigger(prewarm, "registration");
+    } else if (strcmp(key, "Technology") == 0) {
+        dbus_message_iter_get_basic(&value, &technology);
+        if (technology != prewarm->technology
+            && tapi_utils_network_type_from_ril_tech(technology) != NETWORK_TYPE_UNKNOWN)
+            data_prewarm_trigger(prewarm, "technology");
+
+        prewarm->technology = technology;
+    }
+
+    return 1;
+}
+
+static int data_prewarm_slot_changed(DBusConnection* connection, DBusMessage* message,
+    void* user_data)
+{
+    data_prewarm* prewarm = user_data;
+    DBusMessageIter value;
+    const char* modem_path;
+    const char* key;
+    int slot_id;
+
+    if (prewarm == NULL) {
+        tapi_log_error("prewarm in %s is null", __func__);
+        return 0;
+    }
+
+    if (!data_prewarm_property(message, &key, &value) || strcmp(key, "DataSlot") != 0)
+        return 1;
+
+    dbus_message_iter_get_basic(&value, &modem_path);
+    slot_id = tapi_utils_get_slot_id(modem_path);
+    if (slot_id == prewarm->slot_id)
+        return 1;
+
+    /* the bearer follows the default data slot */
+    data_prewarm_drop(prewarm);
+    prewarm->pending = false;
+    prewarm->slot_id = slot_id;
+    data_prewarm_load_slot(prewarm);
+    data_prewarm_trigger(prewarm, "data slot");
+    return 1;
+}
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+void data_prewarm_sync(dbus_context* ctx, int slot_id)
+{
+    data_prewarm* prewarm = ctx->data_prewarm;
+
+    if (prewarm == NULL || prewarm->slot_id != slot_id)
+        return;
+
+    /* the arbiter requests held networks again, only the state is reloaded */
+    data_prewarm_load_slot(prewarm);
+}
+
+void data_prewarm_screen_changed(dbus_context* ctx)
+{
+    /* screen off only stops new pre-warming, a held bearer runs to its idle timeout */
+    if (ctx->data_prewarm != NULL && ctx->screen_on)
+        data_prewarm_trigger(ctx->data_prewarm, "screen on");
+}
+
+void data_prewarm_release(dbus_context* ctx)
+{
+    data_prewarm* prewarm = ctx->data_prewarm;
+
+    if (prewarm == NULL)
+        return;
+
+    if (prewarm->data_watch != 0)
+        g_dbus_remove_watch(ctx->connection, prewarm->data_watch);
+    if (prewarm->slot_watch != 0)
+        g_dbus_remove_watch(ctx->connection, prewarm->slot_watch);
+
+    data_prewarm_drop(prewarm);
+    ctx->data_prewarm = NULL;
+    uv_close((uv_handle_t*)&prewarm->idle_timer, data_prewarm_close_done);
+}
+
+int tapi_data_enable_prewarm(tapi_context context, u_int32_t idle_timeout_ms)
+{
+    dbus_context* ctx = context;
+    data_prewarm* prewarm;
+
+    if (ctx == NULL) {
+        tapi_log_error("context is null in %s", __func__);
+        return -EINVAL;
+    }
+
+    if (ctx->data_prewarm != NULL) {
+        tapi_log_error("prewarm already enabled in %s", __func__);
+        return -EALREADY;
+    }
+
+    prewarm = malloc(sizeof(data_prewarm));
+    if (prewarm == NULL) {
+        tapi_log_error("prewarm in %s is null", __func__);
+        return -ENOMEM;
+    }
+
+    memset(prewarm, 0, sizeof(data_prewarm));
+    prewarm->ctx = ctx;
+    prewarm->idle_timeout = idle_timeout_ms > 0 ? idle_timeout_ms
+                                                : CONFIG_TELEPHONY_DATA_PREWARM_IDLE_TIMEOUT;
+
+    /* one watch serves all slots, only the default data slot is followed */
+    prewarm->data_watch = g_dbus_add_signal_watch(ctx->connection, OFONO_SERVICE, NULL,
+        OFONO_CONNECTION_MANAGER_INTERFACE, "PropertyChanged",
+        data_prewarm_data_changed, prewarm, NULL);
+    prewarm->slot_watch = g_dbus_add_signal_watch(ctx->connection, OFONO_SERVICE,
+        OFONO_MANAGER_PATH, OFONO_MANAGER_INTERFACE, "PropertyChanged",
+        data_prewarm_slot_changed, prewarm, NULL);
+    if (prewarm->data_watch == 0 || prewarm->slot_watch == 0) {
+        tapi_log_error("add signal watch failed in %s", __func__);
+        if (prewarm->data_watch != 0)
+            g_dbus_remove_watch(ctx->connection, prewarm->data_watch);
+        if (prewarm->slot_watch != 0)
+            g_dbus_remove_watch(ctx->connection, prewarm->slot_watch);
+        free(prewarm);
+        return -EINVAL;
+    }
+
+    uv_timer_init(uv_default_loop(), &prewarm->idle_timer);
+    prewarm->idle_timer.data = prewarm;
+    ctx->data_prewarm = prewarm;
+
+    if (tapi_data_get_default_slot(ctx, &prewarm->slot_id) != OK)
+        prewarm->slot_id = -1;
+
+    data_prewarm_load_slot(prewarm);
+    data_prewarm_trigger(prewarm, "enable");
+    return OK;
+}
+
+int tapi_data_disable_prewarm(tapi_context context)
+{
+    dbus_context* ctx = context;
+
+    if (ctx == NULL) {
+        tapi_log_error("context is null in %s", __func__);
+        return -EINVAL;
+    }
+
+    if (ctx->data_prewarm == NULL) {
+        tapi_log_error("prewarm is not enabled in %s", __func__);
+        return -EIO;
+    }
+
+    data_prewarm_release(ctx);
+    return OK;
+}
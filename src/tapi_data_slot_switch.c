@@ -0,0 +1,579 @@
+/*
+ * Copyright (C) 2023 Xiaomi Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <uv.h>
+
+#include "tapi.h"
+#include "tapi_internal.h"
+
+/****************************************************************************
+ * Private Type Declarations
+ ****************************************************************************/
+
+typedef enum {
+    SLOT_SWITCH_PARALLEL, /* target attaches while the old slot keeps its bearer */
+    SLOT_SWITCH_SEQUENTIAL, /* DataSlot moved, the modem tears down before setup */
+    SLOT_SWITCH_DONE,
+} slot_switch_phase;
+
+struct data_slot_switch {
+    dbus_context* ctx;
+    unsigned int generation;
+    int event_id;
+    tapi_async_function cb;
+    slot_switch_phase phase;
+    int status;
+    bool from_up; /* internet of the old slot, assumed up until it is reported down */
+    bool to_up; /* internet of the target slot */
+    bool moving; /* DataSlot move sent */
+    bool moved; /* DataSlot move acknowledged */
+    u_int64_t begin; /* ms */
+    u_int64_t gap_begin; /* ms, internet went down on both slots */
+    u_int64_t gap; /* ms without internet on either slot before gap_begin */
+    int watches[2]; /* ContextChanged of the old and the target slot */
+    uv_timer_t timer;
+    tapi_data_slot_switch_result result;
+};
+
+typedef struct {
+    dbus_context* ctx;
+    unsigned int generation;
+} slot_switch_param;
+
+/****************************************************************************
+ * Private Data
+ ****************************************************************************/
+
+/* A reply is only applied to the switch that sent the request */
+static unsigned int g_switch_generation;
+
+/****************************************************************************
+ * Private Function Prototypes
+ ****************************************************************************/
+
+static void slot_switch_sequential(data_slot_switch* sw);
+static void slot_switch_move(data_slot_switch* sw);
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+
+static u_int64_t slot_switch_now(void)
+{
+    return uv_hrtime() / 1000000;
+}
+
+static void slot_switch_close_done(uv_handle_t* handle)
+{
+    free(handle->data);
+}
+
+static void slot_switch_free(data_slot_switch* sw)
+{
+    dbus_context* ctx = sw->ctx;
+
+    for (int i = 0; i < 2; i++) {
+        if (sw->watches[i] != 0)
+            g_dbus_remove_watch(ctx->connection, sw->watches[i]);
+    }
+
+    ctx->slot_switch = NULL;
+    uv_timer_stop(&sw->timer);
+    uv_close((uv_handle_t*)&sw->timer, slot_switch_close_done);
+}
+
+static slot_switch_param* slot_switch_param_new(data_slot_switch* sw)
+{
+    slot_switch_param* param = malloc(sizeof(slot_switch_param));
+
+    if (param == NULL) {
+        tapi_log_error("param in %s is null", __func__);
+        return NULL;
+    }
+
+    param->ctx = sw->ctx;
+    param->generation = sw->generation;
+    return param;
+}
+
+static void slot_switch_finish(uv_timer_t* handle)
+{
+    data_slot_switch* sw = handle->data;
+    tapi_async_function cb = sw->cb;
+    tapi_async_result ar;
+
+    memset(&ar, 0, sizeof(tapi_async_result));
+    ar.msg_id = sw->event_id;
+    ar.msg_type = RESPONSE;
+    ar.arg1 = sw->result.to_slot;
+    ar.arg2 = sw->result.gap;
+    ar.status = sw->status;
+    ar.data = &sw->result;
+
+    tapi_log_info("%s: slot %d to %d %s, gap %u ms in %u ms", __func__,
+        sw->result.from_slot, sw->result.to_slot, sw->result.parallel ? "parallel" : "sequential",
+        (unsigned int)sw->result.gap, (unsigned int)sw->result.duration);
+
+    if (cb != NULL)
+        cb(&ar);
+
+    slot_switch_free(sw);
+}
+
+/* Completion is deferred, it may be reached from a signal watch that is removed with it */
+static void slot_switch_complete(data_slot_switch* sw, int status)
+{
+    u_int64_t now = slot_switch_now();
+
+    if (sw->phase == SLOT_SWITCH_DONE)
+        return;
+
+    sw->phase = SLOT_SWITCH_DONE;
+    sw->status = status;
+    sw->result.duration = now - sw->begin;
+    sw->result.gap = sw->gap;
+    if (!sw->from_up && !sw->to_up)
+        sw->result.gap += now - sw->gap_begin;
+
+    uv_timer_stop(&sw->timer);
+    uv_timer_start(&sw->timer, slot_switch_finish, 0, 0);
+}
+
+/* Tracks the internet state of one slot, the gap runs while neither is up */
+static void slot_switch_track(data_slot_switch* sw, bool* state, bool up)
+{
+    bool was_up = sw->from_up || sw->to_up;
+    u_int64_t now;
+
+    if (*state == up)
+        return;
+
+    *state = up;
+    now = slot_switch_now();
+
+    if (was_up && !sw->from_up && !sw->to_up)
+        sw->gap_begin = now;
+    else if (!was_up && (sw->from_up || sw->to_up))
+        sw->gap += now - sw->gap_begin;
+}
+
+static void slot_switch_set_allowed(data_slot_switch* sw, int slot_id, bool allowed,
+    GDBusResultFunction function)
+{
+    GDBusProxy* proxy = sw->ctx->dbus_proxy[slot_id][DBUS_PROXY_DATA];
+    slot_switch_param* param = NULL;
+    dbus_bool_t value = allowed;
+
+    if (proxy == NULL) {
+        tapi_log_error("no available proxy in %s", __func__);
+        if (function != NULL)
+            slot_switch_sequential(sw);
+        return;
+    }
+
+    if (function != NULL) {
+        param = slot_switch_param_new(sw);
+        if (param == NULL) {
+            slot_switch_sequential(sw);
+            return;
+        }
+    }
+
+    if (!g_dbus_proxy_set_property_basic(proxy, "DataAllowed", DBUS_TYPE_BOOLEAN, &value,
+            function, param, free)) {
+        tapi_log_error("set property failed in %s", __func__);
+        free(param);
+        if (function != NULL)
+            slot_switch_sequential(sw);
+    }
+}
+
+/* Returns true if dict describes an active internet context */
+static bool slot_switch_internet_active(DBusMessageIter* dict, bool* internet)
+{
+    dbus_bool_t active = false;
+
+    *internet = false;
+
+    while (dbus_message_iter_get_arg_type(dict) == DBUS_TYPE_DICT_ENTRY) {
+        DBusMessageIter entry, value;
+        const char* key;
+        const char* type;
+
+        dbus_message_iter_recurse(dict, &entry);
+        dbus_message_iter_get_basic(&entry, &key);
+        dbus_message_iter_next(&entry);
+        dbus_message_iter_recurse(&entry, &value);
+
+        if (strcmp(key, "Active") == 0) {
+            dbus_message_iter_get_basic(&value, &active);
+        } else if (strcmp(key, "Type") == 0) {
+            dbus_message_iter_get_basic(&value, &type);
+            *internet = tapi_utils_apn_type_from_string(type) == DATA_CONTEXT_TYPE_INTERNET;
+        }
+
+        dbus_message_iter_next(dict);
+    }
+
+    return *internet && active;
+}
+
+static data_slot_switch* slot_switch_lookup(slot_switch_param* param)
+{
+    data_slot_switch* sw = param->ctx->slot_switch;
+
+    if (sw == NULL || sw->generation != param->generation || sw->phase == SLOT_SWITCH_DONE)
+        return NULL;
+
+    return sw;
+}
+
+/* The switch is done once DataSlot is moved and the target still carries data */
+static void slot_switch_target_changed(data_slot_switch* sw, bool active)
+{
+    slot_switch_track(sw, &sw->to_up, active);
+    if (!active)
+        return;
+
+    if (sw->moved) {
+        slot_switch_complete(sw, OK);
+    } else if (sw->phase == SLOT_SWITCH_PARALLEL && !sw->moving) {
+        /* the new bearer already carries data, only now DataSlot moves */
+        sw->result.parallel = true;
+        slot_switch_move(sw);
+    }
+}
+
+/* Answers whether the target is up, no ContextChanged follows for a context already up */
+static void slot_switch_contexts_loaded(DBusMessage* message, void* user_data)
+{
+    data_slot_switch* sw = slot_switch_lookup(user_data);
+    DBusMessageIter args, list;
+    bool internet;
+
+    if (sw == NULL)
+        return;
+
+    if (dbus_message_get_type(message) == DBUS_MESSAGE_TYPE_ERROR
+        || !dbus_message_has_signature(message, "a(oa{sv})")
+        || !dbus_message_iter_init(message, &args))
+        return;
+
+    dbus_message_iter_recurse(&args, &list);
+
+    while (dbus_message_iter_get_arg_type(&list) == DBUS_TYPE_STRUCT) {
+        DBusMessageIter entry, dict;
+
+        dbus_message_iter_recurse(&list, &entry);
+        dbus_message_iter_next(&entry);
+        dbus_message_iter_recurse(&entry, &dict);
+
+        if (slot_switch_internet_active(&dict, &internet)) {
+            slot_switch_target_changed(sw, true);
+            return;
+        }
+
+        dbus_message_iter_next(&list);
+    }
+
+    slot_switch_target_changed(sw, false);
+}
+
+static void slot_switch_load_contexts(data_slot_switch* sw)
+{
+    GDBusProxy* proxy = sw->ctx->dbus_proxy[sw->result.to_slot][DBUS_PROXY_DATA];
+    slot_switch_param* param;
+
+    if (proxy == NULL) {
+        tapi_log_error("no available proxy in %s", __func__);
+        return;
+    }
+
+    param = slot_switch_param_new(sw);
+    if (param == NULL)
+        return;
+
+    /* a failure leaves the switch to ContextChanged and the timer */
+    if (!g_dbus_proxy_method_call(proxy, "GetContexts", NULL,
+            slot_switch_contexts_loaded, param, free)) {
+        tapi_log_error("dbus method call fail in %s", __func__);
+        free(param);
+    }
+}
+
+/* DataSlot did not move, the old slot keeps data and only it stays allowed */
+static void slot_switch_move_failed(data_slot_switch* sw, int status)
+{
+    if (sw->result.parallel)
+        slot_switch_set_allowed(sw, sw->result.to_slot, false, NULL);
+    else if (sw->phase == SLOT_SWITCH_SEQUENTIAL && tapi_is_valid_slotid(sw->result.from_slot))
+        slot_switch_set_allowed(sw, sw->result.from_slot, true, NULL);
+
+    slot_switch_complete(sw, status);
+}
+
+static void slot_switch_moved(const DBusError* error, void* user_data)
+{
+    data_slot_switch* sw = slot_switch_lookup(user_data);
+
+    if (sw == NULL)
+        return;
+
+    if (dbus_error_is_set(error)) {
+        tapi_log_error("%s: %s", error->name, error->message);
+        slot_switch_move_failed(sw, -EIO);
+        return;
+    }
+
+    sw->moved = true;
+
+    /* the old slot is released after the move, as the sequential path did before it */
+    if (sw->result.parallel)
+        slot_switch_set_allowed(sw, sw->result.from_slot, false, NULL);
+
+    /* the modem may set the target up again after the move, ask for its state now */
+    slot_switch_load_contexts(sw);
+}
+
+static void slot_switch_move(data_slot_switch* sw)
+{
+    GDBusProxy* proxy = sw->ctx->dbus_proxy_manager;
+    const char* modem_path = tapi_utils_get_modem_path(sw->result.to_slot);
+    slot_switch_param* param;
+
+    sw->moving = true;
+
+    if (proxy == NULL || modem_path == NULL) {
+        tapi_log_error("no available proxy in %s", __func__);
+        slot_switch_move_failed(sw, -EIO);
+        return;
+    }
+
+    param = slot_switch_param_new(sw);
+    if (param == NULL) {
+        slot_switch_move_failed(sw, -ENOMEM);
+        return;
+    }
+
+    if (!g_dbus_proxy_set_property_basic(proxy, "DataSlot", DBUS_TYPE_STRING, &modem_path,
+            slot_switch_moved, param, free)) {
+        tapi_log_error("set property failed in %s", __func__);
+        free(param);
+        slot_switch_move_failed(sw, -EINVAL);
+    }
+}
+
+static int slot_switch_context_changed(DBusConnection* connection, DBusMessage* message,
+    void* user_data)
+{
+    data_slot_switch* sw = user_data;
+    DBusMessageIter iter, dict;
+    const char* path;
+    bool internet;
+    bool active;
+    int slot_id;
+
+    if (sw == NULL) {
+        tapi_log_error("switch in %s is null", __func__);
+        return 0;
+    }
+
+    if (sw->phase == SLOT_SWITCH_DONE)
+        return 1;
+
+    if (!dbus_message_iter_init(message, &iter)
+        || dbus_message_iter_get_arg_type(&iter) != DBUS_TYPE_OBJECT_PATH) {
+        tapi_log_error("message invalid in %s", __func__);
+        return 0;
+    }
+
+    dbus_message_iter_get_basic(&iter, &path);
+    dbus_message_iter_next(&iter);
+    if (dbus_message_iter_get_arg_type(&iter) != DBUS_TYPE_ARRAY) {
+        tapi_log_error("message invalid in %s", __func__);
+        return 0;
+    }
+
+    dbus_message_iter_recurse(&iter, &dict);
+    active = slot_switch_internet_active(&dict, &internet);
+    if (!internet)
+        return 1;
+
+    slot_id = tapi_utils_get_slot_id(dbus_message_get_path(message));
+
+    if (slot_id == sw->result.from_slot)
+        slot_switch_track(sw, &sw->from_up, active);
+    else if (slot_id == sw->result.to_slot)
+        slot_switch_target_changed(sw, active);
+
+    return 1;
+}
+
+static void slot_switch_allowed(const DBusError* error, void* user_data)
+{
+    data_slot_switch* sw = slot_switch_lookup(user_data);
+
+    if (sw == NULL || sw->phase != SLOT_SWITCH_PARALLEL)
+        return;
+
+    /* a modem without dual active data refuses a second allowed slot */
+    if (dbus_error_is_set(error)) {
+        tapi_log_error("%s: %s", error->name, error->message);
+        slot_switch_sequential(sw);
+        return;
+    }
+
+    slot_switch_load_contexts(sw);
+}
+
+static void slot_switch_expired(uv_timer_t* handle)
+{
+    data_slot_switch* sw = handle->data;
+
+    /* the target did not come up next to the old slot, it stays allowed for the move */
+    if (sw->phase == SLOT_SWITCH_PARALLEL && !sw->moving) {
+        slot_switch_sequential(sw);
+        return;
+    }
+
+    tapi_log_error("slot %d did not activate data in %s", sw->result.to_slot, __func__);
+    slot_switch_complete(sw, -ETIMEDOUT);
+}
+
+static void slot_switch_sequential(data_slot_switch* sw)
+{
+    if (sw->phase != SLOT_SWITCH_PARALLEL || sw->moving)
+        return;
+
+    sw->phase = SLOT_SWITCH_SEQUENTIAL;
+    uv_timer_start(&sw->timer, slot_switch_expired, CONFIG_TELEPHONY_DATA_SLOT_SWITCH_TIMEOUT, 0);
+
+    if (tapi_is_valid_slotid(sw->result.from_slot))
+        slot_switch_set_allowed(sw, sw->result.from_slot, false, NULL);
+
+    slot_switch_move(sw);
+}
+
+static int slot_switch_add_watch(data_slot_switch* sw, int slot_id)
+{
+    const char* modem_path = tapi_utils_get_modem_path(slot_id);
+
+    if (!tapi_is_valid_slotid(slot_id) || modem_path == NULL)
+        return 0;
+
+    return g_dbus_add_signal_watch(sw->ctx->connection, OFONO_SERVICE, modem_path,
+        OFONO_CONNECTION_MANAGER_INTERFACE, "ContextChanged",
+        slot_switch_context_changed, sw, NULL);
+}
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+void data_slot_switch_release(dbus_context* ctx)
+{
+    if (ctx->slot_switch != NULL)
+        slot_switch_free(ctx->slot_switch);
+}
+
+int tapi_data_switch_default_slot(tapi_context context, int slot_id, int event_id,
+    tapi_async_function p_handle)
+{
+    dbus_context* ctx = context;
+    data_slot_switch* sw;
+    int from_slot = -1;
+
+    if (ctx == NULL) {
+        tapi_log_error("context in %s is null", __func__);
+        return -EINVAL;
+    }
+
+    if (!tapi_is_valid_slotid(slot_id)) {
+        tapi_log_error("invalid slot id in %s", __func__);
+        return -EINVAL;
+    }
+
+    if (!ctx->client_ready) {
+        tapi_log_error("dbus client is not ready in %s", __func__);
+        return -EAGAIN;
+    }
+
+    if (ctx->slot_switch != NULL) {
+        tapi_log_error("slot switch in progress in %s", __func__);
+        return -EBUSY;
+    }
+
+    if (ctx->dbus_proxy[slot_id][DBUS_PROXY_DATA] == NULL) {
+        tapi_log_error("no available proxy in %s", __func__);
+        return -EIO;
+    }
+
+    if (tapi_data_get_default_slot(ctx, &from_slot) != OK)
+        from_slot = -1;
+
+    sw = malloc(sizeof(data_slot_switch));
+    if (sw == NULL) {
+        tapi_log_error("switch in %s is null", __func__);
+        return -ENOMEM;
+    }
+
+    memset(sw, 0, sizeof(data_slot_switch));
+    sw->ctx = ctx;
+    sw->generation = ++g_switch_generation;
+    sw->event_id = event_id;
+    sw->cb = p_handle;
+    sw->phase = SLOT_SWITCH_PARALLEL;
+    sw->begin = slot_switch_now();
+    sw->from_up = tapi_is_valid_slotid(from_slot);
+    sw->gap_begin = sw->begin;
+    sw->result.from_slot = from_slot;
+    sw->result.to_slot = slot_id;
+
+    sw->watches[0] = slot_switch_add_watch(sw, from_slot);
+    sw->watches[1] = slot_switch_add_watch(sw, slot_id);
+    if (sw->watches[1] == 0) {
+        tapi_log_error("add signal watch failed in %s", __func__);
+        if (sw->watches[0] != 0)
+            g_dbus_remove_watch(ctx->connection, sw->watches[0]);
+        free(sw);
+        return -EINVAL;
+    }
+
+    uv_timer_init(uv_default_loop(), &sw->timer);
+    sw->timer.data = sw;
+    ctx->slot_switch = sw;
+
+    if (from_slot == slot_id) {
+        slot_switch_complete(sw, OK);
+        return OK;
+    }
+
+    /* without an old slot there is nothing to overlap with */
+    if (!tapi_is_valid_slotid(from_slot)) {
+        slot_switch_sequential(sw);
+        return OK;
+    }
+
+    uv_timer_start(&sw->timer, slot_switch_expired, CONFIG_TELEPHONY_DATA_SLOT_SWITCH_TIMEOUT, 0);
+    slot_switch_set_allowed(sw, slot_id, true, slot_switch_allowed);
+    return OK;
+}
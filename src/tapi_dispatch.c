@@ -0,0 +1,371 @@
+/*
+ * Copyright (C) 2023 Xiaomi Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <string.h>
+#include <uv.h>
+
+#include "tapi.h"
+#include "tapi_internal.h"
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+
+/* Low lane indications delivered per loop iteration */
+#define DISPATCH_LOW_LANE_BATCH 4
+
+/* Low lane indications kept at most, the oldest is dropped beyond it */
+#define DISPATCH_LOW_LANE_MAX 64
+
+#define NSEC_PER_USEC 1000ULL
+
+/****************************************************************************
+ * Private Type Declarations
+ ****************************************************************************/
+
+typedef struct {
+    struct list_node node;
+    DBusConnection* connection;
+    DBusMessage* message;
+    const char* property; /* first string argument of message, NULL if none */
+    GDBusSignalFunction function;
+    void* user_data;
+    uint64_t arrived; /* ns, uv_hrtime at handler entry, as for the high lane */
+} dispatch_item;
+
+/* A signal watch whose handler runs in the low lane */
+typedef struct {
+    struct list_node node;
+    DBusConnection* connection;
+    unsigned int watch_id;
+    void* user_data;
+    GDBusDestroyFunction destroy;
+} dispatch_watch;
+
+/****************************************************************************
+ * Private Data
+ ****************************************************************************/
+
+/* Signals are dispatched from the default loop, lanes are per process */
+static struct list_node g_low_lane = LIST_INITIAL_VALUE(g_low_lane);
+static struct list_node g_low_lane_watches = LIST_INITIAL_VALUE(g_low_lane_watches);
+static tapi_dispatch_lane_stats g_lane_stats[DISPATCH_LANE_COUNT];
+static uv_idle_t g_low_lane_idle;
+static bool g_low_lane_ready;
+static bool g_low_lane_draining;
+static int g_dispatch_connections;
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+
+static void dispatch_item_free(dispatch_item* item)
+{
+    list_delete(&item->node);
+    dbus_message_unref(item->message);
+    free(item);
+
+    g_lane_stats[DISPATCH_LANE_LOW].pending--;
+}
+
+static const char* dispatch_message_property(DBusMessage* message)
+{
+    DBusMessageIter iter;
+    const char* property;
+
+    if (!dbus_message_iter_init(message, &iter)
+        || dbus_message_iter_get_arg_type(&iter) != DBUS_TYPE_STRING)
+        return NULL;
+
+    dbus_message_iter_get_basic(&iter, &property);
+    return property;
+}
+
+/* A pending indication of the same handler and property is superseded */
+static dispatch_item* dispatch_find_pending(GDBusSignalFunction function, void* user_data,
+    const char* property)
+{
+    dispatch_item* item;
+
+    list_for_every_entry(&g_low_lane, item, dispatch_item, node)
+    {
+        if (item->function != function || item->user_data != user_data)
+            continue;
+
+        if (item->property == property
+            || (item->property != NULL && property != NULL
+                && strcmp(item->property, property) == 0))
+            return item;
+    }
+
+    return NULL;
+}
+
+/* A handler returning false gives up its watch, as it would outside the lane */
+static void dispatch_remove_watch(DBusConnection* connection, void* user_data)
+{
+    dispatch_watch* watch;
+
+    list_for_every_entry(&g_low_lane_watches, watch, dispatch_watch, node)
+    {
+        if (watch->connection == connection && watch->user_data == user_data) {
+            g_dbus_remove_watch(connection, watch->watch_id);
+            return;
+        }
+    }
+}
+
+/* Queued indications of the watch go with it, then its own data */
+static void dispatch_watch_destroy(void* obj)
+{
+    GDBusDestroyFunction destroy = NULL;
+    dispatch_watch* watch;
+    dispatch_watch* next;
+    dispatch_item* item;
+    dispatch_item* tmp;
+
+    list_for_every_entry_safe(&g_low_lane, item, tmp, dispatch_item, node)
+    {
+        if (item->user_data == obj)
+            dispatch_item_free(item);
+    }
+
+    list_for_every_entry_safe(&g_low_lane_watches, watch, next, dispatch_watch, node)
+    {
+        if (watch->user_data == obj) {
+            destroy = watch->destroy;
+            list_delete(&watch->node);
+            free(watch);
+        }
+    }
+
+    if (destroy != NULL)
+        destroy(obj);
+}
+
+static void dispatch_low_lane_drain(uv_idle_t* handle)
+{
+    dispatch_item* item;
+    int budget = DISPATCH_LOW_LANE_BATCH;
+    int ret;
+
+    while (budget-- > 0 && !list_is_empty(&g_low_lane)) {
+        /* off the list first, the handler may unregister its own watch */
+        item = list_remove_head_type(&g_low_lane, dispatch_item, node);
+        list_initialize(&item->node);
+
+        /* the handler runs inline instead of queueing itself again */
+        g_low_lane_draining = true;
+        ret = item->function(item->connection, item->message, item->user_data);
+        g_low_lane_draining = false;
+
+        dispatch_lane_end(DISPATCH_LANE_LOW, item->arrived);
+        if (!ret)
+            dispatch_remove_watch(item->connection, item->user_data);
+
+        dispatch_item_free(item);
+    }
+
+    if (list_is_empty(&g_low_lane))
+        uv_idle_stop(handle);
+}
+
+static void dispatch_low_lane_closed(uv_handle_t* handle)
+{
+    g_low_lane_ready = false;
+}
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+bool dispatch_defer_signal(DBusConnection* connection, DBusMessage* message,
+    GDBusSignalFunction function, void* user_data)
+{
+    tapi_dispatch_lane_stats* stats = &g_lane_stats[DISPATCH_LANE_LOW];
+    const char* property;
+    dispatch_item* item;
+
+    if (g_low_lane_draining)
+        return false;
+
+    /* the lane is closing with the last context, deliver inline */
+    if (g_low_lane_ready && uv_is_closing((uv_handle_t*)&g_low_lane_idle))
+        return false;
+
+    /* only the latest state is worth delivering, the item keeps its place
+     * and the latency is that of the delivered signal */
+    property = dispatch_message_property(message);
+    item = dispatch_find_pending(function, user_data, property);
+    if (item != NULL) {
+        dbus_message_unref(item->message);
+        item->message = dbus_message_ref(message);
+        item->property = property;
+        item->arrived = dispatch_lane_begin();
+        stats->dropped++;
+        return true;
+    }
+
+    item = malloc(sizeof(dispatch_item));
+    if (item == NULL) {
+        tapi_log_error("item in %s is null", __func__);
+        return false;
+    }
+
+    if (!g_low_lane_ready) {
+        uv_idle_init(uv_default_loop(), &g_low_lane_idle);
+        g_low_lane_ready = true;
+    }
+
+    /* a storm of distinct indications loses the oldest, it is stale by now */
+    if (stats->pending >= DISPATCH_LOW_LANE_MAX) {
+        dispatch_item* oldest = list_remove_head_type(&g_low_lane, dispatch_item, node);
+
+        list_initialize(&oldest->node);
+        dispatch_item_free(oldest);
+        stats->dropped++;
+    }
+
+    item->connection = connection;
+    item->message = dbus_message_ref(message);
+    item->property = property;
+    item->function = function;
+    item->user_data = user_data;
+    item->arrived = dispatch_lane_begin();
+    list_add_tail(&g_low_lane, &item->node);
+
+    if (++stats->pending > stats->max_pending)
+        stats->max_pending = stats->pending;
+
+    uv_idle_start(&g_low_lane_idle, dispatch_low_lane_drain);
+    return true;
+}
+
+unsigned int dispatch_add_signal_watch(DBusConnection* connection, const char* path,
+    const char* interface, const char* member, GDBusSignalFunction function, void* user_data,
+    GDBusDestroyFunction destroy)
+{
+    dispatch_watch* watch;
+
+    watch = malloc(sizeof(dispatch_watch));
+    if (watch == NULL) {
+        tapi_log_error("watch in %s is null", __func__);
+        return 0;
+    }
+
+    /* listed first, the destroy of a failed watch looks it up */
+    watch->connection = connection;
+    watch->user_data = user_data;
+    watch->destroy = destroy;
+    list_add_tail(&g_low_lane_watches, &watch->node);
+
+    watch->watch_id = g_dbus_add_signal_watch(connection, OFONO_SERVICE, path, interface,
+        member, function, user_data, dispatch_watch_destroy);
+    if (watch->watch_id == 0) {
+        list_delete(&watch->node);
+        free(watch);
+        return 0;
+    }
+
+    return watch->watch_id;
+}
+
+void dispatch_add_connection(DBusConnection* connection)
+{
+    g_dispatch_connections++;
+}
+
+void dispatch_drop_connection(DBusConnection* connection)
+{
+    dispatch_item* item;
+    dispatch_item* tmp;
+
+    list_for_every_entry_safe(&g_low_lane, item, tmp, dispatch_item, node)
+    {
+        if (item->connection == connection)
+            dispatch_item_free(item);
+    }
+
+    if (g_low_lane_ready && list_is_empty(&g_low_lane))
+        uv_idle_stop(&g_low_lane_idle);
+
+    /* the last context takes the idle handle with it */
+    if (--g_dispatch_connections == 0 && g_low_lane_ready
+        && !uv_is_closing((uv_handle_t*)&g_low_lane_idle))
+        uv_close((uv_handle_t*)&g_low_lane_idle, dispatch_low_lane_closed);
+}
+
+/* Both lanes measure from handler entry, the arrival of the signal in the
+ * library; the low lane takes it before queueing the signal.
+ */
+uint64_t dispatch_lane_begin(void)
+{
+    return uv_hrtime();
+}
+
+void dispatch_lane_end(tapi_dispatch_lane lane, uint64_t begin)
+{
+    tapi_dispatch_lane_stats* stats = &g_lane_stats[lane];
+    u_int32_t latency = (uv_hrtime() - begin) / NSEC_PER_USEC;
+
+    stats->count++;
+    stats->total_latency += latency;
+    if (latency > stats->max_latency)
+        stats->max_latency = latency;
+}
+
+int tapi_get_dispatch_stats(tapi_context context, tapi_dispatch_lane lane,
+    tapi_dispatch_lane_stats* out)
+{
+    dbus_context* ctx = context;
+
+    if (ctx == NULL || out == NULL) {
+        tapi_log_error("invalid argument in %s", __func__);
+        return -EINVAL;
+    }
+
+    if (lane < DISPATCH_LANE_HIGH || lane >= DISPATCH_LANE_COUNT) {
+        tapi_log_error("invalid lane %d in %s", lane, __func__);
+        return -EINVAL;
+    }
+
+    memcpy(out, &g_lane_stats[lane], sizeof(tapi_dispatch_lane_stats));
+    return OK;
+}
+
+int tapi_reset_dispatch_stats(tapi_context context)
+{
+    dbus_context* ctx = context;
+
+    if (ctx == NULL) {
+        tapi_log_error("context is null in %s", __func__);
+        return -EINVAL;
+    }
+
+    for (int i = 0; i < DISPATCH_LANE_COUNT; i++) {
+        u_int32_t pending = g_lane_stats[i].pending;
+
+        memset(&g_lane_stats[i], 0, sizeof(tapi_dispatch_lane_stats));
+        g_lane_stats[i].pending = pending;
+        g_lane_stats[i].max_pending = pending;
+    }
+
+    return OK;
+}
@@ -0,0 +1,425 @@
+/*
+ * Copyright (C) 2023 Xiaomi Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <uv.h>
+
+#include "tapi.h"
+#include "tapi_internal.h"
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+
+#define DTMF_DEFAULT_ON_DURATION 100
+#define DTMF_DEFAULT_OFF_DURATION 100
+#define DTMF_DEFAULT_PAUSE_DURATION 2000
+#define DTMF_DEFAULT_WAIT_DURATION 5000
+
+#define DTMF_PAUSE_CHAR ','
+#define DTMF_WAIT_CHAR ';'
+
+#define NSEC_PER_USEC 1000ULL
+#define NSEC_PER_MSEC 1000000ULL
+
+/****************************************************************************
+ * Private Type Declarations
+ ****************************************************************************/
+
+struct dtmf_sequencer {
+    dbus_context* ctx; /* NULL once released with its context */
+    int slot_id;
+    int event_id;
+    tapi_async_function cb;
+    tapi_dtmf_sequence_config config;
+    char sequence[MAX_DTMF_SEQUENCE_LENGTH + 1];
+    int position;
+    bool tone_on;
+    bool finished;
+    int pending;
+    uint64_t start_time; /* ns, uv_hrtime */
+    uint64_t deadline; /* ns since start_time */
+    uv_timer_t timer;
+    tapi_dtmf_sequence_result result;
+};
+
+typedef struct {
+    dtmf_sequencer* sequencer;
+    int index;
+    unsigned char digit;
+    int flag;
+} dtmf_request;
+
+/****************************************************************************
+ * Private Function Prototypes
+ ****************************************************************************/
+
+static void dtmf_sequencer_step(uv_timer_t* handle);
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+
+static void dtmf_sequencer_close_done(uv_handle_t* handle)
+{
+    free(handle->data);
+}
+
+static void dtmf_sequencer_complete(dtmf_sequencer* sequencer)
+{
+    tapi_dtmf_sequence_result* result = &sequencer->result;
+    tapi_async_result ar;
+    int64_t jitter_sum = 0;
+    int played = 0;
+
+    if (!sequencer->finished || sequencer->pending > 0)
+        return;
+
+    memset(&ar, 0, sizeof(tapi_async_result));
+    ar.msg_id = sequencer->event_id;
+    ar.msg_type = RESPONSE;
+    ar.arg1 = sequencer->slot_id;
+    ar.status = result->cancelled ? ERROR : OK;
+
+    for (int i = 0; i < result->count; i++) {
+        tapi_dtmf_digit_result* digit = &result->digits[i];
+
+        if (digit->status == -EINPROGRESS)
+            digit->status = OK;
+
+        if (digit->status == OK)
+            played++;
+        else
+            ar.status = ERROR;
+
+        jitter_sum += digit->jitter;
+        if (digit->jitter > result->max_jitter)
+            result->max_jitter = digit->jitter;
+    }
+
+    if (result->count > 0)
+        result->mean_jitter = jitter_sum / result->count;
+
+    ar.arg2 = played;
+    ar.data = result;
+
+    if (sequencer->ctx != NULL
+        && sequencer->ctx->dtmf_sequencers[sequencer->slot_id] == sequencer)
+        sequencer->ctx->dtmf_sequencers[sequencer->slot_id] = NULL;
+
+    if (sequencer->cb != NULL)
+        sequencer->cb(&ar);
+
+    uv_close((uv_handle_t*)&sequencer->timer, dtmf_sequencer_close_done);
+}
+
+static void dtmf_request_append(DBusMessageIter* iter, void* user_data)
+{
+    dtmf_request* request = user_data;
+
+    if (request == NULL) {
+        tapi_log_error("request in %s is null", __func__);
+        return;
+    }
+
+    dbus_message_iter_append_basic(iter, DBUS_TYPE_BYTE, &request->digit);
+    dbus_message_iter_append_basic(iter, DBUS_TYPE_INT32, &request->flag);
+}
+
+static void dtmf_request_done(DBusMessage* message, void* user_data)
+{
+    dtmf_request* request = user_data;
+    dtmf_sequencer* sequencer;
+    tapi_dtmf_digit_result* digit;
+    DBusError err;
+
+    if (request == NULL) {
+        tapi_log_error("request in %s is null", __func__);
+        return;
+    }
+
+    sequencer = request->sequencer;
+    sequencer->pending--;
+
+    dbus_error_init(&err);
+    if (dbus_set_error_from_message(&err, message) == true) {
+        tapi_log_error("error from message in %s, %s: %s", __func__, err.name, err.message);
+        dbus_error_free(&err);
+
+        digit = &sequencer->result.digits[request->index];
+        if (digit->status == -EINPROGRESS)
+            digit->status = ERROR;
+    }
+
+    dtmf_sequencer_complete(sequencer);
+}
+
+static int dtmf_sequencer_send(dtmf_sequencer* sequencer, int index, int flag)
+{
+    dtmf_request* request;
+    GDBusProxy* proxy;
+
+    proxy = sequencer->ctx->dbus_proxy[sequencer->slot_id][DBUS_PROXY_CALL];
+    if (proxy == NULL) {
+        tapi_log_error("no available proxy in %s", __func__);
+        return -EIO;
+    }
+
+    request = malloc(sizeof(dtmf_request));
+    if (request == NULL) {
+        tapi_log_error("request in %s is null", __func__);
+        return -ENOMEM;
+    }
+
+    request->sequencer = sequencer;
+    request->index = index;
+    request->digit = flag == START_PLAY_DTMF ? sequencer->result.digits[index].digit : 0;
+    request->flag = flag;
+
+    /* pipelined, the next step is timed by the schedule and not by this reply */
+    if (!g_dbus_proxy_method_call(proxy, "PlayDtmf", dtmf_request_append,
+            dtmf_request_done, request, free)) {
+        tapi_log_error("dbus method call fail in %s", __func__);
+        free(request);
+        return -EINVAL;
+    }
+
+    sequencer->pending++;
+    return OK;
+}
+
+static void dtmf_sequencer_schedule(dtmf_sequencer* sequencer, uint64_t now)
+{
+    uint64_t delay = 0;
+
+    if (sequencer->deadline > now)
+        delay = (sequencer->deadline - now + NSEC_PER_MSEC - 1) / NSEC_PER_MSEC;
+
+    uv_timer_start(&sequencer->timer, dtmf_sequencer_step, delay, 0);
+}
+
+static void dtmf_sequencer_step(uv_timer_t* handle)
+{
+    dtmf_sequencer* sequencer = handle->data;
+    tapi_dtmf_digit_result* digit;
+    uint64_t now;
+    int index;
+    char c;
+
+    now = uv_hrtime() - sequencer->start_time;
+
+    if (sequencer->tone_on) {
+        sequencer->tone_on = false;
+        index = sequencer->result.count - 1;
+
+        if (dtmf_sequencer_send(sequencer, index, STOP_PLAY_DTMF) != OK)
+            sequencer->result.digits[index].status = ERROR;
+
+        sequencer->deadline += sequencer->config.off_duration * NSEC_PER_MSEC;
+        dtmf_sequencer_schedule(sequencer, now);
+        return;
+    }
+
+    c = sequencer->sequence[sequencer->position];
+    if (c == '\0') {
+        sequencer->finished = true;
+        dtmf_sequencer_complete(sequencer);
+        return;
+    }
+
+    sequencer->position++;
+
+    if (c == DTMF_PAUSE_CHAR || c == DTMF_WAIT_CHAR) {
+        sequencer->deadline += (c == DTMF_PAUSE_CHAR
+                                       ? sequencer->config.pause_duration
+                                       : sequencer->config.wait_duration)
+            * NSEC_PER_MSEC;
+        dtmf_sequencer_schedule(sequencer, now);
+        return;
+    }
+
+    index = sequencer->result.count++;
+    digit = &sequencer->result.digits[index];
+    digit->digit = c;
+    digit->status = -EINPROGRESS;
+    digit->jitter = now > sequencer->deadline
+        ? (now - sequencer->deadline) / NSEC_PER_USEC
+        : 0;
+
+    if (dtmf_sequencer_send(sequencer, index, START_PLAY_DTMF) == OK) {
+        sequencer->tone_on = true;
+        sequencer->deadline += sequencer->config.on_duration * NSEC_PER_MSEC;
+    } else {
+        digit->status = -EIO;
+        sequencer->deadline += (sequencer->config.on_duration
+                                   + sequencer->config.off_duration)
+            * NSEC_PER_MSEC;
+    }
+
+    dtmf_sequencer_schedule(sequencer, now);
+}
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+void dtmf_sequencer_release_all(dbus_context* ctx)
+{
+    for (int i = 0; i < CONFIG_MODEM_ACTIVE_COUNT; i++) {
+        dtmf_sequencer* sequencer = ctx->dtmf_sequencers[i];
+
+        if (sequencer == NULL)
+            continue;
+
+        uv_timer_stop(&sequencer->timer);
+        ctx->dtmf_sequencers[i] = NULL;
+
+        /* PlayDtmf replies in flight still point at it, the last one frees it */
+        sequencer->ctx = NULL;
+        sequencer->cb = NULL;
+        sequencer->finished = true;
+        dtmf_sequencer_complete(sequencer);
+    }
+}
+
+int tapi_call_play_dtmf_sequence(tapi_context context, int slot_id, const char* sequence,
+    const tapi_dtmf_sequence_config* config, int event_id, tapi_async_function p_handle)
+{
+    dbus_context* ctx = context;
+    dtmf_sequencer* sequencer;
+    int digits = 0;
+
+    if (ctx == NULL) {
+        tapi_log_error("context is null in %s", __func__);
+        return -EINVAL;
+    }
+
+    if (!tapi_is_valid_slotid(slot_id)) {
+        tapi_log_error("invalid slot id %d in %s", slot_id, __func__);
+        return -EINVAL;
+    }
+
+    if (sequence == NULL || strlen(sequence) > MAX_DTMF_SEQUENCE_LENGTH) {
+        tapi_log_error("sequence is invalid in %s", __func__);
+        return -EINVAL;
+    }
+
+    for (const char* p = sequence; *p != '\0'; p++) {
+        if (*p == DTMF_PAUSE_CHAR || *p == DTMF_WAIT_CHAR)
+            continue;
+
+        if (!is_valid_dtmf_digit(*p)) {
+            tapi_log_error("invalid digit %c in %s", *p, __func__);
+            return -EINVAL;
+        }
+
+        digits++;
+    }
+
+    if (digits == 0) {
+        tapi_log_error("no digit in %s", __func__);
+        return -EINVAL;
+    }
+
+    if (config != NULL && config->on_duration == 0) {
+        tapi_log_error("config is invalid in %s", __func__);
+        return -EINVAL;
+    }
+
+    if (ctx->dtmf_sequencers[slot_id] != NULL) {
+        tapi_log_error("sequence of slot %d is playing in %s", slot_id, __func__);
+        return -EBUSY;
+    }
+
+    if (ctx->dbus_proxy[slot_id][DBUS_PROXY_CALL] == NULL) {
+        tapi_log_error("no available proxy in %s", __func__);
+        return -EIO;
+    }
+
+    sequencer = malloc(sizeof(dtmf_sequencer));
+    if (sequencer == NULL) {
+        tapi_log_error("sequencer in %s is null", __func__);
+        return -ENOMEM;
+    }
+
+    memset(sequencer, 0, sizeof(dtmf_sequencer));
+    sequencer->ctx = ctx;
+    sequencer->slot_id = slot_id;
+    sequencer->event_id = event_id;
+    sequencer->cb = p_handle;
+    strcpy(sequencer->sequence, sequence);
+
+    if (config != NULL) {
+        sequencer->config = *config;
+    } else {
+        sequencer->config.on_duration = DTMF_DEFAULT_ON_DURATION;
+        sequencer->config.off_duration = DTMF_DEFAULT_OFF_DURATION;
+        sequencer->config.pause_duration = DTMF_DEFAULT_PAUSE_DURATION;
+        sequencer->config.wait_duration = DTMF_DEFAULT_WAIT_DURATION;
+    }
+
+    uv_timer_init(uv_default_loop(), &sequencer->timer);
+    sequencer->timer.data = sequencer;
+    sequencer->start_time = uv_hrtime();
+    ctx->dtmf_sequencers[slot_id] = sequencer;
+
+    uv_timer_start(&sequencer->timer, dtmf_sequencer_step, 0, 0);
+
+    return OK;
+}
+
+int tapi_call_cancel_dtmf_sequence(tapi_context context, int slot_id)
+{
+    dbus_context* ctx = context;
+    dtmf_sequencer* sequencer;
+    int index;
+
+    if (ctx == NULL) {
+        tapi_log_error("context is null in %s", __func__);
+        return -EINVAL;
+    }
+
+    if (!tapi_is_valid_slotid(slot_id)) {
+        tapi_log_error("invalid slot id %d in %s", slot_id, __func__);
+        return -EINVAL;
+    }
+
+    sequencer = ctx->dtmf_sequencers[slot_id];
+    if (sequencer == NULL || sequencer->finished) {
+        tapi_log_error("no sequence of slot %d in %s", slot_id, __func__);
+        return -EINVAL;
+    }
+
+    uv_timer_stop(&sequencer->timer);
+    sequencer->result.cancelled = true;
+    sequencer->finished = true;
+
+    if (sequencer->tone_on) {
+        sequencer->tone_on = false;
+        index = sequencer->result.count - 1;
+
+        if (dtmf_sequencer_send(sequencer, index, STOP_PLAY_DTMF) != OK)
+            sequencer->result.digits[index].status = ERROR;
+    }
+
+    dtmf_sequencer_complete(sequencer);
+    return OK;
+}
@@ -0,0 +1,461 @@
+/*
+ * Copyright (C) 2023 Xiaomi Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "tapi.h"
+#include "tapi_internal.h"
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+
+#define ECC_NUMBER_MAX_LENGTH 16
+
+/* digits 0-9 followed by '*', '#' and '+' */
+#define ECC_TRIE_FANOUT 13
+#define ECC_TRIE_INITIAL_NODES 32
+#define ECC_TRIE_NO_ENTRY -1
+
+/****************************************************************************
+ * Private Type Declarations
+ ****************************************************************************/
+
+typedef struct {
+    uint16_t child[ECC_TRIE_FANOUT]; /* 0 for none, the root is never a child */
+    int8_t entry; /* index in entries or ECC_TRIE_NO_ENTRY */
+    uint8_t count; /* numbers ending in this subtree */
+} ecc_trie_node;
+
+typedef struct {
+    dbus_context* ctx;
+    int slot_id;
+    bool dirty;
+    int call_watch;
+    int modem_watch;
+    int entry_count;
+    ecc_info entries[MAX_ECC_LIST_SIZE];
+    char numbers[MAX_ECC_LIST_SIZE][ECC_NUMBER_MAX_LENGTH + 1];
+    int node_count;
+    int node_capacity;
+    ecc_trie_node* nodes;
+} ecc_index_slot;
+
+struct ecc_number_index {
+    ecc_index_slot slots[CONFIG_MODEM_ACTIVE_COUNT];
+};
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+
+static int ecc_trie_symbol(char c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+
+    switch (c) {
+    case '*':
+        return 10;
+    case '#':
+        return 11;
+    case '+':
+        return 12;
+    default:
+        return -1;
+    }
+}
+
+static int ecc_trie_new_node(ecc_index_slot* slot)
+{
+    ecc_trie_node* nodes;
+    int capacity;
+
+    if (slot->node_count == slot->node_capacity) {
+        capacity = slot->node_capacity ? slot->node_capacity * 2 : ECC_TRIE_INITIAL_NODES;
+        if (capacity > UINT16_MAX)
+            return -ENOSPC;
+
+        nodes = realloc(slot->nodes, capacity * sizeof(ecc_trie_node));
+        if (nodes == NULL)
+            return -ENOMEM;
+
+        slot->nodes = nodes;
+        slot->node_capacity = capacity;
+    }
+
+    memset(&slot->nodes[slot->node_count], 0, sizeof(ecc_trie_node));
+    slot->nodes[slot->node_count].entry = ECC_TRIE_NO_ENTRY;
+
+    return slot->node_count++;
+}
+
+static int ecc_trie_insert(ecc_index_slot* slot, const char* number, int entry)
+{
+    int node = 0;
+    int symbol;
+    int next;
+
+    /* validate first so that a bad number leaves the counts untouched */
+    for (const char* p = number; *p != '\0'; p++) {
+        if (ecc_trie_symbol(*p) < 0)
+            return -EINVAL;
+    }
+
+    for (const char* p = number; *p != '\0'; p++) {
+        slot->nodes[node].count++;
+
+        symbol = ecc_trie_symbol(*p);
+        next = slot->nodes[node].child[symbol];
+        if (next == 0) {
+            next = ecc_trie_new_node(slot);
+            if (next < 0)
+                return next;
+
+            slot->nodes[node].child[symbol] = next;
+        }
+
+        node = next;
+    }
+
+    slot->nodes[node].count++;
+    if (slot->nodes[node].entry == ECC_TRIE_NO_ENTRY)
+        slot->nodes[node].entry = entry;
+
+    return OK;
+}
+
+static int ecc_trie_walk(const ecc_index_slot* slot, const char* number)
+{
+    int node = 0;
+    int symbol;
+
+    if (slot->node_count == 0)
+        return -1;
+
+    for (const char* p = number; *p != '\0'; p++) {
+        symbol = ecc_trie_symbol(*p);
+        if (symbol < 0)
+            return -1;
+
+        node = slot->nodes[node].child[symbol];
+        if (node == 0)
+            return -1;
+    }
+
+    return node;
+}
+
+static void ecc_parse_category_condition(const char* str, ecc_info* info)
+{
+    char* end;
+
+    /* "<category>,<condition>", left untouched as it is owned by D-Bus */
+    info->category = strtoul(str, &end, 10);
+    info->condition = *end == ',' ? strtoul(end + 1, NULL, 10) : 0;
+}
+
+static int ecc_index_rebuild(ecc_index_slot* slot)
+{
+    DBusMessageIter list, array;
+    GDBusProxy* proxy;
+    const char* number;
+    const char* str;
+    ecc_info* info;
+    int ret;
+
+    slot->entry_count = 0;
+    slot->node_count = 0;
+
+    proxy = slot->ctx->dbus_proxy[slot->slot_id][DBUS_PROXY_CALL];
+    if (proxy == NULL || !g_dbus_proxy_get_property(proxy, "EmergencyNumbers", &list)) {
+        proxy = slot->ctx->dbus_proxy[slot->slot_id][DBUS_PROXY_MODEM];
+        if (proxy == NULL || !g_dbus_proxy_get_property(proxy, "EmergencyNumbers", &list)) {
+            tapi_log_error("no EmergencyNumbers of slot %d in %s", slot->slot_id, __func__);
+            return -EIO;
+        }
+    }
+
+    if (dbus_message_iter_get_arg_type(&list) != DBUS_TYPE_ARRAY)
+        return -EINVAL;
+
+    ret = ecc_trie_new_node(slot);
+    if (ret < 0)
+        return ret;
+
+    dbus_message_iter_recurse(&list, &array);
+
+    while (dbus_message_iter_get_arg_type(&array) == DBUS_TYPE_STRING
+        && slot->entry_count < MAX_ECC_LIST_SIZE) {
+        dbus_message_iter_get_basic(&array, &number);
+        dbus_message_iter_next(&array);
+
+        info = &slot->entries[slot->entry_count];
+        info->category = 0;
+        info->condition = 0;
+        if (dbus_message_iter_get_arg_type(&array) == DBUS_TYPE_STRING) {
+            dbus_message_iter_get_basic(&array, &str);
+            ecc_parse_category_condition(str, info);
+            dbus_message_iter_next(&array);
+        }
+
+        if (strlen(number) == 0 || strlen(number) > ECC_NUMBER_MAX_LENGTH) {
+            tapi_log_error("ecc number %s is skipped in %s", number, __func__);
+            continue;
+        }
+
+        /* keep the first occurrence, as the linear search used to */
+        ret = ecc_trie_walk(slot, number);
+        if (ret >= 0 && slot->nodes[ret].entry != ECC_TRIE_NO_ENTRY)
+            continue;
+
+        strcpy(slot->numbers[slot->entry_count], number);
+        info->ecc_num = slot->numbers[slot->entry_count];
+
+        ret = ecc_trie_insert(slot, info->ecc_num, slot->entry_count);
+        if (ret == -EINVAL) {
+            tapi_log_error("ecc number %s is skipped in %s", number, __func__);
+            continue;
+        } else if (ret < 0) {
+            return ret;
+        }
+
+        slot->entry_count++;
+    }
+
+    slot->dirty = false;
+    tapi_log_debug("ecc index of slot %d rebuilt, count: %d, nodes: %d",
+        slot->slot_id, slot->entry_count, slot->node_count);
+
+    return OK;
+}
+
+static int ecc_index_prepare(dbus_context* ctx, int slot_id, ecc_index_slot** out)
+{
+    ecc_index_slot* slot;
+    int ret;
+
+    if (ctx->ecc_index == NULL)
+        return -EIO;
+
+    if (!ctx->client_ready) {
+        tapi_log_error("client is not ready in %s", __func__);
+        return -EAGAIN;
+    }
+
+    slot = &ctx->ecc_index->slots[slot_id];
+    if (slot->dirty) {
+        ret = ecc_index_rebuild(slot);
+        if (ret < 0) {
+            slot->entry_count = 0;
+            slot->node_count = 0;
+            return ret;
+        }
+    }
+
+    *out = slot;
+    return OK;
+}
+
+static int ecc_list_changed(DBusConnection* connection, DBusMessage* message, void* user_data)
+{
+    ecc_index_slot* slot = user_data;
+    DBusMessageIter iter;
+    const char* key;
+
+    if (slot == NULL) {
+        tapi_log_error("slot in %s is null", __func__);
+        return 0;
+    }
+
+    if (dbus_message_iter_init(message, &iter) == false
+        || dbus_message_iter_get_arg_type(&iter) != DBUS_TYPE_STRING) {
+        tapi_log_error("message iter init failed in %s", __func__);
+        return 0;
+    }
+
+    dbus_message_iter_get_basic(&iter, &key);
+    if (strcmp(key, "EmergencyNumbers") == 0) {
+        /* rebuilt on next lookup, once the proxy has cached the new value */
+        slot->dirty = true;
+    }
+
+    return 1;
+}
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+int ecc_index_init(dbus_context* ctx)
+{
+    const char* modem_path;
+    ecc_number_index* index;
+
+    index = malloc(sizeof(ecc_number_index));
+    if (index == NULL) {
+        tapi_log_error("index in %s is null", __func__);
+        return -ENOMEM;
+    }
+
+    memset(index, 0, sizeof(ecc_number_index));
+    ctx->ecc_index = index;
+
+    for (int i = 0; i < CONFIG_MODEM_ACTIVE_COUNT; i++) {
+        ecc_index_slot* slot = &index->slots[i];
+
+        slot->ctx = ctx;
+        slot->slot_id = i;
+        slot->dirty = true;
+
+        modem_path = tapi_utils_get_modem_path(i);
+        if (modem_path == NULL)
+            continue;
+
+        slot->call_watch = g_dbus_add_signal_watch(ctx->connection, OFONO_SERVICE,
+            modem_path, OFONO_VOICECALL_MANAGER_INTERFACE, "PropertyChanged",
+            ecc_list_changed, slot, NULL);
+        slot->modem_watch = g_dbus_add_signal_watch(ctx->connection, OFONO_SERVICE,
+            modem_path, OFONO_MODEM_INTERFACE, "PropertyChanged",
+            ecc_list_changed, slot, NULL);
+        if (slot->call_watch == 0 || slot->modem_watch == 0) {
+            tapi_log_error("add signal watch failed in %s", __func__);
+            ecc_index_release(ctx);
+            return -EINVAL;
+        }
+    }
+
+    return OK;
+}
+
+void ecc_index_invalidate(dbus_context* ctx, int slot_id)
+{
+    if (ctx->ecc_index == NULL || !tapi_is_valid_slotid(slot_id))
+        return;
+
+    ctx->ecc_index->slots[slot_id].dirty = true;
+}
+
+void ecc_index_release(dbus_context* ctx)
+{
+    ecc_number_index* index = ctx->ecc_index;
+
+    if (index == NULL)
+        return;
+
+    for (int i = 0; i < CONFIG_MODEM_ACTIVE_COUNT; i++) {
+        ecc_index_slot* slot = &index->slots[i];
+
+        if (slot->call_watch != 0)
+            g_dbus_remove_watch(ctx->connection, slot->call_watch);
+        if (slot->modem_watch != 0)
+            g_dbus_remove_watch(ctx->connection, slot->modem_watch);
+
+        free(slot->nodes);
+    }
+
+    free(index);
+    ctx->ecc_index = NULL;
+}
+
+int tapi_call_match_emergency_number(tapi_context context, int slot_id,
+    const char* number, ecc_info* out)
+{
+    dbus_context* ctx = context;
+    ecc_index_slot* slot;
+    int node;
+    int ret;
+
+    if (ctx == NULL) {
+        tapi_log_error("context is null in %s", __func__);
+        return -EINVAL;
+    }
+
+    if (!tapi_is_valid_slotid(slot_id)) {
+        tapi_log_error("invalid slot id %d in %s", slot_id, __func__);
+        return -EINVAL;
+    }
+
+    if (number == NULL) {
+        tapi_log_error("number is null in %s", __func__);
+        return -EINVAL;
+    }
+
+    ret = ecc_index_prepare(ctx, slot_id, &slot);
+    if (ret < 0)
+        return ret;
+
+    node = ecc_trie_walk(slot, number);
+    if (node < 0) {
+        tapi_number_key key;
+        char digits[ECC_NUMBER_MAX_LENGTH + 1];
+
+        /* retry without separators, e.g. "1 1 2" */
+        if (tapi_utils_number_key_from_string(number, NULL, &key) != OK
+            || !(key.flags & NUMBER_KEY_SHORT)
+            || tapi_utils_number_key_to_string(&key, digits, sizeof(digits)) < 0)
+            return 0;
+
+        node = ecc_trie_walk(slot, digits);
+    }
+
+    if (node < 0 || slot->nodes[node].entry == ECC_TRIE_NO_ENTRY)
+        return 0;
+
+    if (out != NULL)
+        *out = slot->entries[(int)slot->nodes[node].entry];
+
+    return 1;
+}
+
+int tapi_call_match_emergency_prefix(tapi_context context, int slot_id, const char* prefix)
+{
+    dbus_context* ctx = context;
+    ecc_index_slot* slot;
+    int node;
+    int ret;
+
+    if (ctx == NULL) {
+        tapi_log_error("context is null in %s", __func__);
+        return -EINVAL;
+    }
+
+    if (!tapi_is_valid_slotid(slot_id)) {
+        tapi_log_error("invalid slot id %d in %s", slot_id, __func__);
+        return -EINVAL;
+    }
+
+    if (prefix == NULL) {
+        tapi_log_error("prefix is null in %s", __func__);
+        return -EINVAL;
+    }
+
+    ret = ecc_index_prepare(ctx, slot_id, &slot);
+    if (ret < 0)
+        return ret;
+
+    node = ecc_trie_walk(slot, prefix);
+    if (node < 0)
+        return 0;
+
+    return slot->nodes[node].count;
+}
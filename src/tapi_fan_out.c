@@ -0,0 +1,254 @@
+/*
+ * Copyright (C) 2023 Xiaomi Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <uv.h>
+
+#include "tapi.h"
+#include "tapi_internal.h"
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+
+/* Slot requests are tagged with private event ids so that replies can be
+ * routed back to their fan-out, the callbacks carry no user data.
+ */
+#define FAN_OUT_TOKEN_BASE 0x7F000000
+#define FAN_OUT_TOKEN_MASK 0x00FFFFFF
+
+/****************************************************************************
+ * Private Type Declarations
+ ****************************************************************************/
+
+typedef struct {
+    struct list_node node;
+    dbus_context* ctx;
+    int token;
+    int event_id;
+    int pending;
+    tapi_fan_out_dup_function dup;
+    tapi_async_function cb;
+    uv_timer_t timer;
+    tapi_fan_out_slot_result results[CONFIG_MODEM_ACTIVE_COUNT];
+} fan_out_request;
+
+/****************************************************************************
+ * Private Data
+ ****************************************************************************/
+
+static struct list_node g_fan_out_list = LIST_INITIAL_VALUE(g_fan_out_list);
+static int g_fan_out_token;
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+
+static fan_out_request* fan_out_find(int token)
+{
+    fan_out_request* request;
+
+    list_for_every_entry(&g_fan_out_list, request, fan_out_request, node)
+    {
+        if (request->token == token)
+            return request;
+    }
+
+    return NULL;
+}
+
+static void fan_out_close_done(uv_handle_t* handle)
+{
+    free(handle->data);
+}
+
+static void fan_out_release(fan_out_request* request)
+{
+    for (int i = 0; i < CONFIG_MODEM_ACTIVE_COUNT; i++) {
+        if (request->results[i].data != NULL)
+            free(request->results[i].data);
+    }
+
+    uv_timer_stop(&request->timer);
+    uv_close((uv_handle_t*)&request->timer, fan_out_close_done);
+}
+
+static void fan_out_complete(fan_out_request* request)
+{
+    tapi_async_result ar;
+
+    list_delete(&request->node);
+
+    memset(&ar, 0, sizeof(tapi_async_result));
+    ar.msg_id = request->event_id;
+    ar.msg_type = RESPONSE;
+    ar.status = OK;
+    ar.arg1 = -1;
+    ar.arg2 = CONFIG_MODEM_ACTIVE_COUNT;
+    ar.data = request->results;
+
+    for (int i = 0; i < CONFIG_MODEM_ACTIVE_COUNT; i++) {
+        if (request->results[i].status != OK) {
+            ar.status = ERROR;
+            break;
+        }
+    }
+
+    if (request->cb != NULL)
+        request->cb(&ar);
+
+    fan_out_release(request);
+}
+
+static void fan_out_slot_done(tapi_async_result* result)
+{
+    tapi_fan_out_slot_result* slot_result;
+    fan_out_request* request;
+
+    request = fan_out_find(result->msg_id);
+    if (request == NULL) {
+        /* completed by deadline or cancelled, drop the late reply */
+        tapi_log_debug("late reply %d in %s", result->msg_id, __func__);
+        return;
+    }
+
+    if (!tapi_is_valid_slotid(result->arg1)) {
+        tapi_log_error("slot_id in %s is invalid", __func__);
+        return;
+    }
+
+    slot_result = &request->results[result->arg1];
+    if (slot_result->status != -EINPROGRESS)
+        return;
+
+    slot_result->status = result->status;
+    slot_result->arg2 = result->arg2;
+    if (result->status == OK && request->dup != NULL)
+        slot_result->data = request->dup(result);
+
+    if (--request->pending == 0)
+        fan_out_complete(request);
+}
+
+static void fan_out_deadline(uv_timer_t* handle)
+{
+    fan_out_request* request = handle->data;
+
+    for (int i = 0; i < CONFIG_MODEM_ACTIVE_COUNT; i++) {
+        if (request->results[i].status == -EINPROGRESS)
+            request->results[i].status = -ETIMEDOUT;
+    }
+
+    tapi_log_error("fan-out %d reached deadline in %s", request->event_id, __func__);
+    fan_out_complete(request);
+}
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+void fan_out_cancel_all(dbus_context* ctx)
+{
+    fan_out_request* request;
+    fan_out_request* tmp;
+
+    list_for_every_entry_safe(&g_fan_out_list, request, tmp, fan_out_request, node)
+    {
+        if (request->ctx != ctx)
+            continue;
+
+        list_delete(&request->node);
+        fan_out_release(request);
+    }
+}
+
+int tapi_fan_out(tapi_context context, int event_id, tapi_slot_request_function request_fn,
+    tapi_fan_out_dup_function dup, u_int32_t timeout_ms, tapi_async_function p_handle)
+{
+    dbus_context* ctx = context;
+    fan_out_request* request;
+    int first_error = OK;
+    int issued = 0;
+    int ret;
+
+    if (ctx == NULL || request_fn == NULL) {
+        tapi_log_error("invalid argument in %s", __func__);
+        return -EINVAL;
+    }
+
+    request = malloc(sizeof(fan_out_request));
+    if (request == NULL) {
+        tapi_log_error("request in %s is null", __func__);
+        return -ENOMEM;
+    }
+
+    memset(request, 0, sizeof(fan_out_request));
+    request->ctx = ctx;
+    request->token = FAN_OUT_TOKEN_BASE | (g_fan_out_token++ & FAN_OUT_TOKEN_MASK);
+    request->event_id = event_id;
+    request->dup = dup;
+    request->cb = p_handle;
+
+    uv_timer_init(uv_default_loop(), &request->timer);
+    request->timer.data = request;
+
+    /* hold one extra reference while issuing, so that a reply delivered
+     * before the loop finishes cannot complete the fan-out early.
+     */
+    request->pending = CONFIG_MODEM_ACTIVE_COUNT + 1;
+    list_add_tail(&g_fan_out_list, &request->node);
+
+    for (int i = 0; i < CONFIG_MODEM_ACTIVE_COUNT; i++) {
+        request->results[i].slot_id = i;
+        request->results[i].status = -EINPROGRESS;
+    }
+
+    for (int i = 0; i < CONFIG_MODEM_ACTIVE_COUNT; i++) {
+        ret = request_fn(ctx, i, request->token, fan_out_slot_done);
+        if (ret == OK) {
+            issued++;
+            continue;
+        }
+
+        tapi_log_error("slot %d request failed in %s, ret: %d", i, __func__, ret);
+        if (first_error == OK)
+            first_error = ret;
+
+        request->results[i].status = ret;
+        request->pending--;
+    }
+
+    if (issued == 0) {
+        list_delete(&request->node);
+        fan_out_release(request);
+        return first_error;
+    }
+
+    if (--request->pending == 0) {
+        fan_out_complete(request);
+        return OK;
+    }
+
+    if (timeout_ms > 0)
+        uv_timer_start(&request->timer, fan_out_deadline, timeout_ms, 0);
+
+    return OK;
+}
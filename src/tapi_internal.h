@@ -46,6 +46,9 @@
 #define MAX_VOICE_CALL_PROXY_COUNT 99
 #define SLOT_NOT_SET "SLOT_NOT_SET"
 
+#define START_PLAY_DTMF 1
+#define STOP_PLAY_DTMF 2
+
 /****************************************************************************
  * Public Types
  ****************************************************************************/
@@ -70,6 +73,21 @@ enum dbus_proxy_type {
     DBUS_PROXY_MAX_COUNT,
 };
 
+typedef struct cell_history cell_history;
+typedef struct cell_rate_controller cell_rate_controller;
+typedef struct signal_stats signal_stats;
+typedef struct call_list_mirror call_list_mirror;
+typedef struct ecc_number_index ecc_number_index;
+typedef struct dtmf_sequencer dtmf_sequencer;
+typedef struct call_kpi_tracker call_kpi_tracker;
+typedef struct number_cache number_cache;
+typedef struct call_history call_history;
+typedef struct apn_cache apn_cache;
+typedef struct data_monitor data_monitor;
+typedef struct network_arbiter network_arbiter;
+typedef struct data_prewarm data_prewarm;
+typedef struct data_slot_switch data_slot_switch;
+
 typedef struct {
     char name[MAX_CONTEXT_NAME_LENGTH + 1];
     DBusConnection* connection;
@@ -80,6 +98,24 @@ typedef struct {
     tapi_modem_state modem_state[CONFIG_MODEM_ACTIVE_COUNT];
     bool client_ready;
     tapi_async_function logging_over_miwear_cb;
+    cell_history* cell_histories[CONFIG_MODEM_ACTIVE_COUNT];
+    cell_rate_controller* cell_rate_controllers[CONFIG_MODEM_ACTIVE_COUNT];
+    struct list_node cell_diff_list;
+    signal_stats* slot_signal_stats[CONFIG_MODEM_ACTIVE_COUNT];
+    call_list_mirror* call_mirror;
+    ecc_number_index* ecc_index;
+    dtmf_sequencer* dtmf_sequencers[CONFIG_MODEM_ACTIVE_COUNT];
+    call_kpi_tracker* call_kpi;
+    number_cache* number_cache;
+    u_int32_t call_coalesce_window[CONFIG_MODEM_ACTIVE_COUNT];
+    struct list_node call_coalesce_list;
+    call_history* call_history;
+    apn_cache* apn_cache;
+    data_monitor* data_monitors[CONFIG_MODEM_ACTIVE_COUNT];
+    network_arbiter* network_arbiters[CONFIG_MODEM_ACTIVE_COUNT];
+    data_prewarm* data_prewarm;
+    data_slot_switch* slot_switch;
+    bool screen_on;
 } dbus_context;
 
 typedef struct {
@@ -109,6 +145,74 @@ bool is_interface_supported(const char* interface);
 int get_modem_id_by_proxy(dbus_context* context, GDBusProxy* proxy);
 int get_op_code_base_mcc_mnc(const char* mcc, const char* mnc);
 void get_covered_plmn(const char* mcc, const char* mnc, char* covered_plmn);
+void fill_cell_identity_list(DBusMessageIter* iter, tapi_cell_identity* cell);
+void cell_history_release_all(dbus_context* ctx);
+void cell_rate_release_all(dbus_context* ctx);
+void cell_rate_screen_changed(dbus_context* ctx);
+void cell_diff_detach_all(dbus_context* ctx);
+void signal_stats_release_all(dbus_context* ctx);
+void fan_out_cancel_all(dbus_context* ctx);
+int decode_voice_call_info(DBusMessageIter* iter, tapi_call_info* call_info);
+void apply_voice_call_property(tapi_call_info* call_info, const char* key,
+    DBusMessageIter* value);
+int call_list_mirror_attach(dbus_context* ctx);
+void call_list_mirror_sync(dbus_context* ctx, int slot_id);
+void call_list_mirror_retry(dbus_context* ctx, int slot_id);
+void call_list_mirror_release(dbus_context* ctx);
+const tapi_call_info* call_list_mirror_get(dbus_context* ctx, int slot_id, int* count);
+int call_list_mirror_post(dbus_context* ctx, int slot_id, int event_id,
+    tapi_async_function p_handle);
+int ecc_index_init(dbus_context* ctx);
+void ecc_index_invalidate(dbus_context* ctx, int slot_id);
+void ecc_index_release(dbus_context* ctx);
+bool is_valid_dtmf_digit(char c);
+void dtmf_sequencer_release_all(dbus_context* ctx);
+int call_kpi_init(dbus_context* ctx);
+void call_kpi_release(dbus_context* ctx);
+void call_kpi_dial_sent(dbus_context* ctx, int slot_id);
+void call_kpi_dial_replied(dbus_context* ctx, int slot_id, const char* call_id);
+void call_kpi_update(dbus_context* ctx, int slot_id, const tapi_call_info* call_info);
+void call_kpi_remove(dbus_context* ctx, int slot_id, const char* call_id);
+void call_kpi_drop_calls(dbus_context* ctx, int slot_id);
+void number_cache_release(dbus_context* ctx);
+bool dispatch_defer_signal(DBusConnection* connection, DBusMessage* message,
+    GDBusSignalFunction function, void* user_data);
+unsigned int dispatch_add_signal_watch(DBusConnection* connection, const char* path,
+    const char* interface, const char* member, GDBusSignalFunction function, void* user_data,
+    GDBusDestroyFunction destroy);
+void dispatch_add_connection(DBusConnection* connection);
+void dispatch_drop_connection(DBusConnection* connection);
+uint64_t dispatch_lane_begin(void);
+void dispatch_lane_end(tapi_dispatch_lane lane, uint64_t begin);
+int call_coalesce_register(dbus_context* ctx, int slot_id, tapi_indication_msg msg,
+    void* user_obj, tapi_async_function p_handle);
+void call_coalesce_detach_all(dbus_context* ctx);
+void call_history_update(dbus_context* ctx, int slot_id, const tapi_call_info* call_info);
+void call_history_remove(dbus_context* ctx, int slot_id, const char* call_id);
+void call_history_drop_calls(dbus_context* ctx, int slot_id);
+void call_history_release(dbus_context* ctx);
+void update_data_context(const char* prop, DBusMessageIter* iter, tapi_data_context* dc);
+void update_data_contexts(DBusMessageIter* iter, tapi_data_context* dc);
+void apn_context_append(DBusMessageIter* iter, void* user_data);
+void apn_context_remove(DBusMessageIter* iter, void* user_data);
+void apn_context_edit(DBusMessageIter* iter, void* user_data);
+int apn_cache_init(dbus_context* ctx);
+void apn_cache_invalidate(dbus_context* ctx, int slot_id);
+int apn_cache_load(dbus_context* ctx, int slot_id, int event_id,
+    tapi_async_function p_handle, bool refresh);
+void apn_cache_release(dbus_context* ctx);
+void data_monitor_sync(dbus_context* ctx, int slot_id);
+void data_monitor_release_all(dbus_context* ctx);
+int network_request_acquire(dbus_context* ctx, int slot_id, tapi_data_context_type type,
+    int event_id, void* user_obj, tapi_async_function p_handle);
+int network_request_drop(dbus_context* ctx, int slot_id, tapi_data_context_type type);
+int network_request_count(dbus_context* ctx, int slot_id, tapi_data_context_type type);
+void network_request_sync(dbus_context* ctx, int slot_id);
+void network_request_release_all(dbus_context* ctx);
+void data_prewarm_sync(dbus_context* ctx, int slot_id);
+void data_prewarm_screen_changed(dbus_context* ctx);
+void data_prewarm_release(dbus_context* ctx);
+void data_slot_switch_release(dbus_context* ctx);
 
 /**
  * Power on or off modem.
@@ -666,6 +666,7 @@ static int modem_ecc_list_change(DBusConnection* connection,
     char* key = NULL;
     int index = 0;
     ecc_info ecc_list[MAX_ECC_LIST_SIZE] = { 0 };
+    uint64_t begin = dispatch_lane_begin();
 
     if (handler == NULL) {
         tapi_log_error("handler in %s is null", __func__);
@@ -728,6 +729,7 @@ static int modem_ecc_list_change(DBusConnection* connection,
         ar->data = ecc_list;
         ar->arg2 = index;
         cb(ar);
+        dispatch_lane_end(DISPATCH_LANE_HIGH, begin);
     }
 
     return true;
@@ -1018,6 +1020,9 @@ static void on_dbus_client_ready(GDBusClient* client, void* user_data)
     ctx = cbd->context;
     if (ctx != NULL) {
         ctx->client_ready = true;
+
+        for (int i = 0; i < CONFIG_MODEM_ACTIVE_COUNT; i++)
+            call_list_mirror_sync(ctx, i);
     }
 
     cb = cbd->callback;
@@ -1045,6 +1050,14 @@ static void on_modem_property_change(GDBusProxy* proxy, const char* name,
         tapi_log_info("%s - refresh dbus_proxy ", __func__);
         release_mutable_dbus_proxy(ctx);
         get_mutable_dbus_proxy(ctx);
+        call_list_mirror_sync(ctx, modem_id);
+        ecc_index_invalidate(ctx, modem_id);
+        apn_cache_invalidate(ctx, modem_id);
+        data_monitor_sync(ctx, modem_id);
+        network_request_sync(ctx, modem_id);
+        data_prewarm_sync(ctx, modem_id);
+    } else {
+        call_list_mirror_retry(ctx, modem_id);
     }
 
     ctx->modem_state[modem_id] = new_state;
@@ -1239,16 +1252,41 @@ tapi_context tapi_open(const char* client_name,
     ctx->client = client;
     ctx->client_ready = false;
     ctx->logging_over_miwear_cb = NULL;
+    ctx->screen_on = true;
+    list_initialize(&ctx->cell_diff_list);
+    list_initialize(&ctx->call_coalesce_list);
+    ctx->call_mirror = NULL;
+    ctx->ecc_index = NULL;
+    ctx->call_kpi = NULL;
+    ctx->number_cache = NULL;
+    ctx->call_history = NULL;
+    ctx->apn_cache = NULL;
+    ctx->data_prewarm = NULL;
+    ctx->slot_switch = NULL;
     snprintf(ctx->name, sizeof(ctx->name), "%s", client_name);
+    dispatch_add_connection(connection);
     get_persistent_dbus_proxy(ctx);
     get_mutable_dbus_proxy(ctx);
 
     for (int i = 0; i < CONFIG_MODEM_ACTIVE_COUNT; i++) {
         ctx->modem_state[i] = MODEM_STATE_POWER_OFF;
+        ctx->cell_histories[i] = NULL;
+        ctx->cell_rate_controllers[i] = NULL;
+        ctx->slot_signal_stats[i] = NULL;
+        ctx->dtmf_sequencers[i] = NULL;
+        ctx->call_coalesce_window[i] = 0;
+        ctx->data_monitors[i] = NULL;
+        ctx->network_arbiters[i] = NULL;
         g_dbus_proxy_set_property_watch(ctx->dbus_proxy[i][DBUS_PROXY_MODEM],
             on_modem_property_change, ctx);
     }
 
+    if (ecc_index_init(ctx) != OK)
+        tapi_log_error("ecc index init failed in %s", __func__);
+
+    if (apn_cache_init(ctx) != OK)
+        tapi_log_error("apn cache init failed in %s", __func__);
+
     tapi_enable_modem_abnormal_event(ctx, slot_id, enable, 0, module_mask, from_event_id, to_event_id, NULL);
 
     return ctx;
@@ -1277,6 +1315,24 @@ int tapi_close(tapi_context context)
         g_dbus_proxy_remove_property_watch(ctx->dbus_proxy[i][DBUS_PROXY_MODEM], NULL);
     }
 
+    cell_history_release_all(ctx);
+    cell_rate_release_all(ctx);
+    cell_diff_detach_all(ctx);
+    signal_stats_release_all(ctx);
+    fan_out_cancel_all(ctx);
+    call_list_mirror_release(ctx);
+    call_kpi_release(ctx);
+    call_history_release(ctx);
+    number_cache_release(ctx);
+    ecc_index_release(ctx);
+    apn_cache_release(ctx);
+    data_monitor_release_all(ctx);
+    data_slot_switch_release(ctx);
+    data_prewarm_release(ctx);
+    network_request_release_all(ctx);
+    dtmf_sequencer_release_all(ctx);
+    call_coalesce_detach_all(ctx);
+    dispatch_drop_connection(ctx->connection);
     release_persistent_dbus_proxy(ctx);
     release_mutable_dbus_proxy(ctx);
     g_dbus_client_unref(ctx->client);
@@ -1287,6 +1343,24 @@ int tapi_close(tapi_context context)
     return OK;
 }
 
+int tapi_set_screen_state(tapi_context context, bool screen_on)
+{
+    dbus_context* ctx = context;
+
+    if (ctx == NULL) {
+        tapi_log_error("context in %s is null", __func__);
+        return -EINVAL;
+    }
+
+    if (ctx->screen_on == screen_on)
+        return OK;
+
+    ctx->screen_on = screen_on;
+    cell_rate_screen_changed(ctx);
+    data_prewarm_screen_changed(ctx);
+    return OK;
+}
+
 int tapi_query_modem_list(tapi_context context, int event_id, tapi_async_function p_handle)
 {
     dbus_context* ctx = context;
@@ -2303,6 +2377,9 @@ int tapi_data_log_ind(DBusConnection* connection, DBusMessage* message, void* us
     DBusMessageIter iter;
     char* out_data;
 
+    if (dispatch_defer_signal(connection, message, tapi_data_log_ind, user_data))
+        return 1;
+
     if (handler == NULL) {
         tapi_log_error("handler in %s is null", __func__);
         return 0;
@@ -2374,9 +2451,8 @@ static int tapi_manager_register_data_loging(tapi_context context,
     ar->arg1 = slot_id;
     ar->user_obj = user_obj;
 
-    watch_id = g_dbus_add_signal_watch(ctx->connection,
-        OFONO_SERVICE, OFONO_MANAGER_PATH, OFONO_MANAGER_INTERFACE,
-        "DataLogInd", tapi_data_log_ind, handler, handler_free);
+    watch_id = dispatch_add_signal_watch(ctx->connection, OFONO_MANAGER_PATH,
+        OFONO_MANAGER_INTERFACE, "DataLogInd", tapi_data_log_ind, handler, handler_free);
 
     if (watch_id == 0) {
         tapi_log_error("add signal watch failed in %s", __func__);
@@ -2442,6 +2518,7 @@ int tapi_register(tapi_context context,
     case MSG_CELLINFO_CHANGE_IND:
     case MSG_SIGNAL_STRENGTH_CHANGE_IND:
     case MSG_NITZ_STATE_CHANGE_IND:
+    case MSG_CELLINFO_DIFF_IND:
         return tapi_network_register(context, slot_id, msg, user_obj, p_handle);
     case MSG_DATA_ENABLED_CHANGE_IND:
     case MSG_DATA_REGISTRATION_STATE_CHANGE_IND:
@@ -2604,7 +2681,8 @@ int tapi_set_fast_dormancy(tapi_context context,
         return -EINVAL;
     }
 
-    return OK;
+    /* the screen state sent to the modem drives the local policies too */
+    return tapi_set_screen_state(ctx, state);
 }
 
 int tapi_get_phone_number(tapi_context context, int slot_id, char** out)
@@ -24,6 +24,19 @@
 #include "tapi.h"
 #include "tapi_internal.h"
 
+/****************************************************************************
+ * Private Type Declarations
+ ****************************************************************************/
+
+typedef struct {
+    struct list_node node;
+    tapi_async_handler* handler;
+    int watch_id;
+    bool snapshot;
+    int count;
+    tapi_cell_identity* cells;
+} cell_diff_registration;
+
 /****************************************************************************
  * Private Functions
  ****************************************************************************/
@@ -229,7 +242,7 @@ static void update_network_operator(const char* prop, DBusMessageIter* iter, tap
     }
 }
 
-static void fill_cell_identity_list(DBusMessageIter* iter, tapi_cell_identity* cell)
+void fill_cell_identity_list(DBusMessageIter* iter, tapi_cell_identity* cell)
 {
     while (dbus_message_iter_get_arg_type(iter) == DBUS_TYPE_DICT_ENTRY) {
         DBusMessageIter entry, value;
@@ -327,6 +340,9 @@ static int cellinfo_list_changed(DBusConnection* connection,
     const char* property;
     int cell_index;
 
+    if (dispatch_defer_signal(connection, message, cellinfo_list_changed, user_data))
+        return 1;
+
     if (handler == NULL) {
         tapi_log_error("handler in %s is null", __func__);
         return 0;
@@ -404,6 +420,164 @@ static int cellinfo_list_changed(DBusConnection* connection,
     return 1;
 }
 
+static bool cell_key_equal(const tapi_cell_identity* a, const tapi_cell_identity* b)
+{
+    if (a->type != b->type || a->earfcn != b->earfcn)
+        return false;
+
+    if (a->type == TYPE_LTE || a->type == TYPE_NR)
+        return a->pci == b->pci;
+
+    return a->ci == b->ci;
+}
+
+static bool cell_value_changed(const tapi_cell_identity* a, const tapi_cell_identity* b)
+{
+    return a->ci != b->ci || a->pci != b->pci || a->tac != b->tac || a->lac != b->lac
+        || a->registered != b->registered || a->bandwidth != b->bandwidth
+        || memcmp(&a->signal_strength, &b->signal_strength, sizeof(tapi_signal_strength)) != 0
+        || strcmp(a->mcc_str, b->mcc_str) != 0 || strcmp(a->mnc_str, b->mnc_str) != 0;
+}
+
+static void cell_diff_registration_free(void* obj)
+{
+    cell_diff_registration* reg = obj;
+
+    if (reg == NULL)
+        return;
+
+    if (reg->node.next != NULL)
+        list_delete(&reg->node);
+
+    handler_free(reg->handler);
+    free(reg->cells);
+    free(reg);
+}
+
+static int cellinfo_diff_changed(DBusConnection* connection,
+    DBusMessage* message, void* user_data)
+{
+    bool matched[MAX_CELL_INFO_LIST_SIZE] = { false };
+    cell_diff_registration* reg = user_data;
+    tapi_cell_identity* current;
+    tapi_cell_list_diff diff;
+    tapi_async_result* ar;
+    tapi_async_function cb;
+    DBusMessageIter iter, list;
+    const char* property;
+    int count = 0;
+
+    if (dispatch_defer_signal(connection, message, cellinfo_diff_changed, user_data))
+        return 1;
+
+    if (reg == NULL || reg->handler == NULL) {
+        tapi_log_error("handler in %s is null", __func__);
+        return 0;
+    }
+
+    ar = reg->handler->result;
+    if (ar == NULL) {
+        tapi_log_error("async result in %s is null", __func__);
+        return 0;
+    }
+
+    cb = reg->handler->cb_function;
+    if (cb == NULL) {
+        tapi_log_error("callback in %s is null", __func__);
+        return 0;
+    }
+
+    if (dbus_message_iter_init(message, &iter) == false) {
+        tapi_log_error("message iter init failed in %s", __func__);
+        return 0;
+    }
+
+    dbus_message_iter_get_basic(&iter, &property);
+    if (strcmp(property, "CellList") != 0) {
+        return 0;
+    }
+
+    dbus_message_iter_next(&iter);
+    if (dbus_message_iter_get_arg_type(&iter) != DBUS_TYPE_ARRAY) {
+        tapi_log_error("message iter get arg type failed in %s", __func__);
+        return 0;
+    }
+
+    current = malloc(sizeof(tapi_cell_identity) * MAX_CELL_INFO_LIST_SIZE);
+    if (current == NULL) {
+        tapi_log_error("current in %s is null", __func__);
+        return 0;
+    }
+
+    dbus_message_iter_recurse(&iter, &list);
+
+    while (dbus_message_iter_get_arg_type(&list) == DBUS_TYPE_STRUCT
+        && count < MAX_CELL_INFO_LIST_SIZE) {
+        DBusMessageIter entry, dict;
+
+        memset(&current[count], 0, sizeof(tapi_cell_identity));
+        current[count].type = TYPE_NONE;
+
+        dbus_message_iter_recurse(&list, &entry);
+        dbus_message_iter_recurse(&entry, &dict);
+
+        fill_cell_identity_list(&dict, &current[count++]);
+
+        dbus_message_iter_next(&list);
+    }
+
+    memset(&diff, 0, sizeof(tapi_cell_list_diff));
+    diff.snapshot = reg->snapshot;
+
+    for (int i = 0; i < count; i++) {
+        int j = 0;
+
+        if (!diff.snapshot) {
+            while (j < reg->count && (matched[j] || !cell_key_equal(&current[i], &reg->cells[j])))
+                j++;
+        }
+
+        if (diff.snapshot || j == reg->count) {
+            diff.added[diff.added_count++] = &current[i];
+            continue;
+        }
+
+        matched[j] = true;
+        if (cell_value_changed(&current[i], &reg->cells[j]))
+            diff.changed[diff.changed_count++] = &current[i];
+    }
+
+    for (int j = 0; !diff.snapshot && j < reg->count; j++) {
+        if (!matched[j])
+            diff.removed[diff.removed_count++] = &reg->cells[j];
+    }
+
+    if (diff.snapshot || diff.added_count > 0 || diff.removed_count > 0 || diff.changed_count > 0) {
+        ar->status = OK;
+        ar->arg2 = diff.added_count + diff.removed_count + diff.changed_count;
+        ar->data = &diff;
+        cb(ar);
+        ar->data = NULL;
+    }
+
+    free(reg->cells);
+    reg->cells = NULL;
+    reg->count = count;
+    reg->snapshot = false;
+
+    if (count > 0) {
+        reg->cells = realloc(current, sizeof(tapi_cell_identity) * count);
+        if (reg->cells == NULL) {
+            /* keep the oversized buffer rather than losing the baseline */
+            reg->cells = current;
+        }
+    } else {
+        free(current);
+    }
+
+    return 1;
+}
+
 static int signal_strength_changed(DBusConnection* connection,
     DBusMessage* message, void* user_data)
 {
@@ -414,6 +588,9 @@ static int signal_strength_changed(DBusConnection* connection,
     const char* property;
     tapi_signal_strength* ss = NULL;
 
+    if (dispatch_defer_signal(connection, message, signal_strength_changed, user_data))
+        return 1;
+
     if (handler == NULL) {
         tapi_log_error("handler in %s is null", __func__);
         return 0;
@@ -891,6 +1068,39 @@ done:
     }
 }
 
+static int network_register_cell_diff(dbus_context* ctx,
+    const char* modem_path, tapi_async_handler* handler)
+{
+    cell_diff_registration* reg;
+
+    reg = malloc(sizeof(cell_diff_registration));
+    if (reg == NULL) {
+        tapi_log_error("reg in %s is null", __func__);
+        handler_free(handler);
+        return -ENOMEM;
+    }
+
+    reg->node.prev = NULL;
+    reg->node.next = NULL;
+    reg->handler = handler;
+    reg->snapshot = true;
+    reg->count = 0;
+    reg->cells = NULL;
+
+    /* the highest rate indication, it goes through the low lane as CellList does */
+    reg->watch_id = dispatch_add_signal_watch(ctx->connection, modem_path,
+        OFONO_NETMON_INTERFACE, "PropertyChanged", cellinfo_diff_changed, reg,
+        cell_diff_registration_free);
+    if (reg->watch_id == 0) {
+        tapi_log_error("add signal watch failed in %s", __func__);
+        cell_diff_registration_free(reg);
+        return -EINVAL;
+    }
+
+    list_add_tail(&ctx->cell_diff_list, &reg->node);
+    return reg->watch_id;
+}
+
 static void cell_info_list_rate_param_append(DBusMessageIter* iter, void* user_data)
 {
     tapi_async_handler* handler = user_data;
@@ -1658,7 +1868,8 @@ int tapi_network_register(tapi_context context,
         return -EINVAL;
     }
 
-    if (msg < MSG_NETWORK_STATE_CHANGE_IND || msg > MSG_NITZ_STATE_CHANGE_IND) {
+    if ((msg < MSG_NETWORK_STATE_CHANGE_IND || msg > MSG_NITZ_STATE_CHANGE_IND)
+        && msg != MSG_CELLINFO_DIFF_IND) {
         tapi_log_error("msg in %s is invalid", __func__);
         return -EINVAL;
     }
@@ -1688,6 +1899,9 @@ int tapi_network_register(tapi_context context,
     ar->arg1 = slot_id;
     ar->user_obj = user_obj;
 
+    if (msg == MSG_CELLINFO_DIFF_IND)
+        return network_register_cell_diff(ctx, modem_path, handler);
+
     switch (msg) {
     case MSG_NETWORK_STATE_CHANGE_IND:
     case MSG_VOICE_REGISTRATION_STATE_CHANGE_IND:
@@ -1696,14 +1910,14 @@ int tapi_network_register(tapi_context context,
             "PropertyChanged", network_state_changed, handler, handler_free);
         break;
     case MSG_CELLINFO_CHANGE_IND:
-        watch_id = g_dbus_add_signal_watch(ctx->connection,
-            OFONO_SERVICE, modem_path, OFONO_NETMON_INTERFACE,
-            "PropertyChanged", cellinfo_list_changed, handler, handler_free);
+        watch_id = dispatch_add_signal_watch(ctx->connection, modem_path,
+            OFONO_NETMON_INTERFACE, "PropertyChanged", cellinfo_list_changed, handler,
+            handler_free);
         break;
     case MSG_SIGNAL_STRENGTH_CHANGE_IND:
-        watch_id = g_dbus_add_signal_watch(ctx->connection,
-            OFONO_SERVICE, modem_path, OFONO_NETWORK_REGISTRATION_INTERFACE,
-            "PropertyChanged", signal_strength_changed, handler, handler_free);
+        watch_id = dispatch_add_signal_watch(ctx->connection, modem_path,
+            OFONO_NETWORK_REGISTRATION_INTERFACE, "PropertyChanged", signal_strength_changed, handler,
+            handler_free);
         break;
     case MSG_NITZ_STATE_CHANGE_IND:
         watch_id = g_dbus_add_signal_watch(ctx->connection,
@@ -1743,3 +1957,37 @@ int tapi_network_unregister(tapi_context context, int watch_id)
 
     return OK;
 }
+
+int tapi_network_request_cell_snapshot(tapi_context context, int watch_id)
+{
+    dbus_context* ctx = context;
+    cell_diff_registration* reg;
+
+    if (ctx == NULL) {
+        tapi_log_error("context in %s is null", __func__);
+        return -EINVAL;
+    }
+
+    list_for_every_entry(&ctx->cell_diff_list, reg, cell_diff_registration, node)
+    {
+        if (reg->watch_id == watch_id) {
+            reg->snapshot = true;
+            return OK;
+        }
+    }
+
+    tapi_log_error("watch_id %d in %s is not registered", watch_id, __func__);
+    return -EINVAL;
+}
+
+void cell_diff_detach_all(dbus_context* ctx)
+{
+    cell_diff_registration* reg;
+    cell_diff_registration* tmp;
+
+    /* watches may outlive the context, make their destroy skip the list */
+    list_for_every_entry_safe(&ctx->cell_diff_list, reg, tmp, cell_diff_registration, node)
+    {
+        list_delete(&reg->node);
+    }
+}
@@ -0,0 +1,500 @@
+/*
+ * Copyright (C) 2023 Xiaomi Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <uv.h>
+
+#include "tapi.h"
+#include "tapi_internal.h"
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+
+#define NETWORK_REQUEST_TYPE_COUNT (DATA_CONTEXT_TYPE_EMERGENCY + 1)
+
+/****************************************************************************
+ * Private Type Declarations
+ ****************************************************************************/
+
+typedef enum {
+    NETWORK_REQUEST_IDLE,
+    NETWORK_REQUEST_REQUESTING, /* RequestNetwork in flight */
+    NETWORK_REQUEST_ACTIVE,
+    NETWORK_REQUEST_LINGER, /* no holder left, released when the linger time ends */
+    NETWORK_REQUEST_RELEASING, /* ReleaseNetwork in flight */
+} network_request_state;
+
+typedef struct {
+    struct list_node node;
+    int event_id;
+    void* user_obj;
+    tapi_async_function cb;
+} network_request_waiter;
+
+typedef struct {
+    network_request_state state;
+    int refs; /* holders in this process */
+    int orphans; /* holders without callback of a failed request, their release is absorbed */
+    unsigned int generation;
+    u_int64_t linger_end; /* ms, uv_now at which a lingering bearer is released */
+    struct list_node waiters; /* completion callbacks of the pending request */
+} network_request;
+
+struct network_arbiter {
+    dbus_context* ctx;
+    int slot_id;
+    uv_timer_t timer;
+    network_request requests[NETWORK_REQUEST_TYPE_COUNT];
+};
+
+typedef struct {
+    dbus_context* ctx;
+    int slot_id;
+    tapi_data_context_type type;
+    unsigned int generation;
+} network_request_param;
+
+/****************************************************************************
+ * Private Data
+ ****************************************************************************/
+
+/* A reply is only applied to the request state that sent it */
+static unsigned int g_request_generation;
+
+/****************************************************************************
+ * Private Function Prototypes
+ ****************************************************************************/
+
+static void network_request_reply(DBusMessage* message, void* user_data);
+static void network_release_reply(DBusMessage* message, void* user_data);
+static void network_arbiter_expired(uv_timer_t* handle);
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+
+static void network_arbiter_close_done(uv_handle_t* handle)
+{
+    free(handle->data);
+}
+
+static void network_request_append(DBusMessageIter* iter, void* user_data)
+{
+    network_request_param* param = user_data;
+    const char* type = tapi_utils_apn_type_to_string(param->type);
+
+    dbus_message_iter_append_basic(iter, DBUS_TYPE_STRING, &type);
+}
+
+static void network_request_complete(network_arbiter* arbiter,
+    tapi_data_context_type type, int status)
+{
+    network_request* request = &arbiter->requests[type];
+    network_request_waiter* waiter;
+    network_request_waiter* tmp;
+    tapi_async_result ar;
+
+    memset(&ar, 0, sizeof(tapi_async_result));
+    ar.msg_type = RESPONSE;
+    ar.arg1 = arbiter->slot_id;
+    ar.arg2 = type;
+    ar.status = status;
+
+    list_for_every_entry_safe(&request->waiters, waiter, tmp, network_request_waiter, node)
+    {
+        list_delete(&waiter->node);
+        ar.msg_id = waiter->event_id;
+        ar.user_obj = waiter->user_obj;
+        waiter->cb(&ar);
+        free(waiter);
+    }
+}
+
+/* A failed request holds no reference, holders that were not told keep a release to make */
+static void network_request_fail(network_arbiter* arbiter, tapi_data_context_type type)
+{
+    network_request* request = &arbiter->requests[type];
+    network_request_waiter* waiter;
+    int told = 0;
+
+    list_for_every_entry(&request->waiters, waiter, network_request_waiter, node)
+        told++;
+
+    if (request->refs > told)
+        request->orphans += request->refs - told;
+
+    request->refs = 0;
+    request->state = NETWORK_REQUEST_IDLE;
+    network_request_complete(arbiter, type, ERROR);
+}
+
+/* Sends RequestNetwork or ReleaseNetwork, returns false if nothing was sent */
+static bool network_request_send(network_arbiter* arbiter, tapi_data_context_type type,
+    bool release)
+{
+    network_request* request = &arbiter->requests[type];
+    network_request_param* param;
+    GDBusProxy* proxy;
+
+    proxy = arbiter->ctx->dbus_proxy[arbiter->slot_id][DBUS_PROXY_DATA];
+    if (proxy == NULL) {
+        tapi_log_error("no available proxy in %s", __func__);
+        return false;
+    }
+
+    param = malloc(sizeof(network_request_param));
+    if (param == NULL) {
+        tapi_log_error("param in %s is null", __func__);
+        return false;
+    }
+
+    param->ctx = arbiter->ctx;
+    param->slot_id = arbiter->slot_id;
+    param->type = type;
+    param->generation = ++g_request_generation;
+
+    if (!g_dbus_proxy_method_call(proxy, release ? "ReleaseNetwork" : "RequestNetwork",
+            network_request_append, release ? network_release_reply : network_request_reply,
+            param, free)) {
+        tapi_log_error("dbus method call fail in %s", __func__);
+        free(param);
+        return false;
+    }
+
+    request->generation = param->generation;
+    request->state = release ? NETWORK_REQUEST_RELEASING : NETWORK_REQUEST_REQUESTING;
+    return true;
+}
+
+static void network_arbiter_schedule(network_arbiter* arbiter)
+{
+    u_int64_t now = uv_now(uv_default_loop());
+    u_int64_t next = 0;
+
+    for (int i = 0; i < NETWORK_REQUEST_TYPE_COUNT; i++) {
+        network_request* request = &arbiter->requests[i];
+
+        if (request->state != NETWORK_REQUEST_LINGER)
+            continue;
+
+        if (next == 0 || request->linger_end < next)
+            next = request->linger_end;
+    }
+
+    if (next == 0) {
+        uv_timer_stop(&arbiter->timer);
+        return;
+    }
+
+    uv_timer_start(&arbiter->timer, network_arbiter_expired,
+        next > now ? next - now : 0, 0);
+}
+
+static void network_arbiter_expired(uv_timer_t* handle)
+{
+    network_arbiter* arbiter = handle->data;
+    u_int64_t now = uv_now(uv_default_loop());
+
+    for (int i = 0; i < NETWORK_REQUEST_TYPE_COUNT; i++) {
+        network_request* request = &arbiter->requests[i];
+
+        if (request->state != NETWORK_REQUEST_LINGER || request->linger_end > now)
+            continue;
+
+        if (!network_request_send(arbiter, i, true))
+            request->state = NETWORK_REQUEST_IDLE;
+    }
+
+    network_arbiter_schedule(arbiter);
+}
+
+/* The last holder is gone, keep the bearer for the linger time before releasing it */
+static void network_request_linger(network_arbiter* arbiter, tapi_data_context_type type)
+{
+    network_request* request = &arbiter->requests[type];
+
+    if (CONFIG_TELEPHONY_DATA_NETWORK_LINGER <= 0) {
+        if (!network_request_send(arbiter, type, true))
+            request->state = NETWORK_REQUEST_IDLE;
+        return;
+    }
+
+    request->state = NETWORK_REQUEST_LINGER;
+    request->linger_end = uv_now(uv_default_loop()) + CONFIG_TELEPHONY_DATA_NETWORK_LINGER;
+    network_arbiter_schedule(arbiter);
+}
+
+static network_request* network_request_lookup(network_request_param* param,
+    network_arbiter** out)
+{
+    network_arbiter* arbiter = param->ctx->network_arbiters[param->slot_id];
+    network_request* request;
+
+    if (arbiter == NULL)
+        return NULL;
+
+    request = &arbiter->requests[param->type];
+    if (request->generation != param->generation)
+        return NULL;
+
+    *out = arbiter;
+    return request;
+}
+
+static void network_request_reply(DBusMessage* message, void* user_data)
+{
+    network_request_param* param = user_data;
+    network_arbiter* arbiter;
+    network_request* request;
+    DBusError err;
+
+    request = network_request_lookup(param, &arbiter);
+    if (request == NULL || request->state != NETWORK_REQUEST_REQUESTING)
+        return;
+
+    dbus_error_init(&err);
+    if (dbus_set_error_from_message(&err, message) == true) {
+        tapi_log_error("%s: %s", err.name, err.message);
+        dbus_error_free(&err);
+
+        network_request_fail(arbiter, param->type);
+        return;
+    }
+
+    request->state = NETWORK_REQUEST_ACTIVE;
+    network_request_complete(arbiter, param->type, OK);
+
+    /* every holder released while the request was in flight */
+    if (request->refs == 0)
+        network_request_linger(arbiter, param->type);
+}
+
+static void network_release_reply(DBusMessage* message, void* user_data)
+{
+    network_request_param* param = user_data;
+    network_arbiter* arbiter;
+    network_request* request;
+    DBusError err;
+
+    request = network_request_lookup(param, &arbiter);
+    if (request == NULL || request->state != NETWORK_REQUEST_RELEASING)
+        return;
+
+    dbus_error_init(&err);
+    if (dbus_set_error_from_message(&err, message) == true) {
+        tapi_log_error("%s: %s", err.name, err.message);
+        dbus_error_free(&err);
+    }
+
+    request->state = NETWORK_REQUEST_IDLE;
+
+    /* requested again while the release was in flight */
+    if (request->refs > 0 && !network_request_send(arbiter, param->type, false))
+        network_request_fail(arbiter, param->type);
+}
+
+static network_arbiter* network_arbiter_get(dbus_context* ctx, int slot_id)
+{
+    network_arbiter* arbiter = ctx->network_arbiters[slot_id];
+
+    if (arbiter != NULL)
+        return arbiter;
+
+    arbiter = malloc(sizeof(network_arbiter));
+    if (arbiter == NULL) {
+        tapi_log_error("arbiter in %s is null", __func__);
+        return NULL;
+    }
+
+    memset(arbiter, 0, sizeof(network_arbiter));
+    arbiter->ctx = ctx;
+    arbiter->slot_id = slot_id;
+
+    for (int i = 0; i < NETWORK_REQUEST_TYPE_COUNT; i++)
+        list_initialize(&arbiter->requests[i].waiters);
+
+    uv_timer_init(uv_default_loop(), &arbiter->timer);
+    arbiter->timer.data = arbiter;
+
+    ctx->network_arbiters[slot_id] = arbiter;
+    return arbiter;
+}
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+int network_request_acquire(dbus_context* ctx, int slot_id, tapi_data_context_type type,
+    int event_id, void* user_obj, tapi_async_function p_handle)
+{
+    network_arbiter* arbiter;
+    network_request* request;
+    network_request_waiter* waiter = NULL;
+    tapi_async_result ar;
+
+    arbiter = network_arbiter_get(ctx, slot_id);
+    if (arbiter == NULL)
+        return -ENOMEM;
+
+    request = &arbiter->requests[type];
+
+    if (request->state == NETWORK_REQUEST_ACTIVE || request->state == NETWORK_REQUEST_LINGER) {
+        if (request->state == NETWORK_REQUEST_LINGER) {
+            request->state = NETWORK_REQUEST_ACTIVE;
+            network_arbiter_schedule(arbiter);
+        }
+
+        request->refs++;
+
+        if (p_handle != NULL) {
+            memset(&ar, 0, sizeof(tapi_async_result));
+            ar.msg_id = event_id;
+            ar.msg_type = RESPONSE;
+            ar.arg1 = slot_id;
+            ar.arg2 = type;
+            ar.status = OK;
+            ar.user_obj = user_obj;
+            p_handle(&ar);
+        }
+
+        return OK;
+    }
+
+    if (p_handle != NULL) {
+        waiter = malloc(sizeof(network_request_waiter));
+        if (waiter == NULL) {
+            tapi_log_error("waiter in %s is null", __func__);
+            return -ENOMEM;
+        }
+
+        waiter->event_id = event_id;
+        waiter->user_obj = user_obj;
+        waiter->cb = p_handle;
+    }
+
+    /* requesting joins the call in flight, releasing requests again on its reply */
+    if (request->state == NETWORK_REQUEST_IDLE && !network_request_send(arbiter, type, false)) {
+        free(waiter);
+        return -EINVAL;
+    }
+
+    if (waiter != NULL)
+        list_add_tail(&request->waiters, &waiter->node);
+
+    request->refs++;
+    return OK;
+}
+
+int network_request_drop(dbus_context* ctx, int slot_id, tapi_data_context_type type)
+{
+    network_arbiter* arbiter;
+    network_request* request;
+
+    arbiter = network_arbiter_get(ctx, slot_id);
+    if (arbiter == NULL)
+        return -ENOMEM;
+
+    request = &arbiter->requests[type];
+
+    if (request->refs > 0) {
+        /* a request or release in flight checks the holders on its reply */
+        if (--request->refs == 0 && request->state == NETWORK_REQUEST_ACTIVE)
+            network_request_linger(arbiter, type);
+
+        return OK;
+    }
+
+    /* the release of a holder whose request failed, there is nothing to release */
+    if (request->orphans > 0) {
+        request->orphans--;
+        return OK;
+    }
+
+    /* nobody in this process holds the network, release it now as asked */
+    if (request->state == NETWORK_REQUEST_IDLE || request->state == NETWORK_REQUEST_LINGER) {
+        if (!network_request_send(arbiter, type, true)) {
+            request->state = NETWORK_REQUEST_IDLE;
+            network_arbiter_schedule(arbiter);
+            return -EINVAL;
+        }
+
+        network_arbiter_schedule(arbiter);
+    }
+
+    return OK;
+}
+
+int network_request_count(dbus_context* ctx, int slot_id, tapi_data_context_type type)
+{
+    network_arbiter* arbiter = ctx->network_arbiters[slot_id];
+
+    return arbiter != NULL ? arbiter->requests[type].refs : 0;
+}
+
+void network_request_sync(dbus_context* ctx, int slot_id)
+{
+    network_arbiter* arbiter;
+
+    if (!tapi_is_valid_slotid(slot_id))
+        return;
+
+    arbiter = ctx->network_arbiters[slot_id];
+    if (arbiter == NULL)
+        return;
+
+    /* bearers do not survive a modem restart, request the held ones again */
+    for (int i = 0; i < NETWORK_REQUEST_TYPE_COUNT; i++) {
+        network_request* request = &arbiter->requests[i];
+
+        request->generation = 0;
+        request->state = NETWORK_REQUEST_IDLE;
+
+        if (request->refs > 0 && !network_request_send(arbiter, i, false))
+            network_request_fail(arbiter, i);
+    }
+
+    network_arbiter_schedule(arbiter);
+}
+
+void network_request_release_all(dbus_context* ctx)
+{
+    for (int i = 0; i < CONFIG_MODEM_ACTIVE_COUNT; i++) {
+        network_arbiter* arbiter = ctx->network_arbiters[i];
+
+        if (arbiter == NULL)
+            continue;
+
+        for (int j = 0; j < NETWORK_REQUEST_TYPE_COUNT; j++) {
+            network_request* request = &arbiter->requests[j];
+
+            /* a lingering bearer has no holder, do not leave it up */
+            if (request->state == NETWORK_REQUEST_LINGER)
+                network_request_send(arbiter, j, true);
+
+            network_request_complete(arbiter, j, -ECANCELED);
+        }
+
+        ctx->network_arbiters[i] = NULL;
+        uv_timer_stop(&arbiter->timer);
+        uv_close((uv_handle_t*)&arbiter->timer, network_arbiter_close_done);
+    }
+}
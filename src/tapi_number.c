@@ -0,0 +1,535 @@
+/*
+ * Copyright (C) 2023 Xiaomi Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tapi.h"
+#include "tapi_internal.h"
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+
+#define NUMBER_KEY_MAX_DIGITS (MAX_NUMBER_KEY_BCD_SIZE * 2)
+
+/* Numbers up to this length without '+' are short codes, e.g. 112 or 10086 */
+#define NUMBER_SHORT_CODE_MAX_DIGITS 6
+
+#define NUMBER_CACHE_SIZE 16
+
+#define NUMBER_PLAN_NONE (-1)
+
+/****************************************************************************
+ * Private Type Declarations
+ ****************************************************************************/
+
+typedef struct {
+    uint16_t mcc;
+    uint16_t cc;
+    char trunk; /* national prefix, '\0' if none */
+    uint8_t nsn; /* length of national numbers dialed without trunk, 0 if none */
+    const char* idd; /* international prefix */
+} number_plan;
+
+typedef struct {
+    bool used;
+    int16_t plan;
+    uint32_t hash;
+    uint32_t stamp;
+    char number[MAX_PHONE_NUMBER_LENGTH + 1];
+    tapi_number_key key;
+} number_cache_entry;
+
+struct number_cache {
+    uint32_t clock;
+    number_cache_entry entries[NUMBER_CACHE_SIZE];
+};
+
+/****************************************************************************
+ * Private Data
+ ****************************************************************************/
+
+/* Sorted by MCC, see ITU-T E.212 and E.164 */
+static const number_plan g_number_plans[] = {
+    { 202, 30, '\0', 0, "00" },
+    { 204, 31, '0', 0, "00" },
+    { 206, 32, '0', 0, "00" },
+    { 208, 33, '0', 0, "00" },
+    { 212, 377, '\0', 0, "00" },
+    { 213, 376, '\0', 0, "00" },
+    { 214, 34, '\0', 0, "00" },
+    { 216, 36, '0', 0, "00" },
+    { 218, 387, '0', 0, "00" },
+    { 219, 385, '0', 0, "00" },
+    { 220, 381, '0', 0, "00" },
+    { 222, 39, '\0', 0, "00" },
+    { 226, 40, '0', 0, "00" },
+    { 228, 41, '0', 0, "00" },
+    { 230, 420, '\0', 0, "00" },
+    { 231, 421, '0', 0, "00" },
+    { 232, 43, '0', 0, "00" },
+    { 234, 44, '0', 0, "00" },
+    { 235, 44, '0', 0, "00" },
+    { 238, 45, '\0', 0, "00" },
+    { 240, 46, '0', 0, "00" },
+    { 242, 47, '\0', 0, "00" },
+    { 244, 358, '0', 0, "00" },
+    { 246, 370, '0', 0, "00" },
+    { 247, 371, '\0', 0, "00" },
+    { 248, 372, '\0', 0, "00" },
+    { 250, 7, '8', 0, "810" },
+    { 255, 380, '0', 0, "00" },
+    { 257, 375, '8', 0, "810" },
+    { 259, 373, '0', 0, "00" },
+    { 260, 48, '\0', 0, "00" },
+    { 262, 49, '0', 0, "00" },
+    { 268, 351, '\0', 0, "00" },
+    { 270, 352, '\0', 0, "00" },
+    { 272, 353, '0', 0, "00" },
+    { 274, 354, '\0', 0, "00" },
+    { 276, 355, '0', 0, "00" },
+    { 278, 356, '\0', 0, "00" },
+    { 280, 357, '\0', 0, "00" },
+    { 282, 995, '0', 0, "00" },
+    { 283, 374, '0', 0, "00" },
+    { 284, 359, '0', 0, "00" },
+    { 286, 90, '0', 0, "00" },
+    { 293, 386, '0', 0, "00" },
+    { 294, 389, '0', 0, "00" },
+    { 302, 1, '1', 10, "011" },
+    { 310, 1, '1', 10, "011" },
+    { 311, 1, '1', 10, "011" },
+    { 312, 1, '1', 10, "011" },
+    { 313, 1, '1', 10, "011" },
+    { 314, 1, '1', 10, "011" },
+    { 315, 1, '1', 10, "011" },
+    { 316, 1, '1', 10, "011" },
+    { 334, 52, '\0', 0, "00" },
+    { 404, 91, '0', 0, "00" },
+    { 405, 91, '0', 0, "00" },
+    { 410, 92, '0', 0, "00" },
+    { 412, 93, '0', 0, "00" },
+    { 413, 94, '0', 0, "00" },
+    { 414, 95, '0', 0, "00" },
+    { 415, 961, '0', 0, "00" },
+    { 416, 962, '0', 0, "00" },
+    { 417, 963, '0', 0, "00" },
+    { 418, 964, '0', 0, "00" },
+    { 419, 965, '\0', 0, "00" },
+    { 420, 966, '0', 0, "00" },
+    { 421, 967, '0', 0, "00" },
+    { 422, 968, '\0', 0, "00" },
+    { 424, 971, '0', 0, "00" },
+    { 425, 972, '0', 0, "00" },
+    { 426, 973, '\0', 0, "00" },
+    { 427, 974, '\0', 0, "00" },
+    { 428, 976, '0', 0, "001" },
+    { 429, 977, '0', 0, "00" },
+    { 432, 98, '0', 0, "00" },
+    { 434, 998, '\0', 0, "00" },
+    { 437, 996, '0', 0, "00" },
+    { 438, 993, '8', 0, "810" },
+    { 440, 81, '0', 0, "010" },
+    { 441, 81, '0', 0, "010" },
+    { 450, 82, '0', 0, "001" },
+    { 452, 84, '0', 0, "00" },
+    { 454, 852, '\0', 0, "001" },
+    { 455, 853, '\0', 0, "00" },
+    { 456, 855, '0', 0, "001" },
+    { 457, 856, '0', 0, "00" },
+    { 460, 86, '0', 11, "00" },
+    { 461, 86, '0', 11, "00" },
+    { 466, 886, '0', 0, "002" },
+    { 470, 880, '0', 0, "00" },
+    { 472, 960, '\0', 0, "00" },
+    { 502, 60, '0', 0, "00" },
+    { 505, 61, '0', 0, "0011" },
+    { 510, 62, '0', 0, "001" },
+    { 515, 63, '0', 0, "00" },
+    { 520, 66, '0', 0, "001" },
+    { 525, 65, '\0', 0, "001" },
+    { 528, 673, '\0', 0, "00" },
+    { 530, 64, '0', 0, "00" },
+    { 602, 20, '0', 0, "00" },
+    { 603, 213, '0', 0, "00" },
+    { 604, 212, '0', 0, "00" },
+    { 605, 216, '\0', 0, "00" },
+    { 606, 218, '0', 0, "00" },
+    { 620, 233, '0', 0, "00" },
+    { 621, 234, '0', 0, "009" },
+    { 639, 254, '0', 0, "000" },
+    { 640, 255, '0', 0, "000" },
+    { 641, 256, '0', 0, "000" },
+    { 655, 27, '0', 0, "00" },
+    { 704, 502, '\0', 0, "00" },
+    { 706, 503, '\0', 0, "00" },
+    { 708, 504, '\0', 0, "00" },
+    { 710, 505, '\0', 0, "00" },
+    { 712, 506, '\0', 0, "00" },
+    { 714, 507, '\0', 0, "00" },
+    { 716, 51, '0', 0, "00" },
+    { 722, 54, '0', 0, "00" },
+    { 724, 55, '0', 0, "0014" },
+    { 730, 56, '\0', 0, "00" },
+    { 732, 57, '\0', 0, "009" },
+    { 734, 58, '0', 0, "00" },
+    { 736, 591, '0', 0, "00" },
+    { 740, 593, '0', 0, "00" },
+    { 744, 595, '0', 0, "00" },
+    { 748, 598, '0', 0, "00" },
+};
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+
+static int number_plan_find(const char* mcc)
+{
+    int low = 0;
+    int high = sizeof(g_number_plans) / sizeof(g_number_plans[0]) - 1;
+    int value;
+
+    if (mcc == NULL || strlen(mcc) != MAX_MCC_LENGTH)
+        return NUMBER_PLAN_NONE;
+
+    value = atoi(mcc);
+    while (low <= high) {
+        int mid = (low + high) / 2;
+
+        if (g_number_plans[mid].mcc == value)
+            return mid;
+
+        if (g_number_plans[mid].mcc < value)
+            low = mid + 1;
+        else
+            high = mid - 1;
+    }
+
+    return NUMBER_PLAN_NONE;
+}
+
+static int number_nibble(char c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c == '*')
+        return 0xA;
+    if (c == '#')
+        return 0xB;
+
+    return -1;
+}
+
+static bool number_key_append(tapi_number_key* key, const char* digits, int length)
+{
+    for (int i = 0; i < length; i++) {
+        int nibble = number_nibble(digits[i]);
+        uint8_t* byte;
+
+        if (nibble < 0 || key->length >= NUMBER_KEY_MAX_DIGITS)
+            return false;
+
+        byte = &key->bcd[key->length / 2];
+        if (key->length % 2 == 0)
+            *byte = (*byte & 0xF0) | nibble;
+        else
+            *byte = (*byte & 0x0F) | (nibble << 4);
+
+        key->length++;
+    }
+
+    return true;
+}
+
+/* Drops visual separators, stops at post-dial pauses */
+static int number_strip(const char* number, char* out, int size, bool* plus)
+{
+    int length = 0;
+
+    *plus = false;
+
+    for (const char* p = number; *p != '\0'; p++) {
+        switch (*p) {
+        case ' ':
+        case '-':
+        case '.':
+        case '(':
+        case ')':
+        case '/':
+            continue;
+        case ',':
+        case ';':
+        case 'p':
+        case 'P':
+        case 'w':
+        case 'W':
+            goto done;
+        case '+':
+            if (length > 0 || *plus)
+                return -EINVAL;
+
+            *plus = true;
+            continue;
+        default:
+            if (number_nibble(*p) < 0 || length >= size - 1)
+                return -EINVAL;
+
+            out[length++] = *p;
+            break;
+        }
+    }
+
+done:
+    out[length] = '\0';
+    return length;
+}
+
+static int number_key_build(const char* number, int plan, tapi_number_key* out)
+{
+    char digits[MAX_PHONE_NUMBER_LENGTH + 1];
+    const number_plan* np;
+    char cc[8];
+    bool plus;
+    int length;
+    int skip;
+
+    length = number_strip(number, digits, sizeof(digits), &plus);
+    if (length <= 0)
+        return -EINVAL;
+
+    memset(out, 0, sizeof(tapi_number_key));
+    memset(out->bcd, 0xFF, sizeof(out->bcd));
+
+    if (plus) {
+        out->flags = NUMBER_KEY_INTERNATIONAL;
+        return number_key_append(out, digits, length) ? OK : -EINVAL;
+    }
+
+    if (length <= NUMBER_SHORT_CODE_MAX_DIGITS || strpbrk(digits, "*#") != NULL) {
+        out->flags = NUMBER_KEY_SHORT;
+        return number_key_append(out, digits, length) ? OK : -EINVAL;
+    }
+
+    if (plan == NUMBER_PLAN_NONE)
+        return number_key_append(out, digits, length) ? OK : -EINVAL;
+
+    np = &g_number_plans[plan];
+    skip = strlen(np->idd);
+
+    if (strncmp(digits, np->idd, skip) == 0) {
+        out->flags = NUMBER_KEY_INTERNATIONAL;
+        return number_key_append(out, digits + skip, length - skip) ? OK : -EINVAL;
+    }
+
+    if (np->trunk != '\0' && digits[0] == np->trunk) {
+        skip = 1;
+    } else if (np->trunk == '\0' || length == np->nsn) {
+        /* e.g. NANP without the leading 1 or a mobile number in China */
+        skip = 0;
+    } else {
+        /* subscriber number without area code, no country to add */
+        return number_key_append(out, digits, length) ? OK : -EINVAL;
+    }
+
+    snprintf(cc, sizeof(cc), "%u", np->cc);
+    out->flags = NUMBER_KEY_INTERNATIONAL;
+    if (!number_key_append(out, cc, strlen(cc))
+        || !number_key_append(out, digits + skip, length - skip))
+        return -EINVAL;
+
+    return OK;
+}
+
+static uint32_t number_hash(const char* number)
+{
+    uint32_t hash = 2166136261u;
+
+    while (*number != '\0') {
+        hash ^= (uint8_t)*number++;
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+static bool number_get_mcc(dbus_context* ctx, int slot_id, char* mcc)
+{
+    GDBusProxy* proxies[] = {
+        ctx->dbus_proxy[slot_id][DBUS_PROXY_NETREG],
+        ctx->dbus_proxy[slot_id][DBUS_PROXY_SIM],
+    };
+    DBusMessageIter iter;
+    char* value;
+
+    /* serving network first, home network when not registered */
+    for (int i = 0; i < sizeof(proxies) / sizeof(proxies[0]); i++) {
+        if (proxies[i] == NULL
+            || !g_dbus_proxy_get_property(proxies[i], "MobileCountryCode", &iter)
+            || dbus_message_iter_get_arg_type(&iter) != DBUS_TYPE_STRING)
+            continue;
+
+        dbus_message_iter_get_basic(&iter, &value);
+        if (value != NULL && strlen(value) == MAX_MCC_LENGTH) {
+            snprintf(mcc, MAX_MCC_LENGTH + 1, "%s", value);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+void number_cache_release(dbus_context* ctx)
+{
+    free(ctx->number_cache);
+    ctx->number_cache = NULL;
+}
+
+int tapi_utils_number_key_from_string(const char* number, const char* mcc,
+    tapi_number_key* out)
+{
+    if (number == NULL || out == NULL) {
+        tapi_log_error("invalid argument in %s", __func__);
+        return -EINVAL;
+    }
+
+    return number_key_build(number, number_plan_find(mcc), out);
+}
+
+int tapi_utils_normalize_number(tapi_context context, int slot_id, const char* number,
+    tapi_number_key* out)
+{
+    dbus_context* ctx = context;
+    number_cache_entry* victim = NULL;
+    number_cache_entry* entry;
+    char mcc[MAX_MCC_LENGTH + 1];
+    number_cache* cache;
+    uint32_t hash;
+    int plan;
+    int ret;
+
+    if (ctx == NULL) {
+        tapi_log_error("context is null in %s", __func__);
+        return -EINVAL;
+    }
+
+    if (!tapi_is_valid_slotid(slot_id)) {
+        tapi_log_error("invalid slot id %d in %s", slot_id, __func__);
+        return -EINVAL;
+    }
+
+    if (number == NULL || out == NULL) {
+        tapi_log_error("invalid argument in %s", __func__);
+        return -EINVAL;
+    }
+
+    plan = number_get_mcc(ctx, slot_id, mcc) ? number_plan_find(mcc) : NUMBER_PLAN_NONE;
+
+    if (ctx->number_cache == NULL) {
+        ctx->number_cache = malloc(sizeof(number_cache));
+        if (ctx->number_cache == NULL) {
+            tapi_log_error("number cache in %s is null", __func__);
+            return number_key_build(number, plan, out);
+        }
+
+        memset(ctx->number_cache, 0, sizeof(number_cache));
+    }
+
+    cache = ctx->number_cache;
+    hash = number_hash(number);
+
+    /* the plan is part of the key, a new country never hits an old entry */
+    for (int i = 0; i < NUMBER_CACHE_SIZE; i++) {
+        entry = &cache->entries[i];
+
+        if (!entry->used) {
+            if (victim == NULL || victim->used)
+                victim = entry;
+            continue;
+        }
+
+        if (entry->hash == hash && entry->plan == plan && strcmp(entry->number, number) == 0) {
+            entry->stamp = ++cache->clock;
+            *out = entry->key;
+            return OK;
+        }
+
+        if (victim == NULL || (victim->used && entry->stamp < victim->stamp))
+            victim = entry;
+    }
+
+    ret = number_key_build(number, plan, out);
+    if (ret != OK || strlen(number) > MAX_PHONE_NUMBER_LENGTH)
+        return ret;
+
+    victim->used = true;
+    victim->plan = plan;
+    victim->hash = hash;
+    victim->stamp = ++cache->clock;
+    victim->key = *out;
+    strcpy(victim->number, number);
+
+    return OK;
+}
+
+bool tapi_utils_number_key_equal(const tapi_number_key* a, const tapi_number_key* b)
+{
+    if (a == NULL || b == NULL)
+        return false;
+
+    return memcmp(a, b, sizeof(tapi_number_key)) == 0;
+}
+
+int tapi_utils_number_key_to_string(const tapi_number_key* key, char* out, int size)
+{
+    static const char digits[] = "0123456789*#";
+    int length = 0;
+
+    if (key == NULL || out == NULL || key->length > NUMBER_KEY_MAX_DIGITS) {
+        tapi_log_error("invalid argument in %s", __func__);
+        return -EINVAL;
+    }
+
+    if (size < key->length + 2) {
+        tapi_log_error("buffer is too small in %s", __func__);
+        return -ENOSPC;
+    }
+
+    if (key->flags & NUMBER_KEY_INTERNATIONAL)
+        out[length++] = '+';
+
+    for (int i = 0; i < key->length; i++) {
+        uint8_t byte = key->bcd[i / 2];
+        int nibble = i % 2 == 0 ? byte & 0x0F : byte >> 4;
+
+        if (nibble >= sizeof(digits) - 1)
+            return -EINVAL;
+
+        out[length++] = digits[nibble];
+    }
+
+    out[length] = '\0';
+    return length;
+}
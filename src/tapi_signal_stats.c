@@ -0,0 +1,441 @@
+/*
+ * Copyright (C) 2023 Xiaomi Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+
+#include "tapi.h"
+#include "tapi_internal.h"
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+
+#define SIGNAL_STATS_RAT_COUNT (TYPE_NR + 1)
+
+/* One histogram bin per unit, values outside are clamped */
+#define SIGNAL_STATS_BIN_MIN (-160)
+#define SIGNAL_STATS_BIN_COUNT 256
+#define SIGNAL_STATS_BIN_MAX (SIGNAL_STATS_BIN_MIN + SIGNAL_STATS_BIN_COUNT - 1)
+
+/* EWMA is kept in 1/65536 unit so small steps of a long window are not lost */
+#define SIGNAL_STATS_EWMA_SHIFT 16
+
+/* Ranks followed in the histogram: min, p10, p50, p90 and max */
+#define SIGNAL_STATS_RANK_COUNT 5
+
+/****************************************************************************
+ * Private Type Declarations
+ ****************************************************************************/
+
+typedef struct {
+    int16_t samples[CONFIG_TELEPHONY_SIGNAL_STATS_WINDOW];
+    uint16_t bins[SIGNAL_STATS_BIN_COUNT];
+    int head;
+    int64_t sum;
+    int64_t sum_sq;
+    int ewma;
+    int rank_bin[SIGNAL_STATS_RANK_COUNT];
+    int rank_below[SIGNAL_STATS_RANK_COUNT]; /* samples in the bins under rank_bin */
+    tapi_signal_metric_stats stats;
+} signal_metric_window;
+
+struct signal_stats {
+    dbus_context* ctx;
+    int slot_id;
+    int netreg_watch_id;
+    int netmon_watch_id;
+    int window;
+    tapi_cell_type rat;
+    bool strength_seen;
+    signal_metric_window metrics[SIGNAL_STATS_RAT_COUNT][SIGNAL_METRIC_COUNT];
+};
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+
+static const int signal_stats_rank_percent[SIGNAL_STATS_RANK_COUNT] = { 0, 10, 50, 90, 100 };
+
+/* Moves a rank to the lowest bin whose cumulative count reaches its percentile */
+static int metric_window_rank(signal_metric_window* w, int rank)
+{
+    int target = (w->stats.count * signal_stats_rank_percent[rank] + 99) / 100;
+    int* bin = &w->rank_bin[rank];
+    int* below = &w->rank_below[rank];
+
+    if (target < 1)
+        target = 1;
+
+    while (*bin > 0 && *below >= target)
+        *below -= w->bins[--(*bin)];
+
+    while (*bin < SIGNAL_STATS_BIN_COUNT - 1 && *below + w->bins[*bin] < target)
+        *below += w->bins[(*bin)++];
+
+    return *bin + SIGNAL_STATS_BIN_MIN;
+}
+
+static void metric_window_bin_update(signal_metric_window* w, int value, int delta)
+{
+    int bin = value - SIGNAL_STATS_BIN_MIN;
+
+    w->bins[bin] += delta;
+    for (int i = 0; i < SIGNAL_STATS_RANK_COUNT; i++) {
+        if (bin < w->rank_bin[i])
+            w->rank_below[i] += delta;
+    }
+}
+
+static void metric_window_refresh(signal_metric_window* w)
+{
+    int64_t count = w->stats.count;
+
+    w->stats.mean = (int)(w->sum / count);
+    w->stats.variance = (int)((w->sum_sq - w->sum * w->sum / count) / count);
+    w->stats.ewma = (w->ewma + (1 << (SIGNAL_STATS_EWMA_SHIFT - 1))) >> SIGNAL_STATS_EWMA_SHIFT;
+
+    /* ranks only step over the bins one sample moved them by */
+    w->stats.min = metric_window_rank(w, 0);
+    w->stats.p10 = metric_window_rank(w, 1);
+    w->stats.p50 = metric_window_rank(w, 2);
+    w->stats.p90 = metric_window_rank(w, 3);
+    w->stats.max = metric_window_rank(w, 4);
+}
+
+static void metric_window_add(signal_metric_window* w, int window, int value)
+{
+    int old;
+
+    if (value < SIGNAL_STATS_BIN_MIN)
+        value = SIGNAL_STATS_BIN_MIN;
+    else if (value > SIGNAL_STATS_BIN_MAX)
+        value = SIGNAL_STATS_BIN_MAX;
+
+    if (w->stats.count == window) {
+        old = w->samples[w->head];
+        w->sum -= old;
+        w->sum_sq -= (int64_t)old * old;
+        metric_window_bin_update(w, old, -1);
+        w->stats.count--;
+    }
+
+    if (w->stats.count == 0)
+        w->ewma = value * (1 << SIGNAL_STATS_EWMA_SHIFT);
+    else
+        w->ewma += (value * (1 << SIGNAL_STATS_EWMA_SHIFT) - w->ewma) * 2 / (window + 1);
+
+    w->samples[w->head] = (int16_t)value;
+    w->head = (w->head + 1) % window;
+    w->sum += value;
+    w->sum_sq += (int64_t)value * value;
+    metric_window_bin_update(w, value, 1);
+    w->stats.count++;
+    w->stats.last = value;
+
+    metric_window_refresh(w);
+}
+
+static tapi_cell_type signal_stats_current_rat(signal_stats* stats)
+{
+    tapi_network_type type;
+
+    if (stats->rat != TYPE_NONE)
+        return stats->rat;
+
+    if (tapi_network_get_voice_network_type(stats->ctx, stats->slot_id, &type) != OK)
+        return TYPE_NONE;
+
+    switch (type) {
+    case NETWORK_TYPE_GPRS:
+    case NETWORK_TYPE_EDGE:
+        return TYPE_GSM;
+    case NETWORK_TYPE_UMTS:
+    case NETWORK_TYPE_HSDPA:
+    case NETWORK_TYPE_HSUPA:
+    case NETWORK_TYPE_HSPA:
+        return TYPE_UMTS;
+    case NETWORK_TYPE_LTE:
+    case NETWORK_TYPE_LTE_CA:
+        return TYPE_LTE;
+    case NETWORK_TYPE_NR:
+        return TYPE_NR;
+    default:
+        return TYPE_NONE;
+    }
+}
+
+static void signal_stats_add(signal_stats* stats, tapi_cell_type rat,
+    tapi_signal_metric metric, int value)
+{
+    if (rat < TYPE_GSM || rat > TYPE_NR)
+        return;
+
+    metric_window_add(&stats->metrics[rat][metric], stats->window, value);
+}
+
+static void signal_strength_sampled(signal_stats* stats, DBusMessageIter* dict)
+{
+    tapi_cell_type rat = signal_stats_current_rat(stats);
+    int value;
+
+    while (dbus_message_iter_get_arg_type(dict) == DBUS_TYPE_DICT_ENTRY) {
+        DBusMessageIter entry, var;
+        const char* key;
+
+        dbus_message_iter_recurse(dict, &entry);
+        dbus_message_iter_get_basic(&entry, &key);
+
+        dbus_message_iter_next(&entry);
+        dbus_message_iter_recurse(&entry, &var);
+
+        if (strcmp(key, "ReceivedSignalStrengthIndicator") == 0) {
+            dbus_message_iter_get_basic(&var, &value);
+            signal_stats_add(stats, rat, SIGNAL_METRIC_RSSI, value);
+        } else if (strcmp(key, "ReferenceSignalReceivedPower") == 0) {
+            dbus_message_iter_get_basic(&var, &value);
+            signal_stats_add(stats, rat, SIGNAL_METRIC_RSRP, value);
+        } else if (strcmp(key, "ReferenceSignalReceivedQuality") == 0) {
+            dbus_message_iter_get_basic(&var, &value);
+            signal_stats_add(stats, rat, SIGNAL_METRIC_RSRQ, value);
+        } else if (strcmp(key, "SingalToNoiseRatio") == 0) {
+            dbus_message_iter_get_basic(&var, &value);
+            signal_stats_add(stats, rat, SIGNAL_METRIC_RSSNR, value);
+        }
+
+        dbus_message_iter_next(dict);
+    }
+
+    stats->strength_seen = true;
+}
+
+static int signal_stats_netreg_changed(DBusConnection* connection,
+    DBusMessage* message, void* user_data)
+{
+    signal_stats* stats = user_data;
+    DBusMessageIter iter, var, dict;
+    const char* property;
+
+    if (stats == NULL) {
+        tapi_log_error("stats in %s is null", __func__);
+        return 0;
+    }
+
+    if (dbus_message_iter_init(message, &iter) == false) {
+        tapi_log_error("message iter init failed in %s", __func__);
+        return 0;
+    }
+
+    dbus_message_iter_get_basic(&iter, &property);
+    dbus_message_iter_next(&iter);
+
+    if (strcmp(property, "Technology") == 0) {
+        /* resolved again from the next serving cell or registration */
+        stats->rat = TYPE_NONE;
+    } else if (strcmp(property, "SignalStrength") == 0) {
+        dbus_message_iter_recurse(&iter, &var);
+        dbus_message_iter_recurse(&var, &dict);
+        signal_strength_sampled(stats, &dict);
+    }
+
+    return 1;
+}
+
+static int signal_stats_netmon_changed(DBusConnection* connection,
+    DBusMessage* message, void* user_data)
+{
+    signal_stats* stats = user_data;
+    DBusMessageIter iter, list;
+    tapi_cell_identity cell;
+    const char* property;
+
+    if (stats == NULL) {
+        tapi_log_error("stats in %s is null", __func__);
+        return 0;
+    }
+
+    if (dbus_message_iter_init(message, &iter) == false) {
+        tapi_log_error("message iter init failed in %s", __func__);
+        return 0;
+    }
+
+    dbus_message_iter_get_basic(&iter, &property);
+    if (strcmp(property, "CellList") != 0)
+        return 1;
+
+    dbus_message_iter_next(&iter);
+    if (dbus_message_iter_get_arg_type(&iter) != DBUS_TYPE_ARRAY) {
+        tapi_log_error("message iter get arg type failed in %s", __func__);
+        return 0;
+    }
+
+    dbus_message_iter_recurse(&iter, &list);
+
+    while (dbus_message_iter_get_arg_type(&list) == DBUS_TYPE_STRUCT) {
+        DBusMessageIter entry, dict;
+
+        memset(&cell, 0, sizeof(tapi_cell_identity));
+        cell.type = TYPE_NONE;
+
+        dbus_message_iter_recurse(&list, &entry);
+        dbus_message_iter_recurse(&entry, &dict);
+
+        fill_cell_identity_list(&dict, &cell);
+
+        if (cell.registered) {
+            stats->rat = cell.type;
+
+            /* only sample the serving cell when SignalStrength stays silent */
+            if (!stats->strength_seen) {
+                if (cell.signal_strength.rssi != 0)
+                    signal_stats_add(stats, cell.type, SIGNAL_METRIC_RSSI, cell.signal_strength.rssi);
+                if (cell.signal_strength.rsrp != 0)
+                    signal_stats_add(stats, cell.type, SIGNAL_METRIC_RSRP, cell.signal_strength.rsrp);
+                if (cell.signal_strength.rsrq != 0)
+                    signal_stats_add(stats, cell.type, SIGNAL_METRIC_RSRQ, cell.signal_strength.rsrq);
+                if (cell.signal_strength.rssnr != 0)
+                    signal_stats_add(stats, cell.type, SIGNAL_METRIC_RSSNR, cell.signal_strength.rssnr);
+            }
+
+            break;
+        }
+
+        dbus_message_iter_next(&list);
+    }
+
+    stats->strength_seen = false;
+    return 1;
+}
+
+static void signal_stats_free(dbus_context* ctx, signal_stats* stats)
+{
+    g_dbus_remove_watch(ctx->connection, stats->netreg_watch_id);
+    g_dbus_remove_watch(ctx->connection, stats->netmon_watch_id);
+    free(stats);
+}
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+void signal_stats_release_all(dbus_context* ctx)
+{
+    for (int i = 0; i < CONFIG_MODEM_ACTIVE_COUNT; i++) {
+        if (ctx->slot_signal_stats[i] == NULL)
+            continue;
+
+        signal_stats_free(ctx, ctx->slot_signal_stats[i]);
+        ctx->slot_signal_stats[i] = NULL;
+    }
+}
+
+int tapi_network_signal_stats_enable(tapi_context context, int slot_id, bool enable, int window)
+{
+    dbus_context* ctx = context;
+    const char* modem_path;
+    signal_stats* stats;
+
+    if (ctx == NULL) {
+        tapi_log_error("context in %s is null", __func__);
+        return -EINVAL;
+    }
+
+    if (!tapi_is_valid_slotid(slot_id)) {
+        tapi_log_error("slot_id in %s is invalid", __func__);
+        return -EINVAL;
+    }
+
+    if (ctx->slot_signal_stats[slot_id] != NULL) {
+        signal_stats_free(ctx, ctx->slot_signal_stats[slot_id]);
+        ctx->slot_signal_stats[slot_id] = NULL;
+    }
+
+    if (!enable)
+        return OK;
+
+    if (window <= 0 || window > CONFIG_TELEPHONY_SIGNAL_STATS_WINDOW) {
+        tapi_log_error("window %d in %s is invalid", window, __func__);
+        return -EINVAL;
+    }
+
+    modem_path = tapi_utils_get_modem_path(slot_id);
+    if (modem_path == NULL) {
+        tapi_log_error("no available modem in %s", __func__);
+        return -EIO;
+    }
+
+    stats = malloc(sizeof(signal_stats));
+    if (stats == NULL) {
+        tapi_log_error("stats in %s is null", __func__);
+        return -ENOMEM;
+    }
+
+    memset(stats, 0, sizeof(signal_stats));
+    stats->ctx = ctx;
+    stats->slot_id = slot_id;
+    stats->window = window;
+    stats->rat = TYPE_NONE;
+
+    stats->netreg_watch_id = g_dbus_add_signal_watch(ctx->connection,
+        OFONO_SERVICE, modem_path, OFONO_NETWORK_REGISTRATION_INTERFACE,
+        "PropertyChanged", signal_stats_netreg_changed, stats, NULL);
+    stats->netmon_watch_id = g_dbus_add_signal_watch(ctx->connection,
+        OFONO_SERVICE, modem_path, OFONO_NETMON_INTERFACE,
+        "PropertyChanged", signal_stats_netmon_changed, stats, NULL);
+    if (stats->netreg_watch_id == 0 || stats->netmon_watch_id == 0) {
+        tapi_log_error("add signal watch failed in %s", __func__);
+        signal_stats_free(ctx, stats);
+        return -EINVAL;
+    }
+
+    ctx->slot_signal_stats[slot_id] = stats;
+    return OK;
+}
+
+int tapi_network_get_signal_stats(tapi_context context, int slot_id,
+    tapi_cell_type rat, tapi_signal_metric metric, tapi_signal_metric_stats* out)
+{
+    dbus_context* ctx = context;
+    signal_stats* stats;
+
+    if (ctx == NULL || out == NULL) {
+        tapi_log_error("invalid argument in %s", __func__);
+        return -EINVAL;
+    }
+
+    if (!tapi_is_valid_slotid(slot_id)) {
+        tapi_log_error("slot_id in %s is invalid", __func__);
+        return -EINVAL;
+    }
+
+    if (rat < TYPE_GSM || rat > TYPE_NR || metric < 0 || metric >= SIGNAL_METRIC_COUNT) {
+        tapi_log_error("rat or metric in %s is invalid", __func__);
+        return -EINVAL;
+    }
+
+    stats = ctx->slot_signal_stats[slot_id];
+    if (stats == NULL) {
+        tapi_log_error("signal stats in %s is not enabled", __func__);
+        return -EINVAL;
+    }
+
+    *out = stats->metrics[rat][metric].stats;
+    return OK;
+}
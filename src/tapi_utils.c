@@ -155,6 +155,8 @@ tapi_network_type tapi_utils_network_type_from_ril_tech(int type)
         return NETWORK_TYPE_HSUPA;
     } else if (type == RADIO_TECH_LTE_CA) {
         return NETWORK_TYPE_LTE_CA;
+    } else if (type == RADIO_TECH_NR) {
+        return NETWORK_TYPE_NR;
     }
 
     return NETWORK_TYPE_UNKNOWN;
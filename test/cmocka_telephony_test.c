@@ -378,6 +378,13 @@ static void TestTeleFunc_CI_CallStopDtmf(void** state)
     assert_int_equal(ret, OK);
 }
 
+static void TestTeleFunc_CI_CallDtmfSequence(void** state)
+{
+    (void)state;
+    int ret = tapi_dtmf_sequence_test(0);
+    assert_int_equal(ret, OK);
+}
+
 static void TestTeleFunc_CI_CallHangupAfterDialing(void** state)
 {
     (void)state;
@@ -421,6 +428,13 @@ static void TestTeleFunc_CallMergeByUser(void** state)
     assert_int_equal(ret, 0);
 }
 
+static void TestTeleFunc_CallMergeAndHangupByBatch(void** state)
+{
+    (void)state;
+    int ret = call_merge_and_hangup_by_batch(0);
+    assert_int_equal(ret, 0);
+}
+
 static void TestTeleFunc_CallSeparateByUser(void** state)
 {
     (void)state;
@@ -508,6 +522,69 @@ static void TestTeleFunc_CI_CallGetCount(void** state)
     assert_true(ret >= 0);
 }
 
+static void TestTeleFunc_CI_CallSnapshot(void** state)
+{
+    (void)state;
+    int ret = tapi_call_snapshot_test(0);
+    assert_int_equal(ret, OK);
+}
+
+static void TestTeleFunc_CI_CallRecords(void** state)
+{
+    (void)state;
+    int ret = tapi_call_records_test(0);
+    assert_int_equal(ret, OK);
+}
+
+static void TestTeleFunc_CI_CallEccIndex(void** state)
+{
+    (void)state;
+    int ret = tapi_call_ecc_index_test(0);
+    assert_int_equal(ret, OK);
+}
+
+static void TestTeleFunc_CI_CallKpiStats(void** state)
+{
+    (void)state;
+    int ret = tapi_call_kpi_stats_test(0);
+    assert_int_equal(ret, OK);
+}
+
+static void TestTeleFunc_CI_CallHistory(void** state)
+{
+    (void)state;
+    int ret = tapi_call_history_test();
+    assert_int_equal(ret, OK);
+}
+
+static void TestTeleFunc_CI_CallHistoryWraparound(void** state)
+{
+    (void)state;
+    int ret = tapi_call_history_wraparound_test();
+    assert_int_equal(ret, OK);
+}
+
+static void TestTeleFunc_CI_CallHistoryBenchmark(void** state)
+{
+    (void)state;
+    int ret = tapi_call_history_benchmark_test();
+    assert_int_equal(ret, OK);
+}
+
+static void TestTeleFunc_CI_CallEventCoalescing(void** state)
+{
+    (void)state;
+    int ret = tapi_call_event_coalescing_test(0);
+    assert_int_equal(ret, OK);
+}
+
+static void TestTeleFunc_CI_CallEventOrdering(void** state)
+{
+    (void)state;
+    int ret = tapi_call_event_ordering_test(0);
+    assert_int_equal(ret, OK);
+}
+
 static void TestTeleFunc_CI_CallDialNumber(void** state)
 {
     (void)state;
@@ -654,6 +731,27 @@ static void TestTeleFunc_CI_DataLoadApnContexts(void** state)
     assert_int_equal(ret, OK);
 }
 
+static void TestTeleFunc_CI_DataApnCache(void** state)
+{
+    (void)state;
+    int ret = tapi_data_apn_cache_test(0);
+    assert_int_equal(ret, OK);
+}
+
+static void TestTeleFunc_CI_DataTrafficMonitor(void** state)
+{
+    (void)state;
+    int ret = tapi_data_traffic_monitor_test(0);
+    assert_int_equal(ret, OK);
+}
+
+static void TestTeleFunc_CI_DataApnBatch(void** state)
+{
+    (void)state;
+    int ret = tapi_data_apn_batch_test(0);
+    assert_int_equal(ret, OK);
+}
+
 static void TestTeleFunc_DataSaveApnContextSupl(void** state)
 {
     (void)state;
@@ -861,6 +959,34 @@ static void TestTeleFunc_CI_DataReleaseNetworkInternet(void** state)
     assert_int_equal(ret, OK);
 }
 
+static void TestTeleFunc_CI_DataAcquireNetworkInternet(void** state)
+{
+    (void)state;
+    int ret = tapi_data_acquire_network_test(0, "internet");
+    assert_int_equal(ret, OK);
+}
+
+static void TestTeleFunc_CI_DataPrewarmInternet(void** state)
+{
+    (void)state;
+    int ret = tapi_data_prewarm_test(0);
+    assert_int_equal(ret, OK);
+}
+
+static void TestTeleFunc_CI_DataPrewarmBenchmark(void** state)
+{
+    (void)state;
+    int ret = tapi_data_prewarm_benchmark_test(0);
+    assert_int_equal(ret, OK);
+}
+
+static void TestTeleFunc_CI_DataSwitchDefaultSlot(void** state)
+{
+    (void)state;
+    int ret = tapi_data_switch_default_slot_test();
+    assert_int_equal(ret, OK);
+}
+
 static void TestTeleFunc_DataReleaseNetworkInternetNTimes(void** state)
 {
     (void)state;
@@ -1379,6 +1505,41 @@ static void TestTeleFunc_CI_NetQuerySignalstrength(void** state)
     assert_int_equal(ret, OK);
 }
 
+static void TestTeleFunc_NetCellHistory(void** state)
+{
+    (void)state;
+    int ret = tapi_net_cell_history_test(0);
+    assert_int_equal(ret, OK);
+}
+
+static void TestTeleFunc_NetCellRateControl(void** state)
+{
+    (void)state;
+    int ret = tapi_net_cell_rate_control_test(0);
+    assert_int_equal(ret, OK);
+}
+
+static void TestTeleFunc_NetCellDiffRegister(void** state)
+{
+    (void)state;
+    int ret = tapi_net_cell_diff_register_test(0);
+    assert_int_equal(ret, OK);
+}
+
+static void TestTeleFunc_NetSignalStats(void** state)
+{
+    (void)state;
+    int ret = tapi_net_signal_stats_test(0);
+    assert_int_equal(ret, OK);
+}
+
+static void TestTeleFunc_NetFanOutRegistrationInfo(void** state)
+{
+    (void)state;
+    int ret = tapi_net_fan_out_registration_info_test();
+    assert_int_equal(ret, OK);
+}
+
 // static void TestTeleNetSetCellInfoListRate(void **state)
 // {
 //     int ret = tapi_net_set_cell_info_list_rate_test(0, 10);
@@ -1562,6 +1723,20 @@ static void TestTeleFunc_CI_ModemGetRevision(void** state)
     assert_int_equal(ret, OK);
 }
 
+static void TestTeleFunc_CI_NumberKey(void** state)
+{
+    (void)state;
+    int ret = tapi_number_key_test(0);
+    assert_int_equal(ret, OK);
+}
+
+static void TestTeleFunc_CI_DispatchStats(void** state)
+{
+    (void)state;
+    int ret = tapi_dispatch_stats_test();
+    assert_int_equal(ret, OK);
+}
+
 // static void TestTeleImsServiceStatus(void** state)
 // {
 //     case_type* mode = *state;
@@ -2140,7 +2315,17 @@ int main(int argc, char* argv[])
         cmocka_unit_test(TestTeleFunc_CI_CallCheckAleringStatus),
         cmocka_unit_test(TestTeleFunc_CI_CallStartDtmf),
         cmocka_unit_test(TestTeleFunc_CI_CallStopDtmf),
+        cmocka_unit_test(TestTeleFunc_CI_CallDtmfSequence),
         cmocka_unit_test(TestTeleFunc_CI_CallGetCount),
+        cmocka_unit_test(TestTeleFunc_CI_CallSnapshot),
+        cmocka_unit_test(TestTeleFunc_CI_CallRecords),
+        cmocka_unit_test(TestTeleFunc_CI_CallEccIndex),
+        cmocka_unit_test(TestTeleFunc_CI_CallKpiStats),
+        cmocka_unit_test(TestTeleFunc_CI_CallEventCoalescing),
+        cmocka_unit_test(TestTeleFunc_CI_CallEventOrdering),
+        cmocka_unit_test(TestTeleFunc_CI_CallHistory),
+        cmocka_unit_test(TestTeleFunc_CI_CallHistoryWraparound),
+        cmocka_unit_test(TestTeleFunc_CI_CallHistoryBenchmark),
         cmocka_unit_test(TestTeleFunc_CI_CallHangupAll),
         // cmocka_unit_test(TestTeleLoadEccList),
         // hangup between dialing and answering
@@ -2150,6 +2335,7 @@ int main(int argc, char* argv[])
         cmocka_unit_test(TestTeleFunc_CallReleaseAndAnswer),
         cmocka_unit_test(TestTeleFunc_CallHoldAndAnswer),
         cmocka_unit_test(TestTeleFunc_CallMergeByUser),
+        cmocka_unit_test(TestTeleFunc_CallMergeAndHangupByBatch),
         cmocka_unit_test(TestTeleFunc_CallSeparateByUser),
         cmocka_unit_test(TestTeleFunc_CallReleaseAndSwap),
         cmocka_unit_test(TestTeleFunc_CallRemoteAnswerAndHangup),
@@ -2196,6 +2382,9 @@ int main(int argc, char* argv[])
     const struct CMUnitTest DataTestSuites[] = {
         cmocka_unit_test(TestTeleFunc_CI_DataRegister),
         cmocka_unit_test(TestTeleFunc_CI_DataLoadApnContexts),
+        cmocka_unit_test(TestTeleFunc_CI_DataApnCache),
+        cmocka_unit_test(TestTeleFunc_CI_DataTrafficMonitor),
+        cmocka_unit_test(TestTeleFunc_CI_DataApnBatch),
         cmocka_unit_test(TestTeleFunc_DataSaveApnContext),
         cmocka_unit_test(TestTeleFunc_DataRemoveApnContext),
         cmocka_unit_test(TestTeleFunc_DataResetApnContexts),
@@ -2213,8 +2402,12 @@ int main(int argc, char* argv[])
         cmocka_unit_test(TestTeleFunc_CI_DataEnable),
         cmocka_unit_test(TestTeleFunc_CI_DataIsEnable),
         cmocka_unit_test(TestTeleFunc_CI_DataReleaseNetworkInternet),
+        cmocka_unit_test(TestTeleFunc_CI_DataPrewarmBenchmark),
         cmocka_unit_test(TestTeleFunc_CI_DataRequestNetworkInternet),
         cmocka_unit_test(TestTeleFunc_DataReleaseNetworkInternetNTimes),
+        cmocka_unit_test(TestTeleFunc_CI_DataAcquireNetworkInternet),
+        cmocka_unit_test(TestTeleFunc_CI_DataPrewarmInternet),
+        cmocka_unit_test(TestTeleFunc_CI_DataSwitchDefaultSlot),
         cmocka_unit_test(TestTeleFunc_CI_DataDisable),
         cmocka_unit_test(TestTeleFunc_CI_DataIsDisable),
         cmocka_unit_test(TestTeleFunc_DataRequestNetworkIms),
@@ -2307,6 +2500,11 @@ int main(int argc, char* argv[])
         cmocka_unit_test(TestTeleFunc_CI_NetRegistrationInfo),
         cmocka_unit_test(TestTeleFunc_CI_NetGetOperatorName),
         cmocka_unit_test(TestTeleFunc_CI_NetQuerySignalstrength),
+        cmocka_unit_test(TestTeleFunc_NetCellHistory),
+        cmocka_unit_test(TestTeleFunc_NetCellRateControl),
+        cmocka_unit_test(TestTeleFunc_NetCellDiffRegister),
+        cmocka_unit_test(TestTeleFunc_NetSignalStats),
+        cmocka_unit_test(TestTeleFunc_NetFanOutRegistrationInfo),
         //      cmocka_unit_test(TestTeleNetSetCellInfoListRate),
         cmocka_unit_test(TestTeleFunc_CI_NetGetVoiceRegistered),
         cmocka_unit_test(TestTeleFunc_CI_NetGetVoiceNwType),
@@ -2376,6 +2574,8 @@ int main(int argc, char* argv[])
         cmocka_unit_test(TestTeleFunc_ModemInvokeOemRilRequestHexStrings),
         cmocka_unit_test(TestTeleFunc_CI_ImsListen),
         cmocka_unit_test(TestTeleFunc_CI_ModemGetRevision),
+        cmocka_unit_test(TestTeleFunc_CI_NumberKey),
+        cmocka_unit_test(TestTeleFunc_CI_DispatchStats),
         cmocka_unit_test(TestTeleFunc_CI_ModemDisable),
         cmocka_unit_test(TestTeleFunc_CI_ModemDsiableStatus),
         cmocka_unit_test(TestTeleFunc_CI_ModemEnableDisableNTimes),
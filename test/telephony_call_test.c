@@ -1,4 +1,7 @@
+#include <fcntl.h>
 #include <string.h>
+#include <time.h>
+#include <unistd.h>
 
 #include "remote_operation.h"
 #include "telephony_call_test.h"
@@ -31,6 +34,20 @@ static struct
     int current_call_state;
 } test_case_data;
 
+#define CALL_ORDER_MAX_EVENTS 32
+
+/* call state changes in delivery order, kept while recording */
+static struct
+{
+    bool recording;
+    int count;
+    struct {
+        char call_id[101];
+        int state;
+        int remote_held;
+    } events[CALL_ORDER_MAX_EVENTS];
+} call_order;
+
 static void test_case_data_init(void)
 {
     memset(&test_case_data, 0, sizeof(test_case_data));
@@ -68,6 +85,14 @@ static void call_state_change_cb(tapi_async_result* result)
     syslog(LOG_DEBUG, "call Emergency: %d \n", call_info->is_emergency_number);
     syslog(LOG_DEBUG, "call disconnect_reason: %d \n\n", call_info->disconnect_reason);
 
+    if (call_order.recording && call_order.count < CALL_ORDER_MAX_EVENTS) {
+        snprintf(call_order.events[call_order.count].call_id,
+            sizeof(call_order.events[call_order.count].call_id), "%s", call_info->call_id);
+        call_order.events[call_order.count].state = call_info->state;
+        call_order.events[call_order.count].remote_held = call_info->remote_held;
+        call_order.count++;
+    }
+
     if (judge_data.expect == CALL_LOCAL_HANGUP) {
         if (call_info->disconnect_reason == CALL_DISCONNECT_REASON_LOCAL_HANGUP) {
             judge_data.result = 0;
@@ -285,6 +310,28 @@ static void tele_call_async_fun(tapi_async_result* result)
             judge_data.flag = EVENT_REQUEST_STOP_DTMF_DONE;
         }
         break;
+    case EVENT_REQUEST_CONFERENCE_BATCH_DONE:
+        syslog(LOG_DEBUG, "%s: EVENT_REQUEST_CONFERENCE_BATCH_DONE status: %d, done: %d\n",
+            __func__, result->status, result->arg2);
+        if (judge_data.expect == EVENT_REQUEST_CONFERENCE_BATCH_DONE) {
+            tapi_conference_batch_result* batch_result = result->data;
+            judge_data.result = status;
+            if (batch_result == NULL || batch_result->results[0].calls < 2)
+                judge_data.result = -1;
+            judge_data.flag = EVENT_REQUEST_CONFERENCE_BATCH_DONE;
+        }
+        break;
+    case EVENT_REQUEST_DTMF_SEQUENCE_DONE:
+        syslog(LOG_DEBUG, "%s: EVENT_REQUEST_DTMF_SEQUENCE_DONE status: %d, played: %d\n",
+            __func__, result->status, result->arg2);
+        if (judge_data.expect == EVENT_REQUEST_DTMF_SEQUENCE_DONE) {
+            tapi_dtmf_sequence_result* sequence_result = result->data;
+            judge_data.result = status;
+            if (sequence_result == NULL || sequence_result->count != result->arg2)
+                judge_data.result = -1;
+            judge_data.flag = EVENT_REQUEST_DTMF_SEQUENCE_DONE;
+        }
+        break;
     case EVENT_REQUEST_CALL_MERGE_DONE:
         syslog(LOG_DEBUG, "%s: EVENT_REQUEST_CALL_MERGE_DONE status: %d\n",
             __func__, result->status);
@@ -555,6 +602,43 @@ on_exit:
     return res;
 }
 
+int tapi_call_conference_batch_test(int slot_id)
+{
+    tapi_conference_op ops[2];
+    int res = 0;
+
+    memset(ops, 0, sizeof(ops));
+    ops[0].type = CONFERENCE_OP_MERGE;
+    ops[1].type = CONFERENCE_OP_HANGUP_MULTIPARTY;
+
+    judge_data_init();
+    judge_data.expect = EVENT_REQUEST_CONFERENCE_BATCH_DONE;
+    int ret = tapi_call_conference_batch(get_tapi_ctx(), slot_id, ops, 2, true,
+        EVENT_REQUEST_CONFERENCE_BATCH_DONE, tele_call_async_fun);
+
+    if (ret) {
+        syslog(LOG_ERR, "tapi_call_conference_batch execute fail in %s, ret: %d",
+            __func__, ret);
+        res = -1;
+        goto on_exit;
+    }
+
+    if (judge()) {
+        syslog(LOG_DEBUG, "tapi_call_conference_batch_test is not executed in %s", __func__);
+        res = -1;
+        goto on_exit;
+    }
+
+    if (judge_data.result) {
+        syslog(LOG_ERR, "async result is invalid in %s", __func__);
+        res = -1;
+        goto on_exit;
+    }
+
+on_exit:
+    return res;
+}
+
 int tapi_call_separate_call_test(int slot_id)
 {
     syslog(LOG_DEBUG, "%s called, current call id: %s\n",
@@ -846,6 +930,123 @@ on_exit:
     return res;
 }
 
+int tapi_call_snapshot_test(int slot_id)
+{
+    tapi_call_info calls[MAX_CALL_LIST_COUNT];
+    int snapshot_count;
+    int active_count;
+    int call_count;
+    int retry = 0;
+
+    // the first call creates the mirror, wait for its GetCalls to land.
+    do {
+        snapshot_count = tapi_call_get_call_list_snapshot(get_tapi_ctx(), slot_id,
+            calls, MAX_CALL_LIST_COUNT);
+        if (snapshot_count != -EAGAIN)
+            break;
+
+        sleep(1);
+    } while (++retry < TIMEOUT);
+
+    if (snapshot_count < 0) {
+        syslog(LOG_ERR, "tapi_call_get_call_list_snapshot execute fail in %s, ret: %d",
+            __func__, snapshot_count);
+        return -1;
+    }
+
+    call_count = tapi_get_call_count(slot_id);
+    if (call_count != snapshot_count) {
+        syslog(LOG_ERR, "snapshot count %d mismatch call count %d in %s",
+            snapshot_count, call_count, __func__);
+        return -1;
+    }
+
+    active_count = tapi_call_get_call_by_state(get_tapi_ctx(), slot_id,
+        CALL_STATUS_ACTIVE, NULL, 0, calls);
+    if (active_count < 0 || active_count > snapshot_count) {
+        syslog(LOG_ERR, "tapi_call_get_call_by_state execute fail in %s, ret: %d",
+            __func__, active_count);
+        return -1;
+    }
+
+    return 0;
+}
+
+static void call_record_query_complete(tapi_async_result* result)
+{
+    tapi_call_record_list* list = result->data;
+    tapi_call_record_list* copy;
+    tapi_call_info info;
+    tapi_call_info restored;
+
+    if (judge_data.expect != GET_ALL_CALL_RECORDS)
+        return;
+
+    judge_data.result = -1;
+    if (result->status != OK || list == NULL)
+        goto done;
+
+    test_case_data.call_count = result->arg2;
+
+    for (int i = 0; i < list->count; i++) {
+        if (tapi_call_record_to_info(list, &list->records[i], &info) != OK)
+            goto done;
+
+        syslog(LOG_DEBUG, "call record id: %s, state: %d, arena: %d\n",
+            info.call_id, info.state, list->arena_size);
+
+        // legacy to compact and back must keep the call unchanged.
+        copy = tapi_call_record_list_from_info(&info, 1);
+        if (copy == NULL)
+            goto done;
+
+        tapi_call_record_to_info(copy, &copy->records[0], &restored);
+        free(copy);
+
+        if (strcmp(info.call_id, restored.call_id) != 0 || info.state != restored.state)
+            goto done;
+    }
+
+    judge_data.result = 0;
+
+done:
+    judge_data.flag = judge_data.expect;
+}
+
+int tapi_call_records_test(int slot_id)
+{
+    int call_count;
+    int ret;
+
+    call_count = tapi_get_call_count(slot_id);
+    if (call_count < 0)
+        return -1;
+
+    judge_data_init();
+    judge_data.expect = GET_ALL_CALL_RECORDS;
+    test_case_data.call_count = -1;
+
+    ret = tapi_call_get_all_call_records(get_tapi_ctx(), slot_id, 0,
+        call_record_query_complete);
+    if (ret) {
+        syslog(LOG_ERR, "tapi_call_get_all_call_records execute fail in %s, ret: %d",
+            __func__, ret);
+        return -1;
+    }
+
+    if (judge()) {
+        syslog(LOG_ERR, "call_record_query_complete is not executed in %s", __func__);
+        return -1;
+    }
+
+    if (judge_data.result || test_case_data.call_count != call_count) {
+        syslog(LOG_ERR, "async result is invalid in %s", __func__);
+        return -1;
+    }
+
+    return 0;
+}
+
 static int tapi_get_two_call_state(int slot_id)
 {
     int res = 0;
@@ -1078,6 +1279,343 @@ int tapi_call_load_ecc_list_test(int slot_id)
     return ret;
 }
 
+int tapi_call_ecc_index_test(int slot_id)
+{
+    ecc_info out[MAX_ECC_LIST_SIZE];
+    char prefix[2] = { 0 };
+    ecc_info ecc;
+    int size;
+    int ret;
+
+    size = tapi_call_get_ecc_list(get_tapi_ctx(), slot_id, out);
+    if (size <= 0)
+        return -1;
+
+    for (int i = 0; i < size; i++) {
+        ret = tapi_call_match_emergency_number(get_tapi_ctx(), slot_id, out[i].ecc_num, &ecc);
+        if (ret != 1) {
+            syslog(LOG_ERR, "%s is not matched in %s, ret: %d", out[i].ecc_num, __func__, ret);
+            return -1;
+        }
+
+        prefix[0] = out[i].ecc_num[0];
+        if (tapi_call_match_emergency_prefix(get_tapi_ctx(), slot_id, prefix) <= 0) {
+            syslog(LOG_ERR, "prefix %s is not matched in %s", prefix, __func__);
+            return -1;
+        }
+    }
+
+    if (tapi_call_match_emergency_number(get_tapi_ctx(), slot_id, "234", NULL) != 0) {
+        syslog(LOG_ERR, "234 is not emergency number in %s", __func__);
+        return -1;
+    }
+
+    return 0;
+}
+
+int tapi_call_kpi_stats_test(int slot_id)
+{
+    tapi_call_kpi_stats stats;
+    int ret;
+
+    ret = tapi_call_reset_kpi_stats(get_tapi_ctx(), slot_id);
+    if (ret) {
+        syslog(LOG_ERR, "tapi_call_reset_kpi_stats execute fail in %s, ret: %d",
+            __func__, ret);
+        return -1;
+    }
+
+    ret = tapi_call_get_kpi_stats(get_tapi_ctx(), slot_id, &stats);
+    if (ret) {
+        syslog(LOG_ERR, "tapi_call_get_kpi_stats execute fail in %s, ret: %d",
+            __func__, ret);
+        return -1;
+    }
+
+    if (stats.dial_active.count != 0 || stats.duration.count != 0
+        || stats.dial_active.unit == 0 || stats.duration.unit == 0) {
+        syslog(LOG_ERR, "kpi stats are not reset in %s", __func__);
+        return -1;
+    }
+
+    if (tapi_call_get_kpi_stats(get_tapi_ctx(), CONFIG_MODEM_ACTIVE_COUNT, &stats) != -EINVAL) {
+        syslog(LOG_ERR, "invalid slot is accepted in %s", __func__);
+        return -1;
+    }
+
+    return 0;
+}
+
+#define CALL_HISTORY_TEST_PATH "/tmp/tapi_call_history_test"
+#define CALL_HISTORY_BENCHMARK_RECORDS 100000
+#define CALL_HISTORY_BENCHMARK_NUMBERS 1000
+#define CALL_HISTORY_BENCHMARK_QUERIES 1000
+#define CALL_HISTORY_WRAP_CAPACITY 128
+#define CALL_HISTORY_WRAP_RECORDS 300
+
+static void call_history_test_record(tapi_call_history_record* record, u_int32_t start,
+    int number)
+{
+    memset(record, 0, sizeof(tapi_call_history_record));
+    record->start = start;
+    record->duration = number % 600;
+    record->flags = number % 2 ? CALL_HISTORY_INCOMING | CALL_HISTORY_ANSWERED : 0;
+    snprintf(record->number, sizeof(record->number), "1380013%04d", number);
+    tapi_utils_number_key_from_string(record->number, "460", &record->key);
+}
+
+static uint64_t call_history_test_now_us(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+int tapi_call_history_test(void)
+{
+    tapi_call_history_record records[4];
+    tapi_call_history_filter filter;
+    tapi_call_history_record record;
+    tapi_number_key key;
+    int ret = -1;
+    int fd;
+
+    unlink(CALL_HISTORY_TEST_PATH);
+    if (tapi_call_history_enable(get_tapi_ctx(), CALL_HISTORY_TEST_PATH, 0) != OK) {
+        syslog(LOG_ERR, "tapi_call_history_enable execute fail in %s", __func__);
+        return -1;
+    }
+
+    for (int i = 0; i < 3; i++) {
+        call_history_test_record(&record, 1000 + i, i);
+        tapi_call_history_add(get_tapi_ctx(), &record);
+    }
+
+    /* buffered records are visible before and after they are written */
+    tapi_utils_number_key_from_string("+86 138 0013 0001", "460", &key);
+    memset(&filter, 0, sizeof(filter));
+    filter.key = &key;
+    if (tapi_call_history_query(get_tapi_ctx(), &filter, records, 4) != 1
+        || records[0].start != 1001) {
+        syslog(LOG_ERR, "query of buffered records fail in %s", __func__);
+        goto out;
+    }
+
+    if (tapi_call_history_disable(get_tapi_ctx()) != OK
+        || tapi_call_history_enable(get_tapi_ctx(), CALL_HISTORY_TEST_PATH, 0) != OK) {
+        syslog(LOG_ERR, "reopen call history fail in %s", __func__);
+        return -1;
+    }
+
+    memset(&filter, 0, sizeof(filter));
+    filter.from = 1001;
+    if (tapi_call_history_query(get_tapi_ctx(), &filter, records, 4) != 2
+        || records[0].start != 1002 || records[1].start != 1001) {
+        syslog(LOG_ERR, "query of written records fail in %s", __func__);
+        goto out;
+    }
+
+    tapi_call_history_disable(get_tapi_ctx());
+
+    /* a file that is no call history is set aside, not overwritten */
+    fd = open(CALL_HISTORY_TEST_PATH, O_WRONLY | O_TRUNC);
+    if (fd < 0 || write(fd, "not a call history", 18) != 18) {
+        syslog(LOG_ERR, "overwrite call history fail in %s", __func__);
+        if (fd >= 0)
+            close(fd);
+        goto out;
+    }
+
+    close(fd);
+    unlink(CALL_HISTORY_TEST_PATH ".bad");
+    if (tapi_call_history_enable(get_tapi_ctx(), CALL_HISTORY_TEST_PATH, 0) != OK
+        || tapi_call_history_query(get_tapi_ctx(), NULL, records, 4) != 0
+        || access(CALL_HISTORY_TEST_PATH ".bad", F_OK) != 0) {
+        syslog(LOG_ERR, "invalid call history is not set aside in %s", __func__);
+        goto out;
+    }
+
+    ret = 0;
+
+out:
+    tapi_call_history_disable(get_tapi_ctx());
+    unlink(CALL_HISTORY_TEST_PATH);
+    unlink(CALL_HISTORY_TEST_PATH ".bad");
+    return ret;
+}
+
+/* a small history is filled several times over, every write past capacity compacts */
+static int call_history_check_wrapped(void)
+{
+    tapi_call_history_record records[CALL_HISTORY_WRAP_CAPACITY + 1];
+    tapi_call_history_filter filter;
+    tapi_call_history_record record;
+    int count;
+
+    count = tapi_call_history_query(get_tapi_ctx(), NULL, records,
+        CALL_HISTORY_WRAP_CAPACITY + 1);
+    if (count < CALL_HISTORY_WRAP_CAPACITY / 2 || count > CALL_HISTORY_WRAP_CAPACITY)
+        return -1;
+
+    /* the newest records are kept, newest first and without holes */
+    for (int i = 0; i < count; i++) {
+        if (records[i].start != 1000 + CALL_HISTORY_WRAP_RECORDS - 1 - i)
+            return -1;
+    }
+
+    /* the moved index still finds the numbers */
+    call_history_test_record(&record, 0, 3);
+    memset(&filter, 0, sizeof(filter));
+    filter.key = &record.key;
+    count = tapi_call_history_query(get_tapi_ctx(), &filter, records,
+        CALL_HISTORY_WRAP_CAPACITY + 1);
+    if (count <= 0)
+        return -1;
+
+    for (int i = 0; i < count; i++) {
+        if ((records[i].start - 1000) % 4 != 3)
+            return -1;
+    }
+
+    return 0;
+}
+
+int tapi_call_history_wraparound_test(void)
+{
+    tapi_call_history_record record;
+    int ret = -1;
+
+    unlink(CALL_HISTORY_TEST_PATH);
+    if (tapi_call_history_enable(get_tapi_ctx(), CALL_HISTORY_TEST_PATH,
+            CALL_HISTORY_WRAP_CAPACITY) != OK) {
+        syslog(LOG_ERR, "tapi_call_history_enable execute fail in %s", __func__);
+        return -1;
+    }
+
+    for (int i = 0; i < CALL_HISTORY_WRAP_RECORDS; i++) {
+        call_history_test_record(&record, 1000 + i, i % 4);
+        if (tapi_call_history_add(get_tapi_ctx(), &record) != OK) {
+            syslog(LOG_ERR, "tapi_call_history_add execute fail in %s", __func__);
+            goto out;
+        }
+    }
+
+    if (tapi_call_history_flush(get_tapi_ctx()) != OK || call_history_check_wrapped() != 0) {
+        syslog(LOG_ERR, "query of wrapped records fail in %s", __func__);
+        goto out;
+    }
+
+    /* the published count covers the compacted records on flash */
+    if (tapi_call_history_disable(get_tapi_ctx()) != OK
+        || tapi_call_history_enable(get_tapi_ctx(), CALL_HISTORY_TEST_PATH, 0) != OK
+        || call_history_check_wrapped() != 0) {
+        syslog(LOG_ERR, "reopen of wrapped records fail in %s", __func__);
+        goto out;
+    }
+
+    ret = 0;
+
+out:
+    tapi_call_history_disable(get_tapi_ctx());
+    unlink(CALL_HISTORY_TEST_PATH);
+    return ret;
+}
+
+int tapi_call_history_benchmark_test(void)
+{
+    tapi_call_history_record records[16];
+    tapi_call_history_filter filter;
+    tapi_call_history_record record;
+    uint64_t begin, insert_us, number_us, time_us;
+    int ret = -1;
+
+    unlink(CALL_HISTORY_TEST_PATH);
+    if (tapi_call_history_enable(get_tapi_ctx(), CALL_HISTORY_TEST_PATH,
+            CALL_HISTORY_BENCHMARK_RECORDS) != OK) {
+        syslog(LOG_ERR, "tapi_call_history_enable execute fail in %s", __func__);
+        return -1;
+    }
+
+    begin = call_history_test_now_us();
+    for (int i = 0; i < CALL_HISTORY_BENCHMARK_RECORDS; i++) {
+        call_history_test_record(&record, 1000 + i, i % CALL_HISTORY_BENCHMARK_NUMBERS);
+        if (tapi_call_history_add(get_tapi_ctx(), &record) != OK) {
+            syslog(LOG_ERR, "tapi_call_history_add execute fail in %s", __func__);
+            goto out;
+        }
+    }
+
+    tapi_call_history_flush(get_tapi_ctx());
+    insert_us = call_history_test_now_us() - begin + 1;
+
+    begin = call_history_test_now_us();
+    for (int i = 0; i < CALL_HISTORY_BENCHMARK_QUERIES; i++) {
+        call_history_test_record(&record, 0, (i * 7) % CALL_HISTORY_BENCHMARK_NUMBERS);
+        memset(&filter, 0, sizeof(filter));
+        filter.key = &record.key;
+        if (tapi_call_history_query(get_tapi_ctx(), &filter, records, 16) != 16) {
+            syslog(LOG_ERR, "number query fail in %s", __func__);
+            goto out;
+        }
+    }
+
+    number_us = call_history_test_now_us() - begin + 1;
+
+    begin = call_history_test_now_us();
+    for (int i = 0; i < CALL_HISTORY_BENCHMARK_QUERIES; i++) {
+        memset(&filter, 0, sizeof(filter));
+        filter.from = 1000 + (i * 97) % CALL_HISTORY_BENCHMARK_RECORDS;
+        filter.to = filter.from + 15;
+        if (tapi_call_history_query(get_tapi_ctx(), &filter, records, 16) <= 0) {
+            syslog(LOG_ERR, "time query fail in %s", __func__);
+            goto out;
+        }
+    }
+
+    time_us = call_history_test_now_us() - begin + 1;
+
+    syslog(LOG_INFO, "call history %d records: insert %llu/s, number query %llu/s, "
+                     "time query %llu/s",
+        CALL_HISTORY_BENCHMARK_RECORDS,
+        (unsigned long long)CALL_HISTORY_BENCHMARK_RECORDS * 1000000 / insert_us,
+        (unsigned long long)CALL_HISTORY_BENCHMARK_QUERIES * 1000000 / number_us,
+        (unsigned long long)CALL_HISTORY_BENCHMARK_QUERIES * 1000000 / time_us);
+    ret = 0;
+
+out:
+    tapi_call_history_disable(get_tapi_ctx());
+    unlink(CALL_HISTORY_TEST_PATH);
+    return ret;
+}
+
+int tapi_call_event_coalescing_test(int slot_id)
+{
+    int ret;
+
+    ret = tapi_call_set_event_coalescing(get_tapi_ctx(), slot_id, 5);
+    if (ret) {
+        syslog(LOG_ERR, "tapi_call_set_event_coalescing execute fail in %s, ret: %d",
+            __func__, ret);
+        return -1;
+    }
+
+    if (tapi_call_set_event_coalescing(get_tapi_ctx(), slot_id,
+            MAX_CALL_EVENT_COALESCE_WINDOW + 1) != -EINVAL) {
+        syslog(LOG_ERR, "invalid window is accepted in %s", __func__);
+        return -1;
+    }
+
+    ret = tapi_call_set_event_coalescing(get_tapi_ctx(), slot_id, 0);
+    if (ret) {
+        syslog(LOG_ERR, "tapi_call_set_event_coalescing execute fail in %s, ret: %d",
+            __func__, ret);
+        return -1;
+    }
+
+    return 0;
+}
+
 int tapi_call_set_default_voicecall_slot_test(int slot_id)
 {
     int res = 0;
@@ -1297,6 +1835,72 @@ on_exit:
     return res;
 }
 
+int tapi_call_event_ordering_test(int slot_id)
+{
+    char active_id[101];
+    int held = -1;
+    int waiting = -1;
+    int res = -1;
+
+    tapi_call_set_event_coalescing(get_tapi_ctx(), slot_id, 0);
+    if (tapi_get_call_count(slot_id) > 0)
+        tapi_call_hangup_all_test(slot_id);
+
+    if (remote_operation_call_incoming_test(slot_id) != 0
+        || tapi_call_answer_call_test(slot_id, test_case_data.call_id) != 0) {
+        syslog(LOG_ERR, "no active call in %s", __func__);
+        goto on_exit;
+    }
+
+    snprintf(active_id, sizeof(active_id), "%s", test_case_data.call_id);
+
+    /* the remote hold is held back by the window, the waiting call is not */
+    tapi_call_set_event_coalescing(get_tapi_ctx(), slot_id, MAX_CALL_EVENT_COALESCE_WINDOW);
+    memset(&call_order, 0, sizeof(call_order));
+    call_order.recording = true;
+
+    judge_data_init();
+    test_case_data_init();
+    judge_data.expect = NEW_CALL_WAITING;
+    remote_call_operation(slot_id, phone_num, HOLD_CALL);
+    remote_call_operation(slot_id, "10010", INCOMING_CALL);
+
+    if (judge() || judge_data.result) {
+        syslog(LOG_ERR, "no waiting call in %s", __func__);
+        goto on_exit;
+    }
+
+    sleep(1);
+    call_order.recording = false;
+
+    for (int i = 0; i < call_order.count; i++) {
+        if (waiting < 0 && call_order.events[i].state == CALL_STATUS_WAITING)
+            waiting = i;
+        if (held < 0 && call_order.events[i].remote_held
+            && strcmp(call_order.events[i].call_id, active_id) == 0)
+            held = i;
+    }
+
+    /* an earlier change of the active call must not follow the waiting call */
+    if (held > waiting) {
+        syslog(LOG_ERR, "remote hold delivered after the waiting call in %s", __func__);
+        goto on_exit;
+    }
+
+    if (held < 0)
+        syslog(LOG_INFO, "remote hold is not reported in %s", __func__);
+
+    res = 0;
+
+on_exit:
+    call_order.recording = false;
+    tapi_call_set_event_coalescing(get_tapi_ctx(), slot_id, 0);
+    if (tapi_get_call_count(slot_id) > 0)
+        tapi_call_hangup_all_test(slot_id);
+
+    return res;
+}
+
 int call_check_alerting_status_after_dial(int slot_id)
 {
     int ret1 = tapi_call_dial_test(slot_id, phone_num, 0);
@@ -1711,6 +2315,51 @@ on_exit:
     return res;
 }
 
+int tapi_dtmf_sequence_test(int slot_id)
+{
+    tapi_dtmf_sequence_config config = {
+        .on_duration = 100,
+        .off_duration = 100,
+        .pause_duration = 500,
+        .wait_duration = 500,
+    };
+    int res = 0;
+
+    judge_data_init();
+    judge_data.expect = EVENT_REQUEST_DTMF_SEQUENCE_DONE;
+    int ret = tapi_call_play_dtmf_sequence(get_tapi_ctx(), slot_id, "12,3#", &config,
+        EVENT_REQUEST_DTMF_SEQUENCE_DONE, tele_call_async_fun);
+    if (ret) {
+        syslog(LOG_ERR, "tapi_call_play_dtmf_sequence execute fail in %s, ret: %d",
+            __func__, ret);
+        res = -1;
+        goto on_exit;
+    }
+
+    ret = tapi_call_play_dtmf_sequence(get_tapi_ctx(), slot_id, "4", &config,
+        EVENT_REQUEST_DTMF_SEQUENCE_DONE, tele_call_async_fun);
+    if (ret != -EBUSY) {
+        syslog(LOG_ERR, "second sequence is not rejected in %s, ret: %d", __func__, ret);
+        res = -1;
+        goto on_exit;
+    }
+
+    if (judge()) {
+        syslog(LOG_DEBUG, "tapi_dtmf_sequence_test is not executed in %s", __func__);
+        res = -1;
+        goto on_exit;
+    }
+
+    if (judge_data.result) {
+        syslog(LOG_ERR, "async result is invalid in %s", __func__);
+        res = -1;
+        goto on_exit;
+    }
+
+on_exit:
+    return res;
+}
+
 // todo: unsolicited message error, need gaojiawei fix
 int call_incoming_and_hangup_by_dialer_before_answer(int slot_id)
 {
@@ -2605,6 +3254,73 @@ on_exit:
     return res;
 }
 
+int call_merge_and_hangup_by_batch(int slot_id)
+{
+    int res = 0;
+    if (tapi_ss_set_call_waiting_test(0, true) < 0) {
+        syslog(LOG_ERR, "Set call waiting fail in %s", __func__);
+        res = -1;
+        goto on_exit;
+    }
+
+    if (tapi_call_dial_test(slot_id, phone_num, 0) < 0) {
+        syslog(LOG_ERR, "dail fail in %s", __func__);
+        res = -1;
+        goto on_exit;
+    }
+
+    if (call_check_alerting_status() < 0) {
+        syslog(LOG_ERR, "check alerting fail in %s", __func__);
+        res = -1;
+        goto on_exit;
+    }
+
+    sleep(3);
+    if (remote_operation_call_active_test(slot_id) < 0) {
+        syslog(LOG_ERR, "active call fail in %s", __func__);
+        res = -1;
+        goto on_exit;
+    }
+
+    sleep(3);
+    if (tapi_call_hold_test(slot_id) < 0) {
+        syslog(LOG_ERR, "hold call fail in %s", __func__);
+        res = -1;
+        goto on_exit;
+    }
+
+    sleep(3);
+    if (remote_operation_call_waiting_test(slot_id) < 0) {
+        syslog(LOG_ERR, "waiting call fail in %s", __func__);
+        res = -1;
+        goto on_exit;
+    }
+
+    sleep(3);
+    if (tapi_call_hold_and_answer_test(slot_id) < 0) {
+        syslog(LOG_ERR, "hold and answer call fail in %s", __func__);
+        res = -1;
+        goto on_exit;
+    }
+
+    sleep(3);
+    if (tapi_call_conference_batch_test(slot_id) < 0) {
+        syslog(LOG_ERR, "merge and hangup by batch fail in %s", __func__);
+        tapi_call_hangup_all_test(slot_id);
+        res = -1;
+        goto on_exit;
+    }
+
+    if (tapi_ss_set_call_waiting_test(0, false) < 0) {
+        syslog(LOG_ERR, "Set call waiting fail in %s", __func__);
+        res = -1;
+        goto on_exit;
+    }
+
+on_exit:
+    return res;
+}
+
 int call_separate_by_user(int slot_id)
 {
     int res = 0;
@@ -19,10 +19,13 @@
 #define NEW_CALL_DIALING 0x13
 #define NEW_CALL_ALERTING 0x14
 #define NEW_CONFERENCE_CALL 0x15
+#define GET_ALL_CALL_RECORDS 0x16
 #define EVENT_REQUEST_START_DTMF_DONE 0x30
 #define EVENT_REQUEST_STOP_DTMF_DONE 0x31
 #define EVENT_REQUEST_CALL_MERGE_DONE 0x32
 #define EVENT_REQUEST_CALL_SEPARATE_DONE 0x33
+#define EVENT_REQUEST_DTMF_SEQUENCE_DONE 0x34
+#define EVENT_REQUEST_CONFERENCE_BATCH_DONE 0x35
 
 int tapi_call_listen_call_test(int slot_id);
 int tapi_call_dial_test(int slot_id, char* phone_number, int hide_caller_id);
@@ -43,7 +46,16 @@ int tapi_dial_with_short_phone_number(int slot_id);
 int tapi_call_dial_conference_test(int slot_id);
 int tapi_start_dtmf_test(int slot_id);
 int tapi_stop_dtmf_test(int slot_id);
+int tapi_dtmf_sequence_test(int slot_id);
+int tapi_call_conference_batch_test(int slot_id);
 int tapi_call_load_ecc_list_test(int slot_id);
+int tapi_call_ecc_index_test(int slot_id);
+int tapi_call_kpi_stats_test(int slot_id);
+int tapi_call_event_coalescing_test(int slot_id);
+int tapi_call_event_ordering_test(int slot_id);
+int tapi_call_history_test(void);
+int tapi_call_history_wraparound_test(void);
+int tapi_call_history_benchmark_test(void);
 int tapi_call_get_call_test(int slot_id);
 int tapi_call_answer_call_test(int slot_id, char* call_id);
 int tapi_ss_listen_test(int slot_id);
@@ -81,6 +93,7 @@ int call_swap_dial_reject_swap(int slot_id);
 int call_release_and_answer(int slot_id);
 int call_hold_and_hangup(int slot_id);
 int call_merge_by_user(int slot_id);
+int call_merge_and_hangup_by_batch(int slot_id);
 int call_separate_by_user(int slot_id);
 int call_release_and_swap_other_call(int slot_id);
 int call_hold_incoming_hangup_second_recover_first(int slot_id);
@@ -117,6 +130,8 @@ int call_listen_and_unlisten_ss(int slot_id);
 int call_listen_error_ss_code(int slot_id);
 int tapi_call_hangup_all_test(int slot_id);
 int tapi_get_call_count(int slot_id);
+int tapi_call_snapshot_test(int slot_id);
+int tapi_call_records_test(int slot_id);
 int tapi_call_set_default_voicecall_slot_test(int slot_id);
 int tapi_call_get_default_voicecall_slot_test(int expect_res);
 int call_clear_voicecall_slot_set(void);
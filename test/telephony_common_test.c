@@ -507,6 +507,72 @@ on_exit:
     return res;
 }
 
+int tapi_number_key_test(int slot_id)
+{
+    tapi_number_key national, international, cached;
+    char number[MAX_PHONE_NUMBER_LENGTH + 1];
+
+    if (tapi_utils_number_key_from_string("13800138000", "460", &national) != OK
+        || tapi_utils_number_key_from_string("+86 138-0013-8000", "460", &international) != OK) {
+        syslog(LOG_ERR, "number key from string fail in %s", __func__);
+        return -1;
+    }
+
+    if (!tapi_utils_number_key_equal(&national, &international)) {
+        syslog(LOG_ERR, "national and international keys differ in %s", __func__);
+        return -1;
+    }
+
+    if (tapi_utils_number_key_to_string(&national, number, sizeof(number)) < 0
+        || strcmp(number, "+8613800138000") != 0) {
+        syslog(LOG_ERR, "number key to string fail in %s", __func__);
+        return -1;
+    }
+
+    if (tapi_utils_normalize_number(get_tapi_ctx(), slot_id, "112", &cached) != OK
+        || !(cached.flags & NUMBER_KEY_SHORT)) {
+        syslog(LOG_ERR, "short code is not kept in %s", __func__);
+        return -1;
+    }
+
+    if (tapi_utils_normalize_number(get_tapi_ctx(), slot_id, "abc", &cached) != -EINVAL) {
+        syslog(LOG_ERR, "invalid number is accepted in %s", __func__);
+        return -1;
+    }
+
+    return 0;
+}
+
+int tapi_dispatch_stats_test(void)
+{
+    tapi_dispatch_lane_stats stats;
+
+    if (tapi_reset_dispatch_stats(get_tapi_ctx()) != OK) {
+        syslog(LOG_ERR, "reset dispatch stats fail in %s", __func__);
+        return -1;
+    }
+
+    for (int lane = DISPATCH_LANE_HIGH; lane < DISPATCH_LANE_COUNT; lane++) {
+        if (tapi_get_dispatch_stats(get_tapi_ctx(), lane, &stats) != OK) {
+            syslog(LOG_ERR, "get dispatch stats of lane %d fail in %s", lane, __func__);
+            return -1;
+        }
+
+        if (stats.count != 0 || stats.dropped != 0 || stats.max_latency != 0
+            || stats.max_pending != stats.pending) {
+            syslog(LOG_ERR, "dispatch stats of lane %d are not reset in %s", lane, __func__);
+            return -1;
+        }
+    }
+
+    if (tapi_get_dispatch_stats(get_tapi_ctx(), DISPATCH_LANE_COUNT, &stats) != -EINVAL) {
+        syslog(LOG_ERR, "invalid lane is accepted in %s", __func__);
+        return -1;
+    }
+
+    return 0;
+}
+
 static void radio_signal_change(tapi_async_result* result)
 {
     int signal = result->msg_id;
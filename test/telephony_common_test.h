@@ -17,5 +17,7 @@ int tapi_invoke_oem_ril_request_strings_test(int slot_id, char* req_data, int le
 int tapi_enable_modem_test(int slot_id, int target_state);
 int tapi_get_modem_status_test(int slot_id, int* state);
 int tapi_set_pref_net_mode_test(int slot_id, tapi_pref_net_mode target_state);
+int tapi_number_key_test(int slot_id);
+int tapi_dispatch_stats_test(void);
 
 #endif
\ No newline at end of file
@@ -1,17 +1,162 @@
+#include <time.h>
+
 #include "telephony_data_test.h"
 
 extern struct judge_type judge_data;
+static tapi_apn_batch_result apn_batch_result;
+static tapi_data_slot_switch_result slot_switch_result;
+
+#define DATA_CALL_LIST_TEST_MAX 16
+
+// types and states of the last connection list, result->data dies with the callback
+static struct {
+    int count;
+    tapi_data_context_type types[DATA_CALL_LIST_TEST_MAX];
+    bool active[DATA_CALL_LIST_TEST_MAX];
+} data_call_list;
 static struct
 {
     int data_enabled_watch_id;
     int data_connection_state_change_watch_id;
     int data_on;
     int connection_state;
+    tapi_data_context* retained_context;
+    // last report of each context, the reference for the changed fields
+    tapi_data_context* reported[MAX_DATA_CALL_LIST_SIZE];
+    int reported_count;
+    int changed_fields;
+    int diff_errors;
+    // ms of the last internet activation and deactivation, 0 until reported
+    uint64_t internet_up_ms;
+    uint64_t internet_down_ms;
 } global_data;
 
+typedef struct {
+    const char* interface;
+    const char* ip;
+    const char* gateway;
+    const char* pcscf;
+    char* const* dns;
+} data_test_family;
+
 static void data_event_response(tapi_async_result* result);
 static void data_signal_change(tapi_async_result* result);
 
+static void data_test_reported_clear(void)
+{
+    for (int i = 0; i < global_data.reported_count; i++)
+        tapi_data_context_release(global_data.reported[i]);
+
+    global_data.reported_count = 0;
+    global_data.diff_errors = 0;
+}
+
+static void data_test_family_of(const tapi_data_context* dc, bool v6, data_test_family* out)
+{
+    const tapi_ipv4_settings* ipv4 = dc->ip_settings->ipv4;
+    const tapi_ipv6_settings* ipv6 = dc->ip_settings->ipv6;
+
+    memset(out, 0, sizeof(data_test_family));
+    out->interface = out->ip = out->gateway = out->pcscf = "";
+
+    if (!v6 && ipv4 != NULL) {
+        out->interface = ipv4->interface;
+        out->ip = ipv4->ip;
+        out->gateway = ipv4->gateway;
+        out->pcscf = ipv4->pcscf;
+        out->dns = ipv4->dns;
+    } else if (v6 && ipv6 != NULL) {
+        out->interface = ipv6->interface;
+        out->ip = ipv6->ip;
+        out->gateway = ipv6->gateway;
+        out->pcscf = ipv6->pcscf;
+        out->dns = ipv6->dns;
+    }
+}
+
+static bool data_test_dns_within(char* const* a, char* const* b)
+{
+    bool found;
+
+    for (int i = 0; a != NULL && i < MAX_DATA_DNS_COUNT; i++) {
+        if (a[i][0] == '\0')
+            continue;
+
+        found = false;
+        for (int j = 0; b != NULL && j < MAX_DATA_DNS_COUNT && !found; j++)
+            found = strcmp(a[i], b[j]) == 0;
+
+        if (!found)
+            return false;
+    }
+
+    return true;
+}
+
+// the fields expected in arg2, worked out from the two full reports.
+static int data_test_expected_changes(const tapi_data_context* prev, const tapi_data_context* dc)
+{
+    data_test_family a, b;
+    int changed = 0;
+
+    for (int v6 = 0; v6 < 2; v6++) {
+        data_test_family_of(prev, v6, &a);
+        data_test_family_of(dc, v6, &b);
+
+        if (strcmp(a.interface, b.interface) != 0)
+            changed |= DATA_CONNECTION_CHANGED_INTERFACE;
+        if (strcmp(a.ip, b.ip) != 0)
+            changed |= DATA_CONNECTION_CHANGED_ADDRESS;
+        if (strcmp(a.gateway, b.gateway) != 0)
+            changed |= DATA_CONNECTION_CHANGED_GATEWAY;
+        if (strcmp(a.pcscf, b.pcscf) != 0)
+            changed |= DATA_CONNECTION_CHANGED_PCSCF;
+        if (!data_test_dns_within(a.dns, b.dns) || !data_test_dns_within(b.dns, a.dns))
+            changed |= DATA_CONNECTION_CHANGED_DNS;
+    }
+
+    if (prev->ip_settings->mtu != dc->ip_settings->mtu)
+        changed |= DATA_CONNECTION_CHANGED_MTU;
+    if (prev->active != dc->active)
+        changed |= DATA_CONNECTION_CHANGED_ACTIVE;
+
+    return changed;
+}
+
+// every report is checked, an unchanged replay must give 0 and a new address the address bit.
+static void data_test_check_changes(tapi_data_context* dc, int changed)
+{
+    int expected = DATA_CONNECTION_CHANGED_ALL;
+    int index;
+
+    for (index = 0; index < global_data.reported_count; index++) {
+        if (strcmp(global_data.reported[index]->id, dc->id) == 0) {
+            expected = data_test_expected_changes(global_data.reported[index], dc);
+            tapi_data_context_release(global_data.reported[index]);
+            break;
+        }
+    }
+
+    if (changed != expected) {
+        syslog(LOG_ERR, "changed fields of %s are 0x%x, expected 0x%x in %s",
+            dc->id, changed, expected, __func__);
+        global_data.diff_errors++;
+    }
+
+    if (index == global_data.reported_count) {
+        if (index == MAX_DATA_CALL_LIST_SIZE)
+            return;
+
+        global_data.reported_count++;
+    }
+
+    global_data.reported[index] = tapi_data_context_retain(dc);
+    if (global_data.reported[index] == NULL) {
+        global_data.reported[index] = global_data.reported[--global_data.reported_count];
+        global_data.diff_errors++;
+    }
+}
+
 int tapi_data_listen_data_test(int slot_id)
 {
     global_data.data_enabled_watch_id = -1;
@@ -25,6 +170,8 @@ int tapi_data_listen_data_test(int slot_id)
         return -1;
     }
 
+    // a new watch reports every context in full first.
+    data_test_reported_clear();
     global_data.data_connection_state_change_watch_id = -1;
     global_data.data_connection_state_change_watch_id = tapi_data_register(
         get_tapi_ctx(), slot_id, MSG_DATA_CONNECTION_STATE_CHANGE_IND, NULL, data_signal_change);
@@ -51,6 +198,7 @@ int tapi_data_unlisten_data_test(void)
         goto on_exit;
     }
 
+    data_test_reported_clear();
     ret = tapi_data_unregister(get_tapi_ctx(), global_data.data_connection_state_change_watch_id);
     if (ret) {
         syslog(LOG_ERR, "unregister data connection state change fail in %s, ret: %d",
@@ -93,6 +241,148 @@ on_exit:
     return res;
 }
 
+int tapi_data_apn_cache_test(int slot_id)
+{
+    int ret = -1;
+    int res = 0;
+    judge_data_init();
+    judge_data.expect = EVENT_APN_LOADED_DONE;
+    ret = tapi_data_refresh_apn_contexts(get_tapi_ctx(), slot_id, EVENT_APN_LOADED_DONE, data_event_response);
+
+    if (ret) {
+        syslog(LOG_ERR, "tapi_data_refresh_apn_contexts execute fail in %s, ret: %d", __func__, ret);
+        res = -1;
+        goto on_exit;
+    }
+
+    if (judge()) {
+        syslog(LOG_ERR, "data_event_response called by %s is not execute", __func__);
+        res = -1;
+        goto on_exit;
+    }
+
+    // the refreshed table serves the next load before it returns.
+    judge_data_init();
+    judge_data.expect = EVENT_APN_LOADED_DONE;
+    ret = tapi_data_load_apn_contexts(get_tapi_ctx(), slot_id, EVENT_APN_LOADED_DONE, data_event_response);
+
+    if (ret) {
+        syslog(LOG_ERR, "tapi_data_load_apn_contexts execute fail in %s, ret: %d", __func__, ret);
+        res = -1;
+        goto on_exit;
+    }
+
+    if (judge_data.flag != EVENT_APN_LOADED_DONE || judge_data.result) {
+        syslog(LOG_ERR, "apn contexts are not served from cache in %s", __func__);
+        res = -1;
+        goto on_exit;
+    }
+
+on_exit:
+    return res;
+}
+
+int tapi_data_traffic_monitor_test(int slot_id)
+{
+    tapi_data_traffic_stats stats[MAX_DATA_CALL_LIST_SIZE];
+    int ret = -1;
+    int res = 0;
+
+    ret = tapi_data_enable_traffic_monitor(get_tapi_ctx(), slot_id, 0, 0, NULL, data_signal_change);
+    if (ret) {
+        syslog(LOG_ERR, "tapi_data_enable_traffic_monitor execute fail in %s, ret: %d", __func__, ret);
+        return -1;
+    }
+
+    ret = tapi_data_enable_traffic_monitor(get_tapi_ctx(), slot_id, 0, 0, NULL, data_signal_change);
+    if (ret != -EALREADY) {
+        syslog(LOG_ERR, "traffic monitor is enabled twice in %s, ret: %d", __func__, ret);
+        res = -1;
+        goto on_exit;
+    }
+
+    sleep(2);
+
+    ret = tapi_data_get_traffic_stats(get_tapi_ctx(), slot_id, stats, MAX_DATA_CALL_LIST_SIZE);
+    if (ret < 0) {
+        syslog(LOG_ERR, "tapi_data_get_traffic_stats execute fail in %s, ret: %d", __func__, ret);
+        res = -1;
+        goto on_exit;
+    }
+
+    for (int i = 0; i < ret; i++) {
+        syslog(LOG_DEBUG, "%s: active %d rx %llu tx %llu rx_rate %u tx_rate %u stalled %d",
+            stats[i].interface, stats[i].active,
+            (unsigned long long)stats[i].rx_bytes, (unsigned long long)stats[i].tx_bytes,
+            (unsigned int)stats[i].rx_rate, (unsigned int)stats[i].tx_rate, stats[i].stalled);
+    }
+
+on_exit:
+    ret = tapi_data_disable_traffic_monitor(get_tapi_ctx(), slot_id);
+    if (ret) {
+        syslog(LOG_ERR, "tapi_data_disable_traffic_monitor execute fail in %s, ret: %d", __func__, ret);
+        res = -1;
+    }
+
+    return res;
+}
+
+int tapi_data_apn_batch_test(int slot_id)
+{
+    tapi_data_context apn_add;
+    tapi_data_context apn_remove;
+    tapi_apn_op ops[2];
+    int ret = -1;
+    int res = 0;
+
+    memset(&apn_add, 0, sizeof(tapi_data_context));
+    apn_add.type = DATA_CONTEXT_TYPE_SUPL;
+    strcpy(apn_add.name, "batch");
+    strcpy(apn_add.accesspointname, "batch");
+
+    memset(&apn_remove, 0, sizeof(tapi_data_context));
+    apn_remove.id = "/ril_0/context_invalid";
+
+    // the removal fails, so the added apn is removed again.
+    ops[0].type = APN_OP_ADD;
+    ops[0].apn = &apn_add;
+    ops[1].type = APN_OP_REMOVE;
+    ops[1].apn = &apn_remove;
+
+    judge_data_init();
+    judge_data.expect = EVENT_APN_BATCH_DONE;
+    memset(&apn_batch_result, 0, sizeof(tapi_apn_batch_result));
+    ret = tapi_data_apn_batch(get_tapi_ctx(), slot_id, ops, 2, true, EVENT_APN_BATCH_DONE, data_event_response);
+
+    if (ret) {
+        syslog(LOG_ERR, "tapi_data_apn_batch execute fail in %s, ret: %d", __func__, ret);
+        res = -1;
+        goto on_exit;
+    }
+
+    if (judge()) {
+        syslog(LOG_ERR, "data_event_response called by %s is not execute", __func__);
+        res = -1;
+        goto on_exit;
+    }
+
+    if (judge_data.result == OK || apn_batch_result.count != 2
+        || apn_batch_result.results[1].status == OK) {
+        syslog(LOG_ERR, "apn batch result is invalid in %s", __func__);
+        res = -1;
+        goto on_exit;
+    }
+
+    if (apn_batch_result.results[0].status == OK && !apn_batch_result.results[0].rolled_back) {
+        syslog(LOG_ERR, "added apn is not rolled back in %s", __func__);
+        res = -1;
+        goto on_exit;
+    }
+
+on_exit:
+    return res;
+}
+
 int tapi_data_save_apn_context_test(char* slot_id, char* type, char* name, char* apn, char* proto, char* auth)
 {
     int ret = -1;
@@ -249,6 +539,10 @@ on_exit:
 
 int tapi_data_request_network_test(int slot_id, char* target_state)
 {
+    struct {
+        char padding[64];
+        tapi_data_context dc;
+    } foreign;
     int res = 0;
     judge_data_init();
     judge_data.expect = MSG_DATA_CONNECTION_STATE_CHANGE_IND;
@@ -281,10 +575,356 @@ int tapi_data_request_network_test(int slot_id, char* target_state)
         goto on_exit;
     }
 
+    if (global_data.diff_errors != 0
+        || !(global_data.changed_fields & DATA_CONNECTION_CHANGED_ACTIVE)) {
+        syslog(LOG_ERR, "changed fields 0x%x are wrong, %d errors in %s",
+            global_data.changed_fields, global_data.diff_errors, __func__);
+        res = -1;
+        goto on_exit;
+    }
+
+    // the retained context outlives the indication callback.
+    if (global_data.retained_context == NULL || global_data.retained_context->id == NULL
+        || !global_data.retained_context->active) {
+        syslog(LOG_ERR, "retained data context is invalid in %s", __func__);
+        res = -1;
+        goto on_exit;
+    }
+
+    // a context not delivered by the indication is rejected.
+    memset(&foreign, 0, sizeof(foreign));
+    if (tapi_data_context_retain(&foreign.dc) != NULL
+        || tapi_data_context_release(&foreign.dc) != -EINVAL) {
+        syslog(LOG_ERR, "foreign data context is retainable in %s", __func__);
+        res = -1;
+        goto on_exit;
+    }
+
+on_exit:
+    if (global_data.retained_context != NULL)
+        tapi_data_context_release(global_data.retained_context);
+    global_data.retained_context = NULL;
+    return res;
+}
+
+int tapi_data_acquire_network_test(int slot_id, char* type)
+{
+    int held = 0;
+    int count = 0;
+    int res = 0;
+    int ret;
+
+    // holders from earlier cases keep their references.
+    tapi_data_get_network_request_count(get_tapi_ctx(), slot_id, type, &held);
+
+    judge_data_init();
+    judge_data.expect = EVENT_DATA_NETWORK_ACQUIRE_DONE;
+    ret = tapi_data_acquire_network(get_tapi_ctx(), slot_id, type,
+        EVENT_DATA_NETWORK_ACQUIRE_DONE, data_event_response);
+    if (ret) {
+        syslog(LOG_ERR, "tapi_data_acquire_network execute fail in %s, ret: %d", __func__, ret);
+        return -1;
+    }
+
+    if (judge() || judge_data.result) {
+        syslog(LOG_ERR, "network of %s is not granted in %s", type, __func__);
+        return -1;
+    }
+
+    // the granted network serves the second holder before it returns.
+    judge_data_init();
+    judge_data.expect = EVENT_DATA_NETWORK_ACQUIRE_DONE;
+    ret = tapi_data_acquire_network(get_tapi_ctx(), slot_id, type,
+        EVENT_DATA_NETWORK_ACQUIRE_DONE, data_event_response);
+    if (ret || judge_data.flag != EVENT_DATA_NETWORK_ACQUIRE_DONE || judge_data.result) {
+        syslog(LOG_ERR, "second request of %s is not shared in %s, ret: %d", type, __func__, ret);
+        res = -1;
+    }
+
+    tapi_data_get_network_request_count(get_tapi_ctx(), slot_id, type, &count);
+    if (res == 0 && count != held + 2) {
+        syslog(LOG_ERR, "request count of %s is %d in %s", type, count, __func__);
+        res = -1;
+    }
+
+    for (int i = held; i < count; i++)
+        tapi_data_release_network(get_tapi_ctx(), slot_id, type);
+
+    tapi_data_get_network_request_count(get_tapi_ctx(), slot_id, type, &count);
+    if (count != held) {
+        syslog(LOG_ERR, "network of %s is still held in %s", type, __func__);
+        res = -1;
+    }
+
+    return res;
+}
+
+static uint64_t data_test_now_ms(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static int data_test_wait_ms(const uint64_t* stamp, int timeout_s)
+{
+    for (int i = 0; i < timeout_s * 100 && *stamp == 0; i++)
+        usleep(10000);
+
+    return *stamp != 0 ? 0 : -1;
+}
+
+// time from asking for the internet bearer until it is usable, cold and pre-warmed.
+int tapi_data_prewarm_benchmark_test(int slot_id)
+{
+    int default_slot = -1;
+    uint64_t begin;
+    int cold_ms;
+    int warm_ms;
+    int held = 0;
+    int res = 0;
+    int ret;
+
+    ret = tapi_data_get_default_slot(get_tapi_ctx(), &default_slot);
+    tapi_data_get_network_request_count(get_tapi_ctx(), slot_id, "internet", &held);
+    if (ret || default_slot != slot_id || held != 0) {
+        syslog(LOG_INFO, "slot %d is not an idle default data slot, skipped in %s",
+            slot_id, __func__);
+        return 0;
+    }
+
+    // cold: the bearer is set up on demand, so it must be down to start with.
+    judge_data_init();
+    judge_data.expect = EVENT_DATA_CALL_LIST_QUERY_DONE;
+    ret = tapi_data_get_data_connection_list_by_type(get_tapi_ctx(), slot_id,
+        DATA_CONTEXT_TYPE_INTERNET, EVENT_DATA_CALL_LIST_QUERY_DONE, data_event_response);
+    if (ret || judge() || judge_data.result || data_call_list.count != 0) {
+        syslog(LOG_INFO, "internet of slot %d is not down, skipped in %s", slot_id, __func__);
+        return 0;
+    }
+
+    global_data.internet_up_ms = 0;
+    begin = data_test_now_ms();
+    ret = tapi_data_request_network(get_tapi_ctx(), slot_id, "internet");
+    if (ret || data_test_wait_ms(&global_data.internet_up_ms, TIMEOUT)) {
+        syslog(LOG_ERR, "internet is not activated in %s, ret: %d", __func__, ret);
+        return -1;
+    }
+
+    cold_ms = global_data.internet_up_ms - begin;
+
+    global_data.internet_down_ms = 0;
+    tapi_data_release_network(get_tapi_ctx(), slot_id, "internet");
+    if (data_test_wait_ms(&global_data.internet_down_ms, TIMEOUT)) {
+        syslog(LOG_ERR, "internet is not deactivated in %s", __func__);
+        return -1;
+    }
+
+    // warm: the screen turning on brought the bearer up before it is asked for.
+    ret = tapi_data_enable_prewarm(get_tapi_ctx(), 0);
+    if (ret) {
+        syslog(LOG_ERR, "tapi_data_enable_prewarm execute fail in %s, ret: %d", __func__, ret);
+        return -1;
+    }
+
+    global_data.internet_up_ms = 0;
+    tapi_set_screen_state(get_tapi_ctx(), false);
+    tapi_set_screen_state(get_tapi_ctx(), true);
+    if (data_test_wait_ms(&global_data.internet_up_ms, TIMEOUT)) {
+        syslog(LOG_ERR, "internet is not pre-warmed in %s", __func__);
+        res = -1;
+        goto on_exit;
+    }
+
+    judge_data_init();
+    judge_data.expect = EVENT_DATA_CALL_LIST_QUERY_DONE;
+    begin = data_test_now_ms();
+    ret = tapi_data_request_network(get_tapi_ctx(), slot_id, "internet");
+    if (ret == OK)
+        ret = tapi_data_get_data_connection_list_by_type(get_tapi_ctx(), slot_id,
+            DATA_CONTEXT_TYPE_INTERNET, EVENT_DATA_CALL_LIST_QUERY_DONE, data_event_response);
+    if (ret || judge() || judge_data.result || data_call_list.count == 0) {
+        syslog(LOG_ERR, "pre-warmed internet is not usable in %s, ret: %d", __func__, ret);
+        res = -1;
+        goto on_exit;
+    }
+
+    warm_ms = data_test_now_ms() - begin;
+    syslog(LOG_INFO, "time to internet bearer: cold %d ms, pre-warmed %d ms", cold_ms, warm_ms);
+    tapi_data_release_network(get_tapi_ctx(), slot_id, "internet");
+
 on_exit:
+    global_data.internet_down_ms = 0;
+    tapi_data_disable_prewarm(get_tapi_ctx());
+    if (data_test_wait_ms(&global_data.internet_down_ms, TIMEOUT)) {
+        syslog(LOG_ERR, "pre-warmed internet is not deactivated in %s", __func__);
+        res = -1;
+    }
+
     return res;
 }
 
+int tapi_data_prewarm_test(int slot_id)
+{
+    int default_slot = -1;
+    int held = 0;
+    int count = 0;
+    int res = 0;
+    int ret;
+
+    // only the default data slot is pre-warmed.
+    ret = tapi_data_get_default_slot(get_tapi_ctx(), &default_slot);
+    if (ret || default_slot != slot_id) {
+        syslog(LOG_INFO, "slot %d is not the default data slot, skipped in %s",
+            slot_id, __func__);
+        return 0;
+    }
+
+    tapi_data_get_network_request_count(get_tapi_ctx(), slot_id, "internet", &held);
+
+    ret = tapi_data_enable_prewarm(get_tapi_ctx(), 0);
+    if (ret) {
+        syslog(LOG_ERR, "tapi_data_enable_prewarm execute fail in %s, ret: %d", __func__, ret);
+        return -1;
+    }
+
+    tapi_set_screen_state(get_tapi_ctx(), false);
+    tapi_set_screen_state(get_tapi_ctx(), true);
+    sleep(3);
+
+    // the pre-warm hold is one more request on the default data slot.
+    tapi_data_get_network_request_count(get_tapi_ctx(), slot_id, "internet", &count);
+    if (count != held + 1) {
+        syslog(LOG_ERR, "internet is not pre-warmed in %s, count: %d", __func__, count);
+        res = -1;
+        goto on_exit;
+    }
+
+    judge_data_init();
+    judge_data.expect = EVENT_DATA_NETWORK_ACQUIRE_DONE;
+    ret = tapi_data_acquire_network(get_tapi_ctx(), slot_id, "internet",
+        EVENT_DATA_NETWORK_ACQUIRE_DONE, data_event_response);
+    if (ret || judge() || judge_data.result) {
+        syslog(LOG_ERR, "pre-warmed internet is not granted in %s", __func__);
+        res = -1;
+        goto on_exit;
+    }
+
+    tapi_data_release_network(get_tapi_ctx(), slot_id, "internet");
+
+on_exit:
+    tapi_data_disable_prewarm(get_tapi_ctx());
+
+    tapi_data_get_network_request_count(get_tapi_ctx(), slot_id, "internet", &count);
+    if (count != held) {
+        syslog(LOG_ERR, "pre-warm hold is not dropped in %s, count: %d", __func__, count);
+        res = -1;
+    }
+
+    return res;
+}
+
+#if CONFIG_MODEM_ACTIVE_COUNT > 1
+static int data_switch_slot(int from_slot, int to_slot)
+{
+    // the fallback may wait the switch timeout twice.
+    int timeout = 2 * CONFIG_TELEPHONY_DATA_SLOT_SWITCH_TIMEOUT / 1000 + TIMEOUT;
+    int slot_id = -1;
+    int ret;
+
+    judge_data_init();
+    judge_data.expect = EVENT_DATA_SLOT_SWITCH_DONE;
+    memset(&slot_switch_result, 0, sizeof(tapi_data_slot_switch_result));
+    ret = tapi_data_switch_default_slot(get_tapi_ctx(), to_slot,
+        EVENT_DATA_SLOT_SWITCH_DONE, data_event_response);
+    if (ret) {
+        syslog(LOG_ERR, "tapi_data_switch_default_slot execute fail in %s, ret: %d", __func__, ret);
+        return -1;
+    }
+
+    while (judge_data.flag != EVENT_DATA_SLOT_SWITCH_DONE && timeout-- > 0)
+        sleep(1);
+
+    if (judge_data.flag != EVENT_DATA_SLOT_SWITCH_DONE || judge_data.result) {
+        syslog(LOG_ERR, "slot switch to %d is not completed in %s, result: %d",
+            to_slot, __func__, judge_data.result);
+        return -1;
+    }
+
+    if (slot_switch_result.from_slot != from_slot || slot_switch_result.to_slot != to_slot
+        || slot_switch_result.gap > slot_switch_result.duration) {
+        syslog(LOG_ERR, "slot switch result is invalid in %s", __func__);
+        return -1;
+    }
+
+    syslog(LOG_INFO, "%s: slot %d to %d %s, gap %u ms in %u ms", __func__, from_slot, to_slot,
+        slot_switch_result.parallel ? "parallel" : "sequential",
+        (unsigned int)slot_switch_result.gap, (unsigned int)slot_switch_result.duration);
+
+    ret = tapi_data_get_default_slot(get_tapi_ctx(), &slot_id);
+    if (ret || slot_id != to_slot) {
+        syslog(LOG_ERR, "default slot is %d instead of %d in %s", slot_id, to_slot, __func__);
+        return -1;
+    }
+
+    return 0;
+}
+#endif
+
+int tapi_data_switch_default_slot_test(void)
+{
+#if CONFIG_MODEM_ACTIVE_COUNT > 1
+    bool has_card = false;
+    int other_slot;
+#endif
+    int slot_id = -1;
+    int ret;
+
+    ret = tapi_data_get_default_slot(get_tapi_ctx(), &slot_id);
+    if (ret || slot_id < 0) {
+        syslog(LOG_ERR, "tapi_data_get_default_slot execute fail in %s, ret: %d", __func__, ret);
+        return -1;
+    }
+
+    // switching to the current slot completes at once without a gap.
+    judge_data_init();
+    judge_data.expect = EVENT_DATA_SLOT_SWITCH_DONE;
+    memset(&slot_switch_result, 0, sizeof(tapi_data_slot_switch_result));
+    ret = tapi_data_switch_default_slot(get_tapi_ctx(), slot_id,
+        EVENT_DATA_SLOT_SWITCH_DONE, data_event_response);
+    if (ret) {
+        syslog(LOG_ERR, "tapi_data_switch_default_slot execute fail in %s, ret: %d", __func__, ret);
+        return -1;
+    }
+
+    if (judge() || judge_data.result) {
+        syslog(LOG_ERR, "slot switch is not completed in %s", __func__);
+        return -1;
+    }
+
+    if (slot_switch_result.to_slot != slot_id || slot_switch_result.gap != 0) {
+        syslog(LOG_ERR, "slot switch result is invalid in %s", __func__);
+        return -1;
+    }
+
+#if CONFIG_MODEM_ACTIVE_COUNT > 1
+    // a real switch to the other slot and back, whichever path the modem takes.
+    other_slot = slot_id == 0 ? 1 : 0;
+    ret = tapi_sim_has_icc_card(get_tapi_ctx(), other_slot, &has_card);
+    if (ret || !has_card) {
+        syslog(LOG_INFO, "no sim in slot %d, cross-slot switch skipped in %s",
+            other_slot, __func__);
+        return 0;
+    }
+
+    if (data_switch_slot(slot_id, other_slot) || data_switch_slot(other_slot, slot_id))
+        return -1;
+#endif
+
+    return 0;
+}
+
 int tapi_data_release_network_test(int slot_id, char* target_state)
 {
     int res = 0;
@@ -318,6 +958,14 @@ int tapi_data_release_network_test(int slot_id, char* target_state)
         goto on_exit;
     }
 
+    if (global_data.diff_errors != 0
+        || !(global_data.changed_fields & DATA_CONNECTION_CHANGED_ACTIVE)) {
+        syslog(LOG_ERR, "changed fields 0x%x are wrong, %d errors in %s",
+            global_data.changed_fields, global_data.diff_errors, __func__);
+        res = -1;
+        goto on_exit;
+    }
+
 on_exit:
     return res;
 }
@@ -499,6 +1147,67 @@ on_exit:
     return res;
 }
 
+int tapi_data_get_data_call_list_by_type_test(int slot_id, int type)
+{
+    int expected = 0;
+    int res = 0;
+
+    // the unfiltered list tells how many connections of the type to expect.
+    if (tapi_data_get_data_call_list_test(slot_id)) {
+        syslog(LOG_ERR, "get data call list failed in %s", __func__);
+        return -1;
+    }
+
+    for (int i = 0; i < data_call_list.count; i++) {
+        if (type == DATA_CONTEXT_TYPE_ANY || data_call_list.types[i] == type)
+            expected++;
+    }
+
+    judge_data_init();
+    judge_data.expect = EVENT_DATA_CALL_LIST_QUERY_DONE;
+
+    int ret = tapi_data_get_data_connection_list_by_type(get_tapi_ctx(), slot_id,
+        type, EVENT_DATA_CALL_LIST_QUERY_DONE, data_event_response);
+    if (ret) {
+        syslog(LOG_DEBUG, "tapi_data_get_data_connection_list_by_type execute fail in %s",
+            __func__);
+        res = -1;
+        goto on_exit;
+    }
+
+    if (judge()) {
+        syslog(LOG_ERR, "data_event_response in %s is not executed", __func__);
+        res = -1;
+        goto on_exit;
+    }
+
+    if (judge_data.result) {
+        syslog(LOG_DEBUG, "async result is invalid in %s", __func__);
+        res = -1;
+        goto on_exit;
+    }
+
+    if (data_call_list.count != expected) {
+        syslog(LOG_ERR, "%d connections of type %d, expected %d in %s",
+            data_call_list.count, type, expected, __func__);
+        res = -1;
+        goto on_exit;
+    }
+
+    for (int i = 0; i < data_call_list.count; i++) {
+        if (!data_call_list.active[i]
+            || (type != DATA_CONTEXT_TYPE_ANY && data_call_list.types[i] != type)) {
+            syslog(LOG_ERR, "connection %d of type %d, active %d returned for type %d in %s",
+                i, data_call_list.types[i], data_call_list.active[i], type, __func__);
+            res = -1;
+            goto on_exit;
+        }
+    }
+
+on_exit:
+    return res;
+}
+
 static void data_event_response(tapi_async_result* result)
 {
     syslog(LOG_DEBUG, "%s : \n", __func__);
@@ -546,6 +1255,26 @@ static void data_event_response(tapi_async_result* result)
             judge_data.flag = EVENT_APN_RESTORE_DONE;
         }
         break;
+    case EVENT_DATA_NETWORK_ACQUIRE_DONE:
+        if (judge_data.expect == EVENT_DATA_NETWORK_ACQUIRE_DONE) {
+            judge_data.result = status;
+            judge_data.flag = EVENT_DATA_NETWORK_ACQUIRE_DONE;
+        }
+        break;
+    case EVENT_DATA_SLOT_SWITCH_DONE:
+        if (judge_data.expect == EVENT_DATA_SLOT_SWITCH_DONE) {
+            memcpy(&slot_switch_result, result->data, sizeof(tapi_data_slot_switch_result));
+            judge_data.result = status;
+            judge_data.flag = EVENT_DATA_SLOT_SWITCH_DONE;
+        }
+        break;
+    case EVENT_APN_BATCH_DONE:
+        if (judge_data.expect == EVENT_APN_BATCH_DONE) {
+            memcpy(&apn_batch_result, result->data, sizeof(tapi_apn_batch_result));
+            judge_data.result = status;
+            judge_data.flag = EVENT_APN_BATCH_DONE;
+        }
+        break;
     case EVENT_DATA_ALLOWED_DONE:
         if (judge_data.expect == EVENT_DATA_ALLOWED_DONE) {
             judge_data.result = status;
@@ -559,6 +1288,15 @@ static void data_event_response(tapi_async_result* result)
         break;
     case EVENT_DATA_CALL_LIST_QUERY_DONE:
         if (judge_data.expect == EVENT_DATA_CALL_LIST_QUERY_DONE) {
+            tapi_data_context** contexts = result->data;
+
+            data_call_list.count = 0;
+            for (int i = 0; i < result->arg2 && i < DATA_CALL_LIST_TEST_MAX; i++) {
+                data_call_list.types[i] = contexts[i]->type;
+                data_call_list.active[i] = contexts[i]->active;
+                data_call_list.count++;
+            }
+
             judge_data.result = status;
             judge_data.flag = EVENT_DATA_CALL_LIST_QUERY_DONE;
         }
@@ -618,13 +1356,30 @@ static void data_signal_change(tapi_async_result* result)
         }
         break;
     case MSG_DATA_CONNECTION_STATE_CHANGE_IND:
+        if (result->data != NULL) {
+            dc = result->data;
+            data_test_check_changes(dc, result->arg2);
+
+            if (dc->type == DATA_CONTEXT_TYPE_INTERNET
+                && (result->arg2 & DATA_CONNECTION_CHANGED_ACTIVE)) {
+                if (dc->active)
+                    global_data.internet_up_ms = data_test_now_ms();
+                else
+                    global_data.internet_down_ms = data_test_now_ms();
+            }
+        }
+
         if (judge_data.expect == MSG_DATA_CONNECTION_STATE_CHANGE_IND) {
             dc = result->data;
+            global_data.changed_fields = result->arg2;
             if (dc != NULL) {
                 syslog(LOG_DEBUG, "id (apn_path) = %s \n", dc->id);
                 syslog(LOG_DEBUG, "type = %s \n", tapi_utils_apn_type_to_string(dc->type));
                 syslog(LOG_DEBUG, "active = %d \n", dc->active);
+                syslog(LOG_DEBUG, "changed fields = 0x%x \n", result->arg2);
                 global_data.connection_state = dc->active;
+                tapi_data_context_release(global_data.retained_context);
+                global_data.retained_context = tapi_data_context_retain(dc);
                 if (dc->ip_settings != NULL) {
                     ipv4 = dc->ip_settings->ipv4;
                     if (ipv4 != NULL) {
@@ -642,6 +1397,9 @@ static void data_signal_change(tapi_async_result* result)
             judge_data.flag = MSG_DATA_CONNECTION_STATE_CHANGE_IND;
         }
         break;
+    case MSG_DATA_STALL_IND:
+        syslog(LOG_DEBUG, "data stall changed to %d in slot[%d] \n", param, slot_id);
+        break;
     default:
         break;
     }
@@ -714,6 +1472,13 @@ int data_get_call_list(int slot_id)
         goto on_exit;
     }
 
+    ret = tapi_data_get_data_call_list_by_type_test(slot_id, DATA_CONTEXT_TYPE_INTERNET);
+    if (ret) {
+        syslog(LOG_ERR, "get internet data call list failed in %s", __func__);
+        res = -1;
+        goto on_exit;
+    }
+
     ret = tapi_data_enable_test(0);
     if (ret) {
         syslog(LOG_ERR, "disable data failed in %s", __func__);
@@ -7,6 +7,13 @@ int tapi_data_listen_data_test(int slot_id);
 int tapi_data_unlisten_data_test(void);
 int tapi_data_enable_test(int state);
 int tapi_data_load_apn_contexts_test(int slot_id);
+int tapi_data_apn_cache_test(int slot_id);
+int tapi_data_traffic_monitor_test(int slot_id);
+int tapi_data_apn_batch_test(int slot_id);
+int tapi_data_acquire_network_test(int slot_id, char* type);
+int tapi_data_prewarm_test(int slot_id);
+int tapi_data_prewarm_benchmark_test(int slot_id);
+int tapi_data_switch_default_slot_test(void);
 int tapi_data_save_apn_context_test(char* slot_id, char* type, char* name, char* apn, char* proto, char* auth);
 int tapi_data_edit_apn_context_test(char* slot_id, char* id, char* type, char* name, char* apn, char* proto, char* auth);
 int tapi_data_remove_apn_context_test(char* slot_id, char* id);
@@ -25,6 +32,7 @@ int tapi_data_get_default_data_slot_test(void);
 int tapi_data_set_data_allow_test(int slot_id);
 int tapi_data_send_screen_stat_test(int slot_id);
 int tapi_data_get_data_call_list_test(int slot_id);
+int tapi_data_get_data_call_list_by_type_test(int slot_id, int type);
 int data_enabled_test(int slot_id);
 int data_disabled_test(int slot_id);
 int data_release_network_test(int slot_id);
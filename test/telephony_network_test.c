@@ -358,4 +358,443 @@ int tapi_net_get_voice_registered_test(int slot_id)
     syslog(LOG_DEBUG, "%s, slot_id: %d, voice_reg: %d", __func__, slot_id, (int)result);
 
     return ret || !result;
-}
\ No newline at end of file
+}
+
+#define CELL_HISTORY_TEST_CAPACITY 256
+#define CELL_HISTORY_TEST_FILE "/tmp/cell_history.bin"
+
+/* Returns the records of the exported file, -1 if it is malformed */
+static int net_cell_history_exported(int slot_id)
+{
+    uint32_t header[4];
+    int64_t first_ts, last_ts;
+    uint16_t used, records;
+    int total = 0;
+    FILE* fp;
+
+    fp = fopen(CELL_HISTORY_TEST_FILE, "rb");
+    if (fp == NULL)
+        return -1;
+
+    // magic "TCHS", version 1 and the slot.
+    if (fread(header, sizeof(header), 1, fp) != 1 || header[0] != 0x53484354
+        || header[1] != ((1u << 16) | (uint32_t)slot_id)) {
+        fclose(fp);
+        return -1;
+    }
+
+    for (uint32_t i = 0; i < header[3]; i++) {
+        if (fread(&first_ts, sizeof(first_ts), 1, fp) != 1
+            || fread(&last_ts, sizeof(last_ts), 1, fp) != 1
+            || fread(&used, sizeof(used), 1, fp) != 1
+            || fread(&records, sizeof(records), 1, fp) != 1
+            || used > header[2] || first_ts > last_ts
+            || fseek(fp, used, SEEK_CUR) != 0) {
+            fclose(fp);
+            return -1;
+        }
+
+        total += records;
+    }
+
+    fclose(fp);
+    return total;
+}
+
+int tapi_net_cell_history_test(int slot_id)
+{
+    tapi_cell_measurement* records;
+    tapi_cell_measurement* found;
+    int count = 0;
+    int matches = 0;
+    int res = 0;
+    int ret;
+
+    records = malloc(2 * CELL_HISTORY_TEST_CAPACITY * sizeof(tapi_cell_measurement));
+    if (records == NULL)
+        return -1;
+
+    found = records + CELL_HISTORY_TEST_CAPACITY;
+
+    ret = tapi_network_cell_history_enable(get_tapi_ctx(), slot_id, true);
+    if (ret) {
+        syslog(LOG_ERR, "tapi_network_cell_history_enable execute fail in %s, ret: %d",
+            __func__, ret);
+        free(records);
+        return -1;
+    }
+
+    // wait for the modem to report a cell list.
+    for (int i = 0; i < TIMEOUT && count == 0; i++) {
+        sleep(1);
+        count = tapi_network_cell_history_query_by_time(get_tapi_ctx(), slot_id,
+            0, INT64_MAX, records, CELL_HISTORY_TEST_CAPACITY);
+    }
+
+    syslog(LOG_DEBUG, "%s, slot_id: %d, records: %d", __func__, slot_id, count);
+    if (count <= 0) {
+        syslog(LOG_ERR, "no cell measurement recorded in %s, ret: %d", __func__, count);
+        res = -1;
+        goto on_exit;
+    }
+
+    // the decoded records come back oldest first.
+    for (int i = 1; i < count; i++) {
+        if (records[i].timestamp < records[i - 1].timestamp) {
+            syslog(LOG_ERR, "records are out of order in %s", __func__);
+            res = -1;
+            goto on_exit;
+        }
+    }
+
+    // a window of one timestamp returns exactly the records of that timestamp.
+    for (int i = 0; i < count; i++) {
+        if (records[i].timestamp == records[0].timestamp)
+            matches++;
+    }
+
+    ret = tapi_network_cell_history_query_by_time(get_tapi_ctx(), slot_id,
+        records[0].timestamp, records[0].timestamp, found, CELL_HISTORY_TEST_CAPACITY);
+    if (ret != matches || memcmp(found, records, matches * sizeof(tapi_cell_measurement)) != 0) {
+        syslog(LOG_ERR, "time window query is invalid in %s, ret: %d, expected: %d",
+            __func__, ret, matches);
+        res = -1;
+        goto on_exit;
+    }
+
+    // the cell query returns the same records filtered by cell id.
+    matches = 0;
+    for (int i = 0; i < count; i++) {
+        if (records[i].ci == records[0].ci)
+            matches++;
+    }
+
+    ret = tapi_network_cell_history_query_by_cell(get_tapi_ctx(), slot_id,
+        records[0].ci, found, CELL_HISTORY_TEST_CAPACITY);
+    if (ret < matches) {
+        syslog(LOG_ERR, "cell query is invalid in %s, ret: %d, expected: %d",
+            __func__, ret, matches);
+        res = -1;
+        goto on_exit;
+    }
+
+    for (int i = 0; i < ret; i++) {
+        if (found[i].ci != records[0].ci) {
+            syslog(LOG_ERR, "cell query returns cell %d in %s", found[i].ci, __func__);
+            res = -1;
+            goto on_exit;
+        }
+    }
+
+    // records may arrive between the queries, the export holds at least as many.
+    count = tapi_network_cell_history_query_by_time(get_tapi_ctx(), slot_id,
+        0, INT64_MAX, records, CELL_HISTORY_TEST_CAPACITY);
+    ret = tapi_network_cell_history_export(get_tapi_ctx(), slot_id, CELL_HISTORY_TEST_FILE);
+    if (ret) {
+        syslog(LOG_ERR, "tapi_network_cell_history_export execute fail in %s, ret: %d",
+            __func__, ret);
+        res = -1;
+        goto on_exit;
+    }
+
+    ret = net_cell_history_exported(slot_id);
+    if (ret < 0 || (count < CELL_HISTORY_TEST_CAPACITY && ret < count)) {
+        syslog(LOG_ERR, "exported history is invalid in %s, records: %d, expected: %d",
+            __func__, ret, count);
+        res = -1;
+        goto on_exit;
+    }
+
+on_exit:
+    unlink(CELL_HISTORY_TEST_FILE);
+    tapi_network_cell_history_enable(get_tapi_ctx(), slot_id, false);
+    free(records);
+    return res;
+}
+
+int tapi_net_cell_rate_control_test(int slot_id)
+{
+    tapi_cell_rate_config config = { 2000, 30000, 6 };
+    tapi_cell_rate_stats stats;
+    int res = 0;
+    int ret;
+
+    ret = tapi_network_set_cell_rate_control(get_tapi_ctx(), slot_id, true, &config);
+    if (ret) {
+        syslog(LOG_ERR, "tapi_network_set_cell_rate_control execute fail in %s, ret: %d",
+            __func__, ret);
+        return -1;
+    }
+
+    ret = tapi_network_get_cell_rate_stats(get_tapi_ctx(), slot_id, &stats);
+    syslog(LOG_DEBUG, "%s, slot_id: %d, period: %u", __func__, slot_id, stats.current_period);
+    if (ret || stats.current_period < config.min_period
+        || stats.current_period > config.max_period) {
+        syslog(LOG_ERR, "cell rate stats is error in %s, ret: %d", __func__, ret);
+        res = -1;
+    }
+
+    tapi_network_set_cell_rate_control(get_tapi_ctx(), slot_id, false, NULL);
+    return res;
+}
+
+static struct
+{
+    tapi_cell_identity cells[MAX_CELL_INFO_LIST_SIZE];
+    int count;
+    int snapshots;
+    int diffs;
+    int errors;
+} cell_diff_data;
+
+static int cell_diff_find(const tapi_cell_identity* cell)
+{
+    for (int i = 0; i < cell_diff_data.count; i++) {
+        const tapi_cell_identity* known = &cell_diff_data.cells[i];
+
+        if (known->type != cell->type || known->earfcn != cell->earfcn)
+            continue;
+
+        if (cell->type == TYPE_LTE || cell->type == TYPE_NR
+                ? known->pci == cell->pci
+                : known->ci == cell->ci)
+            return i;
+    }
+
+    return -1;
+}
+
+static void cell_diff_callback(tapi_async_result* result)
+{
+    tapi_cell_list_diff* diff = result->data;
+    int index;
+
+    if (result->status != OK || diff == NULL)
+        return;
+
+    if (diff->snapshot) {
+        cell_diff_data.snapshots++;
+        cell_diff_data.count = 0;
+        for (int i = 0; i < diff->added_count; i++)
+            cell_diff_data.cells[cell_diff_data.count++] = *diff->added[i];
+        return;
+    }
+
+    cell_diff_data.diffs++;
+
+    // an unchanged list is not reported, an unchanged cell is in no set.
+    if (result->arg2 == 0)
+        cell_diff_data.errors++;
+
+    for (int i = 0; i < diff->changed_count; i++) {
+        index = cell_diff_find(diff->changed[i]);
+        if (index < 0 || memcmp(&cell_diff_data.cells[index], diff->changed[i],
+                             sizeof(tapi_cell_identity))
+                == 0) {
+            syslog(LOG_ERR, "unchanged cell %d reported as changed", diff->changed[i]->pci);
+            cell_diff_data.errors++;
+            continue;
+        }
+
+        cell_diff_data.cells[index] = *diff->changed[i];
+    }
+
+    for (int i = 0; i < diff->removed_count; i++) {
+        index = cell_diff_find(diff->removed[i]);
+        if (index < 0) {
+            cell_diff_data.errors++;
+            continue;
+        }
+
+        cell_diff_data.cells[index] = cell_diff_data.cells[--cell_diff_data.count];
+    }
+
+    for (int i = 0; i < diff->added_count; i++) {
+        if (cell_diff_find(diff->added[i]) >= 0 || cell_diff_data.count >= MAX_CELL_INFO_LIST_SIZE) {
+            cell_diff_data.errors++;
+            continue;
+        }
+
+        cell_diff_data.cells[cell_diff_data.count++] = *diff->added[i];
+    }
+}
+
+int tapi_net_cell_diff_register_test(int slot_id)
+{
+    int watch_id;
+    int res = 0;
+    int ret;
+
+    memset(&cell_diff_data, 0, sizeof(cell_diff_data));
+
+    watch_id = tapi_network_register(get_tapi_ctx(), slot_id, MSG_CELLINFO_DIFF_IND,
+        NULL, cell_diff_callback);
+    if (watch_id <= 0) {
+        syslog(LOG_ERR, "tapi_network_register execute fail in %s, ret: %d",
+            __func__, watch_id);
+        return -1;
+    }
+
+    // the first indication is a snapshot, the following ones only carry changes.
+    for (int i = 0; i < TIMEOUT && cell_diff_data.diffs == 0; i++)
+        sleep(1);
+
+    syslog(LOG_DEBUG, "%s, slot_id: %d, snapshots: %d, diffs: %d, cells: %d", __func__,
+        slot_id, cell_diff_data.snapshots, cell_diff_data.diffs, cell_diff_data.count);
+    if (cell_diff_data.snapshots != 1 || cell_diff_data.errors > 0) {
+        syslog(LOG_ERR, "cell diff is invalid in %s, errors: %d", __func__,
+            cell_diff_data.errors);
+        res = -1;
+    }
+
+    ret = tapi_network_request_cell_snapshot(get_tapi_ctx(), watch_id);
+    if (ret) {
+        syslog(LOG_ERR, "tapi_network_request_cell_snapshot execute fail in %s, ret: %d",
+            __func__, ret);
+        res = -1;
+    }
+
+    if (tapi_network_unregister(get_tapi_ctx(), watch_id))
+        res = -1;
+
+    return res;
+}
+
+/* Waits for a sampled metric of any RAT, returns false if none arrives */
+static bool net_signal_stats_wait(int slot_id, tapi_signal_metric_stats* stats)
+{
+    for (int i = 0; i < TIMEOUT; i++) {
+        for (int rat = TYPE_GSM; rat <= TYPE_NR; rat++) {
+            for (int metric = 0; metric < SIGNAL_METRIC_COUNT; metric++) {
+                if (tapi_network_get_signal_stats(get_tapi_ctx(), slot_id, rat,
+                        metric, stats)
+                        == OK
+                    && stats->count > 0)
+                    return true;
+            }
+        }
+
+        sleep(1);
+    }
+
+    return false;
+}
+
+static bool net_signal_stats_valid(const tapi_signal_metric_stats* stats, int window)
+{
+    int64_t range = stats->max - stats->min;
+
+    syslog(LOG_DEBUG, "%s, count: %d, last: %d, min: %d, p10: %d, p50: %d, p90: %d, "
+                      "max: %d, mean: %d, variance: %d, ewma: %d",
+        __func__, stats->count, stats->last, stats->min, stats->p10, stats->p50,
+        stats->p90, stats->max, stats->mean, stats->variance, stats->ewma);
+
+    // ordered ranks, every average within the range, variance bounded by it.
+    return stats->count >= 1 && stats->count <= window
+        && stats->min <= stats->p10 && stats->p10 <= stats->p50
+        && stats->p50 <= stats->p90 && stats->p90 <= stats->max
+        && stats->last >= stats->min && stats->last <= stats->max
+        && stats->mean >= stats->min && stats->mean <= stats->max
+        && stats->ewma >= stats->min && stats->ewma <= stats->max
+        && stats->variance >= 0 && stats->variance <= range * range / 4 + 1;
+}
+
+int tapi_net_signal_stats_test(int slot_id)
+{
+    tapi_signal_metric_stats stats;
+    int res = 0;
+    int ret;
+
+    ret = tapi_network_signal_stats_enable(get_tapi_ctx(), slot_id, true, 16);
+    if (ret) {
+        syslog(LOG_ERR, "tapi_network_signal_stats_enable execute fail in %s, ret: %d",
+            __func__, ret);
+        return -1;
+    }
+
+    if (!net_signal_stats_wait(slot_id, &stats) || !net_signal_stats_valid(&stats, 16)) {
+        syslog(LOG_ERR, "signal stats of window 16 is invalid in %s", __func__);
+        res = -1;
+        goto on_exit;
+    }
+
+    // a window of one sample: every statistic is that sample.
+    ret = tapi_network_signal_stats_enable(get_tapi_ctx(), slot_id, true, 1);
+    if (ret || !net_signal_stats_wait(slot_id, &stats) || !net_signal_stats_valid(&stats, 1)
+        || stats.min != stats.last || stats.max != stats.last || stats.p50 != stats.last
+        || stats.mean != stats.last || stats.ewma != stats.last || stats.variance != 0) {
+        syslog(LOG_ERR, "signal stats of window 1 is invalid in %s, ret: %d", __func__, ret);
+        res = -1;
+    }
+
+on_exit:
+    tapi_network_signal_stats_enable(get_tapi_ctx(), slot_id, false, 0);
+    return res;
+}
+
+static void* registration_info_dup(tapi_async_result* result)
+{
+    tapi_registration_info* info;
+
+    if (result->data == NULL)
+        return NULL;
+
+    info = malloc(sizeof(tapi_registration_info));
+    if (info != NULL)
+        memcpy(info, result->data, sizeof(tapi_registration_info));
+
+    return info;
+}
+
+static void fan_out_event_callback(tapi_async_result* result)
+{
+    tapi_fan_out_slot_result* slot_results = result->data;
+    tapi_registration_info* info;
+
+    if (judge_data.expect != EVENT_NETWORK_FAN_OUT_DONE)
+        return;
+
+    judge_data.result = -1;
+    for (int i = 0; i < result->arg2; i++) {
+        info = slot_results[i].data;
+        syslog(LOG_DEBUG, "%s, slot_id: %d, status: %d, reg_state: %d", __func__,
+            slot_results[i].slot_id, slot_results[i].status, info ? info->reg_state : -1);
+
+        /* slot 0 is expected to be registered, others may be absent */
+        if (slot_results[i].slot_id == 0 && slot_results[i].status == OK && info != NULL)
+            judge_data.result = 0;
+    }
+
+    judge_data.flag = EVENT_NETWORK_FAN_OUT_DONE;
+}
+
+int tapi_net_fan_out_registration_info_test(void)
+{
+    int res = 0;
+    judge_data_init();
+    judge_data.expect = EVENT_NETWORK_FAN_OUT_DONE;
+
+    int ret = tapi_fan_out(get_tapi_ctx(), EVENT_NETWORK_FAN_OUT_DONE,
+        tapi_network_get_registration_info, registration_info_dup, 5000,
+        fan_out_event_callback);
+    if (ret) {
+        syslog(LOG_ERR, "tapi_fan_out execute fail in %s, ret: %d", __func__, ret);
+        res = -1;
+        goto on_exit;
+    }
+
+    if (judge()) {
+        syslog(LOG_ERR, "fan_out_event_callback is not executed in %s", __func__);
+        res = -1;
+        goto on_exit;
+    }
+
+    if (judge_data.result) {
+        syslog(LOG_ERR, "async result is error in %s", __func__);
+        res = -1;
+        goto on_exit;
+    }
+
+on_exit:
+    return res;
+}
@@ -13,5 +13,10 @@ int tapi_net_get_voice_networktype_test(int slot_id, tapi_network_type* type);
 int tapi_net_get_operator_name_test(int slot_id);
 int tapi_net_query_signalstrength_test(int slot_id);
 int tapi_net_get_voice_registered_test(int slot_id);
+int tapi_net_cell_history_test(int slot_id);
+int tapi_net_cell_rate_control_test(int slot_id);
+int tapi_net_cell_diff_register_test(int slot_id);
+int tapi_net_signal_stats_test(int slot_id);
+int tapi_net_fan_out_registration_info_test(void);
 
 #endif /* TELEPHONY_NETWORK_TEST_H_ */
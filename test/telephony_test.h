@@ -32,6 +32,9 @@
 #define EVENT_DATA_ALLOWED_DONE 0x101D
 #define EVENT_DATA_CALL_LIST_QUERY_DONE 0x101E
 #define EVENT_REQUEST_SCREEN_STATE_DONE 0x101F
+#define EVENT_APN_BATCH_DONE 0x1020
+#define EVENT_DATA_NETWORK_ACQUIRE_DONE 0x1021
+#define EVENT_DATA_SLOT_SWITCH_DONE 0x1022
 
 // SIM Callback Event
 #define EVENT_CHANGE_SIM_PIN_DONE 0x21
@@ -53,6 +56,7 @@
 #define EVENT_QUERY_SERVING_CELL_DONE 0x35
 #define EVENT_QUERY_NEIGHBOURING_CELL_DONE 0x36
 #define EVENT_NETWORK_SET_CELL_INFO_LIST_RATE_DONE 0x37
+#define EVENT_NETWORK_FAN_OUT_DONE 0x38
 
 // SS Callback Event
 #define EVENT_REQUEST_CALL_BARRING_DONE 0x41
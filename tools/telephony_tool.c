@@ -745,6 +745,7 @@ static void network_event_callback(tapi_async_result* result)
 
 static void network_signal_change(tapi_async_result* result)
 {
+    tapi_cell_list_diff* diff;
     tapi_cell_identity** cell_list;
     tapi_cell_identity* cell;
     tapi_network_time* nitz;
@@ -773,6 +774,26 @@ static void network_signal_change(tapi_async_result* result)
             syslog(LOG_DEBUG, "phone state changed to %d in slot[%d] \n", param, slot_id);
         }
         break;
+    case MSG_CELLINFO_DIFF_IND:
+        diff = result->data;
+        if (diff != NULL) {
+            syslog(LOG_DEBUG, "cell list diff in slot[%d] -- snapshot : %d, added : %d, "
+                              "removed : %d, changed : %d \n",
+                slot_id, diff->snapshot, diff->added_count, diff->removed_count,
+                diff->changed_count);
+            for (int i = 0; i < diff->added_count; i++)
+                syslog(LOG_DEBUG, "added ci : %d, pci : %d, earfcn : %d, rsrp : %d \n",
+                    diff->added[i]->ci, diff->added[i]->pci, diff->added[i]->earfcn,
+                    diff->added[i]->signal_strength.rsrp);
+            for (int i = 0; i < diff->removed_count; i++)
+                syslog(LOG_DEBUG, "removed ci : %d, pci : %d, earfcn : %d \n",
+                    diff->removed[i]->ci, diff->removed[i]->pci, diff->removed[i]->earfcn);
+            for (int i = 0; i < diff->changed_count; i++)
+                syslog(LOG_DEBUG, "changed ci : %d, pci : %d, earfcn : %d, rsrp : %d \n",
+                    diff->changed[i]->ci, diff->changed[i]->pci, diff->changed[i]->earfcn,
+                    diff->changed[i]->signal_strength.rsrp);
+        }
+        break;
     case MSG_SIGNAL_STRENGTH_CHANGE_IND:
         ss = result->data;
         if (ss != NULL)
@@ -884,6 +905,7 @@ static void data_signal_change(tapi_async_result* result)
         syslog(LOG_DEBUG, "id (apn_path) = %s \n", dc->id);
         syslog(LOG_DEBUG, "type = %s \n", tapi_utils_apn_type_to_string(dc->type));
         syslog(LOG_DEBUG, "active = %d \n", dc->active);
+        syslog(LOG_DEBUG, "changed fields = 0x%x \n", result->arg2);
 
         if (dc->ip_settings == NULL)
             break;
@@ -1415,6 +1437,66 @@ static int telephonytool_cmd_deflect_call(tapi_context context, char* pargs)
     return tapi_call_deflect_by_id(context, atoi(slot_id), (char*)dst[1], (char*)dst[2]);
 }
 
+static void print_call_kpi_histogram(const char* name, const tapi_call_kpi_histogram* h)
+{
+    syslog(LOG_DEBUG, "%s: count %u, min %u, max %u, mean %u (ms)\n", name, h->count,
+        h->min, h->max, h->count > 0 ? (u_int32_t)(h->sum / h->count) : 0);
+
+    for (int i = 0; i < CALL_KPI_BUCKET_COUNT; i++) {
+        if (i < CALL_KPI_BUCKET_COUNT - 1)
+            syslog(LOG_DEBUG, "  < %u ms : %u\n", h->unit << i, h->buckets[i]);
+        else
+            syslog(LOG_DEBUG, "  >= %u ms : %u\n", h->unit << (i - 1), h->buckets[i]);
+    }
+}
+
+static int telephonytool_cmd_get_call_kpi(tapi_context context, char* pargs)
+{
+    char dst[1][MAX_INPUT_ARGS_LEN];
+    int cnt = split_input(dst, 1, pargs, " ");
+    tapi_call_kpi_stats stats;
+    char* slot_id;
+    int ret;
+
+    if (cnt != 1)
+        return -EINVAL;
+
+    slot_id = dst[0];
+    if (!is_valid_slot_id_str(slot_id))
+        return -EINVAL;
+
+    ret = tapi_call_get_kpi_stats(context, atoi(slot_id), &stats);
+    if (ret != OK)
+        return ret;
+
+    print_call_kpi_histogram("dial reply", &stats.dial_reply);
+    print_call_kpi_histogram("dial to alerting", &stats.dial_alerting);
+    print_call_kpi_histogram("dial to active", &stats.dial_active);
+    print_call_kpi_histogram("incoming to answer", &stats.incoming_answer);
+    print_call_kpi_histogram("duration", &stats.duration);
+    syslog(LOG_DEBUG, "dial rejected: %u, setup failed: %u, missed: %u\n",
+        stats.dial_rejected, stats.setup_failed, stats.missed);
+
+    for (int i = 0; i < CALL_KPI_DISCONNECT_REASON_COUNT; i++)
+        syslog(LOG_DEBUG, "disconnect reason %d: %u\n", i, stats.disconnect_reasons[i]);
+
+    return OK;
+}
+
+static int telephonytool_cmd_reset_call_kpi(tapi_context context, char* pargs)
+{
+    char dst[1][MAX_INPUT_ARGS_LEN];
+    int cnt = split_input(dst, 1, pargs, " ");
+
+    if (cnt != 1)
+        return -EINVAL;
+
+    if (!is_valid_slot_id_str(dst[0]))
+        return -EINVAL;
+
+    return tapi_call_reset_kpi_stats(context, atoi(dst[0]));
+}
+
 static int telephonytool_cmd_query_modem_list(tapi_context context, char* pargs)
 {
     if (strlen(pargs) > 0)
@@ -2162,17 +2244,27 @@ static int telephonytool_cmd_release_network(tapi_context context, char* pargs)
 
 static int telephonytool_cmd_get_data_call_list(tapi_context context, char* pargs)
 {
+    char dst[2][MAX_INPUT_ARGS_LEN];
+    tapi_data_context_type type = DATA_CONTEXT_TYPE_ANY;
     char* slot_id;
+    int cnt;
 
     if (strlen(pargs) == 0)
         return -EINVAL;
 
-    slot_id = strtok_r(pargs, " ", NULL);
+    cnt = split_input(dst, 2, pargs, " ");
+    if (cnt < 1 || cnt > 2)
+        return -EINVAL;
+
+    slot_id = dst[0];
     if (!is_valid_slot_id_str(slot_id))
         return -EINVAL;
 
-    return tapi_data_get_data_connection_list(context,
-        atoi(slot_id), EVENT_DATA_CALL_LIST_QUERY_DONE, data_event_response);
+    if (cnt == 2)
+        type = atoi(dst[1]);
+
+    return tapi_data_get_data_connection_list_by_type(context, atoi(slot_id),
+        type, EVENT_DATA_CALL_LIST_QUERY_DONE, data_event_response);
 }
 
 static int telephonytool_cmd_set_data_roaming(tapi_context context, char* pargs)
@@ -4513,6 +4605,12 @@ static struct telephonytool_cmd_s g_telephonytool_cmds[] = {
     { "deflect", CALL_CMD,
         telephonytool_cmd_deflect_call,
         "call deflect (enter example : deflect 0 /ril_0/voicecall01 15512345678)" },
+    { "get-call-kpi", CALL_CMD,
+        telephonytool_cmd_get_call_kpi,
+        "get call setup kpi (enter example : get-call-kpi 0 [slot_id])" },
+    { "reset-call-kpi", CALL_CMD,
+        telephonytool_cmd_reset_call_kpi,
+        "reset call setup kpi (enter example : reset-call-kpi 0 [slot_id])" },
 
     /* Data Command */
     { "listen-data", DATA_CMD,
@@ -4548,7 +4646,7 @@ static struct telephonytool_cmd_s g_telephonytool_cmds[] = {
         "release network (enter example : release-network 0 internet [slot_id][apn_type_string])" },
     { "get-data-calls", DATA_CMD,
         telephonytool_cmd_get_data_call_list,
-        "query active data call list (enter example : get-data-calls 0 [slot_id])" },
+        "query active data call list (enter example : get-data-calls 0 1 [slot_id][apn_type, optional])" },
     { "set-data-roaming", DATA_CMD,
         telephonytool_cmd_set_data_roaming,
         "set data roaming (enter example : set-data-roaming 1[state])" },